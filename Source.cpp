@@ -1,10 +1,28 @@
+#include "aes.h"
 #include "app.h"
+#include "chacha20.h"
+#include "poly1305.h"
+#include "sha256.h"
+#include "sha512.h"
 
 #include <cstdio>
 
 int main()
 {
+    using pm::security::aes256;
+    using pm::security::chacha20;
+    using pm::security::poly1305;
+    using pm::security::sha256;
+    using pm::security::sha512;
+
     std::printf("Loading...\n");
 
+    //Check the kernels picked for this CPU before any key is derived or archive sealed with them
+    if (!sha256::self_test() || !sha512::self_test() || !aes256::self_test() || !chacha20::self_test() || !poly1305::self_test())
+    {
+        std::printf("Self-test failed!\n");
+        return 1;
+    }
+
     return pm::app{}.run();
-}
\ No newline at end of file
+}
@@ -0,0 +1,853 @@
+#include "aes.h"
+#include "aes_impl.h"
+#include "secure_memory.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+/*
+ * Implements AES-256 as described in FIPS PUB 197 (November 2001).
+ *
+ * The portable implementation is bitsliced: the state of up to four
+ * blocks is held in eight 64-bit words, word b holding bit b of every
+ * byte. Byte i of block k is found at bit 16 * k + i, so each block
+ * occupies one group of 16 bits, and within a group the byte in row r
+ * and column c of the state is found at bit 4 * c + r.
+ *
+ * The S-box is computed with the circuit of Boyar and Peralta ("A
+ * depth-16 circuit for the AES S-box", 2011) and the other steps
+ * are shifts and masks, so nothing depends on the data but the
+ * values computed.
+ */
+
+using byte = std::uint8_t;
+using word = std::uint64_t;
+
+using pm::security::aes256;
+using pm::security::detail::aes_cbc;
+using pm::security::detail::aes_ctr_fn;
+
+/* Bitsliced operations */
+
+/*
+ * The blocks processed at once by the portable implementation.
+ */
+static constexpr std::size_t const slice_blocks = 4;
+
+/*
+ * Repeats a 16-bit mask into every group of a word.
+ */
+static constexpr word replicate(std::uint16_t mask) noexcept
+{
+    return static_cast<word>(mask) * 0x0001000100010001ull;
+}
+
+/*
+ * Spreads up to four blocks over the eight bit planes. Missing
+ * blocks are left as zero.
+ */
+static void bitslice(byte const (*blocks)[16], std::size_t count, word(&q)[8]) noexcept
+{
+    std::fill(std::begin(q), std::end(q), word{ 0 });
+
+    for (std::size_t k = 0; k < count; k++)
+    {
+        for (std::size_t i = 0; i < 16; i++)
+        {
+            auto const v = blocks[k][i];
+
+            for (std::size_t b = 0; b < 8; b++)
+                q[b] |= static_cast<word>((v >> b) & 1) << (16 * k + i);
+        }
+    }
+}
+
+/*
+ * Gathers the blocks back from the eight bit planes.
+ */
+static void unbitslice(word const(&q)[8], std::size_t count, byte (*blocks)[16]) noexcept
+{
+    for (std::size_t k = 0; k < count; k++)
+    {
+        for (std::size_t i = 0; i < 16; i++)
+        {
+            byte v = 0;
+
+            for (std::size_t b = 0; b < 8; b++)
+                v |= static_cast<byte>(((q[b] >> (16 * k + i)) & 1) << b);
+
+            blocks[k][i] = v;
+        }
+    }
+}
+
+/*
+ * Applies the S-box to every byte of the planes.
+ */
+static void sub_bytes(word(&q)[8]) noexcept
+{
+    //The circuit numbers the bits from the most significant one
+    word const x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4],
+               x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+    //Top linear transformation
+    word const y14 = x3 ^ x5;
+    word const y13 = x0 ^ x6;
+    word const y9  = x0 ^ x3;
+    word const y8  = x0 ^ x5;
+    word const t0  = x1 ^ x2;
+    word const y1  = t0 ^ x7;
+    word const y4  = y1 ^ x3;
+    word const y12 = y13 ^ y14;
+    word const y2  = y1 ^ x0;
+    word const y5  = y1 ^ x6;
+    word const y3  = y5 ^ y8;
+    word const t1  = x4 ^ y12;
+    word const y15 = t1 ^ x5;
+    word const y20 = t1 ^ x1;
+    word const y6  = y15 ^ x7;
+    word const y10 = y15 ^ t0;
+    word const y11 = y20 ^ y9;
+    word const y7  = x7 ^ y11;
+    word const y17 = y10 ^ y11;
+    word const y19 = y10 ^ y8;
+    word const y16 = t0 ^ y11;
+    word const y21 = y13 ^ y16;
+    word const y18 = x0 ^ y16;
+
+    //Shared non-linear middle section
+    word const t2  = y12 & y15;
+    word const t3  = y3 & y6;
+    word const t4  = t3 ^ t2;
+    word const t5  = y4 & x7;
+    word const t6  = t5 ^ t2;
+    word const t7  = y13 & y16;
+    word const t8  = y5 & y1;
+    word const t9  = t8 ^ t7;
+    word const t10 = y2 & y7;
+    word const t11 = t10 ^ t7;
+    word const t12 = y9 & y11;
+    word const t13 = y14 & y17;
+    word const t14 = t13 ^ t12;
+    word const t15 = y8 & y10;
+    word const t16 = t15 ^ t12;
+    word const t17 = t4 ^ t14;
+    word const t18 = t6 ^ t16;
+    word const t19 = t9 ^ t14;
+    word const t20 = t11 ^ t16;
+    word const t21 = t17 ^ y20;
+    word const t22 = t18 ^ y19;
+    word const t23 = t19 ^ y21;
+    word const t24 = t20 ^ y18;
+
+    word const t25 = t21 ^ t22;
+    word const t26 = t21 & t23;
+    word const t27 = t24 ^ t26;
+    word const t28 = t25 & t27;
+    word const t29 = t28 ^ t22;
+    word const t30 = t23 ^ t24;
+    word const t31 = t22 ^ t26;
+    word const t32 = t31 & t30;
+    word const t33 = t32 ^ t24;
+    word const t34 = t23 ^ t33;
+    word const t35 = t27 ^ t33;
+    word const t36 = t24 & t35;
+    word const t37 = t36 ^ t34;
+    word const t38 = t27 ^ t36;
+    word const t39 = t29 & t38;
+    word const t40 = t25 ^ t39;
+
+    word const t41 = t40 ^ t37;
+    word const t42 = t29 ^ t33;
+    word const t43 = t29 ^ t40;
+    word const t44 = t33 ^ t37;
+    word const t45 = t42 ^ t41;
+    word const z0  = t44 & y15;
+    word const z1  = t37 & y6;
+    word const z2  = t33 & x7;
+    word const z3  = t43 & y16;
+    word const z4  = t40 & y1;
+    word const z5  = t29 & y7;
+    word const z6  = t42 & y11;
+    word const z7  = t45 & y17;
+    word const z8  = t41 & y10;
+    word const z9  = t44 & y12;
+    word const z10 = t37 & y3;
+    word const z11 = t33 & y4;
+    word const z12 = t43 & y13;
+    word const z13 = t40 & y5;
+    word const z14 = t29 & y2;
+    word const z15 = t42 & y9;
+    word const z16 = t45 & y14;
+    word const z17 = t41 & y8;
+
+    //Bottom linear transformation
+    word const t46 = z15 ^ z16;
+    word const t47 = z10 ^ z11;
+    word const t48 = z5 ^ z13;
+    word const t49 = z9 ^ z10;
+    word const t50 = z2 ^ z12;
+    word const t51 = z2 ^ z5;
+    word const t52 = z7 ^ z8;
+    word const t53 = z0 ^ z3;
+    word const t54 = z6 ^ z7;
+    word const t55 = z16 ^ z17;
+    word const t56 = z12 ^ t48;
+    word const t57 = t50 ^ t53;
+    word const t58 = z4 ^ t46;
+    word const t59 = z3 ^ t54;
+    word const t60 = t46 ^ t57;
+    word const t61 = z14 ^ t57;
+    word const t62 = t52 ^ t58;
+    word const t63 = t49 ^ t58;
+    word const t64 = z4 ^ t59;
+    word const t65 = t61 ^ t62;
+    word const t66 = z1 ^ t63;
+    word const s0  = t59 ^ t63;
+    word const s6  = t56 ^ ~t62;
+    word const s7  = t48 ^ ~t60;
+    word const t67 = t64 ^ t65;
+    word const s3  = t53 ^ t66;
+    word const s4  = t51 ^ t66;
+    word const s5  = t47 ^ t65;
+    word const s1  = t64 ^ ~s3;
+    word const s2  = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+/*
+ * Applies the inverse of the affine transformation of the S-box,
+ * which turns the S-box into its own inverse when applied on both
+ * sides of it.
+ */
+static void inverse_affine(word(&q)[8]) noexcept
+{
+    word const q0 = ~q[0], q1 = ~q[1], q2 = q[2], q3 = q[3],
+               q4 =  q[4], q5 = ~q[5], q6 = ~q[6], q7 = q[7];
+
+    q[7] = q1 ^ q4 ^ q6;
+    q[6] = q0 ^ q3 ^ q5;
+    q[5] = q7 ^ q2 ^ q4;
+    q[4] = q6 ^ q1 ^ q3;
+    q[3] = q5 ^ q0 ^ q2;
+    q[2] = q4 ^ q7 ^ q1;
+    q[1] = q3 ^ q6 ^ q0;
+    q[0] = q2 ^ q5 ^ q7;
+}
+
+/*
+ * Applies the inverse S-box to every byte of the planes.
+ */
+static void inverse_sub_bytes(word(&q)[8]) noexcept
+{
+    inverse_affine(q);
+    sub_bytes(q);
+    inverse_affine(q);
+}
+
+/*
+ * Moves the bytes of row r, found in the plane bits selected by the
+ * row mask, r columns to the left when inverse is false, or to the
+ * right when it is true.
+ */
+static word shift_row(word x, unsigned r, bool inverse) noexcept
+{
+    auto const s    = 4 * r;
+    auto const low  = replicate(static_cast<std::uint16_t>((1u << (16 - s)) - 1));
+    auto const high = replicate(static_cast<std::uint16_t>(~((1u << (16 - s)) - 1)));
+
+    if (!inverse) return ((x >> s) & low) | ((x << (16 - s)) & high);
+
+    auto const right = replicate(static_cast<std::uint16_t>(~((1u << s) - 1)));
+    auto const left  = replicate(static_cast<std::uint16_t>((1u << s) - 1));
+
+    return ((x << s) & right) | ((x >> (16 - s)) & left);
+}
+
+static void shift_rows(word(&q)[8], bool inverse) noexcept
+{
+    constexpr word const row0 = replicate(0x1111);
+
+    for (auto& x : q)
+    {
+        x = (x & row0)
+          | shift_row(x & (row0 << 1), 1, inverse)
+          | shift_row(x & (row0 << 2), 2, inverse)
+          | shift_row(x & (row0 << 3), 3, inverse);
+    }
+}
+
+/*
+ * Replaces each byte by the one n rows further down its column.
+ */
+template<unsigned n>
+static word rotate_rows(word x) noexcept
+{
+    constexpr word const low  = replicate(static_cast<std::uint16_t>(0x1111 * ((1u << (4 - n)) - 1)));
+    constexpr word const high = ~low;
+
+    return ((x >> n) & low) | ((x << (4 - n)) & high);
+}
+
+/*
+ * Multiplies every byte by x in GF(2^8).
+ */
+static void xtime(word const(&a)[8], word(&r)[8]) noexcept
+{
+    r[0] = a[7];
+    r[1] = a[0] ^ a[7];
+    r[2] = a[1];
+    r[3] = a[2] ^ a[7];
+    r[4] = a[3] ^ a[7];
+    r[5] = a[4];
+    r[6] = a[5];
+    r[7] = a[6];
+}
+
+static void mix_columns(word(&q)[8]) noexcept
+{
+    //b[r] = 2 * (a[r] ^ a[r + 1]) ^ a[r + 1] ^ a[r + 2] ^ a[r + 3]
+    word t[8], u[8];
+    for (std::size_t b = 0; b < 8; b++) t[b] = q[b] ^ rotate_rows<1>(q[b]);
+
+    xtime(t, u);
+
+    for (std::size_t b = 0; b < 8; b++)
+        q[b] = u[b] ^ rotate_rows<1>(q[b]) ^ rotate_rows<2>(q[b]) ^ rotate_rows<3>(q[b]);
+}
+
+static void inverse_mix_columns(word(&q)[8]) noexcept
+{
+    //Multiplying by 4 * (a[r] ^ a[r + 2]) first turns the inverse into the forward transformation
+    word t[8], u[8], v[8];
+    for (std::size_t b = 0; b < 8; b++) t[b] = q[b] ^ rotate_rows<2>(q[b]);
+
+    xtime(t, u);
+    xtime(u, v);
+
+    for (std::size_t b = 0; b < 8; b++) q[b] ^= v[b];
+
+    mix_columns(q);
+}
+
+static void add_round_key(word(&q)[8], word const(&k)[8]) noexcept
+{
+    for (std::size_t b = 0; b < 8; b++) q[b] ^= k[b];
+}
+
+/*
+ * Spreads the round keys over bit planes, repeated for every block.
+ */
+static void bitslice_round_keys(byte const (*round_keys)[16], word(&keys)[aes256::rounds + 1][8]) noexcept
+{
+    for (std::size_t r = 0; r <= aes256::rounds; r++)
+    {
+        bitslice(round_keys + r, 1, keys[r]);
+
+        for (auto& x : keys[r]) x = replicate(static_cast<std::uint16_t>(x));
+    }
+}
+
+static void encrypt_slices(word const(&keys)[aes256::rounds + 1][8], word(&q)[8]) noexcept
+{
+    add_round_key(q, keys[0]);
+
+    for (std::size_t r = 1; r < aes256::rounds; r++)
+    {
+        sub_bytes(q);
+        shift_rows(q, false);
+        mix_columns(q);
+        add_round_key(q, keys[r]);
+    }
+
+    sub_bytes(q);
+    shift_rows(q, false);
+    add_round_key(q, keys[aes256::rounds]);
+}
+
+static void decrypt_slices(word const(&keys)[aes256::rounds + 1][8], word(&q)[8]) noexcept
+{
+    add_round_key(q, keys[aes256::rounds]);
+
+    for (std::size_t r = aes256::rounds - 1; r > 0; r--)
+    {
+        shift_rows(q, true);
+        inverse_sub_bytes(q);
+        add_round_key(q, keys[r]);
+        inverse_mix_columns(q);
+    }
+
+    shift_rows(q, true);
+    inverse_sub_bytes(q);
+    add_round_key(q, keys[0]);
+}
+
+/* Key expansion */
+
+/*
+ * Applies the S-box to the four bytes of a word of the key.
+ */
+static void sub_word(byte(&w)[4]) noexcept
+{
+    byte block[1][16]{};
+    std::copy(std::begin(w), std::end(w), block[0]);
+
+    word q[8];
+    bitslice(block, 1, q);
+    sub_bytes(q);
+    unbitslice(q, 1, block);
+
+    std::copy(block[0], block[0] + 4, w);
+}
+
+/*
+ * Multiplies a byte by x in GF(2^8) without branching on it.
+ */
+static byte gf_double(byte x) noexcept
+{
+    return static_cast<byte>((x << 1) ^ (0x1B & (0u - (x >> 7))));
+}
+
+/*
+ * Applies InvMixColumns to a round key, giving the round key of
+ * the equivalent inverse cipher.
+ */
+static void inverse_mix_round_key(byte const* in, byte* out) noexcept
+{
+    for (std::size_t c = 0; c < 4; c++)
+    {
+        byte const* a = in + 4 * c;
+
+        //Multiply each byte by 2, 4 and 8
+        byte a2[4], a4[4], a8[4];
+        for (std::size_t r = 0; r < 4; r++)
+        {
+            a2[r] = gf_double(a[r]);
+            a4[r] = gf_double(a2[r]);
+            a8[r] = gf_double(a4[r]);
+        }
+
+        for (std::size_t r = 0; r < 4; r++)
+        {
+            auto const i0 = r, i1 = (r + 1) % 4, i2 = (r + 2) % 4, i3 = (r + 3) % 4;
+
+            //14 * a0 ^ 11 * a1 ^ 13 * a2 ^ 9 * a3
+            out[4 * c + r] = static_cast<byte>
+            (
+                (a8[i0] ^ a4[i0] ^ a2[i0])         ^
+                (a8[i1] ^ a2[i1] ^ a[i1])          ^
+                (a8[i2] ^ a4[i2] ^ a[i2])          ^
+                (a8[i3] ^ a[i3])
+            );
+        }
+    }
+}
+
+void pm::security::aes256::expand_key(byte const* key, key_schedule* schedule) noexcept
+{
+    constexpr std::size_t const nk    = key_length / 4;
+    constexpr std::size_t const words = 4 * (rounds + 1);
+
+    auto* w = &schedule->encryption[0][0];
+
+    //The first words are the key itself
+    std::memcpy(w, key, key_length);
+
+    byte rcon = 0x01;
+    for (std::size_t i = nk; i < words; i++)
+    {
+        byte t[4];
+        std::copy(w + 4 * (i - 1), w + 4 * i, t);
+
+        if (i % nk == 0)
+        {
+            //RotWord, SubWord and the round constant
+            std::rotate(t, t + 1, t + 4);
+            sub_word(t);
+
+            t[0] ^= rcon;
+            rcon  = gf_double(rcon);
+        }
+        else if (i % nk == 4)
+        {
+            sub_word(t);
+        }
+
+        for (std::size_t j = 0; j < 4; j++)
+            w[4 * i + j] = static_cast<byte>(w[4 * (i - nk) + j] ^ t[j]);
+    }
+
+    //The equivalent inverse cipher uses the keys backwards, with InvMixColumns applied to the inner ones
+    std::memcpy(schedule->decryption[0], schedule->encryption[rounds], block_length);
+
+    for (std::size_t r = 1; r < rounds; r++)
+        inverse_mix_round_key(schedule->encryption[rounds - r], schedule->decryption[r]);
+
+    std::memcpy(schedule->decryption[rounds], schedule->encryption[0], block_length);
+}
+
+/* Implementation */
+
+void pm::security::detail::aes_encrypt_cbc_portable(aes256::key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    word keys[aes256::rounds + 1][8];
+    bitslice_round_keys(schedule.encryption, keys);
+
+    //Each block depends on the one before, so they go one at a time
+    byte block[1][16];
+    std::memcpy(block[0], iv, 16);
+
+    for (std::size_t i = 0; i < block_count; i++, in += 16, out += 16)
+    {
+        for (std::size_t j = 0; j < 16; j++) block[0][j] ^= in[j];
+
+        word q[8];
+        bitslice(block, 1, q);
+        encrypt_slices(keys, q);
+        unbitslice(q, 1, block);
+
+        std::memcpy(out, block[0], 16);
+    }
+
+    std::memcpy(iv, block[0], 16);
+
+    pm::secure_wipe(keys, sizeof(keys));
+}
+
+void pm::security::detail::aes_decrypt_cbc_portable(aes256::key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    word keys[aes256::rounds + 1][8];
+    bitslice_round_keys(schedule.encryption, keys);
+
+    //Decryption has no such dependency, so the blocks are decrypted together
+    byte chain[slice_blocks + 1][16];
+    byte blocks[slice_blocks][16];
+
+    std::memcpy(chain[0], iv, 16);
+
+    while (block_count > 0)
+    {
+        auto const count = std::min(block_count, slice_blocks);
+
+        //Keep the ciphertext, the output may overwrite it
+        std::memcpy(chain[1], in, count * 16);
+        std::memcpy(blocks,   in, count * 16);
+
+        word q[8];
+        bitslice(blocks, count, q);
+        decrypt_slices(keys, q);
+        unbitslice(q, count, blocks);
+
+        for (std::size_t k = 0; k < count; k++)
+        {
+            for (std::size_t j = 0; j < 16; j++) out[16 * k + j] = static_cast<byte>(blocks[k][j] ^ chain[k][j]);
+        }
+
+        std::memcpy(chain[0], chain[count], 16);
+
+        in          += count * 16;
+        out         += count * 16;
+        block_count -= count;
+    }
+
+    std::memcpy(iv, chain[0], 16);
+
+    pm::secure_wipe(keys,   sizeof(keys));
+    pm::secure_wipe(blocks, sizeof(blocks));
+}
+
+/*
+ * Increments a counter block as a 128-bit big-endian integer.
+ */
+static void increment_counter(byte* counter) noexcept
+{
+    for (std::size_t i = 16; i-- > 0; )
+    {
+        if (++counter[i] != 0) break;
+    }
+}
+
+void pm::security::detail::aes_crypt_ctr_portable(aes256::key_schedule const& schedule, byte* counter, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    word keys[aes256::rounds + 1][8];
+    bitslice_round_keys(schedule.encryption, keys);
+
+    //The counter blocks do not depend on each other, so they are encrypted together
+    byte blocks[slice_blocks][16];
+
+    while (block_count > 0)
+    {
+        auto const count = std::min(block_count, slice_blocks);
+
+        for (std::size_t k = 0; k < count; k++)
+        {
+            std::memcpy(blocks[k], counter, 16);
+            increment_counter(counter);
+        }
+
+        word q[8];
+        bitslice(blocks, count, q);
+        encrypt_slices(keys, q);
+        unbitslice(q, count, blocks);
+
+        for (std::size_t k = 0; k < count; k++)
+        {
+            for (std::size_t j = 0; j < 16; j++) out[16 * k + j] = static_cast<byte>(in[16 * k + j] ^ blocks[k][j]);
+        }
+
+        in          += count * 16;
+        out         += count * 16;
+        block_count -= count;
+    }
+
+    pm::secure_wipe(keys,   sizeof(keys));
+    pm::secure_wipe(blocks, sizeof(blocks));
+}
+
+/*
+ * Picks the fastest implementation supported by the processor.
+ */
+static aes_cbc select_cbc() noexcept
+{
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    if (cpu.aesni) return { pm::security::detail::aes_encrypt_cbc_aesni, pm::security::detail::aes_decrypt_cbc_aesni };
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    if (cpu.aes) return { pm::security::detail::aes_encrypt_cbc_armv8, pm::security::detail::aes_decrypt_cbc_armv8 };
+#endif
+
+    return { pm::security::detail::aes_encrypt_cbc_portable, pm::security::detail::aes_decrypt_cbc_portable };
+}
+
+static aes_ctr_fn select_ctr() noexcept
+{
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    if (cpu.aesni) return pm::security::detail::aes_crypt_ctr_aesni;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    if (cpu.aes) return pm::security::detail::aes_crypt_ctr_armv8;
+#endif
+
+    return pm::security::detail::aes_crypt_ctr_portable;
+}
+
+pm::security::detail::aes_cbc pm::security::detail::get_aes_cbc() noexcept
+{
+    static aes_cbc const cbc = select_cbc();
+
+    return cbc;
+}
+
+pm::security::detail::aes_ctr_fn pm::security::detail::get_aes_ctr() noexcept
+{
+    static aes_ctr_fn const ctr = select_ctr();
+
+    return ctr;
+}
+
+void pm::security::aes256::encrypt_cbc(key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    detail::get_aes_cbc().encrypt(schedule, iv, in, out, block_count);
+}
+
+void pm::security::aes256::decrypt_cbc(key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    detail::get_aes_cbc().decrypt(schedule, iv, in, out, block_count);
+}
+
+void pm::security::aes256::crypt_ctr(key_schedule const& schedule, byte* counter, byte const* in, byte* out, std::size_t length) noexcept
+{
+    auto const crypt = detail::get_aes_ctr();
+
+    //Whole blocks go straight through
+    auto const block_count = length / block_length;
+    crypt(schedule, counter, in, out, block_count);
+
+    //A partial block at the end uses the start of one more block of key stream
+    auto const remainder = length % block_length;
+    if (remainder != 0)
+    {
+        byte block[block_length]{};
+        std::memcpy(block, in + block_count * block_length, remainder);
+        crypt(schedule, counter, block, block, 1);
+        std::memcpy(out + block_count * block_length, block, remainder);
+
+        pm::secure_wipe(block, sizeof(block));
+    }
+}
+
+void pm::security::aes256::add_to_counter(byte* counter, std::uint64_t block_count) noexcept
+{
+    //Add a byte at a time from the end, carrying into the bytes before
+    unsigned carry = 0;
+    for (std::size_t i = block_length; i-- > 0; )
+    {
+        auto const sum = counter[i] + static_cast<unsigned>(block_count & 0xFF) + carry;
+
+        counter[i]    = static_cast<byte>(sum);
+        carry         = sum >> 8;
+        block_count >>= 8;
+    }
+}
+
+/*
+ * The AES-256 example of FIPS PUB 197 appendix C.3, and the
+ * CBC-AES256 and CTR-AES256 examples of NIST SP 800-38A
+ * appendices F.2.5 and F.5.5.
+ */
+static constexpr byte const fips197_key[32]
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F
+};
+
+static constexpr byte const fips197_plaintext[16]
+{
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+};
+
+static constexpr byte const fips197_ciphertext[16]
+{
+    0x8E, 0xA2, 0xB7, 0xCA, 0x51, 0x67, 0x45, 0xBF, 0xEA, 0xFC, 0x49, 0x90, 0x4B, 0x49, 0x60, 0x89
+};
+
+static constexpr byte const sp800_38a_key[32]
+{
+    0x60, 0x3D, 0xEB, 0x10, 0x15, 0xCA, 0x71, 0xBE, 0x2B, 0x73, 0xAE, 0xF0, 0x85, 0x7D, 0x77, 0x81,
+    0x1F, 0x35, 0x2C, 0x07, 0x3B, 0x61, 0x08, 0xD7, 0x2D, 0x98, 0x10, 0xA3, 0x09, 0x14, 0xDF, 0xF4
+};
+
+static constexpr byte const sp800_38a_iv[16]
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+static constexpr byte const sp800_38a_plaintext[64]
+{
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+};
+
+static constexpr byte const sp800_38a_ciphertext[64]
+{
+    0xF5, 0x8C, 0x4C, 0x04, 0xD6, 0xE5, 0xF1, 0xBA, 0x77, 0x9E, 0xAB, 0xFB, 0x5F, 0x7B, 0xFB, 0xD6,
+    0x9C, 0xFC, 0x4E, 0x96, 0x7E, 0xDB, 0x80, 0x8D, 0x67, 0x9F, 0x77, 0x7B, 0xC6, 0x70, 0x2C, 0x7D,
+    0x39, 0xF2, 0x33, 0x69, 0xA9, 0xD9, 0xBA, 0xCF, 0xA5, 0x30, 0xE2, 0x63, 0x04, 0x23, 0x14, 0x61,
+    0xB2, 0xEB, 0x05, 0xE2, 0xC3, 0x9B, 0xE9, 0xFC, 0xDA, 0x6C, 0x19, 0x07, 0x8C, 0x6A, 0x9D, 0x1B
+};
+
+static constexpr byte const sp800_38a_counter[16]
+{
+    0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+static constexpr byte const sp800_38a_ctr_ciphertext[64]
+{
+    0x60, 0x1E, 0xC3, 0x13, 0x77, 0x57, 0x89, 0xA5, 0xB7, 0xA7, 0xF5, 0x04, 0xBB, 0xF3, 0xD2, 0x28,
+    0xF4, 0x43, 0xE3, 0xCA, 0x4D, 0x62, 0xB5, 0x9A, 0xCA, 0x84, 0xE9, 0x90, 0xCA, 0xCA, 0xF5, 0xC5,
+    0x2B, 0x09, 0x30, 0xDA, 0xA2, 0x3D, 0xE9, 0x4C, 0xE8, 0x70, 0x17, 0xBA, 0x2D, 0x84, 0x98, 0x8D,
+    0xDF, 0xC9, 0xC5, 0x8D, 0xB6, 0x7A, 0xAD, 0xA6, 0x13, 0xC2, 0xDD, 0x08, 0x45, 0x79, 0x41, 0xA6
+};
+
+bool pm::security::aes256::self_test() noexcept
+{
+    //Gather every implementation this processor can run
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+    struct implementation
+    {
+        aes_cbc    cbc;
+        aes_ctr_fn ctr;
+        bool       supported;
+    };
+
+    implementation const implementations[]
+    {
+        { { detail::aes_encrypt_cbc_portable, detail::aes_decrypt_cbc_portable }, detail::aes_crypt_ctr_portable, true },
+#if defined(PM_ARCH_X86)
+        { { detail::aes_encrypt_cbc_aesni,    detail::aes_decrypt_cbc_aesni    }, detail::aes_crypt_ctr_aesni,    cpu.aesni },
+#endif
+#if defined(PM_ARCH_ARM64)
+        { { detail::aes_encrypt_cbc_armv8,    detail::aes_decrypt_cbc_armv8    }, detail::aes_crypt_ctr_armv8,    cpu.aes },
+#endif
+    };
+
+    //Runs a single test in both directions, in place and out of place
+    auto const check = [](aes_cbc cbc, byte const* key, byte const* iv, byte const* plaintext, byte const* ciphertext, std::size_t block_count) noexcept
+    {
+        key_schedule schedule;
+        expand_key(key, &schedule);
+
+        byte buffer[64];
+        byte chain [16];
+
+        std::memcpy(chain, iv, 16);
+        cbc.encrypt(schedule, chain, plaintext, buffer, block_count);
+        if (!std::equal(buffer, buffer + 16 * block_count, ciphertext)) return false;
+
+        std::memcpy(chain, iv, 16);
+        cbc.decrypt(schedule, chain, buffer, buffer, block_count);
+        if (!std::equal(buffer, buffer + 16 * block_count, plaintext)) return false;
+
+        return true;
+    };
+
+    //Runs the counter mode test both ways, which is the same operation
+    auto const check_ctr = [](aes_ctr_fn ctr) noexcept
+    {
+        key_schedule schedule;
+        expand_key(sp800_38a_key, &schedule);
+
+        byte buffer [64];
+        byte counter[16];
+
+        std::memcpy(counter, sp800_38a_counter, 16);
+        ctr(schedule, counter, sp800_38a_plaintext, buffer, 4);
+        if (!std::equal(buffer, buffer + 64, sp800_38a_ctr_ciphertext)) return false;
+
+        //The counter is left at the block after the last one used
+        byte expected[16];
+        std::memcpy(expected, sp800_38a_counter, 16);
+        add_to_counter(expected, 4);
+        if (!std::equal(counter, counter + 16, expected)) return false;
+
+        std::memcpy(counter, sp800_38a_counter, 16);
+        ctr(schedule, counter, buffer, buffer, 4);
+        if (!std::equal(buffer, buffer + 64, sp800_38a_plaintext)) return false;
+
+        return true;
+    };
+
+    //With an IV of zero, a single block of CBC is the bare cipher
+    byte const zero_iv[16]{};
+
+    for (auto const& [cbc, ctr, supported] : implementations)
+    {
+        if (!supported) continue;
+
+        if (!check(cbc, fips197_key,   zero_iv,      fips197_plaintext,   fips197_ciphertext,   1)) return false;
+        if (!check(cbc, sp800_38a_key, sp800_38a_iv, sp800_38a_plaintext, sp800_38a_ciphertext, 4)) return false;
+        if (!check_ctr(ctr))                                                                         return false;
+    }
+
+    return true;
+}
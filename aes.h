@@ -0,0 +1,89 @@
+#ifndef PM_AES_H
+#define PM_AES_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Implements AES-256 as described in FIPS PUB 197 (November 2001),
+ * in the CBC mode of NIST SP 800-38A without any padding, which is
+ * what BCrypt does when it is given no flags, and in the CTR mode
+ * of the same document.
+ *
+ * The fastest implementation the processor supports is picked at
+ * run-time. Without AES instructions a bitsliced implementation is
+ * used, which does not index memory with secret data and so runs
+ * in constant time.
+ */
+
+namespace pm::security
+{
+    struct aes256
+    {
+        static constexpr std::size_t const block_length = 16;
+        static constexpr std::size_t const key_length   = 32;
+        static constexpr std::size_t const rounds       = 14;
+
+        using byte = std::uint8_t;
+
+        /*
+         * The expanded key. The decryption round keys are those of
+         * the equivalent inverse cipher, in the order they are used.
+         */
+        struct key_schedule
+        {
+            alignas(16) byte encryption[rounds + 1][block_length];
+            alignas(16) byte decryption[rounds + 1][block_length];
+        };
+
+        /*
+         * Expands a key of key_length bytes into the round keys.
+         */
+        static void expand_key(byte const* key, key_schedule* schedule) noexcept;
+
+        /*
+         * Encrypts a number of whole blocks in CBC mode. The IV is
+         * replaced by the last block of ciphertext, so a message can
+         * be encrypted a piece at a time. The input and output may
+         * be the same buffer.
+         */
+        static void encrypt_cbc(key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept;
+
+        /*
+         * Decrypts a number of whole blocks in CBC mode. The IV is
+         * replaced by the last block of ciphertext, so a message can
+         * be decrypted a piece at a time. The input and output may
+         * be the same buffer.
+         */
+        static void decrypt_cbc(key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept;
+
+        /*
+         * Encrypts or decrypts in CTR mode, which are the same thing.
+         * The counter block is incremented as a 128-bit big-endian
+         * integer, and is left at the counter of the block after the
+         * last one, so a message can be processed a piece at a time.
+         * Only the last piece of a message may end partway through a
+         * block. The input and output may be the same buffer.
+         */
+        static void crypt_ctr(key_schedule const& schedule, byte* counter, byte const* in, byte* out, std::size_t length) noexcept;
+
+        /*
+         * Advances a counter block by a number of blocks, to start
+         * CTR mode partway through a message.
+         */
+        static void add_to_counter(byte* counter, std::uint64_t block_count) noexcept;
+
+        /*
+         * Runs the known-answer tests from FIPS PUB 197 and NIST
+         * SP 800-38A against every implementation supported by the
+         * processor, in both modes. Returns false if any of them got
+         * it wrong.
+         */
+        static bool self_test() noexcept;
+
+        aes256() = delete;
+    };
+};
+
+#endif
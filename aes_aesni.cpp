@@ -0,0 +1,205 @@
+#include "aes_impl.h"
+
+/*
+ * Implements AES-256 using the AES-NI instructions.
+ * Only called after the processor has been checked for support.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <cstring>
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("aes,sse2")
+#endif
+
+using byte = pm::security::aes256::byte;
+
+using pm::security::aes256;
+
+/*
+ * The blocks decrypted at once, enough to keep the AES unit busy
+ * while each instruction waits for the one before it.
+ */
+static constexpr std::size_t const parallel_blocks = 4;
+
+/*
+ * The counter blocks encrypted at once. Counter mode has no chain
+ * at all, so more blocks fit in flight than for CBC decryption.
+ */
+static constexpr std::size_t const ctr_parallel_blocks = 8;
+
+static inline __m128i load_key(byte const(&key)[16]) noexcept
+{
+    return _mm_load_si128(reinterpret_cast<__m128i const*>(key));
+}
+
+static inline __m128i load_block(byte const* p) noexcept
+{
+    return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+}
+
+static inline void store_block(byte* p, __m128i x) noexcept
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+}
+
+static inline std::uint64_t byte_swap(std::uint64_t x) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_uint64(x);
+#else
+    return __builtin_bswap64(x);
+#endif
+}
+
+/*
+ * Holds the 128-bit big-endian counter as two native halves, which
+ * are cheaper to step than the bytes of the block.
+ */
+struct counter_block
+{
+    std::uint64_t high;
+    std::uint64_t low;
+
+    static counter_block load(byte const* p) noexcept
+    {
+        std::uint64_t high, low;
+        std::memcpy(&high, p,     8);
+        std::memcpy(&low,  p + 8, 8);
+
+        return { byte_swap(high), byte_swap(low) };
+    }
+
+    void store(byte* p) const noexcept
+    {
+        auto const high = byte_swap(this->high);
+        auto const low  = byte_swap(this->low);
+        std::memcpy(p,     &high, 8);
+        std::memcpy(p + 8, &low,  8);
+    }
+
+    //Returns the current block and steps to the next one
+    __m128i next() noexcept
+    {
+        auto const block = _mm_set_epi64x(static_cast<long long>(byte_swap(this->low)), static_cast<long long>(byte_swap(this->high)));
+
+        if (++this->low == 0) this->high++;
+
+        return block;
+    }
+};
+
+void pm::security::detail::aes_encrypt_cbc_aesni(aes256::key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    __m128i keys[aes256::rounds + 1];
+    for (std::size_t r = 0; r <= aes256::rounds; r++) keys[r] = load_key(schedule.encryption[r]);
+
+    //Each block depends on the one before, so they go one at a time
+    auto chain = load_block(iv);
+
+    for (std::size_t i = 0; i < block_count; i++, in += 16, out += 16)
+    {
+        auto x = _mm_xor_si128(_mm_xor_si128(load_block(in), chain), keys[0]);
+
+        for (std::size_t r = 1; r < aes256::rounds; r++) x = _mm_aesenc_si128(x, keys[r]);
+
+        chain = _mm_aesenclast_si128(x, keys[aes256::rounds]);
+        store_block(out, chain);
+    }
+
+    store_block(iv, chain);
+}
+
+void pm::security::detail::aes_decrypt_cbc_aesni(aes256::key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    __m128i keys[aes256::rounds + 1];
+    for (std::size_t r = 0; r <= aes256::rounds; r++) keys[r] = load_key(schedule.decryption[r]);
+
+    auto chain = load_block(iv);
+
+    //Decryption has no such dependency, so several blocks are in flight at once
+    for (; block_count >= parallel_blocks; block_count -= parallel_blocks, in += 16 * parallel_blocks, out += 16 * parallel_blocks)
+    {
+        __m128i c[parallel_blocks], x[parallel_blocks];
+
+        for (std::size_t k = 0; k < parallel_blocks; k++)
+        {
+            c[k] = load_block(in + 16 * k);
+            x[k] = _mm_xor_si128(c[k], keys[0]);
+        }
+
+        for (std::size_t r = 1; r < aes256::rounds; r++)
+        {
+            for (std::size_t k = 0; k < parallel_blocks; k++) x[k] = _mm_aesdec_si128(x[k], keys[r]);
+        }
+
+        for (std::size_t k = 0; k < parallel_blocks; k++)
+        {
+            x[k] = _mm_aesdeclast_si128(x[k], keys[aes256::rounds]);
+
+            store_block(out + 16 * k, _mm_xor_si128(x[k], chain));
+            chain = c[k];
+        }
+    }
+
+    //Finish the remaining blocks one at a time
+    for (; block_count > 0; block_count--, in += 16, out += 16)
+    {
+        auto const c = load_block(in);
+        auto       x = _mm_xor_si128(c, keys[0]);
+
+        for (std::size_t r = 1; r < aes256::rounds; r++) x = _mm_aesdec_si128(x, keys[r]);
+
+        x = _mm_aesdeclast_si128(x, keys[aes256::rounds]);
+
+        store_block(out, _mm_xor_si128(x, chain));
+        chain = c;
+    }
+
+    store_block(iv, chain);
+}
+
+void pm::security::detail::aes_crypt_ctr_aesni(aes256::key_schedule const& schedule, byte* counter, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    __m128i keys[aes256::rounds + 1];
+    for (std::size_t r = 0; r <= aes256::rounds; r++) keys[r] = load_key(schedule.encryption[r]);
+
+    auto ctr = counter_block::load(counter);
+
+    for (; block_count >= ctr_parallel_blocks; block_count -= ctr_parallel_blocks, in += 16 * ctr_parallel_blocks, out += 16 * ctr_parallel_blocks)
+    {
+        __m128i x[ctr_parallel_blocks];
+
+        for (std::size_t k = 0; k < ctr_parallel_blocks; k++) x[k] = _mm_xor_si128(ctr.next(), keys[0]);
+
+        for (std::size_t r = 1; r < aes256::rounds; r++)
+        {
+            for (std::size_t k = 0; k < ctr_parallel_blocks; k++) x[k] = _mm_aesenc_si128(x[k], keys[r]);
+        }
+
+        for (std::size_t k = 0; k < ctr_parallel_blocks; k++)
+        {
+            x[k] = _mm_aesenclast_si128(x[k], keys[aes256::rounds]);
+
+            store_block(out + 16 * k, _mm_xor_si128(x[k], load_block(in + 16 * k)));
+        }
+    }
+
+    //Finish the remaining blocks one at a time
+    for (; block_count > 0; block_count--, in += 16, out += 16)
+    {
+        auto x = _mm_xor_si128(ctr.next(), keys[0]);
+
+        for (std::size_t r = 1; r < aes256::rounds; r++) x = _mm_aesenc_si128(x, keys[r]);
+
+        x = _mm_aesenclast_si128(x, keys[aes256::rounds]);
+
+        store_block(out, _mm_xor_si128(x, load_block(in)));
+    }
+
+    ctr.store(counter);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#include "aes_impl.h"
+
+/*
+ * Implements AES-256 using the ARMv8 cryptography extensions.
+ * Only called after the processor has been checked for support.
+ */
+
+#if defined(PM_ARCH_ARM64)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <arm64_neon.h>
+#else
+#   include <arm_neon.h>
+#endif
+
+#if defined(__clang__)
+#   pragma clang attribute push(__attribute__((target("crypto"))), apply_to = function)
+#elif defined(__GNUC__)
+#   pragma GCC target("+crypto")
+#endif
+
+using byte = pm::security::aes256::byte;
+
+using pm::security::aes256;
+
+/*
+ * The blocks decrypted at once, enough to keep the AES unit busy
+ * while each instruction waits for the one before it.
+ */
+static constexpr std::size_t const parallel_blocks = 4;
+
+/*
+ * The counter blocks encrypted at once. Counter mode has no chain
+ * at all, so more blocks fit in flight than for CBC decryption.
+ */
+static constexpr std::size_t const ctr_parallel_blocks = 8;
+
+/*
+ * AESE and AESD add the round key before substituting the bytes
+ * rather than after mixing the columns, so every round key moves
+ * one round earlier and the last one is added on its own.
+ */
+
+void pm::security::detail::aes_encrypt_cbc_armv8(aes256::key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    uint8x16_t keys[aes256::rounds + 1];
+    for (std::size_t r = 0; r <= aes256::rounds; r++) keys[r] = vld1q_u8(schedule.encryption[r]);
+
+    //Each block depends on the one before, so they go one at a time
+    auto chain = vld1q_u8(iv);
+
+    for (std::size_t i = 0; i < block_count; i++, in += 16, out += 16)
+    {
+        auto x = veorq_u8(vld1q_u8(in), chain);
+
+        for (std::size_t r = 0; r < aes256::rounds - 1; r++) x = vaesmcq_u8(vaeseq_u8(x, keys[r]));
+
+        x     = vaeseq_u8(x, keys[aes256::rounds - 1]);
+        chain = veorq_u8(x, keys[aes256::rounds]);
+
+        vst1q_u8(out, chain);
+    }
+
+    vst1q_u8(iv, chain);
+}
+
+void pm::security::detail::aes_decrypt_cbc_armv8(aes256::key_schedule const& schedule, byte* iv, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    uint8x16_t keys[aes256::rounds + 1];
+    for (std::size_t r = 0; r <= aes256::rounds; r++) keys[r] = vld1q_u8(schedule.decryption[r]);
+
+    auto chain = vld1q_u8(iv);
+
+    //Decryption has no such dependency, so several blocks are in flight at once
+    for (; block_count >= parallel_blocks; block_count -= parallel_blocks, in += 16 * parallel_blocks, out += 16 * parallel_blocks)
+    {
+        uint8x16_t c[parallel_blocks], x[parallel_blocks];
+
+        for (std::size_t k = 0; k < parallel_blocks; k++) x[k] = c[k] = vld1q_u8(in + 16 * k);
+
+        for (std::size_t r = 0; r < aes256::rounds - 1; r++)
+        {
+            for (std::size_t k = 0; k < parallel_blocks; k++) x[k] = vaesimcq_u8(vaesdq_u8(x[k], keys[r]));
+        }
+
+        for (std::size_t k = 0; k < parallel_blocks; k++)
+        {
+            x[k] = veorq_u8(vaesdq_u8(x[k], keys[aes256::rounds - 1]), keys[aes256::rounds]);
+
+            vst1q_u8(out + 16 * k, veorq_u8(x[k], chain));
+            chain = c[k];
+        }
+    }
+
+    //Finish the remaining blocks one at a time
+    for (; block_count > 0; block_count--, in += 16, out += 16)
+    {
+        auto const c = vld1q_u8(in);
+        auto       x = c;
+
+        for (std::size_t r = 0; r < aes256::rounds - 1; r++) x = vaesimcq_u8(vaesdq_u8(x, keys[r]));
+
+        x = veorq_u8(vaesdq_u8(x, keys[aes256::rounds - 1]), keys[aes256::rounds]);
+
+        vst1q_u8(out, veorq_u8(x, chain));
+        chain = c;
+    }
+
+    vst1q_u8(iv, chain);
+}
+
+/*
+ * Holds the 128-bit big-endian counter as two native halves, which
+ * are cheaper to step than the bytes of the block.
+ */
+struct counter_block
+{
+    std::uint64_t high;
+    std::uint64_t low;
+
+    static counter_block load(byte const* p) noexcept
+    {
+        auto const halves = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(p)));
+
+        return { vgetq_lane_u64(halves, 0), vgetq_lane_u64(halves, 1) };
+    }
+
+    void store(byte* p) const noexcept
+    {
+        vst1q_u8(p, this->block());
+    }
+
+    uint8x16_t block() const noexcept
+    {
+        return vrev64q_u8(vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(this->high), vcreate_u64(this->low))));
+    }
+
+    //Returns the current block and steps to the next one
+    uint8x16_t next() noexcept
+    {
+        auto const block = this->block();
+
+        if (++this->low == 0) this->high++;
+
+        return block;
+    }
+};
+
+void pm::security::detail::aes_crypt_ctr_armv8(aes256::key_schedule const& schedule, byte* counter, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    uint8x16_t keys[aes256::rounds + 1];
+    for (std::size_t r = 0; r <= aes256::rounds; r++) keys[r] = vld1q_u8(schedule.encryption[r]);
+
+    auto ctr = counter_block::load(counter);
+
+    for (; block_count >= ctr_parallel_blocks; block_count -= ctr_parallel_blocks, in += 16 * ctr_parallel_blocks, out += 16 * ctr_parallel_blocks)
+    {
+        uint8x16_t x[ctr_parallel_blocks];
+
+        for (std::size_t k = 0; k < ctr_parallel_blocks; k++) x[k] = ctr.next();
+
+        for (std::size_t r = 0; r < aes256::rounds - 1; r++)
+        {
+            for (std::size_t k = 0; k < ctr_parallel_blocks; k++) x[k] = vaesmcq_u8(vaeseq_u8(x[k], keys[r]));
+        }
+
+        for (std::size_t k = 0; k < ctr_parallel_blocks; k++)
+        {
+            x[k] = veorq_u8(vaeseq_u8(x[k], keys[aes256::rounds - 1]), keys[aes256::rounds]);
+
+            vst1q_u8(out + 16 * k, veorq_u8(x[k], vld1q_u8(in + 16 * k)));
+        }
+    }
+
+    //Finish the remaining blocks one at a time
+    for (; block_count > 0; block_count--, in += 16, out += 16)
+    {
+        auto x = ctr.next();
+
+        for (std::size_t r = 0; r < aes256::rounds - 1; r++) x = vaesmcq_u8(vaeseq_u8(x, keys[r]));
+
+        x = veorq_u8(vaeseq_u8(x, keys[aes256::rounds - 1]), keys[aes256::rounds]);
+
+        vst1q_u8(out, veorq_u8(x, vld1q_u8(in)));
+    }
+
+    ctr.store(counter);
+}
+
+#if defined(__clang__)
+#   pragma clang attribute pop
+#endif
+
+#endif
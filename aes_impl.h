@@ -0,0 +1,85 @@
+#ifndef PM_AES_IMPL_H
+#define PM_AES_IMPL_H
+#pragma once
+
+#include "aes.h"
+#include "cpu_features.h"
+
+#include <cstddef>
+
+/*
+ * Internal definitions shared between the different
+ * implementations of AES-256.
+ */
+
+namespace pm::security::detail
+{
+    /*
+     * Encrypts or decrypts a number of whole blocks in CBC mode,
+     * replacing the IV with the last block of ciphertext.
+     */
+    using aes_cbc_fn = void(*)
+    (
+        aes256::key_schedule const& schedule,
+        aes256::byte* iv,
+        aes256::byte const* in,
+        aes256::byte* out,
+        std::size_t block_count
+    ) noexcept;
+
+    struct aes_cbc
+    {
+        aes_cbc_fn encrypt;
+        aes_cbc_fn decrypt;
+    };
+
+    /*
+     * Encrypts or decrypts a number of whole blocks in CTR mode,
+     * advancing the counter block past them.
+     */
+    using aes_ctr_fn = void(*)
+    (
+        aes256::key_schedule const& schedule,
+        aes256::byte* counter,
+        aes256::byte const* in,
+        aes256::byte* out,
+        std::size_t block_count
+    ) noexcept;
+
+    /*
+     * Bitsliced implementation. Always available, and runs in
+     * constant time.
+     */
+    void aes_encrypt_cbc_portable(aes256::key_schedule const& schedule, aes256::byte* iv, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+    void aes_decrypt_cbc_portable(aes256::key_schedule const& schedule, aes256::byte* iv, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+    void aes_crypt_ctr_portable  (aes256::key_schedule const& schedule, aes256::byte* counter, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Implementation using the AES-NI instructions.
+     * Requires AES and SSE2.
+     */
+    void aes_encrypt_cbc_aesni(aes256::key_schedule const& schedule, aes256::byte* iv, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+    void aes_decrypt_cbc_aesni(aes256::key_schedule const& schedule, aes256::byte* iv, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+    void aes_crypt_ctr_aesni  (aes256::key_schedule const& schedule, aes256::byte* counter, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    /*
+     * Implementation using the ARMv8 cryptography extensions.
+     * Requires AES.
+     */
+    void aes_encrypt_cbc_armv8(aes256::key_schedule const& schedule, aes256::byte* iv, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+    void aes_decrypt_cbc_armv8(aes256::key_schedule const& schedule, aes256::byte* iv, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+    void aes_crypt_ctr_armv8  (aes256::key_schedule const& schedule, aes256::byte* counter, aes256::byte const* in, aes256::byte* out, std::size_t block_count) noexcept;
+#endif
+
+    /*
+     * Retrieves the fastest implementation supported by the
+     * processor.
+     */
+    aes_cbc get_aes_cbc() noexcept;
+    aes_ctr_fn get_aes_ctr() noexcept;
+};
+
+#endif
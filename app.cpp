@@ -9,8 +9,10 @@
 #include "xorshift.h"
 
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -60,6 +62,19 @@ namespace pm
 
     static constexpr decltype(auto) ARCHIVE_PATH = "archive.bhpm";
 
+    //Views a password read from the screen as the bytes the archive key is derived from
+    static span<std::uint8_t> as_password(char const* pass) noexcept
+    {
+        return { reinterpret_cast<std::uint8_t const*>(pass), static_cast<std::ptrdiff_t>(std::strlen(pass)) };
+    }
+
+    //Wipes and frees a password read from the screen
+    static void release_password(char* pass) noexcept
+    {
+        secure_wipe(pass, std::strlen(pass));
+        delete[] pass;
+    }
+
     app::app() noexcept
     {
         //Set the initial state
@@ -183,38 +198,48 @@ namespace pm
             //Break out if they're equal
             if (std::string_view(tmp1).compare(tmp2) == 0)
             {
-                delete[] tmp2;
+                release_password(tmp2);
 
                 pass = tmp1;
 
                 break;
             }
 
-            delete[] tmp1;
-            delete[] tmp2;
+            release_password(tmp1);
+            release_password(tmp2);
 
             //Write error message
             this->screen.write(ui::color::RED, "Passwords did not match!", 35, 17);
         }
 
-        //Create the file
-        auto handle = CreateFileA(ARCHIVE_PATH, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, nullptr);
+        //Pick the cost of the key derivation, so unlocking takes about as long as it should on this machine
+        auto kdf     = kdf_params{};
+        auto success = calibrate_kdf_params(kdf_algorithm::ARGON2ID, default_unlock_latency, &kdf);
 
-        //Check that it was successful
-        if (handle != INVALID_HANDLE_VALUE)
+        //Write an empty archive under the master password, so it can be unlocked at login
+        if (!success)
         {
-            char test[]{ "Hello" };
-            DWORD written;
-            WriteFile(handle, test, 5, &written, nullptr);
+            std::ofstream file{ ARCHIVE_PATH, std::ios::binary | std::ios::out };
+            success = write_block_archive(file, std::vector<struct entry>{}, as_password(pass), kdf);
+        }
 
-            CloseHandle(handle);
+        release_password(pass);
+
+        if (success)
+        {
+            //Don't leave half an archive behind for the next login to trip over
+            std::error_code ec;
+            fs::remove(fs::u8path(ARCHIVE_PATH), ec);
 
-            //Transition to the main view state
-            return do_transition<app_state::setup, app_state::main_view>(&this->state);
+            //Write error message
+            this->screen.write(ui::color::RED, "Could not create the archive!", 35, 17);
+
+            //Abort
+            return false;
         }
 
-        //Abort
-        return false;
+        //Transition to the main view state
+        return do_transition<app_state::setup, app_state::main_view>(&this->state);
     }
 
     template<>
@@ -232,6 +257,31 @@ namespace pm
         //Write some stars
         this->screen.write(ui::color::LIME, "******");
 
+        //Open the archive, which only decrypts its directory, so the time it takes does not grow with the passwords
+        this->archive = block_archive{ ARCHIVE_PATH, as_password(pass) };
+
+        //Archives older than version 3 have no blocks, and are read whole and indexed instead
+        auto status = this->archive.get_status();
+        if (status == ntstatus_t::NOT_SUPPORTED)
+        {
+            this->entries = read_archive_file(ARCHIVE_PATH, as_password(pass));
+            status        = std::error_code{};
+
+            //A wrong password reads as an empty vault, and only version 3 archives are ever written empty
+            if (this->entries.empty()) status = ntstatus_t::UNSUCCESSFUL;
+        }
+
+        release_password(pass);
+
+        if (status)
+        {
+            //Write error message
+            this->screen.write(ui::color::RED, "Wrong password, or the archive is damaged!", 40, 16);
+
+            //Abort
+            return false;
+        }
+
         //Transition to the main view state
         return do_transition<app_state::login, app_state::main_view>(&this->state);
     }
@@ -258,9 +308,31 @@ namespace pm
     template<>
     bool app::handle<app_state::fetch_pass>() noexcept
     {
-        //TODO
+        //Ask for the identifier
+        this->screen.write(ui::color::WHITE, "Identifier: ", 40, 14, ui::align::RIGHT);
+        auto id = this->screen.read_text(ui::color::WHITE, ui::color::BLACK);
 
-        return true;
+        //The entry state hides the type of the same name
+        struct entry found{};
+
+        //Look it up in the directory, which decrypts only the block with its password, or in the index of an older archive
+        auto const identifier = span<char>(id, static_cast<std::ptrdiff_t>(std::strlen(id)));
+        auto const has_entry = this->archive.get_status() ? this->entries.find(identifier, &found) : !this->archive.find(identifier, &found);
+
+        if (has_entry)
+        {
+            this->screen.write(ui::color::WHITE, "Password: ", 40, 15, ui::align::RIGHT);
+            this->screen.write(ui::color::LIME, std::string_view(found.password.data(), static_cast<std::size_t>(found.password.size())));
+        }
+        else
+        {
+            this->screen.write(ui::color::RED, "No such entry!", 40, 15);
+        }
+
+        delete[] id;
+
+        //Transition back to the main view state
+        return do_transition<app_state::fetch_pass, app_state::main_view>(&this->state);
     }
 
     template<>
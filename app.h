@@ -2,6 +2,7 @@
 #define PM_APP_H
 #pragma once
 
+#include "archive.h"
 #include "state_manager.h"
 #include "screen.h"
 
@@ -20,8 +21,10 @@ namespace pm
         template<state_value_t state>
         bool handle() noexcept;
 
-        ui::screen screen;
+        ui::screen    screen;
         state_value_t state;
+        block_archive archive;
+        vault         entries;
     };
 };
 
@@ -2,11 +2,29 @@
 
 #include "archive.h"
 #include "crypto.h"
+#include "crypto_session.h"
+#include "crypto_stream.h"
+#include "chacha_poly.h"
+#include "cpu_features.h"
+#include "ctr_hmac.h"
+#include "hmac.h"
+#include "kdf.h"
+#include "mapped_file.h"
+#include "secure_memory.h"
+#include "sha256.h"
+#include "thread_pool.h"
 #include "xorshift.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstring>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <utility>
 
 using std::uint8_t;
 using std::uint32_t;
@@ -23,6 +41,17 @@ struct bhpm_header
     uint64_t iv[2];
 };
 
+//Follows the main header from minor version 1 onwards
+struct bhpm_kdf_header
+{
+    uint8_t  algorithm;
+    uint8_t  pad[3];
+    uint32_t time_cost;
+    uint32_t memory_cost;
+    uint32_t parallelism;
+    uint8_t  salt[16];
+};
+
 struct bhpm_data_hash
 {
     uint64_t hash[4];
@@ -39,197 +68,2032 @@ struct bhpm_xorshift_seed
 {
     uint64_t seed[2];
 };
+
+//Starts the plain text from major version 2, followed by the offset tables and the two columns
+struct bhpm_columns_header
+{
+    uint32_t entry_count;
+};
+
+//Follows the KDF header from major version 3, and says how the directory and the blocks after it are laid out
+struct bhpm_block_layout
+{
+    uint32_t block_length;
+    uint32_t block_count;
+    uint64_t directory_length;
+};
+
+//Where the password of an entry is in a version 3 archive, kept in the directory
+struct bhpm_password_location
+{
+    uint32_t block;
+    uint16_t offset;
+    uint16_t length;
+};
 #pragma pack(pop)
 
-template<typename T>
-static T consume(pm::span<uint8_t>* data)
+static constexpr uint32_t FourCC(char const(&magic)[5])
+{
+    return ((magic[3] << 24) | 
+            (magic[2] << 16) | 
+            (magic[1] <<  8) | 
+            (magic[0] <<  0));
+}
+
+static bool check_magic(uint8_t(&magic)[8])
+{
+    return(((*reinterpret_cast<uint32_t*>(magic))     == FourCC("BHPM")) &&
+           ((*reinterpret_cast<uint32_t*>(&magic[4])) == 0x11223344UL));
+}
+
+//The size of the pieces an archive is read and written in
+static constexpr std::size_t archive_chunk_length = 64 * 1024;
+
+//The most segments of an authenticated archive read or written at once
+static constexpr std::size_t max_batch_segments = 64;
+
+//The longest entry, a header followed by the longest identifier and password it can describe
+static constexpr std::size_t max_entry_length = sizeof(bhpm_entry_header) + 63 + 63;
+
+//The plain text in each block of a version 3 archive, small enough that a lookup decrypts very little
+static constexpr uint32_t block_archive_block_length = 4096;
+
+//The label the key of each message of a version 3 archive is derived with, followed by the number of the message
+static constexpr char const block_key_label[] = "BHPM block key";
+
+//Marks that no block of a version 3 archive has been decrypted
+static constexpr uint32_t no_block = ~uint32_t{ 0 };
+
+/*
+ * Xors the data with the xorshift stream, a 64-bit word at a time.
+ * The length must be a multiple of 8 bytes.
+ */
+static void xorshift_in_place(uint8_t* data, std::size_t length, pm::xorshift_state* xs) noexcept
 {
-    //Read the value
-    auto result = *reinterpret_cast<T const*>(data->data());
+    for (std::size_t i = 0; i < length; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        word ^= xs->next();
+        std::memcpy(data + i, &word, sizeof(word));
+    }
+}
+
+/*
+ * Reads an archive that is already in memory.
+ */
+struct memory_source
+{
+public:
+    explicit memory_source(pm::span<uint8_t> data) noexcept
+        : data{ data }
+    {}
+
+    uint64_t size() const noexcept
+    {
+        return static_cast<uint64_t>(this->data.size());
+    }
+
+    bool read(uint64_t offset, void* buffer, std::size_t length) noexcept
+    {
+        if (offset > this->size() || length > this->size() - offset) return false;
+
+        std::memcpy(buffer, this->data.data() + offset, length);
+
+        return true;
+    }
+
+    //Gives the data in place, so the cipher can read it without a copy
+    uint8_t const* view(uint64_t offset, std::size_t length) const noexcept
+    {
+        if (offset > this->size() || length > this->size() - offset) return nullptr;
+
+        return this->data.data() + offset;
+    }
+
+private:
+    pm::span<uint8_t> data;
+};
+
+/*
+ * Reads an archive from a stream that can seek, such as a file.
+ * Reading carries on from where the last read ended without a
+ * seek, so the stream's buffering and the read-ahead of the
+ * system overlap the file I/O with the decryption.
+ */
+struct stream_source
+{
+public:
+    explicit stream_source(std::istream* stream) noexcept
+        : stream{ stream }
+    {
+        //Find the size of the stream
+        this->stream->seekg(0, std::ios::end);
+        auto const end = this->stream->tellg();
+        this->length   = (end > 0) ? static_cast<uint64_t>(end) : 0;
+        this->position = ~uint64_t{ 0 };
+    }
+
+    uint64_t size() const noexcept
+    {
+        return this->length;
+    }
+
+    bool read(uint64_t offset, void* buffer, std::size_t length) noexcept
+    {
+        if (offset > this->length || length > this->length - offset) return false;
+
+        //Only seek when the read does not follow on from the last one
+        if (offset != this->position)
+        {
+            this->stream->clear();
+            this->stream->seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        }
+
+        this->stream->read(static_cast<char*>(buffer), static_cast<std::streamsize>(length));
+        if (static_cast<std::size_t>(this->stream->gcount()) != length)
+        {
+            this->position = ~uint64_t{ 0 };
+            return false;
+        }
+
+        this->position = offset + length;
+
+        return true;
+    }
+
+    //A stream has nothing in memory to give, everything must be read
+    uint8_t const* view(uint64_t, std::size_t) const noexcept
+    {
+        return nullptr;
+    }
 
-    //Adjust the span
-    *data = data->slice(sizeof(T));
+private:
+    std::istream* stream;
+    uint64_t      length;
+    uint64_t      position;
+};
+
+/*
+ * Finds the next piece of cipher text: in place when the source
+ * has it in memory, or read into the buffer otherwise. Returns
+ * nullptr if the source is too short.
+ */
+template<typename Source>
+static uint8_t const* read_or_view(Source* source, uint64_t offset, uint8_t* buffer, std::size_t length) noexcept
+{
+    if (auto const* data = source->view(offset, length)) return data;
 
-    //Return the result
-    return result;
+    return source->read(offset, buffer, length) ? buffer : nullptr;
 }
 
-template<typename T>
-static T* consume_array(pm::span<uint8_t>* data, std::size_t count)
+/*
+ * The size of the pieces an authenticated archive is read and
+ * written in, enough segments to keep every thread of the shared
+ * pool busy a few times over.
+ */
+template<typename Stream>
+static std::size_t get_batch_length() noexcept
 {
-    //Allocate memory
-    auto* result = new T[count];
+    auto const segments = std::min(pm::thread_pool::get_shared().get_concurrency() * 4, max_batch_segments);
+
+    return segments * Stream::segment_length;
+}
 
-    //Copy data into the allocated block
-    std::memcpy(result, data->data(), sizeof(T) * count);
+/*
+ * Allocates the buffer the whole plain text of an archive is
+ * decrypted into. Returns an empty buffer if it does not fit.
+ */
+static pm::secure_byte_array allocate_plain_text(uint64_t length) noexcept
+{
+    if (length > SIZE_MAX) return {};
 
-    //Adjust the span
-    *data = data->slice(sizeof(T) * count);
+    auto const size = static_cast<std::size_t>(length);
 
-    //Return the result
-    return result;
+    return pm::secure_byte_array{ new (std::nothrow) uint8_t[size], pm::secure_array_deleter<uint8_t>{ size } };
 }
- 
-static pm::span<uint8_t> xorshift_data(pm::span<uint8_t> input, pm::xorshift_state* xs) noexcept
+
+/*
+ * Walks the entries at the start of the plain text, calling the
+ * function with the header and the data of each. Returns the
+ * length up to and including the empty entry that marks the end,
+ * or 0 if the plain text ends first.
+ */
+template<typename F>
+static std::size_t walk_entries(uint8_t const* data, std::size_t length, F&& f) noexcept
 {
-    //Make a copy of the data
-    auto* copy = new uint8_t[input.size()];
-    std::copy(input.cbegin(), input.cend(), copy);
+    auto position = std::size_t{ 0 };
+
+    while (length - position >= sizeof(bhpm_entry_header))
+    {
+        bhpm_entry_header entry_header;
+        std::memcpy(&entry_header, data + position, sizeof(entry_header));
+        position += sizeof(entry_header);
 
-    //Reinterpret as an array of u64
-    auto* arr = reinterpret_cast<uint64_t*>(copy);
-    auto size = input.size() / sizeof(uint64_t);
+        //An empty entry marks the end, anything after it is padding
+        if ((entry_header.id_len == 0) && (entry_header.pass_len == 0)) return position;
 
-    //Iterate over the array and xor it
-    for (decltype(size) i = 0; i < size; i++)
-        arr[i] ^= xs->next();
+        auto const entry_length = static_cast<std::size_t>(entry_header.id_len) + entry_header.pass_len;
+        if (entry_length > length - position) return 0;
 
-    //Reinterpret back as an array of u8
-    copy = reinterpret_cast<uint8_t*>(arr);
+        f(entry_header, data + position);
+        position += entry_length;
+    }
 
-    //Return in a span object
-    return { copy, input.size() };
+    return 0;
 }
 
-static constexpr uint32_t FourCC(char const(&magic)[5])
+/*
+ * The shortest plain text of an archive: the end marker in major
+ * version 1, the entry count in major version 2.
+ */
+static std::size_t get_min_plain_text_length(bhpm_header const& header) noexcept
 {
-    return ((magic[3] << 24) | 
-            (magic[2] << 16) | 
-            (magic[1] <<  8) | 
-            (magic[0] <<  0));
+    return (header.major_version == 2) ? sizeof(bhpm_columns_header) : sizeof(bhpm_entry_header);
 }
 
-static bool check_magic(uint8_t(&magic)[8])
+/*
+ * Reads an entry of an offset table: where an identifier or a
+ * password ends in its column.
+ */
+static uint32_t load_column_end(uint8_t const* ends, std::size_t index) noexcept
 {
-    return(((*reinterpret_cast<uint32_t*>(magic))     == FourCC("BHPM")) &&
-           ((*reinterpret_cast<uint32_t*>(&magic[4])) == 0x11223344UL));
+    uint32_t end;
+    std::memcpy(&end, ends + index * sizeof(end), sizeof(end));
+
+    return end;
 }
 
-std::vector<pm::entry> pm::read_archive(span<std::uint8_t> data) noexcept
+/*
+ * Checks the offset tables of a version 2 archive, the identifier
+ * ends followed by the password ends. Both have to count up, and
+ * the columns they describe have to fill the rest of the plain
+ * text exactly.
+ */
+static bool check_column_tables(uint8_t const* tables, std::size_t count, uint64_t columns_length) noexcept
 {
-    auto password = "1234";
+    auto const* identifier_ends = tables;
+    auto const* password_ends   = tables + count * sizeof(uint32_t);
 
-    //Read the main header
-    auto header = consume<bhpm_header>(&data);
+    auto identifier_end = uint32_t{ 0 };
+    auto password_end   = uint32_t{ 0 };
 
-    //Verify the header
-    if (!check_magic(header.magic)) return {};
-    if (header.major_version != 1)  return {};
-    if (header.pad1 != 0)           return {};
-    if (header.minor_version != 0)  return {};
-    if (header.pad2 != 0)           return {};
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto const next_identifier_end = load_column_end(identifier_ends, i);
+        auto const next_password_end   = load_column_end(password_ends,   i);
+        if ((next_identifier_end < identifier_end) || (next_password_end < password_end)) return false;
+
+        identifier_end = next_identifier_end;
+        password_end   = next_password_end;
+    }
 
-    //Decrypt the encrypted block
-    auto  unencrypted_data = pm::owned_byte_array{ nullptr };
-    auto  unencrypted_len  = std::size_t{ 0 };
-    auto  success = pm::decrypt(pm::span<uint8_t>{ data }, pm::span<uint8_t>{ reinterpret_cast<uint8_t*>(const_cast<char*>(password)), 4 }, span<uint8_t>{reinterpret_cast<uint8_t*>(header.iv), 16}, &unencrypted_data, &unencrypted_len);
-    if (success != ntstatus_t::SUCCESS) return {};
+    return uint64_t{ identifier_end } + password_end == columns_length;
+}
+
+/*
+ * Finds the entries in the plain text of a version 2 archive, as
+ * views into its columns. Returns false if the plain text is not
+ * laid out as the offset tables say.
+ */
+static bool scan_columns(uint8_t const* data, std::size_t length, std::vector<pm::entry>* entries)
+{
+    bhpm_columns_header columns_header;
+    if (length < sizeof(columns_header)) return false;
+    std::memcpy(&columns_header, data, sizeof(columns_header));
+
+    //A damaged count cannot make the tables longer than the plain text
+    auto const rest  = length - sizeof(columns_header);
+    auto const count = static_cast<std::size_t>(columns_header.entry_count);
+    if (count > rest / (2 * sizeof(uint32_t))) return false;
+
+    auto const  tables_length = count * 2 * sizeof(uint32_t);
+    auto const* tables        = data + sizeof(columns_header);
+    if (!check_column_tables(tables, count, rest - tables_length)) return false;
+
+    auto const* identifier_ends = tables;
+    auto const* password_ends   = tables + count * sizeof(uint32_t);
+    auto const* identifiers     = reinterpret_cast<char const*>(tables + tables_length);
+    auto const* passwords       = identifiers + ((count > 0) ? load_column_end(identifier_ends, count - 1) : 0);
+
+    entries->reserve(count);
+
+    auto identifier_start = uint32_t{ 0 };
+    auto password_start   = uint32_t{ 0 };
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        auto const identifier_end = load_column_end(identifier_ends, i);
+        auto const password_end   = load_column_end(password_ends,   i);
+
+        entries->push_back(pm::entry
+        {
+            pm::span<char>{ identifiers + identifier_start, static_cast<std::ptrdiff_t>(identifier_end - identifier_start) },
+            pm::span<char>{ passwords   + password_start,   static_cast<std::ptrdiff_t>(password_end   - password_start)   },
+        });
+
+        identifier_start = identifier_end;
+        password_start   = password_end;
+    }
+
+    return true;
+}
 
-    //Wrap in a span
-    data = pm::span<std::uint8_t>{ unencrypted_data.get(), static_cast<std::ptrdiff_t>(unencrypted_len) };
+/*
+ * Finds the entries in the plain text, as views into it. Returns
+ * the length of the entries with the end marker, or 0 if the
+ * plain text ends before it.
+ */
+static std::size_t scan_entries(uint8_t const* data, std::size_t length, std::vector<pm::entry>* entries)
+{
+    //Count them first, so the views are stored with one allocation
+    auto count = std::size_t{ 0 };
+    auto const end = walk_entries(data, length, [&](bhpm_entry_header const&, uint8_t const*) noexcept { count++; });
+    if (end == 0) return 0;
+
+    entries->reserve(count);
+    walk_entries(data, length, [&](bhpm_entry_header const& entry_header, uint8_t const* entry_data) noexcept
+    {
+        auto const* id = reinterpret_cast<char const*>(entry_data);
+
+        entries->push_back(pm::entry
+        {
+            pm::span<char>{ id,                       entry_header.id_len },
+            pm::span<char>{ id + entry_header.id_len, entry_header.pass_len },
+        });
+    });
 
-    //Read the xorshift seed
-    auto seed_span = data.slice(data.size() - sizeof(bhpm_xorshift_seed));
-    auto xs_state = pm::xorshift_state{ consume<bhpm_xorshift_seed>(&seed_span).seed };
+    return end;
+}
 
-    //Xorshift the data
-    data = xorshift_data(data.slice(0, 48), &xs_state);
+//Marks a slot of the index that holds no entry, so there can be one entry fewer than 32 bits can count
+static constexpr uint32_t empty_slot = ~uint32_t{ 0 };
 
-    //Read the hash
-    auto hash = consume<bhpm_data_hash>(&data);
+/*
+ * Hashes an identifier for the index, with 64-bit FNV-1a folded
+ * to 32 bits. Identifiers are short, so a byte at a time is quick
+ * enough.
+ */
+static uint32_t hash_identifier(pm::span<char> identifier) noexcept
+{
+    auto hash = uint64_t{ 0xCBF29CE484222325 };
 
-    //Read all the entries
-    auto result = std::vector<pm::entry>{};
-    auto is_final = false;
-    while (!is_final)
+    for (auto const c : identifier)
     {
-        //Read the entry header
-        auto entry_header = consume<bhpm_entry_header>(&data);
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3;
+    }
+
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+static bool same_identifier(pm::span<char> a, pm::span<char> b) noexcept
+{
+    return (a.size() == b.size()) && (std::memcmp(a.data(), b.data(), static_cast<std::size_t>(a.size())) == 0);
+}
+
+pm::vault::vault(secure_byte_array plain_text, std::vector<entry> entries) noexcept
+    : plain_text{ std::move(plain_text) }, entries{ std::move(entries) }
+{
+    this->build_index();
+}
 
-        //Set the final flag
-        is_final = (entry_header.id_len == 0) && (entry_header.pass_len == 0);
+void pm::vault::build_index() noexcept
+{
+    //The entry numbers must fit in 32 bits, with one value left over to mark empty slots
+    if (this->entries.empty() || (this->entries.size() >= empty_slot)) return;
+
+    //Keep the table at most half full, so the probes stay short
+    auto slot_count = std::size_t{ 2 };
+    while (slot_count < 2 * this->entries.size()) slot_count *= 2;
+
+    auto* const slots = new (std::nothrow) index_slot[slot_count];
+    if (!slots) return;
+
+    std::fill(slots, slots + slot_count, index_slot{ 0, empty_slot });
+    this->index      = decltype(this->index){ slots, secure_array_deleter<index_slot>{ slot_count } };
+    this->index_mask = slot_count - 1;
 
-        //Check that we're not done
-        if (!is_final)
+    for (std::size_t number = 0; number < this->entries.size(); number++)
+    {
+        auto const& identifier = this->entries[number].identifier;
+        auto const  hash       = hash_identifier(identifier);
+
+        //Probe linearly for a free slot, keeping the first of entries with the same identifier
+        for (auto i = hash & this->index_mask; ; i = (i + 1) & this->index_mask)
         {
-            //Read the ID and password 
-            auto* id   = consume_array<char>(&data, entry_header.id_len);
-            auto* pass = consume_array<char>(&data, entry_header.pass_len);
+            auto& slot = slots[i];
 
-            //Push values into vector
-            result.push_back(pm::entry
+            if (slot.entry == empty_slot)
             {
-                pm::span<char>{id,   entry_header.id_len},
-                pm::span<char>{pass, entry_header.pass_len},
-            });
+                slot = index_slot{ hash, static_cast<uint32_t>(number) };
+                break;
+            }
+
+            if ((slot.hash == hash) && same_identifier(this->entries[slot.entry].identifier, identifier)) break;
         }
     }
+}
+
+bool pm::vault::find(span<char> identifier, entry* result) const noexcept
+{
+    //Without an index, every entry has to be looked at
+    if (!this->index)
+    {
+        auto const it = std::find_if(this->entries.begin(), this->entries.end(), [&](entry const& e) noexcept { return same_identifier(e.identifier, identifier); });
+        if (it == this->entries.end()) return false;
+
+        *result = *it;
+        return true;
+    }
+
+    //The hashes are compared first, so the entries are only touched for a likely match
+    auto const hash = hash_identifier(identifier);
+
+    for (auto i = hash & this->index_mask; ; i = (i + 1) & this->index_mask)
+    {
+        auto const& slot = this->index[i];
+        if (slot.entry == empty_slot) return false;
+        if (slot.hash != hash)        continue;
 
-    //Return the result
-    return result;
+        auto const& candidate = this->entries[slot.entry];
+        if (same_identifier(candidate.identifier, identifier))
+        {
+            *result = candidate;
+            return true;
+        }
+    }
 }
 
-#include <iostream>
-#include <fstream>
-#include <limits>
-
-static uint8_t arr[]
-{ 
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //HASH
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //
-    0xC3, 0xA0, 0x41, 0x42, 0x43, 0x44, 0x43, 0x45,                                                 //DATA
-    0x00, 0x00,                                                                                     //END MARKER
-    0x8A, 0x24, 0xAE, 0xD0, 0x45, 0xD8,                                                             //PADDING
-    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, //XORSHIFT SEED
-};
+/*
+ * Whether a minor version 0 or 1 archive carries the hash of its
+ * entries. The first writer left the field zero, so those archives
+ * have nothing to be checked against.
+ */
+static bool has_data_hash(bhpm_data_hash const& hash) noexcept
+{
+    auto bits = uint64_t{ 0 };
+    for (auto const word : hash.hash) bits |= word;
 
-void pm::test()
+    return (bits != 0);
+}
+
+/*
+ * Reads the body of a minor version 0 or 1 archive, which is chained with
+ * CBC and xorshifted, a chunk at a time.
+ */
+template<typename Source>
+static pm::vault read_cbc_body(Source* source, uint64_t offset, bhpm_header const& header, pm::span<uint8_t> password, pm::kdf_params const& kdf) noexcept
 {
-    auto password = "1234";
+    //The encrypted block holds the hash, the entries, the padding and the xorshift seed
+    auto const block_length = pm::crypto_session::iv_length;
+    auto const data_length  = source->size() - offset;
+    if (data_length < sizeof(bhpm_data_hash) + sizeof(bhpm_entry_header) + sizeof(bhpm_xorshift_seed)) return {};
+    if (data_length % block_length != 0) return {};
 
-    std::ofstream test;
-    test.open("test.bhpm", std::ios::binary | std::ios::out);
+    //Unlock the archive
+    auto session = pm::crypto_session{};
+    auto success = session.open(password, kdf);
+    if (success != pm::ntstatus_t::SUCCESS) return {};
 
-    test << "BHPM";
-    uint32_t magic = 0x11223344;
-    test.write(reinterpret_cast<char const*>(&magic), sizeof(uint32_t));
-    test << (uint8_t)1;
-    test << (uint8_t)0;
-    test << (uint8_t)0;
-    test << (uint8_t)0;
-
-    uint8_t iv[16];
-    auto err = pm::get_random_bytes(iv);
-    test.write(reinterpret_cast<char*>(iv), 16);
-
-    decltype(arr) arr2{};
-    pm::xorshift_state xs_state{ {0x0807060504030201ULL, 0x1615141312111009ULL} };
-    auto arrspan = pm::span<uint8_t>{ arr };
-    xorshift_data(arrspan.slice(0, 48), &xs_state).copy_to(arr2, sizeof(arr2));
-    arrspan.slice(48).copy_to(&arr2[48], sizeof(arr) - 48);
-
-    auto data    = pm::owned_byte_array{ nullptr };;
-    auto datalen = std::size_t{ 0 };
-    err = pm::encrypt(span<uint8_t>{ arr2 }, pm::span<uint8_t>{ reinterpret_cast<uint8_t*>(const_cast<char*>(password)), 4 }, span<uint8_t>{iv}, &data, &datalen);
-    test.write(reinterpret_cast<char*>(data.get()), datalen);
-
-    test.flush();
-    test.close();
+    //The seed is the last block, which decrypts on its own with the block before it as the IV
+    uint8_t tail[2 * block_length];
+    if (!source->read(offset + data_length - sizeof(tail), tail, sizeof(tail))) return {};
+
+    auto seed_block = bhpm_xorshift_seed{};
+    auto seed_len   = std::size_t{ 0 };
+    success = session.decrypt(pm::span<uint8_t>{ tail + block_length, block_length }, pm::span<uint8_t>{ tail, block_length }, reinterpret_cast<uint8_t*>(seed_block.seed), sizeof(seed_block), &seed_len);
+    if (success != pm::ntstatus_t::SUCCESS) return {};
+
+    auto xs_state = pm::xorshift_state{ seed_block.seed };
+
+    //Everything before the seed is decrypted into one buffer
+    auto const body_length = data_length - sizeof(bhpm_xorshift_seed);
+    auto       plain_text  = allocate_plain_text(body_length);
+    if (!plain_text) return {};
+
+    //Stream the body through the cipher a chunk at a time, so reading overlaps decrypting
+    auto cipher = pm::cipher_stream{ session, pm::cipher_stream::direction::DECRYPT };
+
+    success = cipher.init(pm::span<uint8_t>{ reinterpret_cast<uint8_t const*>(header.iv), block_length });
+    for (auto position = uint64_t{ 0 }; !success && (position < body_length); )
+    {
+        //Take the next chunk, a whole number of blocks
+        auto const  length = static_cast<std::size_t>(std::min<uint64_t>(archive_chunk_length, body_length - position));
+        auto* const output = plain_text.get() + position;
+        auto const* input  = read_or_view(source, offset + position, output, length);
+        if (!input)
+        {
+            success = pm::ntstatus_t::UNSUCCESSFUL;
+            break;
+        }
+
+        //Decrypt it into its place in the plain text
+        auto decrypted = std::size_t{ 0 };
+        success = cipher.update(pm::span<uint8_t>{ input, static_cast<std::ptrdiff_t>(length) }, output, length, &decrypted);
+        if (success) break;
+
+        //Xorshift the data
+        xorshift_in_place(output, length, &xs_state);
+
+        position += length;
+    }
+
+    if (!success) success = cipher.finish();
+    if (success != pm::ntstatus_t::SUCCESS) return {};
+
+    //The hash of the entries comes first
+    auto const* entries_data   = plain_text.get() + sizeof(bhpm_data_hash);
+    auto const  entries_length = static_cast<std::size_t>(body_length) - sizeof(bhpm_data_hash);
+
+    auto       entries = std::vector<pm::entry>{};
+    auto const end     = scan_entries(entries_data, entries_length, &entries);
+
+    //An archive that ends before its end marker, or does not match its hash, is damaged
+    if (end == 0) return {};
+
+    auto expected_hash = bhpm_data_hash{};
+    std::memcpy(&expected_hash, plain_text.get(), sizeof(expected_hash));
+
+    if (has_data_hash(expected_hash))
+    {
+        auto hash = std::array<uint8_t, pm::security::sha256::digest_length>{};
+        pm::security::sha256::compute_hash(entries_data, end, hash);
+        if (std::memcmp(hash.data(), &expected_hash, hash.size()) != 0) return {};
+    }
+
+    return pm::vault{ std::move(plain_text), std::move(entries) };
 }
 
-void pm::test2()
+/*
+ * Reads the body of a minor version 2 or 3 archive, which is encrypted
+ * and authenticated by the stream, a batch of segments at a time.
+ * The segments of a batch are decrypted in parallel.
+ */
+template<typename Stream, typename Source>
+static pm::vault read_sealed_body(Source* source, uint64_t offset, pm::span<uint8_t> headers, bhpm_header const& header, pm::span<uint8_t> password, pm::kdf_params const& kdf) noexcept
 {
-    std::ifstream test;
-    test.open("test.bhpm", std::ios::binary | std::ios::in);
+    //The cipher text holds the entries, and the tag follows it
+    auto const tag_length  = Stream::tag_length;
+    auto const data_length = source->size() - offset;
+    if (data_length < get_min_plain_text_length(header) + tag_length) return {};
 
-    test.ignore(std::numeric_limits<std::streamsize>::max());
-    auto size = test.gcount();
-    test.clear();
-    test.seekg(0, std::ios::beg);
+    auto const body_length = data_length - tag_length;
 
-    auto* data = new char[static_cast<std::size_t>(size)];
-    test.read(data, size);
-    test.close();
+    uint8_t tag[tag_length];
+    if (!source->read(offset + body_length, tag, sizeof(tag))) return {};
+
+    //Unlock the archive, with the headers authenticated along with the entries
+    auto key     = pm::derived_key{};
+    auto success = pm::derive_key(password, kdf, &key);
+    if (success != pm::ntstatus_t::SUCCESS) return {};
+
+    auto cipher = Stream{ Stream::direction::DECRYPT };
+    success = cipher.init(key, pm::span<uint8_t>{ reinterpret_cast<uint8_t const*>(header.iv), Stream::nonce_length }, headers);
+    pm::secure_wipe(key.data(), key.size());
+    if (success != pm::ntstatus_t::SUCCESS) return {};
+
+    //Every batch is decrypted into one buffer, since the tag covers all of them
+    auto const batch_length = get_batch_length<Stream>();
+    auto       plain_text   = allocate_plain_text(body_length);
+    if (!plain_text) return {};
+
+    for (auto position = uint64_t{ 0 }; !success && (position < body_length); )
+    {
+        auto const  length = static_cast<std::size_t>(std::min<uint64_t>(batch_length, body_length - position));
+        auto* const output = plain_text.get() + position;
+        auto const* input  = read_or_view(source, offset + position, output, length);
+        if (!input)
+        {
+            success = pm::ntstatus_t::UNSUCCESSFUL;
+            break;
+        }
+
+        //Decrypt it into its place in the plain text
+        auto decrypted = std::size_t{ 0 };
+        success = cipher.update(pm::span<uint8_t>{ input, static_cast<std::ptrdiff_t>(length) }, output, length, &decrypted);
+        if (success) break;
+
+        position += length;
+    }
+
+    //Nothing is looked at unless the archive is exactly what was written
+    if (!success) success = cipher.verify(pm::span<uint8_t>{ tag, static_cast<std::ptrdiff_t>(tag_length) });
+    if (success != pm::ntstatus_t::SUCCESS) return {};
+
+    //Version 2 keeps the identifiers and the passwords in columns, version 1 keeps them together entry by entry
+    auto       entries = std::vector<pm::entry>{};
+    auto const scanned = (header.major_version == 2)
+        ? scan_columns(plain_text.get(), static_cast<std::size_t>(body_length), &entries)
+        : (scan_entries(plain_text.get(), static_cast<std::size_t>(body_length), &entries) != 0);
+    if (!scanned) return {};
+
+    return pm::vault{ std::move(plain_text), std::move(entries) };
+}
+
+//The headers as they are in the file, which later versions authenticate
+using bhpm_raw_headers = uint8_t[sizeof(bhpm_header) + sizeof(bhpm_kdf_header)];
+
+/*
+ * Reads and checks the headers of an archive, and finds where its
+ * body starts and how its key is derived. Returns false if they
+ * are not the headers of a version this reader knows.
+ */
+template<typename Source>
+static bool read_headers(Source* source, bhpm_header* header, pm::kdf_params* kdf, bhpm_raw_headers& headers, uint64_t* offset) noexcept
+{
+    *offset = 0;
+
+    //Read the main header
+    if (!source->read(*offset, header, sizeof(*header))) return false;
+    std::memcpy(headers, header, sizeof(*header));
+    *offset += sizeof(*header);
+
+    //Verify the header
+    if (!check_magic(header->magic))                                 return false;
+    if ((header->major_version < 1) || (header->major_version > 3)) return false;
+    if (header->pad1 != 0)                                           return false;
+    if (header->minor_version > 3)                                   return false;
+    if (header->pad2 != 0)                                           return false;
+
+    //Versions 2 and 3 only changed the layout of the entries, and come with the ciphers of versions 1.2 and 1.3
+    if ((header->major_version >= 2) && (header->minor_version < 2)) return false;
+
+    //Version 0 keys are a plain hash of the password
+    *kdf = pm::kdf_params{ pm::kdf_algorithm::SHA256, 0, 0, 0, {} };
+
+    //Later versions say how the key was derived
+    if (header->minor_version >= 1)
+    {
+        auto kdf_header = bhpm_kdf_header{};
+        if (!source->read(*offset, &kdf_header, sizeof(kdf_header))) return false;
+        std::memcpy(headers + sizeof(*header), &kdf_header, sizeof(kdf_header));
+        *offset += sizeof(kdf_header);
+
+        kdf->algorithm   = static_cast<pm::kdf_algorithm>(kdf_header.algorithm);
+        kdf->time_cost   = kdf_header.time_cost;
+        kdf->memory_cost = kdf_header.memory_cost;
+        kdf->parallelism = kdf_header.parallelism;
+        std::copy(std::begin(kdf_header.salt), std::end(kdf_header.salt), kdf->salt);
+    }
+
+    return true;
+}
+
+/*
+ * Compares two identifiers byte by byte, the shorter first if one
+ * is a prefix of the other. Version 3 archives keep their entries
+ * in this order.
+ */
+static int compare_identifiers(pm::span<char> a, pm::span<char> b) noexcept
+{
+    auto const common = static_cast<std::size_t>(std::min(a.size(), b.size()));
+    auto const result = (common > 0) ? std::memcmp(a.data(), b.data(), common) : 0;
+    if (result != 0) return result;
+
+    return (a.size() < b.size()) ? -1 : (a.size() > b.size()) ? 1 : 0;
+}
+
+/*
+ * Derives the key of one message of a version 3 archive, the
+ * directory being message 0 and block n message n + 1. Every
+ * message is sealed under a key of its own, so they can share
+ * the nonce, and a block moved to another place does not open.
+ */
+static pm::derived_key derive_message_key(pm::derived_key const& key, uint64_t message) noexcept
+{
+    uint8_t info[sizeof(block_key_label) - 1 + sizeof(uint64_t)];
+    std::memcpy(info, block_key_label, sizeof(block_key_label) - 1);
+    for (std::size_t i = 0; i < sizeof(uint64_t); i++) info[sizeof(block_key_label) - 1 + i] = static_cast<uint8_t>(message >> (56 - 8 * i));
+
+    return pm::security::hmac_sha256::compute_mac(key.data(), key.size(), info, sizeof(info));
+}
+
+//The tag after every message of a version 3 archive, which depends on its cipher
+static std::size_t get_message_tag_length(bhpm_header const& header) noexcept
+{
+    return (header.minor_version == 3) ? pm::chacha_poly_stream::tag_length : pm::ctr_hmac_stream::tag_length;
+}
+
+/*
+ * Encrypts one message of a version 3 archive in place and writes
+ * its tag.
+ */
+template<typename Stream>
+static std::error_code seal_message(pm::derived_key const& key, uint64_t message, bhpm_header const& header, pm::span<uint8_t> associated_data, uint8_t* data, std::size_t length, uint8_t* tag) noexcept
+{
+    auto message_key = derive_message_key(key, message);
+
+    auto cipher  = Stream{ Stream::direction::ENCRYPT };
+    auto success = cipher.init(message_key, pm::span<uint8_t>{ reinterpret_cast<uint8_t const*>(header.iv), Stream::nonce_length }, associated_data);
+    pm::secure_wipe(message_key.data(), message_key.size());
+
+    auto encrypted = std::size_t{ 0 };
+    if (!success) success = cipher.update(pm::span<uint8_t>{ data, static_cast<std::ptrdiff_t>(length) }, data, length, &encrypted);
+    if (!success) success = cipher.finish(tag, Stream::tag_length);
+
+    return success;
+}
+
+/*
+ * Decrypts one message of a version 3 archive and checks its tag.
+ * The output is wiped if the message is not what was written.
+ */
+template<typename Stream>
+static std::error_code open_message(pm::derived_key const& key, uint64_t message, bhpm_header const& header, pm::span<uint8_t> associated_data, uint8_t const* input, std::size_t length, uint8_t const* tag, uint8_t* output) noexcept
+{
+    auto message_key = derive_message_key(key, message);
+
+    auto cipher  = Stream{ Stream::direction::DECRYPT };
+    auto success = cipher.init(message_key, pm::span<uint8_t>{ reinterpret_cast<uint8_t const*>(header.iv), Stream::nonce_length }, associated_data);
+    pm::secure_wipe(message_key.data(), message_key.size());
+
+    auto decrypted = std::size_t{ 0 };
+    if (!success) success = cipher.update(pm::span<uint8_t>{ input, static_cast<std::ptrdiff_t>(length) }, output, length, &decrypted);
+    if (!success) success = cipher.verify(pm::span<uint8_t>{ tag, static_cast<std::ptrdiff_t>(Stream::tag_length) });
+
+    if (success) pm::secure_wipe(output, length);
+
+    return success;
+}
+
+/*
+ * What a version 3 archive needs to hand out entries once it has
+ * been opened: the key, which is kept so blocks can be decrypted
+ * when they are needed, the directory of the entries, and the
+ * block decrypted last.
+ *
+ * The directory holds the number of entries, where each identifier
+ * ends, where each password is, and then the identifiers, with the
+ * entries sorted by identifier.
+ */
+struct block_store
+{
+public:
+    block_store() noexcept = default;
+
+    block_store(block_store const&) = delete;
+    block_store& operator = (block_store const&) = delete;
+
+    ~block_store()
+    {
+        pm::secure_wipe(this->key.data(), this->key.size());
+    }
+
+    bhpm_header       header{};
+    bhpm_block_layout layout{};
+    pm::derived_key   key{};
+    uint64_t          blocks_offset = 0;
+
+    //The headers and the layout, which every message authenticates
+    uint8_t associated_data[sizeof(bhpm_header) + sizeof(bhpm_kdf_header) + sizeof(bhpm_block_layout)]{};
+
+    pm::secure_byte_array directory;
+    std::size_t           entry_count     = 0;
+    uint8_t const*        identifier_ends = nullptr;
+    uint8_t const*        locations       = nullptr;
+    char const*           identifiers     = nullptr;
+
+    pm::secure_byte_array block;
+    uint32_t              loaded_block = no_block;
+
+    pm::span<uint8_t> get_associated_data() const noexcept
+    {
+        return { this->associated_data, static_cast<std::ptrdiff_t>(sizeof(this->associated_data)) };
+    }
+
+    pm::span<char> get_identifier(std::size_t index) const noexcept
+    {
+        auto const start = (index > 0) ? load_column_end(this->identifier_ends, index - 1) : 0;
+        auto const end   = load_column_end(this->identifier_ends, index);
+
+        return { this->identifiers + start, static_cast<std::ptrdiff_t>(end - start) };
+    }
+
+    bhpm_password_location get_location(std::size_t index) const noexcept
+    {
+        bhpm_password_location location;
+        std::memcpy(&location, this->locations + index * sizeof(location), sizeof(location));
+
+        return location;
+    }
+
+    //Finds the first entry with the identifier by binary search, or returns the number of entries
+    std::size_t find(pm::span<char> identifier) const noexcept
+    {
+        auto first = std::size_t{ 0 };
+        auto count = this->entry_count;
+
+        while (count > 0)
+        {
+            auto const half = count / 2;
+
+            if (compare_identifiers(this->get_identifier(first + half), identifier) < 0)
+            {
+                first += half + 1;
+                count -= half + 1;
+            }
+            else
+            {
+                count = half;
+            }
+        }
+
+        return ((first < this->entry_count) && (compare_identifiers(this->get_identifier(first), identifier) == 0)) ? first : this->entry_count;
+    }
+};
+
+/*
+ * Reads the layout of a version 3 archive, unlocks it, and decrypts
+ * and checks its directory. The source is where the blocks are read
+ * from later.
+ */
+template<typename Source>
+static std::error_code open_block_store(Source* source, uint64_t offset, pm::span<uint8_t> headers, bhpm_header const& header, pm::span<uint8_t> password, pm::kdf_params const& kdf, block_store* store) noexcept
+{
+    auto& layout = store->layout;
+    if (!source->read(offset, &layout, sizeof(layout))) return pm::ntstatus_t::UNSUCCESSFUL;
+    offset += sizeof(layout);
+
+    store->header = header;
+    std::memcpy(store->associated_data,                  headers.data(), static_cast<std::size_t>(headers.size()));
+    std::memcpy(store->associated_data + headers.size(), &layout,        sizeof(layout));
+
+    //The directory and the blocks, each followed by its tag, have to take up the rest of the archive exactly
+    auto const tag_length = get_message_tag_length(header);
+    auto const rest       = source->size() - offset;
+
+    if ((layout.block_length == 0) || (layout.block_length > UINT16_MAX))                  return pm::ntstatus_t::UNSUCCESSFUL;
+    if ((layout.directory_length < sizeof(bhpm_columns_header)) || (layout.directory_length > rest)) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    auto const blocks_length = uint64_t{ layout.block_count } * (layout.block_length + tag_length);
+    if (rest - layout.directory_length != tag_length + blocks_length) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    //Unlock the archive, keeping the key for the blocks
+    auto success = pm::derive_key(password, kdf, &store->key);
+    if (success) return success;
+
+    auto const directory_length = static_cast<std::size_t>(layout.directory_length);
+    store->directory = allocate_plain_text(directory_length);
+    store->block     = allocate_plain_text(layout.block_length);
+    if (!store->directory || !store->block) return pm::ntstatus_t::NO_MEMORY;
+
+    uint8_t tag[pm::ctr_hmac_stream::tag_length];
+    auto const* input = read_or_view(source, offset, store->directory.get(), directory_length);
+    if (!input || !source->read(offset + directory_length, tag, tag_length)) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    auto* const directory = store->directory.get();
+    if (header.minor_version == 3)
+        success = open_message<pm::chacha_poly_stream>(store->key, 0, header, store->get_associated_data(), input, directory_length, tag, directory);
+    else
+        success = open_message<pm::ctr_hmac_stream>(store->key, 0, header, store->get_associated_data(), input, directory_length, tag, directory);
+
+    if (success) return success;
+
+    //A damaged count cannot make the tables longer than the directory
+    bhpm_columns_header columns_header;
+    std::memcpy(&columns_header, directory, sizeof(columns_header));
+
+    auto const table_entry_length = sizeof(uint32_t) + sizeof(bhpm_password_location);
+    auto const tables_rest        = directory_length - sizeof(columns_header);
+    if (columns_header.entry_count > tables_rest / table_entry_length) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    store->entry_count     = columns_header.entry_count;
+    store->identifier_ends = directory + sizeof(columns_header);
+    store->locations       = store->identifier_ends + store->entry_count * sizeof(uint32_t);
+    store->identifiers     = reinterpret_cast<char const*>(store->locations + store->entry_count * sizeof(bhpm_password_location));
+
+    //The identifiers have to fill the rest of the directory, and every password has to be inside its block
+    auto const identifiers_length = tables_rest - store->entry_count * table_entry_length;
+    auto       identifier_end     = uint32_t{ 0 };
+
+    for (std::size_t i = 0; i < store->entry_count; i++)
+    {
+        auto const next_end = load_column_end(store->identifier_ends, i);
+        if (next_end < identifier_end) return pm::ntstatus_t::UNSUCCESSFUL;
+        identifier_end = next_end;
+
+        auto const location = store->get_location(i);
+        if (location.block >= layout.block_count)                            return pm::ntstatus_t::UNSUCCESSFUL;
+        if (uint32_t{ location.offset } + location.length > layout.block_length) return pm::ntstatus_t::UNSUCCESSFUL;
+    }
+
+    if (identifier_end != identifiers_length) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    store->blocks_offset = offset + directory_length + tag_length;
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+/*
+ * Decrypts and checks one block of a version 3 archive.
+ */
+template<typename Source>
+static std::error_code load_block(Source* source, block_store const& store, uint32_t block, uint8_t* output) noexcept
+{
+    auto const tag_length = get_message_tag_length(store.header);
+    auto const offset     = store.blocks_offset + uint64_t{ block } * (store.layout.block_length + tag_length);
+    auto const length     = static_cast<std::size_t>(store.layout.block_length);
+
+    uint8_t tag[pm::ctr_hmac_stream::tag_length];
+    auto const* input = read_or_view(source, offset, output, length);
+    if (!input || !source->read(offset + length, tag, tag_length)) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    if (store.header.minor_version == 3) return open_message<pm::chacha_poly_stream>(store.key, uint64_t{ block } + 1, store.header, store.get_associated_data(), input, length, tag, output);
+
+    return open_message<pm::ctr_hmac_stream>(store.key, uint64_t{ block } + 1, store.header, store.get_associated_data(), input, length, tag, output);
+}
+
+/*
+ * Hands out an entry of a version 3 archive, decrypting the block
+ * with its password unless it is the one decrypted last. The entry
+ * is valid until another block is decrypted.
+ */
+template<typename Source>
+static std::error_code get_block_entry(Source* source, block_store* store, std::size_t index, pm::entry* result) noexcept
+{
+    auto const location = store->get_location(index);
+
+    if (location.block != store->loaded_block)
+    {
+        store->loaded_block = no_block;
+
+        auto success = load_block(source, *store, location.block, store->block.get());
+        if (success) return success;
+
+        store->loaded_block = location.block;
+    }
+
+    *result = pm::entry
+    {
+        store->get_identifier(index),
+        pm::span<char>{ reinterpret_cast<char const*>(store->block.get()) + location.offset, location.length },
+    };
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+/*
+ * Reads a version 3 archive into a vault, decrypting every block
+ * after the directory. The identifiers and the blocks are kept
+ * together in the plain text of the vault.
+ */
+template<typename Source>
+static pm::vault read_block_body(Source* source, uint64_t offset, pm::span<uint8_t> headers, bhpm_header const& header, pm::span<uint8_t> password, pm::kdf_params const& kdf) noexcept
+{
+    auto store = block_store{};
+    if (open_block_store(source, offset, headers, header, password, kdf, &store) != pm::ntstatus_t::SUCCESS) return {};
+
+    auto const identifiers_length = (store.entry_count > 0) ? load_column_end(store.identifier_ends, store.entry_count - 1) : 0;
+    auto const blocks_length      = uint64_t{ store.layout.block_count } * store.layout.block_length;
+
+    auto plain_text = allocate_plain_text(identifiers_length + blocks_length);
+    if (!plain_text) return {};
+
+    std::memcpy(plain_text.get(), store.identifiers, identifiers_length);
+
+    auto* const blocks = plain_text.get() + identifiers_length;
+    for (uint32_t block = 0; block < store.layout.block_count; block++)
+    {
+        if (load_block(source, store, block, blocks + std::size_t{ block } * store.layout.block_length) != pm::ntstatus_t::SUCCESS) return {};
+    }
+
+    auto entries = std::vector<pm::entry>{};
+    entries.reserve(store.entry_count);
+
+    auto const* identifiers = reinterpret_cast<char const*>(plain_text.get());
+    auto const* passwords   = reinterpret_cast<char const*>(blocks);
+
+    for (std::size_t i = 0; i < store.entry_count; i++)
+    {
+        auto const identifier = store.get_identifier(i);
+        auto const location   = store.get_location(i);
+
+        entries.push_back(pm::entry
+        {
+            pm::span<char>{ identifiers + (identifier.data() - store.identifiers), identifier.size() },
+            pm::span<char>{ passwords + std::size_t{ location.block } * store.layout.block_length + location.offset, location.length },
+        });
+    }
+
+    return pm::vault{ std::move(plain_text), std::move(entries) };
+}
+
+/*
+ * Reads an archive into a vault: the whole plain text is decrypted
+ * into one buffer, which the entries are views into.
+ */
+template<typename Source>
+static pm::vault read_archive(Source* source, pm::span<uint8_t> password) noexcept
+{
+    auto             header = bhpm_header{};
+    auto             kdf    = pm::kdf_params{};
+    auto             offset = uint64_t{ 0 };
+    bhpm_raw_headers headers;
+    if (!read_headers(source, &header, &kdf, headers, &offset)) return {};
+
+    //Minor version 2 replaced CBC and xorshift with authenticated CTR, and minor version 3 uses ChaCha20 instead
+    auto const sealed_headers = pm::span<uint8_t>{ headers, static_cast<std::ptrdiff_t>(sizeof(headers)) };
+
+    //Major version 3 seals its directory and every block on their own
+    if (header.major_version == 3) return read_block_body(source, offset, sealed_headers, header, password, kdf);
+
+    if (header.minor_version == 3) return read_sealed_body<pm::chacha_poly_stream>(source, offset, sealed_headers, header, password, kdf);
+    if (header.minor_version == 2) return read_sealed_body<pm::ctr_hmac_stream>   (source, offset, sealed_headers, header, password, kdf);
+
+    return read_cbc_body(source, offset, header, password, kdf);
+}
+
+pm::vault pm::read_archive(span<std::uint8_t> data, span<std::uint8_t> password) noexcept
+{
+    auto source = memory_source{ data };
+
+    return ::read_archive(&source, password);
+}
+
+pm::vault pm::read_archive(std::istream& stream, span<std::uint8_t> password) noexcept
+{
+    auto source = stream_source{ &stream };
+
+    return ::read_archive(&source, password);
+}
+
+pm::vault pm::read_archive_file(char const* path, span<std::uint8_t> password) noexcept
+{
+    //The mapping only has to outlive the reading, the vault has its own copy of the plain text
+    auto const file = mapped_file{ path };
+    if (file.size() == 0) return {};
+
+    return pm::read_archive(file, password);
+}
+
+/*
+ * What a reader keeps between entries: the archive, the cipher of
+ * its version, the batch of plain text being read and the entry
+ * handed out last. A version 3 archive is read through its
+ * directory instead, a block at a time.
+ */
+struct pm::archive_reader::state
+{
+public:
+    explicit state(span<uint8_t> data) noexcept
+        : source{ data }
+    {}
+
+    explicit state(char const* path) noexcept
+        : file{ path }, source{ file }
+    {}
+
+    state(state const&) = delete;
+    state& operator = (state const&) = delete;
+
+    ~state()
+    {
+        secure_wipe(this->entry_data, sizeof(this->entry_data));
+    }
+
+    //Reads the headers, unlocks the archive with the password and gets ready to read the first entry
+    std::error_code open(span<uint8_t> password) noexcept
+    {
+        if (!read_headers(&this->source, &this->header, &this->kdf, this->headers, &this->body_offset)) return ntstatus_t::UNSUCCESSFUL;
+
+        //Version 3 seals its directory and blocks on their own, and has nothing to stream
+        if (this->has_blocks())
+        {
+            auto const sealed_headers = span<uint8_t>{ this->headers, static_cast<std::ptrdiff_t>(sizeof(this->headers)) };
+
+            auto success = open_block_store(&this->source, this->body_offset, sealed_headers, this->header, password, this->kdf, &this->blocks);
+            if (success) return success;
+
+            this->entry_count = this->blocks.entry_count;
+
+            return ntstatus_t::SUCCESS;
+        }
+
+        auto success = std::error_code{};
+
+        if (this->header.minor_version == 3)
+            success = this->open_sealed(&this->chacha, password);
+        else if (this->header.minor_version == 2)
+            success = this->open_sealed(&this->ctr, password);
+        else
+            success = this->open_cbc(password);
+
+        if (success) return success;
+
+        //Version 2 keeps the identifiers apart from the passwords, and they are read up front
+        if (this->has_columns()) return this->open_columns();
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    bool has_columns() const noexcept
+    {
+        return (this->header.major_version == 2);
+    }
+
+    bool has_blocks() const noexcept
+    {
+        return (this->header.major_version == 3);
+    }
+
+    //Whether every entry of a version 2 or 3 archive has been handed out
+    bool entries_done() const noexcept
+    {
+        return (this->next_entry == this->entry_count);
+    }
+
+    //Hands out the next entry of a version 3 archive, decrypting the block with its password when it is reached
+    std::error_code take_block_entry(entry* e) noexcept
+    {
+        auto success = get_block_entry(&this->source, &this->blocks, this->next_entry, e);
+        if (success) return success;
+
+        this->next_entry++;
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    //Hands out the next entry of a version 2 archive, reading its password from the column
+    std::error_code take_column_entry(entry* e) noexcept
+    {
+        auto const  i               = this->next_entry;
+        auto const* identifier_ends = this->tables.get();
+        auto const* password_ends   = identifier_ends + this->entry_count * sizeof(uint32_t);
+
+        auto const identifier_start = (i > 0) ? load_column_end(identifier_ends, i - 1) : 0;
+        auto const password_start   = (i > 0) ? load_column_end(password_ends,   i - 1) : 0;
+        auto const identifier_end   = load_column_end(identifier_ends, i);
+        auto const password_end     = load_column_end(password_ends,   i);
+
+        //The passwords follow the identifiers in the same order, so they are read straight on
+        auto success = this->take(this->password.get(), password_end - password_start);
+        if (success) return success;
+
+        auto const* identifiers = reinterpret_cast<char const*>(this->identifiers.get());
+        auto const* password    = reinterpret_cast<char const*>(this->password.get());
+
+        *e = entry
+        {
+            span<char>{ identifiers + identifier_start, static_cast<std::ptrdiff_t>(identifier_end - identifier_start) },
+            span<char>{ password,                       static_cast<std::ptrdiff_t>(password_end   - password_start)   },
+        };
+
+        this->next_entry++;
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    //Copies the next bytes of the plain text out, decrypting more of it as needed
+    std::error_code take(uint8_t* output, std::size_t length) noexcept
+    {
+        while (length > 0)
+        {
+            if (this->batch_position == this->batch_length)
+            {
+                auto success = this->decrypt_batch();
+                if (success) return success;
+            }
+
+            auto const count = std::min(length, this->batch_length - this->batch_position);
+            std::memcpy(output, this->batch.get() + this->batch_position, count);
+            if (this->hashing) this->hash_context.update(output, count);
+
+            this->batch_position += count;
+            output               += count;
+            length               -= count;
+        }
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    //Checks what can only be checked at the end marker
+    std::error_code finish() noexcept
+    {
+        //The older versions end with the hash of the entries
+        if (this->hashing)
+        {
+            auto hash = std::array<uint8_t, security::sha256::digest_length>{};
+            this->hash_context.finish(hash);
+            this->hashing = false;
+
+            if (std::memcmp(hash.data(), &this->expected_hash, hash.size()) != 0) return ntstatus_t::UNSUCCESSFUL;
+        }
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    uint8_t entry_data[max_entry_length];
+
+private:
+    /*
+     * Checks the tag of the whole archive without decrypting it,
+     * and starts the cipher that decrypts it as it is read. The
+     * tags of the segments are kept, and every batch is checked
+     * against them once it has been copied out of the archive, so
+     * an archive that changes between the two passes cannot hand
+     * out plain text that was never authenticated.
+     */
+    template<typename Stream>
+    std::error_code open_sealed(Stream* cipher, span<uint8_t> password) noexcept
+    {
+        //The cipher text holds the entries, and the tag follows it
+        auto const tag_length  = Stream::tag_length;
+        auto const data_length = this->source.size() - this->body_offset;
+        if (data_length < get_min_plain_text_length(this->header) + tag_length) return ntstatus_t::UNSUCCESSFUL;
+
+        this->body_length = data_length - tag_length;
+
+        auto const* body = this->source.view(this->body_offset, static_cast<std::size_t>(this->body_length));
+        auto const* tag  = this->source.view(this->body_offset + this->body_length, tag_length);
+
+        //Unlock the archive, with the headers authenticated along with the entries
+        auto key     = derived_key{};
+        auto success = derive_key(password, this->kdf, &key);
+        if (success) return success;
+
+        auto const nonce          = span<uint8_t>{ reinterpret_cast<uint8_t const*>(this->header.iv), Stream::nonce_length };
+        auto const sealed_headers = span<uint8_t>{ this->headers, static_cast<std::ptrdiff_t>(sizeof(this->headers)) };
+
+        auto checker = Stream{ Stream::direction::AUTHENTICATE };
+        success = checker.init(key, nonce, sealed_headers);
+        if (!success) success = cipher->init(key, nonce, sealed_headers);
+        secure_wipe(key.data(), key.size());
+        if (success) return success;
+
+        //Keep the tag of every segment for the pass that decrypts
+        auto const segment_count = static_cast<std::size_t>((this->body_length + Stream::segment_length - 1) / Stream::segment_length);
+        auto const batch_length  = get_batch_length<Stream>();
+
+        this->segment_length     = Stream::segment_length;
+        this->segment_tag_length = Stream::segment_tag_length;
+        this->segment_tags.reset(new (std::nothrow) uint8_t[segment_count * Stream::segment_tag_length]);
+        this->batch_tags  .reset(new (std::nothrow) uint8_t[batch_length / Stream::segment_length * Stream::segment_tag_length]);
+        if (!this->segment_tags || !this->batch_tags) return ntstatus_t::NO_MEMORY;
+
+        //Nothing is handed out unless the archive is exactly what was written
+        auto authenticated = std::size_t{ 0 };
+        success = checker.update(span<uint8_t>{ body, static_cast<std::ptrdiff_t>(this->body_length) }, nullptr, 0, &authenticated, this->segment_tags.get());
+        if (!success) success = checker.verify(span<uint8_t>{ tag, static_cast<std::ptrdiff_t>(tag_length) });
+        if (success) return success;
+
+        return this->allocate_batch(batch_length);
+    }
+
+    /*
+     * Unlocks a minor version 0 or 1 archive and reads the hash in front
+     * of the entries.
+     */
+    std::error_code open_cbc(span<uint8_t> password) noexcept
+    {
+        //The encrypted block holds the hash, the entries, the padding and the xorshift seed
+        auto const block_length = crypto_session::iv_length;
+        auto const data_length  = this->source.size() - this->body_offset;
+        if (data_length < sizeof(bhpm_data_hash) + sizeof(bhpm_entry_header) + sizeof(bhpm_xorshift_seed)) return ntstatus_t::UNSUCCESSFUL;
+        if (data_length % block_length != 0) return ntstatus_t::UNSUCCESSFUL;
+
+        //Unlock the archive
+        auto success = this->session.open(password, this->kdf);
+        if (success) return success;
+
+        //The seed is the last block, which decrypts on its own with the block before it as the IV
+        auto const* tail = this->source.view(this->body_offset + data_length - 2 * block_length, 2 * block_length);
+
+        auto seed_block = bhpm_xorshift_seed{};
+        auto seed_len   = std::size_t{ 0 };
+        success = this->session.decrypt(span<uint8_t>{ tail + block_length, block_length }, span<uint8_t>{ tail, block_length }, reinterpret_cast<uint8_t*>(seed_block.seed), sizeof(seed_block), &seed_len);
+        if (success) return success;
+
+        this->xs_state    = xorshift_state{ seed_block.seed };
+        this->body_length = data_length - sizeof(bhpm_xorshift_seed);
+
+        success = this->cbc.init(span<uint8_t>{ reinterpret_cast<uint8_t const*>(this->header.iv), block_length });
+        if (!success) success = this->allocate_batch(archive_chunk_length);
+        if (!success) success = this->take(reinterpret_cast<uint8_t*>(&this->expected_hash), sizeof(this->expected_hash));
+        if (success) return success;
+
+        //Everything from here to the end marker is hashed, unless the archive came without a hash
+        this->hash_context.init();
+        this->hashing = has_data_hash(this->expected_hash);
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    /*
+     * Reads the offset tables and the identifier column of a version
+     * 2 archive, which leaves the cipher at the start of the password
+     * column, and makes room for the longest password.
+     */
+    std::error_code open_columns() noexcept
+    {
+        bhpm_columns_header columns_header;
+        auto success = this->take(reinterpret_cast<uint8_t*>(&columns_header), sizeof(columns_header));
+        if (success) return success;
+
+        //A damaged count cannot make the tables longer than the archive
+        auto const rest = this->body_length - sizeof(columns_header);
+        if (columns_header.entry_count > rest / (2 * sizeof(uint32_t))) return ntstatus_t::UNSUCCESSFUL;
+
+        this->entry_count = columns_header.entry_count;
+
+        auto const tables_length = this->entry_count * 2 * sizeof(uint32_t);
+        this->tables = allocate_plain_text(tables_length);
+        if (!this->tables) return ntstatus_t::NO_MEMORY;
+
+        success = this->take(this->tables.get(), tables_length);
+        if (success) return success;
+
+        if (!check_column_tables(this->tables.get(), this->entry_count, rest - tables_length)) return ntstatus_t::UNSUCCESSFUL;
+
+        auto const* identifier_ends    = this->tables.get();
+        auto const* password_ends      = identifier_ends + this->entry_count * sizeof(uint32_t);
+        auto const  identifiers_length = (this->entry_count > 0) ? load_column_end(identifier_ends, this->entry_count - 1) : 0;
+
+        this->identifiers = allocate_plain_text(identifiers_length);
+        if (!this->identifiers) return ntstatus_t::NO_MEMORY;
+
+        success = this->take(this->identifiers.get(), identifiers_length);
+        if (success) return success;
+
+        auto longest_password = uint32_t{ 0 };
+        auto password_start   = uint32_t{ 0 };
+        for (std::size_t i = 0; i < this->entry_count; i++)
+        {
+            auto const password_end = load_column_end(password_ends, i);
+            longest_password = std::max(longest_password, password_end - password_start);
+            password_start   = password_end;
+        }
+
+        this->password = allocate_plain_text(longest_password);
+        if (!this->password) return ntstatus_t::NO_MEMORY;
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    std::error_code allocate_batch(std::size_t capacity) noexcept
+    {
+        this->batch = secure_byte_array{ new (std::nothrow) uint8_t[capacity], secure_array_deleter<uint8_t>{ capacity } };
+        if (!this->batch) return ntstatus_t::NO_MEMORY;
+
+        this->batch_capacity = capacity;
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    //Decrypts the next batch of the body, which must be there since the end marker has not been read
+    std::error_code decrypt_batch() noexcept
+    {
+        auto const length = static_cast<std::size_t>(std::min<uint64_t>(this->batch_capacity, this->body_length - this->position));
+        if (length == 0) return ntstatus_t::UNSUCCESSFUL;
+
+        auto decrypted = std::size_t{ 0 };
+        auto success   = std::error_code{};
+
+        if (this->header.minor_version >= 2)
+        {
+            //Copy the batch out of the archive first, so the bytes checked against the first pass are the bytes decrypted
+            if (!this->source.read(this->body_offset + this->position, this->batch.get(), length)) return ntstatus_t::UNSUCCESSFUL;
+
+            auto const input = span<uint8_t>{ this->batch.get(), static_cast<std::ptrdiff_t>(length) };
+
+            if (this->header.minor_version == 3)
+                success = this->chacha.update(input, this->batch.get(), length, &decrypted, this->batch_tags.get());
+            else
+                success = this->ctr.update(input, this->batch.get(), length, &decrypted, this->batch_tags.get());
+
+            //The segments have to be the ones authenticated, or the plain text is wiped rather than handed out
+            auto const first_tag   = static_cast<std::size_t>(this->position / this->segment_length) * this->segment_tag_length;
+            auto const tags_length = (length + this->segment_length - 1) / this->segment_length * this->segment_tag_length;
+
+            if (!success && !secure_equal(this->batch_tags.get(), this->segment_tags.get() + first_tag, tags_length))
+            {
+                secure_wipe(this->batch.get(), length);
+                success = ntstatus_t::AUTH_TAG_MISMATCH;
+            }
+        }
+        else
+        {
+            auto const input = span<uint8_t>{ this->source.view(this->body_offset + this->position, length), static_cast<std::ptrdiff_t>(length) };
+
+            success = this->cbc.update(input, this->batch.get(), length, &decrypted);
+            if (!success) xorshift_in_place(this->batch.get(), length, &this->xs_state);
+        }
+
+        if (success) return success;
+
+        this->position      += length;
+        this->batch_length   = length;
+        this->batch_position = 0;
+
+        return ntstatus_t::SUCCESS;
+    }
+
+    static constexpr uint64_t const no_seed[2]{};
+
+    mapped_file      file;
+    memory_source    source;
+    bhpm_header      header{};
+    kdf_params       kdf{};
+    bhpm_raw_headers headers{};
+    uint64_t         body_offset = 0;
+    uint64_t         body_length = 0;
+    uint64_t         position    = 0;
+
+    //Minor versions 0 and 1
+    crypto_session            session;
+    cipher_stream             cbc{ session, cipher_stream::direction::DECRYPT };
+    xorshift_state            xs_state{ no_seed };
+    security::sha256::context hash_context;
+    bhpm_data_hash            expected_hash{};
+    bool                      hashing = false;
+
+    //Minor versions 2 and 3
+    ctr_hmac_stream            ctr{ ctr_hmac_stream::direction::DECRYPT };
+    chacha_poly_stream         chacha{ chacha_poly_stream::direction::DECRYPT };
+    std::unique_ptr<uint8_t[]> segment_tags;
+    std::unique_ptr<uint8_t[]> batch_tags;
+    std::size_t                segment_length     = 0;
+    std::size_t                segment_tag_length = 0;
+
+    //Major version 2
+    secure_byte_array tables;
+    secure_byte_array identifiers;
+    secure_byte_array password;
+    std::size_t       entry_count = 0;
+    std::size_t       next_entry  = 0;
+
+    //Major version 3
+    block_store blocks;
+
+    secure_byte_array batch;
+    std::size_t       batch_capacity = 0;
+    std::size_t       batch_length   = 0;
+    std::size_t       batch_position = 0;
+};
+
+pm::archive_reader::archive_reader(span<std::uint8_t> data, span<std::uint8_t> password) noexcept
+    : impl{ new (std::nothrow) state{ data } }
+{
+    this->open(password);
+}
+
+pm::archive_reader::archive_reader(char const* path, span<std::uint8_t> password) noexcept
+    : impl{ new (std::nothrow) state{ path } }
+{
+    this->open(password);
+}
+
+pm::archive_reader::~archive_reader() = default;
+
+void pm::archive_reader::open(span<std::uint8_t> password) noexcept
+{
+    if (!this->impl)
+    {
+        this->status = ntstatus_t::NO_MEMORY;
+        return;
+    }
+
+    this->status = this->impl->open(password);
+}
+
+pm::archive_reader::iterator pm::archive_reader::begin() noexcept
+{
+    if (this->started) return this->end();
+    this->started = true;
+
+    return this->advance() ? iterator{ this } : this->end();
+}
+
+bool pm::archive_reader::advance() noexcept
+{
+    //Nothing more comes after a failure or the end
+    if (this->status || !this->impl) return false;
+
+    auto& st = *this->impl;
+    this->current = entry{};
+
+    //Versions 2 and 3 have no end marker, they end after the number of entries they start with
+    if (st.has_columns() || st.has_blocks())
+    {
+        if (st.entries_done())
+        {
+            this->status = st.finish();
+            this->impl.reset();
+            return false;
+        }
+
+        this->status = st.has_blocks() ? st.take_block_entry(&this->current) : st.take_column_entry(&this->current);
+
+        return !this->status;
+    }
+
+    bhpm_entry_header entry_header;
+    this->status = st.take(st.entry_data, sizeof(entry_header));
+    if (this->status) return false;
+
+    std::memcpy(&entry_header, st.entry_data, sizeof(entry_header));
+
+    //An empty entry marks the end, and the reader is done with the archive
+    if ((entry_header.id_len == 0) && (entry_header.pass_len == 0))
+    {
+        this->status = st.finish();
+        this->impl.reset();
+        return false;
+    }
+
+    this->status = st.take(st.entry_data + sizeof(entry_header), static_cast<std::size_t>(entry_header.id_len) + entry_header.pass_len);
+    if (this->status) return false;
+
+    auto const* id = reinterpret_cast<char const*>(st.entry_data + sizeof(entry_header));
+    this->current = entry
+    {
+        span<char>{ id,                       entry_header.id_len },
+        span<char>{ id + entry_header.id_len, entry_header.pass_len },
+    };
+
+    return true;
+}
+
+/*
+ * What an open version 3 archive keeps: the archive, its directory
+ * and the block decrypted last.
+ */
+struct pm::block_archive::state
+{
+public:
+    explicit state(span<uint8_t> data) noexcept
+        : source{ data }
+    {}
+
+    //Only the directory and the blocks that are looked up are read
+    explicit state(char const* path) noexcept
+        : file{ path, mapped_file::access::SPARSE }, source{ file }
+    {}
+
+    state(state const&) = delete;
+    state& operator = (state const&) = delete;
+
+    //Reads the headers, unlocks the archive with the password and decrypts its directory
+    std::error_code open(span<uint8_t> password) noexcept
+    {
+        auto             header = bhpm_header{};
+        auto             kdf    = kdf_params{};
+        bhpm_raw_headers headers;
+        auto             offset = uint64_t{ 0 };
+
+        if (!read_headers(&this->source, &header, &kdf, headers, &offset)) return ntstatus_t::UNSUCCESSFUL;
+
+        //The older versions have no blocks, and have to be read whole
+        if (header.major_version != 3) return ntstatus_t::NOT_SUPPORTED;
+
+        auto const sealed_headers = span<uint8_t>{ headers, static_cast<std::ptrdiff_t>(sizeof(headers)) };
+
+        return open_block_store(&this->source, offset, sealed_headers, header, password, kdf, &this->store);
+    }
+
+    mapped_file   file;
+    memory_source source;
+    block_store   store;
+};
+
+pm::block_archive::block_archive() noexcept
+    : status{ ntstatus_t::INVALID_HANDLE }
+{}
+
+pm::block_archive::block_archive(span<std::uint8_t> data, span<std::uint8_t> password) noexcept
+    : impl{ new (std::nothrow) state{ data } }
+{
+    this->open(password);
+}
+
+pm::block_archive::block_archive(char const* path, span<std::uint8_t> password) noexcept
+    : impl{ new (std::nothrow) state{ path } }
+{
+    this->open(password);
+}
+
+pm::block_archive::block_archive(block_archive&& other) noexcept = default;
+pm::block_archive& pm::block_archive::operator = (block_archive&& other) noexcept = default;
+
+pm::block_archive::~block_archive() = default;
+
+void pm::block_archive::open(span<std::uint8_t> password) noexcept
+{
+    if (!this->impl)
+    {
+        this->status = ntstatus_t::NO_MEMORY;
+        return;
+    }
+
+    this->status = this->impl->open(password);
+
+    //Nothing of an archive that failed to open is kept
+    if (this->status) this->impl.reset();
+}
+
+std::size_t pm::block_archive::size() const noexcept
+{
+    return this->impl ? this->impl->store.entry_count : 0;
+}
+
+std::error_code pm::block_archive::find(span<char> identifier, entry* result) noexcept
+{
+    if (!this->impl) return ntstatus_t::INVALID_HANDLE;
+
+    auto const index = this->impl->store.find(identifier);
+    if (index == this->impl->store.entry_count) return ntstatus_t::NOT_FOUND;
+
+    return get_block_entry(&this->impl->source, &this->impl->store, index, result);
+}
+
+std::error_code pm::block_archive::get_entry(std::size_t index, entry* result) noexcept
+{
+    if (!this->impl)                            return ntstatus_t::INVALID_HANDLE;
+    if (index >= this->impl->store.entry_count) return ntstatus_t::INVALID_PARAMETER;
+
+    return get_block_entry(&this->impl->source, &this->impl->store, index, result);
+}
+
+/*
+ * Collects the plain text of an archive into batches, and encrypts
+ * and writes out each batch once it is full.
+ */
+template<typename Stream>
+struct batch_writer
+{
+public:
+    batch_writer(std::ostream* stream, Stream* cipher, uint8_t* batch, std::size_t capacity) noexcept
+        : stream{ stream }, cipher{ cipher }, batch{ batch }, capacity{ capacity }
+    {}
+
+    //Appends data to the plain text
+    std::error_code put(void const* data, std::size_t length) noexcept
+    {
+        auto const* bytes = static_cast<uint8_t const*>(data);
+
+        while (length > 0)
+        {
+            auto const count = std::min(this->capacity - this->length, length);
+            std::memcpy(this->batch + this->length, bytes, count);
+            this->length += count;
+            bytes        += count;
+            length       -= count;
+
+            if (this->length == this->capacity)
+            {
+                auto success = this->flush();
+                if (success) return success;
+            }
+        }
+
+        return pm::ntstatus_t::SUCCESS;
+    }
+
+    //Writes out what has been collected
+    std::error_code flush() noexcept
+    {
+        //Encrypt in place
+        auto encrypted = std::size_t{ 0 };
+        auto success   = this->cipher->update(pm::span<uint8_t>{ this->batch, static_cast<std::ptrdiff_t>(this->length) }, this->batch, this->length, &encrypted);
+        if (success) return success;
+
+        this->stream->write(reinterpret_cast<char const*>(this->batch), static_cast<std::streamsize>(encrypted));
+        if (!*this->stream) return pm::ntstatus_t::UNSUCCESSFUL;
+
+        this->length = 0;
+
+        return pm::ntstatus_t::SUCCESS;
+    }
+
+private:
+    std::ostream* stream;
+    Stream*       cipher;
+    uint8_t*      batch;
+    std::size_t   capacity;
+    std::size_t   length = 0;
+};
+
+/*
+ * Serializes the entries into the plain text of a version 2 archive:
+ * the number of entries, where each identifier and each password
+ * ends in its column, and then the two columns.
+ */
+template<typename F>
+static std::error_code put_columns(std::vector<pm::entry> const& entries, F&& put) noexcept
+{
+    auto const columns_header = bhpm_columns_header{ static_cast<uint32_t>(entries.size()) };
+
+    auto success = put(&columns_header, sizeof(columns_header));
+
+    auto identifier_end = uint32_t{ 0 };
+    for (auto const& entry : entries)
+    {
+        identifier_end += static_cast<uint32_t>(entry.identifier.size());
+        if (!success) success = put(&identifier_end, sizeof(identifier_end));
+    }
+
+    auto password_end = uint32_t{ 0 };
+    for (auto const& entry : entries)
+    {
+        password_end += static_cast<uint32_t>(entry.password.size());
+        if (!success) success = put(&password_end, sizeof(password_end));
+    }
+
+    for (auto const& entry : entries)
+    {
+        if (!success) success = put(entry.identifier.data(), static_cast<std::size_t>(entry.identifier.size()));
+    }
+
+    for (auto const& entry : entries)
+    {
+        if (!success) success = put(entry.password.data(), static_cast<std::size_t>(entry.password.size()));
+    }
+
+    return success;
+}
+
+/*
+ * Writes the headers, then streams the entries through the cipher
+ * a batch at a time and writes the tag after them.
+ */
+template<typename Stream>
+static std::error_code write_sealed_body(std::ostream* stream, std::vector<pm::entry> const& entries, pm::span<uint8_t> headers, bhpm_header const& header, pm::derived_key const& key) noexcept
+{
+    auto cipher  = Stream{ Stream::direction::ENCRYPT };
+    auto success = cipher.init(key, pm::span<uint8_t>{ reinterpret_cast<uint8_t const*>(header.iv), Stream::nonce_length }, headers);
+    if (success) return success;
+
+    //Write the headers
+    stream->write(reinterpret_cast<char const*>(headers.data()), headers.size());
+    if (!*stream) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    auto const batch_length = get_batch_length<Stream>();
+    auto const batch        = std::make_unique<uint8_t[]>(batch_length);
+    auto writer = batch_writer<Stream>{ stream, &cipher, batch.get(), batch_length };
+
+    uint8_t tag[Stream::tag_length];
+    success = put_columns(entries, [&](void const* data, std::size_t length) noexcept { return writer.put(data, length); });
+    if (!success) success = writer.flush();
+    if (!success) success = cipher.finish(tag, sizeof(tag));
+
+    //The batch held plain text
+    pm::secure_wipe(batch.get(), batch_length);
+    if (success) return success;
+
+    stream->write(reinterpret_cast<char const*>(tag), sizeof(tag));
+    if (!*stream) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+/*
+ * Whether the processor has AES instructions. Without them AES is
+ * bitsliced, which is much slower than ChaCha20.
+ */
+static bool has_aes_instructions() noexcept
+{
+    auto const& cpu = pm::cpu::get_features();
+
+    return cpu.aesni || cpu.aes;
+}
+
+/*
+ * Fills in the headers of a new archive, with a fresh IV and the
+ * cipher that is fastest on this processor, and lays them out as
+ * they are written and authenticated.
+ */
+static std::error_code fill_headers(uint8_t major_version, pm::kdf_params const& kdf, bhpm_header* header, bhpm_raw_headers& headers) noexcept
+{
+    auto const use_aes = has_aes_instructions();
+
+    *header = bhpm_header{ { 'B', 'H', 'P', 'M' }, major_version, 0, static_cast<uint8_t>(use_aes ? 2 : 3), 0, {} };
+    uint32_t const magic = 0x11223344;
+    std::memcpy(&header->magic[4], &magic, sizeof(magic));
+
+    auto success = pm::get_random_bytes(reinterpret_cast<uint8_t*>(header->iv), sizeof(header->iv));
+    if (success) return success;
+
+    auto kdf_header = bhpm_kdf_header{ static_cast<uint8_t>(kdf.algorithm), {}, kdf.time_cost, kdf.memory_cost, kdf.parallelism, {} };
+    std::copy(std::begin(kdf.salt), std::end(kdf.salt), kdf_header.salt);
+
+    std::memcpy(headers,                   header,      sizeof(*header));
+    std::memcpy(headers + sizeof(*header), &kdf_header, sizeof(kdf_header));
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::write_archive(std::ostream& stream, std::vector<entry> const& entries, span<std::uint8_t> password, kdf_params const& kdf) noexcept
+{
+    //Check that the entries and both columns can be counted in 32 bits
+    auto identifiers_length = uint64_t{ 0 };
+    auto passwords_length   = uint64_t{ 0 };
+    for (auto const& entry : entries)
+    {
+        identifiers_length += static_cast<uint64_t>(entry.identifier.size());
+        passwords_length   += static_cast<uint64_t>(entry.password.size());
+    }
+
+    if ((entries.size() > UINT32_MAX) || (identifiers_length > UINT32_MAX) || (passwords_length > UINT32_MAX)) return ntstatus_t::INVALID_PARAMETER;
+
+    //Fill in the headers, in the columnar layout, which are authenticated along with the entries
+    auto             header = bhpm_header{};
+    bhpm_raw_headers headers;
+
+    auto success = fill_headers(2, kdf, &header, headers);
+    if (success) return success;
+
+    auto const sealed_headers = span<uint8_t>{ headers, static_cast<std::ptrdiff_t>(sizeof(headers)) };
+
+    //Unlock the archive
+    auto key = derived_key{};
+    success = derive_key(password, kdf, &key);
+    if (success) return success;
+
+    if (header.minor_version == 2)
+        success = write_sealed_body<ctr_hmac_stream>(&stream, entries, sealed_headers, header, key);
+    else
+        success = write_sealed_body<chacha_poly_stream>(&stream, entries, sealed_headers, header, key);
+
+    secure_wipe(key.data(), key.size());
+    if (success) return success;
+
+    stream.flush();
+    if (!stream) return ntstatus_t::UNSUCCESSFUL;
+
+    return ntstatus_t::SUCCESS;
+}
+
+/*
+ * Writes the layout, the directory and the blocks of a version 3
+ * archive after its headers, sealing each of them with a key of
+ * its own. The entries are written in the order given, each
+ * password at the location given.
+ */
+template<typename Stream>
+static std::error_code write_block_body(std::ostream* stream, std::vector<pm::entry> const& entries, std::vector<uint32_t> const& order, std::vector<bhpm_password_location> const& locations, bhpm_header const& header, bhpm_raw_headers const& headers, bhpm_block_layout const& layout, pm::derived_key const& key) noexcept
+{
+    uint8_t associated_data[sizeof(bhpm_raw_headers) + sizeof(bhpm_block_layout)];
+    std::memcpy(associated_data,                            headers, sizeof(bhpm_raw_headers));
+    std::memcpy(associated_data + sizeof(bhpm_raw_headers), &layout, sizeof(layout));
+
+    auto const sealed = pm::span<uint8_t>{ associated_data, static_cast<std::ptrdiff_t>(sizeof(associated_data)) };
+
+    //Write the headers and the layout
+    stream->write(reinterpret_cast<char const*>(associated_data), sizeof(associated_data));
+    if (!*stream) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    //The directory: the number of entries, where each identifier ends, where each password is, and the identifiers
+    auto const directory_length = static_cast<std::size_t>(layout.directory_length);
+    auto       directory        = allocate_plain_text(directory_length);
+    auto       block            = allocate_plain_text(layout.block_length);
+    if (!directory || !block) return pm::ntstatus_t::NO_MEMORY;
+
+    auto* const ends        = directory.get() + sizeof(bhpm_columns_header);
+    auto* const places      = ends + entries.size() * sizeof(uint32_t);
+    auto* const identifiers = places + entries.size() * sizeof(bhpm_password_location);
+
+    auto const columns_header = bhpm_columns_header{ static_cast<uint32_t>(entries.size()) };
+    std::memcpy(directory.get(), &columns_header, sizeof(columns_header));
+
+    auto identifier_end = uint32_t{ 0 };
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        auto const& identifier = entries[order[i]].identifier;
+        std::memcpy(identifiers + identifier_end, identifier.data(), static_cast<std::size_t>(identifier.size()));
+
+        identifier_end += static_cast<uint32_t>(identifier.size());
+        std::memcpy(ends   + i * sizeof(uint32_t),               &identifier_end, sizeof(identifier_end));
+        std::memcpy(places + i * sizeof(bhpm_password_location), &locations[i],   sizeof(bhpm_password_location));
+    }
+
+    uint8_t tag[Stream::tag_length];
+    auto success = seal_message<Stream>(key, 0, header, sealed, directory.get(), directory_length, tag);
+    if (success) return success;
+
+    stream->write(reinterpret_cast<char const*>(directory.get()), directory_length);
+    stream->write(reinterpret_cast<char const*>(tag), sizeof(tag));
+    if (!*stream) return pm::ntstatus_t::UNSUCCESSFUL;
+
+    //Fill each block with its passwords, which come in the same order, and leave the rest of it zero
+    auto next = std::size_t{ 0 };
+    for (uint32_t i = 0; i < layout.block_count; i++)
+    {
+        std::memset(block.get(), 0, layout.block_length);
+
+        for (; (next < order.size()) && (locations[next].block == i); next++)
+        {
+            auto const& password = entries[order[next]].password;
+            std::memcpy(block.get() + locations[next].offset, password.data(), locations[next].length);
+        }
+
+        success = seal_message<Stream>(key, uint64_t{ i } + 1, header, sealed, block.get(), layout.block_length, tag);
+        if (success) return success;
+
+        stream->write(reinterpret_cast<char const*>(block.get()), layout.block_length);
+        stream->write(reinterpret_cast<char const*>(tag), sizeof(tag));
+        if (!*stream) return pm::ntstatus_t::UNSUCCESSFUL;
+    }
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::write_block_archive(std::ostream& stream, std::vector<entry> const& entries, span<std::uint8_t> password, kdf_params const& kdf) noexcept
+{
+    //Check that the entries and the identifiers can be counted in 32 bits, and that every password fits in a block
+    auto identifiers_length = uint64_t{ 0 };
+    for (auto const& entry : entries)
+    {
+        identifiers_length += static_cast<uint64_t>(entry.identifier.size());
+        if (static_cast<std::size_t>(entry.password.size()) > block_archive_block_length) return ntstatus_t::INVALID_PARAMETER;
+    }
+
+    if ((entries.size() > UINT32_MAX) || (identifiers_length > UINT32_MAX)) return ntstatus_t::INVALID_PARAMETER;
+
+    //The directory is sorted by identifier, so a lookup is a binary search
+    auto order = std::vector<uint32_t>(entries.size());
+    for (std::size_t i = 0; i < order.size(); i++) order[i] = static_cast<uint32_t>(i);
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) noexcept
+    {
+        return compare_identifiers(entries[a].identifier, entries[b].identifier) < 0;
+    });
+
+    //Pack the passwords into the blocks in the same order, never splitting one across two blocks
+    auto locations = std::vector<bhpm_password_location>(entries.size());
+    auto block     = uint32_t{ 0 };
+    auto offset    = uint32_t{ 0 };
+
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        auto const length = static_cast<uint32_t>(entries[order[i]].password.size());
+
+        if (offset + length > block_archive_block_length)
+        {
+            block++;
+            offset = 0;
+        }
+
+        locations[i] = bhpm_password_location{ block, static_cast<uint16_t>(offset), static_cast<uint16_t>(length) };
+        offset += length;
+    }
+
+    auto layout = bhpm_block_layout{};
+    layout.block_length     = block_archive_block_length;
+    layout.block_count      = entries.empty() ? 0 : block + 1;
+    layout.directory_length = sizeof(bhpm_columns_header) + entries.size() * (sizeof(uint32_t) + sizeof(bhpm_password_location)) + identifiers_length;
+
+    //Fill in the headers, which are authenticated along with the directory and every block
+    auto             header = bhpm_header{};
+    bhpm_raw_headers headers;
+
+    auto success = fill_headers(3, kdf, &header, headers);
+    if (success) return success;
+
+    //Unlock the archive
+    auto key = derived_key{};
+    success = derive_key(password, kdf, &key);
+    if (success) return success;
+
+    if (header.minor_version == 2)
+        success = write_block_body<ctr_hmac_stream>(&stream, entries, order, locations, header, headers, layout, key);
+    else
+        success = write_block_body<chacha_poly_stream>(&stream, entries, order, locations, header, headers, layout, key);
+
+    secure_wipe(key.data(), key.size());
+    if (success) return success;
+
+    stream.flush();
+    if (!stream) return ntstatus_t::UNSUCCESSFUL;
+
+    return ntstatus_t::SUCCESS;
+}
+
+#include <fstream>
+
+void pm::test()
+{
+    char    id[]       = { 'A', 'B', 'C' };
+    char    pass[]     = { 'D', 'C', 'E' };
+    uint8_t password[] = { '1', '2', '3', '4' };
+
+    auto entries = std::vector<pm::entry>
+    {
+        { pm::span<char>{ id }, pm::span<char>{ pass } },
+    };
+
+    std::ofstream test;
+    test.open("test.bhpm", std::ios::binary | std::ios::out);
+
+    pm::kdf_params kdf{};
+    auto err = pm::calibrate_kdf_params(pm::kdf_algorithm::ARGON2ID, pm::default_unlock_latency, &kdf);
+    err = pm::write_archive(test, entries, pm::span<uint8_t>{ password }, kdf);
+
+    test.close();
+}
+
+void pm::test2()
+{
+    uint8_t password[] = { '1', '2', '3', '4' };
 
-    pm::read_archive(span<std::uint8_t>{ reinterpret_cast<std::uint8_t*>(data), size });
+    pm::read_archive_file("test.bhpm", pm::span<uint8_t>{ password });
 }
@@ -2,9 +2,17 @@
 #define PM_ARCHIVE_H
 #pragma once
 
+#include "kdf.h"
+#include "secure_memory.h"
 #include "span.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <iosfwd>
+#include <iterator>
+#include <memory>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 namespace pm
@@ -15,7 +23,250 @@ namespace pm
         span<char> password;
     };
 
-	std::vector<entry> read_archive(span<std::uint8_t> data) noexcept;
+    /*
+     * The entries of an archive that has been read. The whole plain
+     * text is kept in one buffer and the entries are views into it,
+     * so they are only valid while the vault is. The plain text is
+     * wiped when the vault goes away.
+     *
+     * The entries are indexed by identifier when the vault is made,
+     * in a flat hash table with open addressing. Each slot holds a
+     * 32-bit hash and a 32-bit entry number, so a lookup touches one
+     * or two cache lines of the table and then the entry itself.
+     */
+    struct vault
+    {
+    public:
+        vault() noexcept = default;
+
+        //Takes the plain text and the entries that are views into it, and indexes them
+        vault(secure_byte_array plain_text, std::vector<entry> entries) noexcept;
+
+        std::vector<entry> const& get_entries() const noexcept
+        {
+            return this->entries;
+        }
+
+        std::size_t size() const noexcept
+        {
+            return this->entries.size();
+        }
+
+        bool empty() const noexcept
+        {
+            return this->entries.empty();
+        }
+
+        auto begin() const noexcept
+        {
+            return this->entries.begin();
+        }
+
+        auto end() const noexcept
+        {
+            return this->entries.end();
+        }
+
+        //Finds the first entry with the identifier, returns false if there is none
+        bool find(span<char> identifier, entry* result) const noexcept;
+
+    private:
+        struct index_slot
+        {
+            std::uint32_t hash;
+            std::uint32_t entry;
+        };
+
+        void build_index() noexcept;
+
+        secure_byte_array                                                plain_text;
+        std::vector<entry>                                               entries;
+        std::unique_ptr<index_slot[], secure_array_deleter<index_slot>> index;
+        std::size_t                                                      index_mask = 0;
+    };
+
+    /*
+     * Reads the entries of an archive one at a time, without keeping
+     * more than a batch of it in memory, so a search can stop at the
+     * first match. It is an input range: begin starts reading, and
+     * each entry is valid until the iterator moves on.
+     *
+     * The authenticated versions are checked in full before the
+     * first entry is handed out, by a pass that reads the cipher
+     * text without decrypting it. That pass keeps the tag of every
+     * segment, and each batch is copied out of the archive and
+     * checked against them before it is decrypted, so an archive
+     * that changes while it is read fails rather than handing out
+     * plain text that was never authenticated. The older versions only have a
+     * hash at the end, so get_status can only tell whether they were
+     * intact once every entry has been read. The first writer left
+     * that hash zero, and its archives cannot be checked at all.
+     *
+     * Major version 2 keeps its passwords apart from its identifiers,
+     * so the offset tables and the identifier column are read into
+     * memory first, and the passwords are then read one at a time.
+     * Major version 3 is read through its directory, a block at a
+     * time, and hands out its entries sorted by identifier.
+     */
+    struct archive_reader
+    {
+    public:
+        struct iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type        = entry;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = entry const*;
+            using reference         = entry const&;
+
+            iterator() noexcept = default;
+
+            explicit iterator(archive_reader* reader) noexcept
+                : reader{ reader }
+            {}
+
+            reference operator *() const noexcept
+            {
+                return this->reader->current;
+            }
+
+            pointer operator ->() const noexcept
+            {
+                return &this->reader->current;
+            }
+
+            iterator& operator ++() noexcept
+            {
+                if (!this->reader->advance()) this->reader = nullptr;
+
+                return *this;
+            }
+
+            //The entry before is gone once the reader moves on, so there is nothing to return
+            void operator ++(int) noexcept
+            {
+                ++*this;
+            }
+
+            bool operator == (iterator const& other) const noexcept
+            {
+                return (this->reader == other.reader);
+            }
+
+            bool operator != (iterator const& other) const noexcept
+            {
+                return (this->reader != other.reader);
+            }
+
+        private:
+            archive_reader* reader = nullptr;
+        };
+
+        //Reads an archive in memory, which must outlive the reader, unlocking it with the password
+        archive_reader(span<std::uint8_t> data, span<std::uint8_t> password) noexcept;
+
+        //Reads an archive file through a read-only mapping, unlocking it with the password
+        archive_reader(char const* path, span<std::uint8_t> password) noexcept;
+
+        archive_reader(archive_reader const&) = delete;
+        archive_reader& operator = (archive_reader const&) = delete;
+
+        ~archive_reader();
+
+        //Starts reading, and can only be called once
+        iterator begin() noexcept;
+
+        iterator end() noexcept
+        {
+            return {};
+        }
+
+        //Whether the archive could be unlocked and everything read so far is intact
+        std::error_code get_status() const noexcept
+        {
+            return this->status;
+        }
+
+    private:
+        struct state;
+
+        void open(span<std::uint8_t> password) noexcept;
+        bool advance() noexcept;
+
+        std::unique_ptr<state> impl;
+        entry                  current{};
+        std::error_code        status;
+        bool                   started = false;
+    };
+
+    /*
+     * A version 3 archive opened for lookups. The archive is made of
+     * fixed-size blocks that are each encrypted and authenticated on
+     * their own, and a directory that says which block holds the
+     * password of each identifier. Opening it only decrypts the
+     * directory, and a lookup only decrypts the block it needs, so
+     * the passwords it is not asked for stay encrypted.
+     *
+     * An entry handed out is valid until the next lookup, which may
+     * decrypt another block in its place.
+     */
+    struct block_archive
+    {
+    public:
+        block_archive() noexcept;
+
+        //Opens an archive in memory, which must outlive it, unlocking it with the password
+        block_archive(span<std::uint8_t> data, span<std::uint8_t> password) noexcept;
+
+        //Opens an archive file through a read-only mapping, unlocking it with the password
+        block_archive(char const* path, span<std::uint8_t> password) noexcept;
+
+        block_archive(block_archive&& other) noexcept;
+        block_archive& operator = (block_archive&& other) noexcept;
+
+        block_archive(block_archive const&) = delete;
+        block_archive& operator = (block_archive const&) = delete;
+
+        ~block_archive();
+
+        //Whether the archive could be unlocked and its directory is intact
+        std::error_code get_status() const noexcept
+        {
+            return this->status;
+        }
+
+        std::size_t size() const noexcept;
+
+        //Finds the first entry with the identifier, returns NOT_FOUND if there is none
+        [[nodiscard]] std::error_code find(span<char> identifier, entry* result) noexcept;
+
+        //Gets an entry by its place in the directory, which is sorted by identifier
+        [[nodiscard]] std::error_code get_entry(std::size_t index, entry* result) noexcept;
+
+    private:
+        struct state;
+
+        void open(span<std::uint8_t> password) noexcept;
+
+        std::unique_ptr<state> impl;
+        std::error_code        status;
+    };
+
+    //Reads an archive that is already in memory, or returns an empty vault if it is damaged or the password is wrong
+    vault read_archive(span<std::uint8_t> data, span<std::uint8_t> password) noexcept;
+
+    //Reads an archive from a stream that can seek, a chunk at a time
+    vault read_archive(std::istream& stream, span<std::uint8_t> password) noexcept;
+
+    //Reads an archive file through a read-only mapping, decrypting straight from the mapped pages
+    vault read_archive_file(char const* path, span<std::uint8_t> password) noexcept;
+
+    //Writes the entries to a stream as a version 2 archive, a chunk at a time, with the key derived from the password as the parameters say
+    [[nodiscard]] std::error_code write_archive(std::ostream& stream, std::vector<entry> const& entries, span<std::uint8_t> password, kdf_params const& kdf) noexcept;
+
+    //Writes the entries to a stream as a version 3 archive of blocks, which block_archive can look up without reading it all
+    [[nodiscard]] std::error_code write_block_archive(std::ostream& stream, std::vector<entry> const& entries, span<std::uint8_t> password, kdf_params const& kdf) noexcept;
 	
     void test();
     void test2();
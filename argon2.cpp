@@ -0,0 +1,437 @@
+#include "argon2.h"
+#include "argon2_blamka.h"
+#include "argon2_impl.h"
+#include "blake2b.h"
+#include "large_pages.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+/*
+ * Implements Argon2id as described in RFC 9106 (September 2021).
+ */
+
+using byte = std::uint8_t;
+
+using pm::security::argon2id;
+using pm::security::blake2b;
+using pm::security::detail::argon2_block;
+using pm::security::detail::argon2_block_words;
+using pm::security::detail::argon2_compress_fn;
+
+/* Portable compression function */
+
+namespace
+{
+    struct portable_ops
+    {
+        struct reg
+        {
+            std::uint64_t w[4];
+        };
+
+        static reg load2(std::uint64_t const* p, std::uint64_t const* q) noexcept
+        {
+            return { { p[0], p[1], q[0], q[1] } };
+        }
+
+        static void store2(std::uint64_t* p, std::uint64_t* q, reg x) noexcept
+        {
+            p[0] = x.w[0];
+            p[1] = x.w[1];
+            q[0] = x.w[2];
+            q[1] = x.w[3];
+        }
+
+        static reg bitwise_xor(reg x, reg y) noexcept
+        {
+            return { { x.w[0] ^ y.w[0], x.w[1] ^ y.w[1], x.w[2] ^ y.w[2], x.w[3] ^ y.w[3] } };
+        }
+
+        static reg blamka(reg x, reg y) noexcept
+        {
+            reg z{};
+            for (int i = 0; i < 4; i++)
+            {
+                auto const m = (x.w[i] & 0xFFFFFFFFull) * (y.w[i] & 0xFFFFFFFFull);
+                z.w[i] = x.w[i] + y.w[i] + 2 * m;
+            }
+
+            return z;
+        }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept
+        {
+            reg z{};
+            for (int i = 0; i < 4; i++) z.w[i] = (x.w[i] >> n) | (x.w[i] << (64 - n));
+
+            return z;
+        }
+
+        template<int n>
+        static reg rotate_lanes(reg x) noexcept
+        {
+            return { { x.w[n & 3], x.w[(n + 1) & 3], x.w[(n + 2) & 3], x.w[(n + 3) & 3] } };
+        }
+    };
+
+    /*
+     * The layout of the memory, shared by every lane.
+     */
+    struct instance
+    {
+        argon2_block*      memory;
+        std::uint32_t      passes;
+        std::uint32_t      lanes;
+        std::uint32_t      memory_blocks;
+        std::uint32_t      lane_length;
+        std::uint32_t      segment_length;
+        argon2_compress_fn compress;
+    };
+};
+
+void pm::security::detail::argon2_compress_portable(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept
+{
+    argon2_compress_blocks<portable_ops>(next, prev, ref, with_xor);
+}
+
+/*
+ * Picks the fastest compression function supported by the processor.
+ */
+static argon2_compress_fn select_compress() noexcept
+{
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    if (cpu.avx2)  return pm::security::detail::argon2_compress_avx2;
+    if (cpu.ssse3) return pm::security::detail::argon2_compress_ssse3;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    return pm::security::detail::argon2_compress_neon;
+#endif
+
+    return pm::security::detail::argon2_compress_portable;
+}
+
+argon2_compress_fn pm::security::detail::get_argon2_compress() noexcept
+{
+    static argon2_compress_fn const compress = select_compress();
+
+    return compress;
+}
+
+/* Hashing */
+
+static void store_little_endian(byte* p, std::uint32_t x) noexcept
+{
+    for (int i = 0; i < 4; i++) p[i] = static_cast<byte>(x >> (8 * i));
+}
+
+/*
+ * Feeds a 32-bit little-endian length followed by the data.
+ */
+static void update_with_length(blake2b::context& ctx, byte const* data, std::size_t data_length) noexcept
+{
+    byte length[4];
+    store_little_endian(length, static_cast<std::uint32_t>(data_length));
+
+    ctx.update(length, sizeof(length));
+    if (data_length > 0) ctx.update(data, data_length);
+}
+
+/*
+ * The variable-length hash function H', producing any number
+ * of bytes from a chain of 64 byte BLAKE2b digests.
+ */
+static void variable_hash(byte* out, std::uint32_t out_length, byte const* in, std::size_t in_length) noexcept
+{
+    byte length[4];
+    store_little_endian(length, out_length);
+
+    blake2b::context ctx;
+
+    //Short outputs are a single digest of the requested length
+    if (out_length <= blake2b::max_digest_length)
+    {
+        ctx.init(out_length);
+        ctx.update(length, sizeof(length));
+        ctx.update(in, in_length);
+        ctx.finish(out);
+
+        return;
+    }
+
+    //Otherwise keep the first half of each digest in the chain
+    byte v[blake2b::max_digest_length];
+
+    ctx.init(blake2b::max_digest_length);
+    ctx.update(length, sizeof(length));
+    ctx.update(in, in_length);
+    ctx.finish(v);
+
+    constexpr std::uint32_t const half = blake2b::max_digest_length / 2;
+
+    std::copy(v, v + half, out);
+    out        += half;
+    out_length -= half;
+
+    while (out_length > blake2b::max_digest_length)
+    {
+        blake2b::compute_hash(v, sizeof(v), v, sizeof(v));
+
+        std::copy(v, v + half, out);
+        out        += half;
+        out_length -= half;
+    }
+
+    //The last digest is kept whole, and sized to fit
+    blake2b::compute_hash(v, sizeof(v), out, out_length);
+}
+
+/*
+ * Computes the pre-hashing digest H0 from the inputs.
+ */
+static void initial_hash(argon2id::input const& in, std::uint32_t tag_length, byte* h0) noexcept
+{
+    constexpr std::uint32_t const type = 2; //Argon2id
+
+    byte params[24];
+    store_little_endian(params +  0, in.parallelism);
+    store_little_endian(params +  4, tag_length);
+    store_little_endian(params +  8, in.memory_cost);
+    store_little_endian(params + 12, in.time_cost);
+    store_little_endian(params + 16, argon2id::version);
+    store_little_endian(params + 20, type);
+
+    blake2b::context ctx;
+    ctx.init(blake2b::max_digest_length);
+    ctx.update(params, sizeof(params));
+
+    update_with_length(ctx, in.password,        in.password_length);
+    update_with_length(ctx, in.salt,            in.salt_length);
+    update_with_length(ctx, in.secret,          in.secret_length);
+    update_with_length(ctx, in.associated_data, in.associated_data_length);
+
+    ctx.finish(h0);
+}
+
+/* Memory filling */
+
+static void load_block(argon2_block* block, byte const* bytes) noexcept
+{
+    for (std::size_t i = 0; i < argon2_block_words; i++)
+    {
+        std::uint64_t w = 0;
+        for (int j = 7; j >= 0; j--) w = (w << 8) | bytes[i * 8 + j];
+
+        block->v[i] = w;
+    }
+}
+
+static void store_block(byte* bytes, argon2_block const* block) noexcept
+{
+    for (std::size_t i = 0; i < argon2_block_words; i++)
+    {
+        for (int j = 0; j < 8; j++) bytes[i * 8 + j] = static_cast<byte>(block->v[i] >> (8 * j));
+    }
+}
+
+/*
+ * Generates the next block of 128 pseudo-random references for
+ * data-independent addressing: G(0, G(0, input)), after bumping
+ * the counter in the input block.
+ */
+static void next_addresses(instance const& inst, argon2_block* address, argon2_block* input, argon2_block const* zero) noexcept
+{
+    input->v[6]++;
+
+    inst.compress(address, zero, input,   false);
+    inst.compress(address, zero, address, false);
+}
+
+/*
+ * Maps the pseudo-random value of a block to the index of the
+ * block it references, within the lane the reference falls in.
+ */
+static std::uint32_t reference_index
+(
+    instance const& inst,
+    std::uint32_t pass,
+    std::uint32_t slice,
+    std::uint32_t index,
+    std::uint32_t pseudo_rand,
+    bool same_lane
+) noexcept
+{
+    //Find how many blocks can be referenced
+    std::uint32_t area;
+
+    if (pass == 0)
+    {
+        if (slice == 0)     area = index - 1;
+        else if (same_lane) area = slice * inst.segment_length + index - 1;
+        else                area = slice * inst.segment_length - ((index == 0) ? 1 : 0);
+    }
+    else
+    {
+        if (same_lane) area = inst.lane_length - inst.segment_length + index - 1;
+        else           area = inst.lane_length - inst.segment_length - ((index == 0) ? 1 : 0);
+    }
+
+    //Bias the choice towards the most recent blocks
+    std::uint64_t relative = pseudo_rand;
+    relative = (relative * relative) >> 32;
+    relative = area - 1 - ((area * relative) >> 32);
+
+    //The area starts after the segment being filled, and wraps around
+    std::uint32_t start = 0;
+    if (pass != 0 && slice != argon2id::sync_points - 1) start = (slice + 1) * inst.segment_length;
+
+    return static_cast<std::uint32_t>((start + relative) % inst.lane_length);
+}
+
+/*
+ * Fills one segment of a lane. The segments of a slice do not
+ * depend on each other, so every lane can fill its segment at
+ * the same time.
+ */
+static void fill_segment(instance const& inst, std::uint32_t pass, std::uint32_t lane, std::uint32_t slice) noexcept
+{
+    //Argon2id uses data-independent addressing for the first half of the first pass
+    auto const independent = (pass == 0) && (slice < argon2id::sync_points / 2);
+
+    argon2_block address{};
+    argon2_block input  {};
+    argon2_block zero   {};
+
+    if (independent)
+    {
+        input.v[0] = pass;
+        input.v[1] = lane;
+        input.v[2] = slice;
+        input.v[3] = inst.memory_blocks;
+        input.v[4] = inst.passes;
+        input.v[5] = 2; //Argon2id
+    }
+
+    //The first two blocks of each lane are already there
+    std::uint32_t start_index = 0;
+    if (pass == 0 && slice == 0)
+    {
+        start_index = 2;
+
+        if (independent) next_addresses(inst, &address, &input, &zero);
+    }
+
+    auto* const lane_blocks = inst.memory + static_cast<std::size_t>(lane) * inst.lane_length;
+
+    for (auto i = start_index; i < inst.segment_length; i++)
+    {
+        auto const current  = slice * inst.segment_length + i;
+        auto const previous = (current == 0) ? inst.lane_length - 1 : current - 1;
+
+        //Pick the pseudo-random value
+        std::uint64_t pseudo_rand;
+        if (independent)
+        {
+            if (i % argon2_block_words == 0) next_addresses(inst, &address, &input, &zero);
+
+            pseudo_rand = address.v[i % argon2_block_words];
+        }
+        else
+        {
+            pseudo_rand = lane_blocks[previous].v[0];
+        }
+
+        //The first slice of the first pass only references its own lane
+        auto ref_lane = static_cast<std::uint32_t>((pseudo_rand >> 32) % inst.lanes);
+        if (pass == 0 && slice == 0) ref_lane = lane;
+
+        auto const ref_index = reference_index(inst, pass, slice, i, static_cast<std::uint32_t>(pseudo_rand), ref_lane == lane);
+        auto const* ref      = inst.memory + static_cast<std::size_t>(ref_lane) * inst.lane_length + ref_index;
+
+        //Later passes XOR the new block into the old one
+        inst.compress(&lane_blocks[current], &lane_blocks[previous], ref, pass != 0);
+    }
+}
+
+bool pm::security::argon2id::compute_hash(input const& in, byte* tag, std::uint32_t tag_length) noexcept
+{
+    //Check the parameters
+    if (in.parallelism == 0 || in.parallelism > max_parallelism) return false;
+    if (in.time_cost == 0)                                       return false;
+    if (in.memory_cost / 8 < in.parallelism)                     return false;
+    if (in.salt_length < min_salt_length)                        return false;
+    if (tag_length < min_tag_length)                             return false;
+
+    //Round the memory down to a whole number of segments in every lane
+    instance inst{};
+    inst.passes         = in.time_cost;
+    inst.lanes          = in.parallelism;
+    inst.segment_length = in.memory_cost / (sync_points * in.parallelism);
+    inst.lane_length    = inst.segment_length * sync_points;
+    inst.memory_blocks  = inst.lane_length * in.parallelism;
+    inst.compress       = detail::get_argon2_compress();
+
+    //Take all of the memory in one go
+    auto buffer = large_page_buffer{ static_cast<std::size_t>(inst.memory_blocks) * block_length };
+    if (buffer.data() == nullptr) return false;
+
+    inst.memory = static_cast<argon2_block*>(buffer.data());
+
+    //Derive the first two blocks of each lane from H0, followed by the block and lane numbers
+    byte h0[blake2b::max_digest_length + 8];
+    initial_hash(in, tag_length, h0);
+
+    byte block_bytes[block_length];
+    for (std::uint32_t lane = 0; lane < inst.lanes; lane++)
+    {
+        store_little_endian(h0 + blake2b::max_digest_length + 4, lane);
+
+        for (std::uint32_t j = 0; j < 2; j++)
+        {
+            store_little_endian(h0 + blake2b::max_digest_length, j);
+
+            variable_hash(block_bytes, block_length, h0, sizeof(h0));
+            load_block(&inst.memory[static_cast<std::size_t>(lane) * inst.lane_length + j], block_bytes);
+        }
+    }
+
+    //Fill the memory, one slice at a time with all the lanes side by side
+    auto& pool = thread_pool::get_shared();
+
+    for (std::uint32_t pass = 0; pass < inst.passes; pass++)
+    {
+        for (std::uint32_t slice = 0; slice < sync_points; slice++)
+        {
+            pool.parallel_for(inst.lanes, [&](std::size_t lane) noexcept
+            {
+                fill_segment(inst, pass, static_cast<std::uint32_t>(lane), slice);
+            });
+        }
+    }
+
+    //XOR the last column together and hash it into the tag
+    argon2_block final_block = inst.memory[inst.lane_length - 1];
+    for (std::uint32_t lane = 1; lane < inst.lanes; lane++)
+    {
+        auto const& last = inst.memory[static_cast<std::size_t>(lane) * inst.lane_length + inst.lane_length - 1];
+
+        for (std::size_t i = 0; i < argon2_block_words; i++) final_block.v[i] ^= last.v[i];
+    }
+
+    store_block(block_bytes, &final_block);
+    variable_hash(tag, tag_length, block_bytes, sizeof(block_bytes));
+
+    //Clear the copies of secret material on the stack
+    std::fill(std::begin(h0), std::end(h0), byte{ 0 });
+    std::fill(std::begin(block_bytes), std::end(block_bytes), byte{ 0 });
+    std::fill(std::begin(final_block.v), std::end(final_block.v), std::uint64_t{ 0 });
+
+    return true;
+}
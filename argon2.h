@@ -0,0 +1,57 @@
+#ifndef PM_ARGON2_H
+#define PM_ARGON2_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Implements Argon2id version 1.3 as described in RFC 9106
+ * (September 2021).
+ *
+ * The lanes of each slice are filled in parallel on the shared
+ * thread pool, the compression function uses the widest SIMD
+ * the processor supports, and the memory is a single buffer
+ * taken from large pages where the system allows it.
+ */
+
+namespace pm::security
+{
+    struct argon2id
+    {
+        static constexpr std::uint32_t const version         = 0x13;
+        static constexpr std::uint32_t const block_length    = 1024;
+        static constexpr std::uint32_t const sync_points     = 4;
+        static constexpr std::size_t   const min_salt_length = 8;
+        static constexpr std::uint32_t const min_tag_length  = 4;
+        static constexpr std::uint32_t const max_parallelism = 0xFFFFFF;
+
+        using byte = std::uint8_t;
+
+        struct input
+        {
+            byte const*   password;
+            std::size_t   password_length;
+            byte const*   salt;
+            std::size_t   salt_length;
+            byte const*   secret;
+            std::size_t   secret_length;
+            byte const*   associated_data;
+            std::size_t   associated_data_length;
+            std::uint32_t time_cost;   //Number of passes over the memory
+            std::uint32_t memory_cost; //Memory in KiB, at least 8 per lane
+            std::uint32_t parallelism; //Number of lanes
+        };
+
+        /*
+         * Computes the tag of the given length. Returns false if
+         * the parameters are out of range, or if the memory
+         * could not be allocated.
+         */
+        [[nodiscard]] static bool compute_hash(input const& in, byte* tag, std::uint32_t tag_length) noexcept;
+
+        argon2id() = delete;
+    };
+};
+
+#endif
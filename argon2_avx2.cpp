@@ -0,0 +1,84 @@
+#include "argon2_impl.h"
+
+/*
+ * Implements the Argon2 compression function with AVX2,
+ * holding four words in a register.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("avx2")
+#endif
+
+#include "argon2_blamka.h"
+
+namespace
+{
+    struct avx2_ops
+    {
+        using reg = __m256i;
+
+        static reg load2(std::uint64_t const* p, std::uint64_t const* q) noexcept
+        {
+            auto const lo = _mm_load_si128(reinterpret_cast<__m128i const*>(p));
+            auto const hi = _mm_load_si128(reinterpret_cast<__m128i const*>(q));
+
+            return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        }
+
+        static void store2(std::uint64_t* p, std::uint64_t* q, reg x) noexcept
+        {
+            _mm_store_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(x));
+            _mm_store_si128(reinterpret_cast<__m128i*>(q), _mm256_extracti128_si256(x, 1));
+        }
+
+        static reg bitwise_xor(reg x, reg y) noexcept
+        {
+            return _mm256_xor_si256(x, y);
+        }
+
+        static reg blamka(reg x, reg y) noexcept
+        {
+            auto const z = _mm256_mul_epu32(x, y);
+
+            return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+        }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept
+        {
+            if constexpr (n == 32)
+            {
+                return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+            }
+            else if constexpr (n == 24)
+            {
+                return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+            }
+            else if constexpr (n == 16)
+            {
+                return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+            }
+            else
+            {
+                return _mm256_xor_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - n));
+            }
+        }
+
+        template<int n>
+        static reg rotate_lanes(reg x) noexcept
+        {
+            return _mm256_permute4x64_epi64(x, _MM_SHUFFLE((n + 3) & 3, (n + 2) & 3, (n + 1) & 3, n & 3));
+        }
+    };
+};
+
+void pm::security::detail::argon2_compress_avx2(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept
+{
+    argon2_compress_blocks<avx2_ops>(next, prev, ref, with_xor);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef PM_ARGON2_BLAMKA_H
+#define PM_ARGON2_BLAMKA_H
+#pragma once
+
+#include "argon2_impl.h"
+
+/*
+ * The Argon2 compression function G, built on the BlaMka
+ * permutation: the BLAKE2b round with its additions replaced
+ * by x + y + 2 * lo(x) * lo(y). The vector operations are
+ * supplied by V, whose registers hold four words and which
+ * must provide:
+ *
+ *     reg, load2, store2, bitwise_xor, blamka,
+ *     right_rotate<n>, rotate_lanes<n>
+ *
+ * where load2 and store2 move two pairs of words, each pair
+ * aligned to 16 bytes, and rotate_lanes<n> moves word i + n
+ * of a register into word i.
+ *
+ * This header must only be included by the translation units
+ * that instantiate it, after they have enabled the instruction
+ * set V is written for. Everything in here has internal linkage
+ * so each instantiation keeps the code generation options of the
+ * unit it was compiled in.
+ */
+
+namespace pm::security::detail
+{
+    /*
+     * Mixes the four columns of a 4x4 matrix of words.
+     */
+    template<typename V>
+    static inline void blamka_mix(typename V::reg& a, typename V::reg& b, typename V::reg& c, typename V::reg& d) noexcept
+    {
+        a = V::blamka(a, b);
+        d = V::template right_rotate<32>(V::bitwise_xor(d, a));
+        c = V::blamka(c, d);
+        b = V::template right_rotate<24>(V::bitwise_xor(b, c));
+        a = V::blamka(a, b);
+        d = V::template right_rotate<16>(V::bitwise_xor(d, a));
+        c = V::blamka(c, d);
+        b = V::template right_rotate<63>(V::bitwise_xor(b, c));
+    }
+
+    /*
+     * Applies the permutation P to eight pairs of words, the k'th
+     * pair found at q + base + k * stride. A row of the block has
+     * its pairs next to each other, a column has them 16 words
+     * apart.
+     */
+    template<typename V>
+    static inline void blamka_round(std::uint64_t* q, std::size_t base, std::size_t stride) noexcept
+    {
+        auto* p = q + base;
+
+        auto a = V::load2(p + 0 * stride, p + 1 * stride);
+        auto b = V::load2(p + 2 * stride, p + 3 * stride);
+        auto c = V::load2(p + 4 * stride, p + 5 * stride);
+        auto d = V::load2(p + 6 * stride, p + 7 * stride);
+
+        //Mix the columns
+        blamka_mix<V>(a, b, c, d);
+
+        //Line up the diagonals and mix them
+        b = V::template rotate_lanes<1>(b);
+        c = V::template rotate_lanes<2>(c);
+        d = V::template rotate_lanes<3>(d);
+
+        blamka_mix<V>(a, b, c, d);
+
+        b = V::template rotate_lanes<3>(b);
+        c = V::template rotate_lanes<2>(c);
+        d = V::template rotate_lanes<1>(d);
+
+        V::store2(p + 0 * stride, p + 1 * stride, a);
+        V::store2(p + 2 * stride, p + 3 * stride, b);
+        V::store2(p + 4 * stride, p + 5 * stride, c);
+        V::store2(p + 6 * stride, p + 7 * stride, d);
+    }
+
+    template<typename V>
+    static void argon2_compress_blocks(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept
+    {
+        alignas(64) std::uint64_t r[argon2_block_words];
+        alignas(64) std::uint64_t q[argon2_block_words];
+
+        //R = prev ^ ref, and Q starts as a copy of it
+        for (std::size_t i = 0; i < argon2_block_words; i += 4)
+        {
+            auto const x = V::bitwise_xor(V::load2(prev->v + i, prev->v + i + 2), V::load2(ref->v + i, ref->v + i + 2));
+
+            V::store2(r + i, r + i + 2, x);
+            V::store2(q + i, q + i + 2, x);
+        }
+
+        //Apply P to the rows, then to the columns
+        for (std::size_t i = 0; i < 8; i++) blamka_round<V>(q, 16 * i,  2);
+        for (std::size_t i = 0; i < 8; i++) blamka_round<V>(q,  2 * i, 16);
+
+        //The result is Q ^ R, XORed into the old block on later passes
+        for (std::size_t i = 0; i < argon2_block_words; i += 4)
+        {
+            auto x = V::bitwise_xor(V::load2(q + i, q + i + 2), V::load2(r + i, r + i + 2));
+            if (with_xor) x = V::bitwise_xor(x, V::load2(next->v + i, next->v + i + 2));
+
+            V::store2(next->v + i, next->v + i + 2, x);
+        }
+    }
+};
+
+#endif
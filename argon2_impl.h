@@ -0,0 +1,73 @@
+#ifndef PM_ARGON2_IMPL_H
+#define PM_ARGON2_IMPL_H
+#pragma once
+
+#include "argon2.h"
+#include "cpu_features.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Internal definitions shared between the different
+ * implementations of the Argon2 compression function.
+ */
+
+namespace pm::security::detail
+{
+    /*
+     * The number of 64-bit words in a block of memory.
+     */
+    inline constexpr std::size_t argon2_block_words = argon2id::block_length / sizeof(std::uint64_t);
+
+    struct alignas(64) argon2_block
+    {
+        std::uint64_t v[argon2_block_words];
+    };
+
+    /* Compression functions */
+
+    /*
+     * Computes G(prev, ref) and stores it into next, or XORs it
+     * into next when with_xor is set. next may alias prev or ref.
+     */
+    using argon2_compress_fn = void(*)
+    (
+        argon2_block* next,
+        argon2_block const* prev,
+        argon2_block const* ref,
+        bool with_xor
+    ) noexcept;
+
+    /*
+     * Portable implementation. Always available.
+     */
+    void argon2_compress_portable(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Two words per register. Requires SSSE3.
+     */
+    void argon2_compress_ssse3(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept;
+
+    /*
+     * Four words per register. Requires AVX2.
+     */
+    void argon2_compress_avx2(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    /*
+     * Two words per register. NEON is always present.
+     */
+    void argon2_compress_neon(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept;
+#endif
+
+    /*
+     * Retrieves the fastest compression function supported by
+     * the processor.
+     */
+    argon2_compress_fn get_argon2_compress() noexcept;
+};
+
+#endif
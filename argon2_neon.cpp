@@ -0,0 +1,92 @@
+#include "argon2_impl.h"
+
+/*
+ * Implements the Argon2 compression function with NEON,
+ * holding four words in a pair of registers.
+ */
+
+#if defined(PM_ARCH_ARM64)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <arm64_neon.h>
+#else
+#   include <arm_neon.h>
+#endif
+
+#include "argon2_blamka.h"
+
+namespace
+{
+    struct neon_ops
+    {
+        struct reg
+        {
+            uint64x2_t lo;
+            uint64x2_t hi;
+        };
+
+        static reg load2(std::uint64_t const* p, std::uint64_t const* q) noexcept
+        {
+            return { vld1q_u64(p), vld1q_u64(q) };
+        }
+
+        static void store2(std::uint64_t* p, std::uint64_t* q, reg x) noexcept
+        {
+            vst1q_u64(p, x.lo);
+            vst1q_u64(q, x.hi);
+        }
+
+        static reg bitwise_xor(reg x, reg y) noexcept
+        {
+            return { veorq_u64(x.lo, y.lo), veorq_u64(x.hi, y.hi) };
+        }
+
+        static uint64x2_t blamka(uint64x2_t x, uint64x2_t y) noexcept
+        {
+            auto const z = vmull_u32(vmovn_u64(x), vmovn_u64(y));
+
+            return vaddq_u64(vaddq_u64(x, y), vaddq_u64(z, z));
+        }
+
+        static reg blamka(reg x, reg y) noexcept
+        {
+            return { blamka(x.lo, y.lo), blamka(x.hi, y.hi) };
+        }
+
+        template<int n>
+        static uint64x2_t right_rotate(uint64x2_t x) noexcept
+        {
+            return vsriq_n_u64(vshlq_n_u64(x, 64 - n), x, n);
+        }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept
+        {
+            return { right_rotate<n>(x.lo), right_rotate<n>(x.hi) };
+        }
+
+        template<int n>
+        static reg rotate_lanes(reg x) noexcept
+        {
+            if constexpr (n == 1)
+            {
+                return { vextq_u64(x.lo, x.hi, 1), vextq_u64(x.hi, x.lo, 1) };
+            }
+            else if constexpr (n == 2)
+            {
+                return { x.hi, x.lo };
+            }
+            else
+            {
+                return { vextq_u64(x.hi, x.lo, 1), vextq_u64(x.lo, x.hi, 1) };
+            }
+        }
+    };
+};
+
+void pm::security::detail::argon2_compress_neon(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept
+{
+    argon2_compress_blocks<neon_ops>(next, prev, ref, with_xor);
+}
+
+#endif
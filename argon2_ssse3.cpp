@@ -0,0 +1,107 @@
+#include "argon2_impl.h"
+
+/*
+ * Implements the Argon2 compression function with SSSE3,
+ * holding four words in a pair of registers.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("ssse3")
+#endif
+
+#include "argon2_blamka.h"
+
+namespace
+{
+    struct ssse3_ops
+    {
+        struct reg
+        {
+            __m128i lo;
+            __m128i hi;
+        };
+
+        static reg load2(std::uint64_t const* p, std::uint64_t const* q) noexcept
+        {
+            return { _mm_load_si128(reinterpret_cast<__m128i const*>(p)), _mm_load_si128(reinterpret_cast<__m128i const*>(q)) };
+        }
+
+        static void store2(std::uint64_t* p, std::uint64_t* q, reg x) noexcept
+        {
+            _mm_store_si128(reinterpret_cast<__m128i*>(p), x.lo);
+            _mm_store_si128(reinterpret_cast<__m128i*>(q), x.hi);
+        }
+
+        static reg bitwise_xor(reg x, reg y) noexcept
+        {
+            return { _mm_xor_si128(x.lo, y.lo), _mm_xor_si128(x.hi, y.hi) };
+        }
+
+        static __m128i blamka(__m128i x, __m128i y) noexcept
+        {
+            auto const z = _mm_mul_epu32(x, y);
+
+            return _mm_add_epi64(_mm_add_epi64(x, y), _mm_add_epi64(z, z));
+        }
+
+        static reg blamka(reg x, reg y) noexcept
+        {
+            return { blamka(x.lo, y.lo), blamka(x.hi, y.hi) };
+        }
+
+        template<int n>
+        static __m128i right_rotate(__m128i x) noexcept
+        {
+            if constexpr (n == 32)
+            {
+                return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+            }
+            else if constexpr (n == 24)
+            {
+                return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+            }
+            else if constexpr (n == 16)
+            {
+                return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+            }
+            else
+            {
+                return _mm_xor_si128(_mm_srli_epi64(x, n), _mm_slli_epi64(x, 64 - n));
+            }
+        }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept
+        {
+            return { right_rotate<n>(x.lo), right_rotate<n>(x.hi) };
+        }
+
+        template<int n>
+        static reg rotate_lanes(reg x) noexcept
+        {
+            if constexpr (n == 1)
+            {
+                return { _mm_alignr_epi8(x.hi, x.lo, 8), _mm_alignr_epi8(x.lo, x.hi, 8) };
+            }
+            else if constexpr (n == 2)
+            {
+                return { x.hi, x.lo };
+            }
+            else
+            {
+                return { _mm_alignr_epi8(x.lo, x.hi, 8), _mm_alignr_epi8(x.hi, x.lo, 8) };
+            }
+        }
+    };
+};
+
+void pm::security::detail::argon2_compress_ssse3(argon2_block* next, argon2_block const* prev, argon2_block const* ref, bool with_xor) noexcept
+{
+    argon2_compress_blocks<ssse3_ops>(next, prev, ref, with_xor);
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "sha256.h"
+#include "sha512.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Compares the throughput of SHA-256 and SHA-512 across message
+ * sizes, hashing one message at a time and hashing a batch of
+ * independent messages in SIMD lanes.
+ */
+
+using clock_type = std::chrono::steady_clock;
+
+//Every run lasts at least this long so the timer resolution does not matter
+static constexpr std::chrono::milliseconds const min_run_time{ 200 };
+
+//The messages hashed per call to compute_hashes
+static constexpr std::size_t const batch_size = 64;
+
+//Keeps the digests alive so the hashing is not optimized away
+static std::uint8_t volatile sink;
+
+/*
+ * Calls the function until the minimum run time has passed, and
+ * returns the number of bytes hashed per second in megabytes.
+ */
+template<typename F>
+static double measure(std::size_t bytes_per_call, F&& f) noexcept
+{
+    //Warm up the caches and the dispatch
+    f();
+
+    auto       calls = std::uint64_t{ 0 };
+    auto const start = clock_type::now();
+    auto       now   = start;
+
+    do
+    {
+        for (int i = 0; i < 16; i++) f();
+
+        calls += 16;
+        now    = clock_type::now();
+    }
+    while (now - start < min_run_time);
+
+    auto const seconds = std::chrono::duration<double>(now - start).count();
+
+    return static_cast<double>(calls) * static_cast<double>(bytes_per_call) / seconds / 1e6;
+}
+
+template<typename Hash>
+static double measure_single(std::vector<std::uint8_t> const& message) noexcept
+{
+    std::array<std::uint8_t, Hash::digest_length> digest;
+
+    return measure(message.size(), [&]() noexcept
+    {
+        Hash::compute_hash(message.data(), message.size(), digest);
+        sink = digest[0];
+    });
+}
+
+template<typename Hash>
+static double measure_batch(std::vector<std::uint8_t> const& messages, std::size_t message_length) noexcept
+{
+    std::uint8_t const*                           data   [batch_size];
+    std::uint64_t                                 lengths[batch_size];
+    std::array<std::uint8_t, Hash::digest_length> digests[batch_size];
+
+    for (std::size_t i = 0; i < batch_size; i++)
+    {
+        data   [i] = messages.data() + i * message_length;
+        lengths[i] = message_length;
+    }
+
+    return measure(batch_size * message_length, [&]() noexcept
+    {
+        Hash::compute_hashes(data, lengths, digests, batch_size);
+        sink = digests[0][0];
+    });
+}
+
+int main()
+{
+    using pm::security::sha256;
+    using pm::security::sha512;
+
+    if (!sha256::self_test() || !sha512::self_test())
+    {
+        std::printf("Self-test failed!\n");
+        return 1;
+    }
+
+    std::size_t const sizes[]{ 16, 64, 256, 1024, 4096, 16384, 65536, 1048576 };
+
+    std::printf("%10s | %12s %12s | %12s %12s\n", "", "single", "", "batch", "");
+    std::printf("%10s | %12s %12s | %12s %12s\n", "bytes", "SHA-256 MB/s", "SHA-512 MB/s", "SHA-256 MB/s", "SHA-512 MB/s");
+
+    for (auto const size : sizes)
+    {
+        //Any content will do, the hashes take the same time on all of it
+        std::vector<std::uint8_t> messages(size * batch_size);
+        for (std::size_t i = 0; i < messages.size(); i++) messages[i] = static_cast<std::uint8_t>(i * 131);
+
+        std::vector<std::uint8_t> const message(messages.begin(), messages.begin() + size);
+
+        std::printf
+        (
+            "%10zu | %12.1f %12.1f | %12.1f %12.1f\n",
+            size,
+            measure_single<sha256>(message),
+            measure_single<sha512>(message),
+            measure_batch <sha256>(messages, size),
+            measure_batch <sha512>(messages, size)
+        );
+    }
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "blake2b.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+/* Types defined for BLAKE2b */
+
+using byte = std::uint8_t;
+using word = std::uint64_t;
+
+/* Constants defined for BLAKE2b */
+
+/*
+ * The initialization vector, the same as the initial hash
+ * value of SHA-512.
+ */
+static constexpr word const blake2b_iv[8]
+{
+    0x6A09E667F3BCC908ull, 0xBB67AE8584CAA73Bull, 0x3C6EF372FE94F82Bull, 0xA54FF53A5F1D36F1ull,
+    0x510E527FADE682D1ull, 0x9B05688C2B3E6C1Full, 0x1F83D9ABFB41BD6Bull, 0x5BE0CD19137E2179ull
+};
+
+/*
+ * The message word permutations, one per round.
+ */
+static constexpr byte const blake2b_sigma[12][16]
+{
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+/* Operations defined for BLAKE2b */
+
+static constexpr word right_rotate(word x, int n) noexcept
+{
+    return (x >> n) | (x << (64 - n));
+}
+
+static constexpr word load_little_endian(byte const* p) noexcept
+{
+    word w = 0;
+    for (int i = 7; i >= 0; i--) w = (w << 8) | p[i];
+
+    return w;
+}
+
+/*
+ * The mixing function G, mixing two message words into four
+ * words of the working vector.
+ */
+static constexpr void mix(word* v, int a, int b, int c, int d, word x, word y) noexcept
+{
+    v[a] = v[a] + v[b] + x;
+    v[d] = right_rotate(v[d] ^ v[a], 32);
+    v[c] = v[c] + v[d];
+    v[b] = right_rotate(v[b] ^ v[c], 24);
+    v[a] = v[a] + v[b] + y;
+    v[d] = right_rotate(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = right_rotate(v[b] ^ v[c], 63);
+}
+
+/*
+ * The compression function F.
+ */
+static void compress(word* h, byte const* block, std::uint64_t const* counter, bool last) noexcept
+{
+    word m[16];
+    for (int i = 0; i < 16; i++) m[i] = load_little_endian(block + i * sizeof(word));
+
+    //Initialize the working vector
+    word v[16];
+    for (int i = 0; i < 8; i++)
+    {
+        v[i]     = h[i];
+        v[i + 8] = blake2b_iv[i];
+    }
+
+    v[12] ^= counter[0];
+    v[13] ^= counter[1];
+
+    if (last) v[14] = ~v[14];
+
+    //Twelve rounds of mixing the columns and then the diagonals
+    for (auto const& s : blake2b_sigma)
+    {
+        mix(v, 0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+        mix(v, 1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+        mix(v, 2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+        mix(v, 3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+        mix(v, 0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+        mix(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        mix(v, 2, 7,  8, 13, m[s[12]], m[s[13]]);
+        mix(v, 3, 4,  9, 14, m[s[14]], m[s[15]]);
+    }
+
+    for (int i = 0; i < 8; i++) h[i] ^= v[i] ^ v[i + 8];
+}
+
+/*
+ * Adds the bytes compressed so far to the 128-bit counter.
+ */
+static void increment(std::uint64_t* counter, std::size_t n) noexcept
+{
+    counter[0] += n;
+    if (counter[0] < n) counter[1]++;
+}
+
+/* Implementation */
+
+void pm::security::blake2b::blake2b_context::init(std::size_t digest_length) noexcept
+{
+    assert(digest_length > 0 && digest_length <= max_digest_length);
+
+    //Mix the parameter block into the initialization vector: no key, fanout and depth of one
+    std::copy(std::begin(blake2b_iv), std::end(blake2b_iv), this->state.begin());
+    this->state[0] ^= 0x01010000ull | static_cast<word>(digest_length);
+
+    this->buffer_length = 0;
+    this->counter[0]    = 0;
+    this->counter[1]    = 0;
+    this->digest_length = digest_length;
+}
+
+void pm::security::blake2b::blake2b_context::update(byte const* data, std::size_t data_length) noexcept
+{
+    while (data_length > 0)
+    {
+        //Only compress a full buffer once there is more to come, it might be the last block
+        if (this->buffer_length == block_length)
+        {
+            increment(this->counter, block_length);
+            compress(this->state.data(), this->buffer.data(), this->counter, false);
+            this->buffer_length = 0;
+        }
+
+        auto const count = std::min(block_length - this->buffer_length, data_length);
+
+        std::copy(data, data + count, this->buffer.data() + this->buffer_length);
+        this->buffer_length += count;
+        data                += count;
+        data_length         -= count;
+    }
+}
+
+void pm::security::blake2b::blake2b_context::finish(byte* digest) noexcept
+{
+    //Pad the last block with zeros
+    std::fill(this->buffer.begin() + this->buffer_length, this->buffer.end(), byte{ 0 });
+
+    increment(this->counter, this->buffer_length);
+    compress(this->state.data(), this->buffer.data(), this->counter, true);
+
+    //Output the words in little-endian order
+    for (std::size_t i = 0; i < this->digest_length; i++)
+        digest[i] = static_cast<byte>(this->state[i / sizeof(word)] >> (8 * (i % sizeof(word))));
+}
+
+void pm::security::blake2b::compute_hash(byte const* data, std::size_t data_length, byte* digest, std::size_t digest_length) noexcept
+{
+    blake2b_context ctx;
+    ctx.init(digest_length);
+    ctx.update(data, data_length);
+    ctx.finish(digest);
+}
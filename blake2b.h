@@ -0,0 +1,73 @@
+#ifndef PM_BLAKE2B_H
+#define PM_BLAKE2B_H
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Implements the unkeyed BLAKE2b as described in RFC 7693
+ * (November 2015), with a digest of 1 to 64 bytes.
+ */
+
+namespace pm::security
+{
+    struct blake2b
+    {
+        static constexpr std::size_t const block_length      = 1024 / 8;
+        static constexpr std::size_t const max_digest_length =  512 / 8;
+
+        using byte = std::uint8_t;
+        using word = std::uint64_t;
+
+        /*
+         * Computes the BLAKE2b hash of a data string, with a digest
+         * of the requested length.
+         */
+        static void compute_hash
+        (
+            byte const* data,
+            std::size_t data_length,
+            byte* digest,
+            std::size_t digest_length
+        ) noexcept;
+
+        /*
+         * A low-level hashing primitive.
+         */
+        using context = struct blake2b_context
+        {
+        public:
+            /*
+             * Prepares or resets the context to produce a digest
+             * of the given length.
+             */
+            void init(std::size_t digest_length) noexcept;
+
+            /*
+             * Feeds an arbitrary amount of the message. The last
+             * block is held back until finish, since it has to be
+             * compressed differently.
+             */
+            void update(byte const* data, std::size_t data_length) noexcept;
+
+            /*
+             * Compresses the last block and writes the digest, of
+             * the length given to init.
+             */
+            void finish(byte* digest) noexcept;
+
+        private:
+            std::array<word, 8>            state{};
+            std::array<byte, block_length> buffer{};
+            std::size_t                    buffer_length = 0;
+            std::uint64_t                  counter[2]{};
+            std::size_t                    digest_length = 0;
+        };
+
+        blake2b() = delete;
+    };
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "chacha20.h"
+#include "chacha20_impl.h"
+#include "secure_memory.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+/*
+ * Implements ChaCha20 as described in RFC 8439 (June 2018).
+ */
+
+using byte = std::uint8_t;
+using word = std::uint32_t;
+
+using pm::security::chacha20;
+using pm::security::detail::chacha20_fn;
+
+static word load_little_endian(byte const* p) noexcept
+{
+    return (static_cast<word>(p[0]) <<  0) |
+           (static_cast<word>(p[1]) <<  8) |
+           (static_cast<word>(p[2]) << 16) |
+           (static_cast<word>(p[3]) << 24);
+}
+
+static word rotate_left(word x, int n) noexcept
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void quarter_round(word& a, word& b, word& c, word& d) noexcept
+{
+    a += b; d ^= a; d = rotate_left(d, 16);
+    c += d; b ^= c; b = rotate_left(b, 12);
+    a += b; d ^= a; d = rotate_left(d,  8);
+    c += d; b ^= c; b = rotate_left(b,  7);
+}
+
+void pm::security::detail::chacha20_blocks_portable(chacha20::state* st, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    word x[16];
+
+    for (; block_count > 0; block_count--, in += chacha20::block_length, out += chacha20::block_length)
+    {
+        std::copy(std::begin(st->words), std::end(st->words), x);
+
+        //Ten double rounds, down the columns and then along the diagonals
+        for (int i = 0; i < 10; i++)
+        {
+            quarter_round(x[0], x[4], x[ 8], x[12]);
+            quarter_round(x[1], x[5], x[ 9], x[13]);
+            quarter_round(x[2], x[6], x[10], x[14]);
+            quarter_round(x[3], x[7], x[11], x[15]);
+
+            quarter_round(x[0], x[5], x[10], x[15]);
+            quarter_round(x[1], x[6], x[11], x[12]);
+            quarter_round(x[2], x[7], x[ 8], x[13]);
+            quarter_round(x[3], x[4], x[ 9], x[14]);
+        }
+
+        //Add the input and XOR the words in little-endian order
+        for (std::size_t i = 0; i < 16; i++)
+        {
+            auto const k = x[i] + st->words[i];
+
+            out[4 * i + 0] = static_cast<byte>(in[4 * i + 0] ^ (k >>  0));
+            out[4 * i + 1] = static_cast<byte>(in[4 * i + 1] ^ (k >>  8));
+            out[4 * i + 2] = static_cast<byte>(in[4 * i + 2] ^ (k >> 16));
+            out[4 * i + 3] = static_cast<byte>(in[4 * i + 3] ^ (k >> 24));
+        }
+
+        st->words[12]++;
+    }
+
+    pm::secure_wipe(x, sizeof(x));
+}
+
+/*
+ * Picks the fastest implementation supported by the processor.
+ */
+static chacha20_fn select_chacha20() noexcept
+{
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    if (cpu.avx2) return pm::security::detail::chacha20_blocks_avx2;
+    if (cpu.sse2) return pm::security::detail::chacha20_blocks_sse2;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    return pm::security::detail::chacha20_blocks_neon;
+#endif
+
+    return pm::security::detail::chacha20_blocks_portable;
+}
+
+chacha20_fn pm::security::detail::get_chacha20() noexcept
+{
+    static chacha20_fn const blocks = select_chacha20();
+
+    return blocks;
+}
+
+void pm::security::chacha20::init(state* st, byte const* key, byte const* nonce, word counter) noexcept
+{
+    //"expand 32-byte k"
+    st->words[0] = 0x61707865;
+    st->words[1] = 0x3320646E;
+    st->words[2] = 0x79622D32;
+    st->words[3] = 0x6B206574;
+
+    for (std::size_t i = 0; i < 8; i++) st->words[4 + i] = load_little_endian(key + 4 * i);
+
+    st->words[12] = counter;
+
+    for (std::size_t i = 0; i < 3; i++) st->words[13 + i] = load_little_endian(nonce + 4 * i);
+}
+
+void pm::security::chacha20::crypt(state* st, byte const* in, byte* out, std::size_t length) noexcept
+{
+    auto const blocks = detail::get_chacha20();
+
+    //Whole blocks go straight through
+    auto const block_count = length / block_length;
+    blocks(st, in, out, block_count);
+
+    //A partial block at the end uses the start of one more block of key stream
+    auto const remainder = length % block_length;
+    if (remainder != 0)
+    {
+        byte block[block_length]{};
+        std::memcpy(block, in + block_count * block_length, remainder);
+        blocks(st, block, block, 1);
+        std::memcpy(out + block_count * block_length, block, remainder);
+
+        pm::secure_wipe(block, sizeof(block));
+    }
+}
+
+/*
+ * The encryption example of RFC 8439 section 2.4.2.
+ */
+static constexpr char const rfc8439_plaintext[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+
+static constexpr byte const rfc8439_nonce[12]
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4A, 0x00, 0x00, 0x00, 0x00
+};
+
+static constexpr byte const rfc8439_ciphertext[114]
+{
+    0x6E, 0x2E, 0x35, 0x9A, 0x25, 0x68, 0xF9, 0x80, 0x41, 0xBA, 0x07, 0x28, 0xDD, 0x0D, 0x69, 0x81,
+    0xE9, 0x7E, 0x7A, 0xEC, 0x1D, 0x43, 0x60, 0xC2, 0x0A, 0x27, 0xAF, 0xCC, 0xFD, 0x9F, 0xAE, 0x0B,
+    0xF9, 0x1B, 0x65, 0xC5, 0x52, 0x47, 0x33, 0xAB, 0x8F, 0x59, 0x3D, 0xAB, 0xCD, 0x62, 0xB3, 0x57,
+    0x16, 0x39, 0xD6, 0x24, 0xE6, 0x51, 0x52, 0xAB, 0x8F, 0x53, 0x0C, 0x35, 0x9F, 0x08, 0x61, 0xD8,
+    0x07, 0xCA, 0x0D, 0xBF, 0x50, 0x0D, 0x6A, 0x61, 0x56, 0xA3, 0x8E, 0x08, 0x8A, 0x22, 0xB6, 0x5E,
+    0x52, 0xBC, 0x51, 0x4D, 0x16, 0xCC, 0xF8, 0x06, 0x81, 0x8C, 0xE9, 0x1A, 0xB7, 0x79, 0x37, 0x36,
+    0x5A, 0xF9, 0x0B, 0xBF, 0x74, 0xA3, 0x5B, 0xE6, 0xB4, 0x0B, 0x8E, 0xED, 0xF2, 0x78, 0x5E, 0x42,
+    0x87, 0x4D
+};
+
+bool pm::security::chacha20::self_test() noexcept
+{
+    //Gather every implementation this processor can run
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+    std::pair<chacha20_fn, bool> const implementations[]
+    {
+        { detail::chacha20_blocks_portable, true },
+#if defined(PM_ARCH_X86)
+        { detail::chacha20_blocks_sse2,     cpu.sse2 },
+        { detail::chacha20_blocks_avx2,     cpu.avx2 },
+#endif
+#if defined(PM_ARCH_ARM64)
+        { detail::chacha20_blocks_neon,     true },
+#endif
+    };
+
+    byte key[key_length];
+    for (std::size_t i = 0; i < key_length; i++) key[i] = static_cast<byte>(i);
+
+    //Check the known answer through the public interface
+    byte buffer[sizeof(rfc8439_ciphertext)];
+
+    state st;
+    init(&st, key, rfc8439_nonce, 1);
+    crypt(&st, reinterpret_cast<byte const*>(rfc8439_plaintext), buffer, sizeof(buffer));
+    if (!std::equal(std::begin(buffer), std::end(buffer), rfc8439_ciphertext)) return false;
+
+    //The vector kernels only take over from four blocks up, so check
+    //each against the portable one over enough blocks to use every path
+    constexpr std::size_t const block_count = 19;
+
+    byte expected[block_count * block_length]{};
+    init(&st, key, rfc8439_nonce, 0xFFFFFFF8);
+    detail::chacha20_blocks_portable(&st, expected, expected, block_count);
+    auto const expected_counter = st.words[12];
+
+    for (auto const& [blocks, supported] : implementations)
+    {
+        if (!supported) continue;
+
+        byte stream[block_count * block_length]{};
+        init(&st, key, rfc8439_nonce, 0xFFFFFFF8);
+        blocks(&st, stream, stream, block_count);
+
+        if (!std::equal(std::begin(stream), std::end(stream), expected)) return false;
+        if (st.words[12] != expected_counter)                           return false;
+    }
+
+    return true;
+}
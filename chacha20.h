@@ -0,0 +1,62 @@
+#ifndef PM_CHACHA20_H
+#define PM_CHACHA20_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Implements the ChaCha20 stream cipher as described in RFC 8439
+ * (June 2018), with a 96-bit nonce and a 32-bit block counter.
+ *
+ * ChaCha20 is only additions, rotations and XORs, so it runs in
+ * constant time and at a good speed without any special hardware.
+ * The processor's vector units are used to compute 4 or 8 blocks
+ * at once where they are available.
+ */
+
+namespace pm::security
+{
+    struct chacha20
+    {
+        static constexpr std::size_t const block_length = 64;
+        static constexpr std::size_t const key_length   = 32;
+        static constexpr std::size_t const nonce_length = 12;
+
+        using byte = std::uint8_t;
+        using word = std::uint32_t;
+
+        /*
+         * The input to the block function: the constants, the key,
+         * the block counter and the nonce.
+         */
+        struct state
+        {
+            word words[16];
+        };
+
+        /*
+         * Prepares the state to start at the given block of the key
+         * stream.
+         */
+        static void init(state* st, byte const* key, byte const* nonce, word counter) noexcept;
+
+        /*
+         * XORs the key stream into the input. The counter moves on
+         * by one for every block used, even partly, so a message can
+         * be processed a piece at a time. Only the last piece of a
+         * message may end partway through a block. The input and
+         * output may be the same buffer.
+         */
+        static void crypt(state* st, byte const* in, byte* out, std::size_t length) noexcept;
+
+        /*
+         * Runs the known-answer tests from RFC 8439 against every
+         * implementation supported by the processor. Returns false
+         * if any of them got it wrong.
+         */
+        static bool self_test() noexcept;
+    };
+};
+
+#endif
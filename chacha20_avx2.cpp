@@ -0,0 +1,129 @@
+#include "chacha20_impl.h"
+
+/*
+ * Implements ChaCha20 with AVX2, computing eight blocks at once
+ * with the same word of every block in one register.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("avx2")
+#endif
+
+#include "secure_memory.h"
+
+using byte = pm::security::chacha20::byte;
+
+using pm::security::chacha20;
+
+static constexpr std::size_t const parallel_blocks = 8;
+
+template<int n>
+static inline __m256i rotate_left(__m256i x) noexcept
+{
+    //Whole byte rotations are a single shuffle
+    if constexpr (n == 16)
+    {
+        return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13, 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+    }
+    else if constexpr (n == 8)
+    {
+        return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14, 3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+    }
+    else
+    {
+        return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+    }
+}
+
+static inline void quarter_round(__m256i& a, __m256i& b, __m256i& c, __m256i& d) noexcept
+{
+    a = _mm256_add_epi32(a, b); d = rotate_left<16>(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d); b = rotate_left<12>(_mm256_xor_si256(b, c));
+    a = _mm256_add_epi32(a, b); d = rotate_left< 8>(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d); b = rotate_left< 7>(_mm256_xor_si256(b, c));
+}
+
+/*
+ * Turns four registers holding a word of every block into four
+ * registers holding four words of two blocks, block k in the low
+ * half of register k and block k + 4 in the high half.
+ */
+static inline void transpose(__m256i& a, __m256i& b, __m256i& c, __m256i& d) noexcept
+{
+    auto const t0 = _mm256_unpacklo_epi32(a, b);
+    auto const t1 = _mm256_unpacklo_epi32(c, d);
+    auto const t2 = _mm256_unpackhi_epi32(a, b);
+    auto const t3 = _mm256_unpackhi_epi32(c, d);
+
+    a = _mm256_unpacklo_epi64(t0, t1);
+    b = _mm256_unpackhi_epi64(t0, t1);
+    c = _mm256_unpacklo_epi64(t2, t3);
+    d = _mm256_unpackhi_epi64(t2, t3);
+}
+
+static inline void xor_store(byte* out, byte const* in, __m128i x) noexcept
+{
+    auto const data = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_xor_si128(data, x));
+}
+
+void pm::security::detail::chacha20_blocks_avx2(chacha20::state* st, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    __m256i input[16], x[16];
+    for (std::size_t i = 0; i < 16; i++) input[i] = _mm256_set1_epi32(static_cast<int>(st->words[i]));
+
+    //Each block gets its own counter
+    auto const lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (; block_count >= parallel_blocks; block_count -= parallel_blocks, in += parallel_blocks * chacha20::block_length, out += parallel_blocks * chacha20::block_length)
+    {
+        input[12] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(st->words[12])), lanes);
+
+        for (std::size_t i = 0; i < 16; i++) x[i] = input[i];
+
+        for (int i = 0; i < 10; i++)
+        {
+            quarter_round(x[0], x[4], x[ 8], x[12]);
+            quarter_round(x[1], x[5], x[ 9], x[13]);
+            quarter_round(x[2], x[6], x[10], x[14]);
+            quarter_round(x[3], x[7], x[11], x[15]);
+
+            quarter_round(x[0], x[5], x[10], x[15]);
+            quarter_round(x[1], x[6], x[11], x[12]);
+            quarter_round(x[2], x[7], x[ 8], x[13]);
+            quarter_round(x[3], x[4], x[ 9], x[14]);
+        }
+
+        for (std::size_t i = 0; i < 16; i++) x[i] = _mm256_add_epi32(x[i], input[i]);
+
+        //Each group of four words becomes 16 bytes of each block
+        for (std::size_t g = 0; g < 4; g++)
+        {
+            transpose(x[4 * g], x[4 * g + 1], x[4 * g + 2], x[4 * g + 3]);
+
+            for (std::size_t k = 0; k < 4; k++)
+            {
+                auto const low  = k       * chacha20::block_length + 16 * g;
+                auto const high = (k + 4) * chacha20::block_length + 16 * g;
+
+                xor_store(out + low,  in + low,  _mm256_castsi256_si128(x[4 * g + k]));
+                xor_store(out + high, in + high, _mm256_extracti128_si256(x[4 * g + k], 1));
+            }
+        }
+
+        st->words[12] += parallel_blocks;
+    }
+
+    pm::secure_wipe(input, sizeof(input));
+    pm::secure_wipe(x,     sizeof(x));
+
+    //Four blocks or more still fit the narrower kernel
+    chacha20_blocks_sse2(st, in, out, block_count);
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef PM_CHACHA20_IMPL_H
+#define PM_CHACHA20_IMPL_H
+#pragma once
+
+#include "chacha20.h"
+#include "cpu_features.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Internal definitions shared between the different
+ * implementations of ChaCha20.
+ */
+
+namespace pm::security::detail
+{
+    /*
+     * XORs a number of whole blocks of key stream into the input,
+     * moving the block counter of the state past them.
+     */
+    using chacha20_fn = void(*)
+    (
+        chacha20::state* st,
+        chacha20::byte const* in,
+        chacha20::byte* out,
+        std::size_t block_count
+    ) noexcept;
+
+    /*
+     * Portable implementation, one block at a time. Always
+     * available.
+     */
+    void chacha20_blocks_portable(chacha20::state* st, chacha20::byte const* in, chacha20::byte* out, std::size_t block_count) noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Four blocks at once, one word of each per register.
+     * Requires SSE2.
+     */
+    void chacha20_blocks_sse2(chacha20::state* st, chacha20::byte const* in, chacha20::byte* out, std::size_t block_count) noexcept;
+
+    /*
+     * Eight blocks at once, one word of each per register.
+     * Requires AVX2.
+     */
+    void chacha20_blocks_avx2(chacha20::state* st, chacha20::byte const* in, chacha20::byte* out, std::size_t block_count) noexcept;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    /*
+     * Four blocks at once, one word of each per register.
+     * NEON is always present.
+     */
+    void chacha20_blocks_neon(chacha20::state* st, chacha20::byte const* in, chacha20::byte* out, std::size_t block_count) noexcept;
+#endif
+
+    /*
+     * Retrieves the fastest implementation supported by the
+     * processor.
+     */
+    chacha20_fn get_chacha20() noexcept;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "chacha20_impl.h"
+
+/*
+ * Implements ChaCha20 with NEON, computing four blocks at once
+ * with the same word of every block in one register.
+ */
+
+#if defined(PM_ARCH_ARM64)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <arm64_neon.h>
+#else
+#   include <arm_neon.h>
+#endif
+
+#include "secure_memory.h"
+
+using byte = pm::security::chacha20::byte;
+
+using pm::security::chacha20;
+
+static constexpr std::size_t const parallel_blocks = 4;
+
+template<int n>
+static inline uint32x4_t rotate_left(uint32x4_t x) noexcept
+{
+    //Swapping the halves of every word is a single instruction
+    if constexpr (n == 16)
+    {
+        return vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x)));
+    }
+    else
+    {
+        return vorrq_u32(vshlq_n_u32(x, n), vshrq_n_u32(x, 32 - n));
+    }
+}
+
+static inline void quarter_round(uint32x4_t& a, uint32x4_t& b, uint32x4_t& c, uint32x4_t& d) noexcept
+{
+    a = vaddq_u32(a, b); d = rotate_left<16>(veorq_u32(d, a));
+    c = vaddq_u32(c, d); b = rotate_left<12>(veorq_u32(b, c));
+    a = vaddq_u32(a, b); d = rotate_left< 8>(veorq_u32(d, a));
+    c = vaddq_u32(c, d); b = rotate_left< 7>(veorq_u32(b, c));
+}
+
+/*
+ * Turns four registers holding a word of every block into four
+ * registers holding four words of one block.
+ */
+static inline void transpose(uint32x4_t& a, uint32x4_t& b, uint32x4_t& c, uint32x4_t& d) noexcept
+{
+    auto const t0 = vreinterpretq_u64_u32(vtrn1q_u32(a, b));
+    auto const t1 = vreinterpretq_u64_u32(vtrn2q_u32(a, b));
+    auto const t2 = vreinterpretq_u64_u32(vtrn1q_u32(c, d));
+    auto const t3 = vreinterpretq_u64_u32(vtrn2q_u32(c, d));
+
+    a = vreinterpretq_u32_u64(vtrn1q_u64(t0, t2));
+    b = vreinterpretq_u32_u64(vtrn1q_u64(t1, t3));
+    c = vreinterpretq_u32_u64(vtrn2q_u64(t0, t2));
+    d = vreinterpretq_u32_u64(vtrn2q_u64(t1, t3));
+}
+
+static inline void xor_store(byte* out, byte const* in, uint32x4_t x) noexcept
+{
+    vst1q_u8(out, veorq_u8(vld1q_u8(in), vreinterpretq_u8_u32(x)));
+}
+
+void pm::security::detail::chacha20_blocks_neon(chacha20::state* st, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    uint32x4_t input[16], x[16];
+    for (std::size_t i = 0; i < 16; i++) input[i] = vdupq_n_u32(st->words[i]);
+
+    //Each block gets its own counter
+    std::uint32_t const lane_values[4]{ 0, 1, 2, 3 };
+    auto const lanes = vld1q_u32(lane_values);
+
+    for (; block_count >= parallel_blocks; block_count -= parallel_blocks, in += parallel_blocks * chacha20::block_length, out += parallel_blocks * chacha20::block_length)
+    {
+        input[12] = vaddq_u32(vdupq_n_u32(st->words[12]), lanes);
+
+        for (std::size_t i = 0; i < 16; i++) x[i] = input[i];
+
+        for (int i = 0; i < 10; i++)
+        {
+            quarter_round(x[0], x[4], x[ 8], x[12]);
+            quarter_round(x[1], x[5], x[ 9], x[13]);
+            quarter_round(x[2], x[6], x[10], x[14]);
+            quarter_round(x[3], x[7], x[11], x[15]);
+
+            quarter_round(x[0], x[5], x[10], x[15]);
+            quarter_round(x[1], x[6], x[11], x[12]);
+            quarter_round(x[2], x[7], x[ 8], x[13]);
+            quarter_round(x[3], x[4], x[ 9], x[14]);
+        }
+
+        for (std::size_t i = 0; i < 16; i++) x[i] = vaddq_u32(x[i], input[i]);
+
+        //Each group of four words becomes 16 bytes of each block
+        for (std::size_t g = 0; g < 4; g++)
+        {
+            transpose(x[4 * g], x[4 * g + 1], x[4 * g + 2], x[4 * g + 3]);
+
+            for (std::size_t k = 0; k < parallel_blocks; k++)
+            {
+                auto const offset = k * chacha20::block_length + 16 * g;
+
+                xor_store(out + offset, in + offset, x[4 * g + k]);
+            }
+        }
+
+        st->words[12] += parallel_blocks;
+    }
+
+    pm::secure_wipe(input, sizeof(input));
+    pm::secure_wipe(x,     sizeof(x));
+
+    //Finish the remaining blocks one at a time
+    chacha20_blocks_portable(st, in, out, block_count);
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include "chacha20_impl.h"
+
+/*
+ * Implements ChaCha20 with SSE2, computing four blocks at once
+ * with the same word of every block in one register.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("sse2")
+#endif
+
+#include "secure_memory.h"
+
+using byte = pm::security::chacha20::byte;
+
+using pm::security::chacha20;
+
+static constexpr std::size_t const parallel_blocks = 4;
+
+template<int n>
+static inline __m128i rotate_left(__m128i x) noexcept
+{
+    return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+static inline void quarter_round(__m128i& a, __m128i& b, __m128i& c, __m128i& d) noexcept
+{
+    a = _mm_add_epi32(a, b); d = rotate_left<16>(_mm_xor_si128(d, a));
+    c = _mm_add_epi32(c, d); b = rotate_left<12>(_mm_xor_si128(b, c));
+    a = _mm_add_epi32(a, b); d = rotate_left< 8>(_mm_xor_si128(d, a));
+    c = _mm_add_epi32(c, d); b = rotate_left< 7>(_mm_xor_si128(b, c));
+}
+
+/*
+ * Turns four registers holding a word of every block into four
+ * registers holding four words of one block.
+ */
+static inline void transpose(__m128i& a, __m128i& b, __m128i& c, __m128i& d) noexcept
+{
+    auto const t0 = _mm_unpacklo_epi32(a, b);
+    auto const t1 = _mm_unpacklo_epi32(c, d);
+    auto const t2 = _mm_unpackhi_epi32(a, b);
+    auto const t3 = _mm_unpackhi_epi32(c, d);
+
+    a = _mm_unpacklo_epi64(t0, t1);
+    b = _mm_unpackhi_epi64(t0, t1);
+    c = _mm_unpacklo_epi64(t2, t3);
+    d = _mm_unpackhi_epi64(t2, t3);
+}
+
+static inline void xor_store(byte* out, byte const* in, __m128i x) noexcept
+{
+    auto const data = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_xor_si128(data, x));
+}
+
+void pm::security::detail::chacha20_blocks_sse2(chacha20::state* st, byte const* in, byte* out, std::size_t block_count) noexcept
+{
+    __m128i input[16], x[16];
+    for (std::size_t i = 0; i < 16; i++) input[i] = _mm_set1_epi32(static_cast<int>(st->words[i]));
+
+    //Each block gets its own counter
+    auto const lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+    for (; block_count >= parallel_blocks; block_count -= parallel_blocks, in += parallel_blocks * chacha20::block_length, out += parallel_blocks * chacha20::block_length)
+    {
+        input[12] = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(st->words[12])), lanes);
+
+        for (std::size_t i = 0; i < 16; i++) x[i] = input[i];
+
+        for (int i = 0; i < 10; i++)
+        {
+            quarter_round(x[0], x[4], x[ 8], x[12]);
+            quarter_round(x[1], x[5], x[ 9], x[13]);
+            quarter_round(x[2], x[6], x[10], x[14]);
+            quarter_round(x[3], x[7], x[11], x[15]);
+
+            quarter_round(x[0], x[5], x[10], x[15]);
+            quarter_round(x[1], x[6], x[11], x[12]);
+            quarter_round(x[2], x[7], x[ 8], x[13]);
+            quarter_round(x[3], x[4], x[ 9], x[14]);
+        }
+
+        for (std::size_t i = 0; i < 16; i++) x[i] = _mm_add_epi32(x[i], input[i]);
+
+        //Each group of four words becomes 16 bytes of each block
+        for (std::size_t g = 0; g < 4; g++)
+        {
+            transpose(x[4 * g], x[4 * g + 1], x[4 * g + 2], x[4 * g + 3]);
+
+            for (std::size_t k = 0; k < parallel_blocks; k++)
+            {
+                auto const offset = k * chacha20::block_length + 16 * g;
+
+                xor_store(out + offset, in + offset, x[4 * g + k]);
+            }
+        }
+
+        st->words[12] += parallel_blocks;
+    }
+
+    pm::secure_wipe(input, sizeof(input));
+    pm::secure_wipe(x,     sizeof(x));
+
+    //Finish the remaining blocks one at a time
+    chacha20_blocks_portable(st, in, out, block_count);
+}
+
+#endif
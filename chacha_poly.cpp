@@ -0,0 +1,244 @@
+#include "chacha_poly.h"
+#include "hmac.h"
+#include "secure_memory.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+using pm::security::chacha20;
+using pm::security::hmac_sha256;
+using pm::security::poly1305;
+
+//The segments handed to the thread pool at once, which bounds the tags kept on the stack
+static constexpr std::size_t max_parallel_segments = 64;
+
+//The label the key is derived with
+static constexpr char const key_label[] = "BHPM ChaCha20-Poly1305 key";
+
+//The bit of the nonce that marks the tag of the whole message, which segment nonces never touch
+static constexpr std::size_t  final_nonce_byte = 0;
+static constexpr std::uint8_t final_nonce_bit  = 0x80;
+
+static void store_u64_big_endian(std::uint8_t* p, std::uint64_t x) noexcept
+{
+    for (std::size_t i = 0; i < 8; i++) p[i] = static_cast<std::uint8_t>(x >> (56 - 8 * i));
+}
+
+static void store_u64_little_endian(std::uint8_t* p, std::uint64_t x) noexcept
+{
+    for (std::size_t i = 0; i < 8; i++) p[i] = static_cast<std::uint8_t>(x >> (8 * i));
+}
+
+/*
+ * Starts the cipher for a nonce, taking the Poly1305 key from the
+ * first block of key stream and leaving the counter at the next.
+ */
+static void start_seal(std::uint8_t const* key, std::uint8_t const* nonce, chacha20::state* st, poly1305::context* mac) noexcept
+{
+    std::uint8_t mac_key[chacha20::block_length]{};
+
+    chacha20::init(st, key, nonce, 0);
+    chacha20::crypt(st, mac_key, mac_key, sizeof(mac_key));
+    mac->init(mac_key);
+
+    pm::secure_wipe(mac_key, sizeof(mac_key));
+}
+
+/*
+ * Ends a seal: pads the associated data and the cipher text to
+ * whole blocks, and adds both lengths.
+ */
+static void finish_seal(poly1305::context* mac, std::uint64_t associated_length, std::uint64_t cipher_length, std::uint8_t* tag) noexcept
+{
+    static constexpr std::uint8_t const zeros[poly1305::block_length]{};
+
+    mac->update(zeros, (poly1305::block_length - cipher_length % poly1305::block_length) % poly1305::block_length);
+
+    std::uint8_t lengths[16];
+    store_u64_little_endian(lengths,     associated_length);
+    store_u64_little_endian(lengths + 8, cipher_length);
+    mac->update(lengths, sizeof(lengths));
+
+    mac->finish(tag);
+}
+
+pm::chacha_poly_stream::~chacha_poly_stream()
+{
+    this->wipe();
+}
+
+std::error_code pm::chacha_poly_stream::init(derived_key const& key, span<std::uint8_t> nonce, span<std::uint8_t> associated_data) noexcept
+{
+    //Check that the provided nonce is long enough
+    if (nonce.size() < static_cast<std::ptrdiff_t>(nonce_length)) return ntstatus_t::INVALID_PARAMETER;
+
+    //Derive a key of its own, so it says nothing about the keys of other formats
+    auto cipher_key = hmac_sha256::compute_mac(key.data(), key.size(), key_label, sizeof(key_label) - 1);
+    std::memcpy(this->key, cipher_key.data(), sizeof(this->key));
+    secure_wipe(cipher_key.data(), cipher_key.size());
+
+    std::memcpy(this->nonce, nonce.data(), nonce_length);
+    this->segment_index = 0;
+    this->total_length  = 0;
+    this->ended         = false;
+    this->started       = true;
+
+    //The tag of the message is sealed under its own nonce, and starts with the associated data
+    std::uint8_t final_nonce[nonce_length];
+    std::memcpy(final_nonce, this->nonce, nonce_length);
+    final_nonce[final_nonce_byte] ^= final_nonce_bit;
+
+    chacha20::state st;
+    start_seal(this->key, final_nonce, &st, &this->message_mac);
+    secure_wipe(&st, sizeof(st));
+
+    this->message_mac.update(associated_data.data(), static_cast<std::size_t>(associated_data.size()));
+    this->sealed_length = static_cast<std::uint64_t>(associated_data.size());
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::chacha_poly_stream::process_segment(std::uint64_t index, std::uint8_t const* input, std::uint8_t* output, std::size_t length, std::uint8_t* tag) const noexcept
+{
+    //Each segment has its own nonce, the last 8 bytes XORed with its index
+    std::uint8_t segment_nonce[nonce_length];
+    std::uint8_t position[8];
+    store_u64_big_endian(position, index);
+
+    std::memcpy(segment_nonce, this->nonce, nonce_length);
+    for (std::size_t i = 0; i < sizeof(position); i++) segment_nonce[nonce_length - 8 + i] ^= position[i];
+
+    chacha20::state   st;
+    poly1305::context mac;
+    start_seal(this->key, segment_nonce, &st, &mac);
+
+    //Decrypt in the output, so input that can change underneath is read once and what is checked is what is decrypted
+    if ((this->dir == direction::DECRYPT) && (output != input))
+    {
+        std::memcpy(output, input, length);
+        input = output;
+    }
+
+    //The MAC always covers the cipher text, which is the input unless encrypting
+    if (this->dir != direction::ENCRYPT) mac.update(input, length);
+
+    if (this->dir != direction::AUTHENTICATE) chacha20::crypt(&st, input, output, length);
+
+    if (this->dir == direction::ENCRYPT) mac.update(output, length);
+
+    finish_seal(&mac, 0, length, tag);
+
+    secure_wipe(&st, sizeof(st));
+}
+
+std::error_code pm::chacha_poly_stream::update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    return this->update(input, output, output_size, output_len, nullptr);
+}
+
+std::error_code pm::chacha_poly_stream::update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len, std::uint8_t* segment_tags) noexcept
+{
+    //Check that a message has been started
+    if (!this->started) return ntstatus_t::INVALID_HANDLE;
+
+    //Authenticating writes nothing, so it needs no output
+    auto const length  = static_cast<std::size_t>(input.size());
+    auto const writing = (this->dir != direction::AUTHENTICATE);
+    if (writing && (output_size < length)) return ntstatus_t::BUFFER_TOO_SMALL;
+
+    //Only the last piece may end partway through a segment
+    if (this->ended && (length > 0)) return ntstatus_t::INVALID_PARAMETER;
+    if (length % segment_length != 0) this->ended = true;
+
+    auto const segment_count = (length + segment_length - 1) / segment_length;
+    auto&      pool          = thread_pool::get_shared();
+
+    for (std::size_t first = 0; first < segment_count; first += max_parallel_segments)
+    {
+        auto const count = std::min(segment_count - first, max_parallel_segments);
+
+        std::array<std::array<std::uint8_t, tag_length>, max_parallel_segments> tags;
+
+        auto const task = [&](std::size_t k) noexcept
+        {
+            auto const offset = (first + k) * segment_length;
+            auto const size   = std::min(segment_length, length - offset);
+
+            this->process_segment(this->segment_index + k, input.data() + offset, writing ? output + offset : nullptr, size, tags[k].data());
+        };
+
+        //A single segment is not worth waking the workers for
+        if (count == 1)
+            task(0);
+        else
+            pool.parallel_for(count, task);
+
+        //The tags of the segments go into the tag of the message in order
+        for (std::size_t k = 0; k < count; k++) this->message_mac.update(tags[k].data(), tags[k].size());
+
+        for (std::size_t k = 0; segment_tags && (k < count); k++) std::memcpy(segment_tags + (first + k) * segment_tag_length, tags[k].data(), segment_tag_length);
+
+        this->sealed_length += count * tag_length;
+        this->segment_index += count;
+    }
+
+    this->total_length += length;
+    *output_len = writing ? length : 0;
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::chacha_poly_stream::finish_tag(std::uint8_t* tag) noexcept
+{
+    //The sealed data ends with the length, so the message cannot be cut short at a segment boundary
+    std::uint8_t length[8];
+    store_u64_big_endian(length, this->total_length);
+    this->message_mac.update(length, sizeof(length));
+    this->sealed_length += sizeof(length);
+
+    //Nothing is encrypted under the final nonce, everything is associated data
+    static constexpr std::uint8_t const zeros[poly1305::block_length]{};
+    this->message_mac.update(zeros, (poly1305::block_length - this->sealed_length % poly1305::block_length) % poly1305::block_length);
+
+    finish_seal(&this->message_mac, this->sealed_length, 0, tag);
+
+    this->wipe();
+}
+
+std::error_code pm::chacha_poly_stream::finish(std::uint8_t* tag, std::size_t tag_size) noexcept
+{
+    //Check that a message is being encrypted
+    if (!this->started)                  return ntstatus_t::INVALID_HANDLE;
+    if (this->dir != direction::ENCRYPT) return ntstatus_t::INVALID_PARAMETER;
+    if (tag_size < tag_length)           return ntstatus_t::BUFFER_TOO_SMALL;
+
+    this->finish_tag(tag);
+
+    return ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::chacha_poly_stream::verify(span<std::uint8_t> tag) noexcept
+{
+    //Check that a message is being decrypted or authenticated
+    if (!this->started)                                        return ntstatus_t::INVALID_HANDLE;
+    if (this->dir == direction::ENCRYPT)                       return ntstatus_t::INVALID_PARAMETER;
+    if (tag.size() != static_cast<std::ptrdiff_t>(tag_length)) return ntstatus_t::INVALID_PARAMETER;
+
+    std::uint8_t computed[tag_length];
+    this->finish_tag(computed);
+
+    if (!secure_equal(computed, tag.data(), tag_length)) return ntstatus_t::AUTH_TAG_MISMATCH;
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::chacha_poly_stream::wipe() noexcept
+{
+    secure_wipe(this->key,          sizeof(this->key));
+    secure_wipe(this->nonce,        sizeof(this->nonce));
+    secure_wipe(&this->message_mac, sizeof(this->message_mac));
+
+    this->started = false;
+}
@@ -0,0 +1,95 @@
+#ifndef PM_CHACHA_POLY_H
+#define PM_CHACHA_POLY_H
+#pragma once
+
+#include "chacha20.h"
+#include "kdf.h"
+#include "ntstatus.h"
+#include "poly1305.h"
+#include "span.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Encrypts and authenticates a message with the ChaCha20-Poly1305
+ * construction of RFC 8439, for processors without AES
+ * instructions. The key is derived from the archive key.
+ *
+ * The message is cut into segments of segment_length bytes. Each
+ * segment is sealed on its own, with the nonce XORed with its
+ * index, so the segments are spread across the shared thread pool.
+ * The tag of the message seals the associated data, the tags of the
+ * segments in order and the total length under a nonce no segment
+ * uses, so segments cannot be dropped, reordered or cut short.
+ *
+ * It is used exactly like pm::ctr_hmac_stream: init, update any
+ * number of times, and finish or verify. Every piece but the last
+ * must be a whole number of segments. Decrypted data must not be
+ * trusted until verify has succeeded, and a stream that only
+ * authenticates checks the tag without decrypting. The tags of the
+ * segments can be kept the same way, and decrypting reads each
+ * segment of the input once.
+ */
+
+namespace pm
+{
+    struct chacha_poly_stream
+    {
+    public:
+        enum class direction : std::uint8_t
+        {
+            ENCRYPT,
+            DECRYPT,
+            AUTHENTICATE,
+        };
+
+        static constexpr std::size_t nonce_length   = security::chacha20::nonce_length;
+        static constexpr std::size_t tag_length     = security::poly1305::tag_length;
+        static constexpr std::size_t segment_length = 64 * 1024;
+
+        //The tag of each segment, which a later pass over the same message can be checked against
+        static constexpr std::size_t segment_tag_length = security::poly1305::tag_length;
+
+        explicit chacha_poly_stream(direction dir) noexcept
+            : dir{ dir }
+        {}
+
+        chacha_poly_stream(chacha_poly_stream const&) = delete;
+        chacha_poly_stream& operator = (chacha_poly_stream const&) = delete;
+
+        ~chacha_poly_stream();
+
+        //Starts a new message with a nonce that is never used twice with the same key
+        [[nodiscard]] std::error_code init(derived_key const& key, span<std::uint8_t> nonce, span<std::uint8_t> associated_data) noexcept;
+
+        //Processes the next piece of the message into the output, which may be the piece itself, or is not needed to authenticate
+        [[nodiscard]] std::error_code update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept;
+
+        //Does the same, and writes the tag of each segment of the piece, segment_tag_length bytes apiece, to the segment tags
+        [[nodiscard]] std::error_code update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len, std::uint8_t* segment_tags) noexcept;
+
+        //Ends an encrypted message and writes its tag
+        [[nodiscard]] std::error_code finish(std::uint8_t* tag, std::size_t tag_size) noexcept;
+
+        //Ends a decrypted or authenticated message and checks it against its tag
+        [[nodiscard]] std::error_code verify(span<std::uint8_t> tag) noexcept;
+
+    private:
+        void process_segment(std::uint64_t index, std::uint8_t const* input, std::uint8_t* output, std::size_t length, std::uint8_t* tag) const noexcept;
+        void finish_tag(std::uint8_t* tag) noexcept;
+        void wipe() noexcept;
+
+        direction                   dir;
+        bool                        started = false;
+        bool                        ended   = false;
+        std::uint64_t               segment_index   = 0;
+        std::uint64_t               total_length    = 0;
+        std::uint64_t               sealed_length   = 0;
+        std::uint8_t                key[security::chacha20::key_length]{};
+        std::uint8_t                nonce[nonce_length]{};
+        security::poly1305::context message_mac{};
+    };
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "cpu_features.h"
+
+#if defined(PM_ARCH_X86)
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <cpuid.h>
+#   endif
+#elif defined(PM_ARCH_ARM64)
+#   if defined(_WIN32)
+#       define WIN32_LEAN_AND_MEAN
+#       include <windows.h>
+#   elif defined(__linux__)
+#       include <sys/auxv.h>
+#       include <asm/hwcap.h>
+#   endif
+#endif
+
+#if defined(PM_ARCH_X86)
+
+static void cpuid(int leaf, int subleaf, int(&regs)[4]) noexcept
+{
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv(unsigned int index) noexcept
+{
+#if defined(_MSC_VER)
+    return _xgetbv(index);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+static bool has_bit(int reg, int bit) noexcept
+{
+    return (static_cast<unsigned int>(reg) >> bit) & 1u;
+}
+
+static pm::cpu::features detect() noexcept
+{
+    pm::cpu::features result{};
+    int regs[4]{};
+
+    //Find the highest supported leaf
+    cpuid(0, 0, regs);
+    auto const max_leaf = regs[0];
+
+    //Check which register sets the operating system saves for us
+    auto os_avx    = false;
+    auto os_avx512 = false;
+
+    //Read the basic feature flags
+    if (max_leaf >= 1)
+    {
+        cpuid(1, 0, regs);
+
+        result.sse2  = has_bit(regs[3], 26);
+        result.ssse3 = has_bit(regs[2],  9);
+        result.sse41 = has_bit(regs[2], 19);
+        result.aesni = has_bit(regs[2], 25);
+
+        //XGETBV is only available if OSXSAVE is set
+        if (has_bit(regs[2], 27) && has_bit(regs[2], 28))
+        {
+            auto const xcr0 = xgetbv(0);
+
+            os_avx    = (xcr0 & 0x06) == 0x06;
+            os_avx512 = (xcr0 & 0xE6) == 0xE6;
+        }
+    }
+
+    //Read the extended feature flags
+    if (max_leaf >= 7)
+    {
+        cpuid(7, 0, regs);
+
+        result.avx2    = has_bit(regs[1],  5) && os_avx;
+        result.avx512f = has_bit(regs[1], 16) && os_avx512;
+        result.sha     = has_bit(regs[1], 29);
+    }
+
+    return result;
+}
+
+#elif defined(PM_ARCH_ARM64)
+
+static pm::cpu::features detect() noexcept
+{
+    pm::cpu::features result{};
+
+#if defined(_WIN32)
+    result.sha2 = IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+    result.aes  = result.sha2;
+#elif defined(__linux__)
+    auto const hwcap = getauxval(AT_HWCAP);
+
+    result.sha2 = (hwcap & HWCAP_SHA2) != 0;
+    result.aes  = (hwcap & HWCAP_AES)  != 0;
+#elif defined(__APPLE__)
+    //Every Apple ARM64 processor implements the crypto extensions
+    result.sha2 = true;
+    result.aes  = true;
+#endif
+
+    return result;
+}
+
+#else
+
+static pm::cpu::features detect() noexcept
+{
+    return {};
+}
+
+#endif
+
+pm::cpu::features const& pm::cpu::get_features() noexcept
+{
+    //Detect the features on first use
+    static features const result = detect();
+
+    return result;
+}
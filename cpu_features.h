@@ -0,0 +1,42 @@
+#ifndef PM_CPU_FEATURES_H
+#define PM_CPU_FEATURES_H
+#pragma once
+
+/*
+ * Runtime detection of the instruction set extensions
+ * we have hand-written code paths for. The result is
+ * computed once and cached for the rest of the process.
+ */
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#   define PM_ARCH_X86 1
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#   define PM_ARCH_ARM64 1
+#endif
+
+namespace pm::cpu
+{
+    struct features
+    {
+        //x86 extensions
+        bool sse2    = false;
+        bool ssse3   = false;
+        bool sse41   = false;
+        bool avx2    = false;
+        bool avx512f = false;
+        bool sha     = false;
+        bool aesni   = false;
+
+        //ARMv8 extensions
+        bool sha2    = false;
+        bool aes     = false;
+    };
+
+    /*
+     * Retrieves the features supported by the processor
+     * and operating system we are running on.
+     */
+    features const& get_features() noexcept;
+};
+
+#endif
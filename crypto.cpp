@@ -1,7 +1,15 @@
 #include "crypto.h"
 
+#if defined(PM_CRYPTO_BCRYPT)
+
+#include "crypto_session.h"
+#include "secure_memory.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <new>
+#include <utility>
 #include <vector>
 
 #define WIN32_LEAN_AND_MEAN
@@ -10,7 +18,7 @@
 
 #pragma comment(lib, "bcrypt.lib")
 
-std::error_code pm::get_random_bytes(std::uint8_t* buffer, std::size_t len) noexcept
+std::error_code pm::get_system_random_bytes(std::uint8_t* buffer, std::size_t len) noexcept
 {
     NTSTATUS          success = static_cast<NTSTATUS>(ntstatus_t::UNSUCCESSFUL);
     BCRYPT_ALG_HANDLE hRngAlg = nullptr;
@@ -135,150 +143,87 @@ cleanup:
     return static_cast<ntstatus_t>(success);
 }
 
-std::error_code pm::encrypt(span<std::uint8_t> input, span<std::uint8_t> password, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept
+/*
+ * Opens a session for a single call, with the key the caller provided.
+ */
+static std::error_code open_session(pm::span<std::uint8_t> key, pm::crypto_session* session) noexcept
 {
-    NTSTATUS           success      = static_cast<NTSTATUS>(ntstatus_t::UNSUCCESSFUL);
-    BCRYPT_ALG_HANDLE  hAesAlg      = nullptr;
-    BCRYPT_KEY_HANDLE  hKey         = nullptr;
-    DWORD              cbData       = 0;
-    DWORD              cbKeyObject  = 0;
-    DWORD const        cbHash       = 32;
-    DWORD const        cbIV         = 16;
-    DWORD              cbCipherText = 0;
-    PBYTE              pbKeyObject  = nullptr;
-    owned_byte_array   pbHash       = nullptr;
-    PBYTE              pbIV         = nullptr;
-    PBYTE              pbCipherText = nullptr;
+    auto copy = pm::derived_key{};
 
-    //Open algorithm provider
-    success = BCryptOpenAlgorithmProvider(&hAesAlg, BCRYPT_AES_ALGORITHM, nullptr, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    //Check that the provided key is a 256-bit key
+    if (key.size() != static_cast<std::ptrdiff_t>(copy.size()))
+        return pm::ntstatus_t::INVALID_PARAMETER;
 
-    //Find how much space the key object needs
-    success = BCryptGetProperty(hAesAlg, BCRYPT_OBJECT_LENGTH, reinterpret_cast<PBYTE>(&cbKeyObject), sizeof(DWORD), &cbData, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    //The session keeps its own copy
+    std::copy(key.cbegin(), key.cend(), copy.begin());
+    auto success = session->open(copy);
+    pm::secure_wipe(copy.data(), copy.size());
 
-    //Allocate space for the key object
-    pbKeyObject = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, cbKeyObject));
-    if (pbKeyObject == nullptr)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    return success;
+}
 
-    //Check that the provided IV is long enough
-    if (iv.size() < cbIV)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+std::error_code pm::encrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    auto session = crypto_session{};
 
-    //Allocate space for the IV
-    pbIV = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, cbIV));
-    if (pbIV == nullptr)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    auto success = open_session(key, &session);
+    if (success) return success;
 
-    //Copy the provided IV into our new buffer
-    std::memcpy(pbIV, iv.data(), cbIV);
+    return session.encrypt(input, iv, output, output_size, output_len);
+}
 
-    //Hash the input password
-    success = static_cast<NTSTATUS>(pm::hash(password, &pbHash).value());
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+std::error_code pm::encrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept
+{
+    auto session = crypto_session{};
 
-    //Generate the key object
-    success = BCryptGenerateSymmetricKey(hAesAlg, &hKey, pbKeyObject, cbKeyObject, pbHash.get(), cbHash, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    auto success = open_session(key, &session);
+    if (success) return success;
 
-    //Calculate the length of the cipher text
-    success = BCryptEncrypt(hKey, const_cast<PUCHAR>(input.data()), static_cast<ULONG>(input.size()), nullptr, pbIV, cbIV, nullptr, 0, &cbCipherText, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    return session.encrypt(input, iv, output, output_len);
+}
 
-    //Allocate space for the cipher text
-    pbCipherText = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, cbCipherText));
-    if (pbCipherText == nullptr)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    auto session = crypto_session{};
 
-    //Encrypt the input
-    success = BCryptEncrypt(hKey, const_cast<PUCHAR>(input.data()), static_cast<ULONG>(input.size()), nullptr, pbIV, cbIV, pbCipherText, cbCipherText, &cbData, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    auto success = open_session(key, &session);
+    if (success) return success;
 
-    //Assign the result
-    *output     = std::make_unique<std::uint8_t[]>(cbCipherText);
-    *output_len = cbCipherText;
-    std::memcpy(output->get(), pbCipherText, cbCipherText);
+    return session.decrypt(input, iv, output, output_size, output_len);
+}
 
-cleanup:
-    //Close algorithm provider
-    if (hAesAlg)
-        BCryptCloseAlgorithmProvider(hAesAlg, 0);
+std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept
+{
+    auto session = crypto_session{};
 
-    //Destroy the key
-    if (hKey)
-        BCryptDestroyKey(hKey);
+    auto success = open_session(key, &session);
+    if (success) return success;
 
-    //Release the memory for the key object
-    if (pbKeyObject)
-        HeapFree(GetProcessHeap(), 0, pbKeyObject);
+    return session.decrypt(input, iv, output, output_len);
+}
 
-    //Release the memory for the IV
-    if (pbIV)
-        HeapFree(GetProcessHeap(), 0, pbIV);
+struct pm::crypto_session::backend
+{
+    BCRYPT_ALG_HANDLE hAesAlg     = nullptr;
+    BCRYPT_KEY_HANDLE hKey        = nullptr;
+    PBYTE             pbKeyObject = nullptr;
+    DWORD             cbKeyObject = 0;
+};
 
-    //Release the memory for the cipher text
-    if (pbCipherText)
-        HeapFree(GetProcessHeap(), 0, pbCipherText);
+std::error_code pm::crypto_session::open(derived_key const& key) noexcept
+{
+    NTSTATUS success = static_cast<NTSTATUS>(ntstatus_t::UNSUCCESSFUL);
+    DWORD    cbData  = 0;
 
-    //Return the status
-    return static_cast<ntstatus_t>(success);
-}
+    this->close();
 
-std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> password, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept
-{
-    NTSTATUS           success      = static_cast<NTSTATUS>(ntstatus_t::UNSUCCESSFUL);
-    BCRYPT_ALG_HANDLE  hAesAlg      = nullptr;
-    BCRYPT_KEY_HANDLE  hKey         = nullptr;
-    DWORD              cbData       = 0;
-    DWORD              cbKeyObject  = 0;
-    DWORD const        cbHash       = 32;
-    DWORD const        cbIV         = 16;
-    DWORD              cbClearText  = 0;
-    PBYTE              pbKeyObject  = nullptr;
-    owned_byte_array   pbHash       = nullptr;
-    PBYTE              pbIV         = nullptr;
-    PBYTE              pbClearText  = nullptr;
+    //Allocate the session state
+    auto* state = new (std::nothrow) backend;
+    if (state == nullptr)
+        return ntstatus_t::NO_MEMORY;
 
     //Open algorithm provider
-    success = BCryptOpenAlgorithmProvider(&hAesAlg, BCRYPT_AES_ALGORITHM, nullptr, 0);
+    success = BCryptOpenAlgorithmProvider(&state->hAesAlg, BCRYPT_AES_ALGORITHM, nullptr, 0);
     if (success < 0)
     {
         //Go to cleanup
@@ -286,7 +231,7 @@ std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> passwor
     }
 
     //Find how much space the key object needs
-    success = BCryptGetProperty(hAesAlg, BCRYPT_OBJECT_LENGTH, reinterpret_cast<PBYTE>(&cbKeyObject), sizeof(DWORD), &cbData, 0);
+    success = BCryptGetProperty(state->hAesAlg, BCRYPT_OBJECT_LENGTH, reinterpret_cast<PBYTE>(&state->cbKeyObject), sizeof(DWORD), &cbData, 0);
     if (success < 0)
     {
         //Go to cleanup
@@ -294,97 +239,109 @@ std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> passwor
     }
 
     //Allocate space for the key object
-    pbKeyObject = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, cbKeyObject));
-    if (pbKeyObject == nullptr)
+    state->pbKeyObject = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, state->cbKeyObject));
+    if (state->pbKeyObject == nullptr)
     {
-        //Go to cleanup
-        goto cleanup;
-    }
+        success = static_cast<NTSTATUS>(ntstatus_t::NO_MEMORY);
 
-    //Check that the provided IV is long enough
-    if (iv.size() < cbIV)
-    {
         //Go to cleanup
         goto cleanup;
     }
 
-    //Allocate space for the IV
-    pbIV = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, cbIV));
-    if (pbIV == nullptr)
+    //Generate the key object, which holds the expanded key for the whole session
+    success = BCryptGenerateSymmetricKey(state->hAesAlg, &state->hKey, state->pbKeyObject, state->cbKeyObject, const_cast<PUCHAR>(key.data()), static_cast<ULONG>(key.size()), 0);
+    if (success < 0)
     {
         //Go to cleanup
         goto cleanup;
     }
 
-    //Copy the provided IV into our new buffer
-    std::memcpy(pbIV, iv.data(), cbIV);
+    //Keep the state
+    this->state = std::exchange(state, nullptr);
 
-    //Hash the input password
-    success = static_cast<NTSTATUS>(pm::hash(password, &pbHash).value());
-    if (success < 0)
+cleanup:
+    //Release a half opened state
+    if (state)
     {
-        //Go to cleanup
-        goto cleanup;
+        this->state = state;
+        this->close();
     }
 
-    //Generate the key object
-    success = BCryptGenerateSymmetricKey(hAesAlg, &hKey, pbKeyObject, cbKeyObject, pbHash.get(), cbHash, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+    //Return the status
+    return static_cast<ntstatus_t>(success);
+}
 
-    //Calculate the length of the clear text
-    success = BCryptDecrypt(hKey, const_cast<PUCHAR>(input.data()), static_cast<ULONG>(input.size()), nullptr, pbIV, cbIV, nullptr, 0, &cbClearText, 0);
-    if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+void pm::crypto_session::close() noexcept
+{
+    if (this->state == nullptr) return;
 
-    //Allocate space for the clear text
-    pbClearText = static_cast<PBYTE>(HeapAlloc(GetProcessHeap(), 0, cbClearText));
-    if (pbClearText == nullptr)
+    //Destroy the key
+    if (this->state->hKey)
+        BCryptDestroyKey(this->state->hKey);
+
+    //Wipe and release the memory for the key object
+    if (this->state->pbKeyObject)
     {
-        //Go to cleanup
-        goto cleanup;
+        secure_wipe(this->state->pbKeyObject, this->state->cbKeyObject);
+        HeapFree(GetProcessHeap(), 0, this->state->pbKeyObject);
     }
 
-    //Decrypt the input
-    success = BCryptDecrypt(hKey, const_cast<PUCHAR>(input.data()), static_cast<ULONG>(input.size()), nullptr, pbIV, cbIV, pbClearText, cbClearText, &cbData, 0);
+    //Close algorithm provider
+    if (this->state->hAesAlg)
+        BCryptCloseAlgorithmProvider(this->state->hAesAlg, 0);
+
+    delete this->state;
+    this->state = nullptr;
+}
+
+std::error_code pm::crypto_session::encrypt_chained(span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept
+{
+    NTSTATUS success = static_cast<NTSTATUS>(ntstatus_t::UNSUCCESSFUL);
+    DWORD    cbData  = 0;
+
+    //Check that the session is open
+    if (this->state == nullptr)
+        return ntstatus_t::INVALID_HANDLE;
+
+    //Check that the output has room, BCrypt would only report the size otherwise
+    if (output_size < static_cast<std::size_t>(input.size()))
+        return ntstatus_t::BUFFER_TOO_SMALL;
+
+    //Encrypt straight into the output, which may be the input. BCrypt
+    //leaves the last cipher text block in the IV, ready for the next call
+    success = BCryptEncrypt(this->state->hKey, const_cast<PUCHAR>(input.data()), static_cast<ULONG>(input.size()), nullptr, iv, static_cast<ULONG>(iv_length), output, static_cast<ULONG>(output_size), &cbData, 0);
     if (success < 0)
-    {
-        //Go to cleanup
-        goto cleanup;
-    }
+        return static_cast<ntstatus_t>(success);
 
     //Assign the result
-    *output     = std::make_unique<std::uint8_t[]>(cbClearText);
-    *output_len = cbClearText;
-    std::memcpy(output->get(), pbClearText, cbClearText);
+    *output_len = cbData;
 
-cleanup:
-    //Close algorithm provider
-    if (hAesAlg)
-        BCryptCloseAlgorithmProvider(hAesAlg, 0);
+    return ntstatus_t::SUCCESS;
+}
 
-    //Destroy the key
-    if (hKey)
-        BCryptDestroyKey(hKey);
+std::error_code pm::crypto_session::decrypt_chained(span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept
+{
+    NTSTATUS success = static_cast<NTSTATUS>(ntstatus_t::UNSUCCESSFUL);
+    DWORD    cbData  = 0;
 
-    //Release the memory for the key object
-    if (pbKeyObject)
-        HeapFree(GetProcessHeap(), 0, pbKeyObject);
+    //Check that the session is open
+    if (this->state == nullptr)
+        return ntstatus_t::INVALID_HANDLE;
 
-    //Release the memory for the IV
-    if (pbIV)
-        HeapFree(GetProcessHeap(), 0, pbIV);
+    //Check that the output has room, BCrypt would only report the size otherwise
+    if (output_size < static_cast<std::size_t>(input.size()))
+        return ntstatus_t::BUFFER_TOO_SMALL;
 
-    //Release the memory for the clear text
-    if (pbClearText)
-        HeapFree(GetProcessHeap(), 0, pbClearText);
+    //Decrypt straight into the output, which may be the input. BCrypt
+    //leaves the last cipher text block in the IV, ready for the next call
+    success = BCryptDecrypt(this->state->hKey, const_cast<PUCHAR>(input.data()), static_cast<ULONG>(input.size()), nullptr, iv, static_cast<ULONG>(iv_length), output, static_cast<ULONG>(output_size), &cbData, 0);
+    if (success < 0)
+        return static_cast<ntstatus_t>(success);
 
-    //Return the status
-    return static_cast<ntstatus_t>(success);
+    //Assign the result
+    *output_len = cbData;
+
+    return ntstatus_t::SUCCESS;
 }
+
+#endif
@@ -9,11 +9,26 @@
 #include <cstddef>
 #include <memory>
 
+/*
+ * The backend is picked at build time. Windows uses BCrypt unless
+ * PM_CRYPTO_PORTABLE is defined, everything else uses the portable
+ * backend built on the in-tree primitives. Both produce the same
+ * output.
+ */
+#if defined(_WIN32) && !defined(PM_CRYPTO_PORTABLE)
+#   define PM_CRYPTO_BCRYPT 1
+#endif
+
 namespace pm
 {
     using owned_byte_array = std::unique_ptr<std::uint8_t[]>;
 
-    //Fills a buffer with random bytes using a CSPRNG
+    /*
+     * Fills a buffer with random bytes from a ChaCha20 generator kept
+     * per thread, which is seeded from the system and reseeded now
+     * and then and after fork. Small requests come out of a buffer
+     * without a system call.
+     */
     [[nodiscard]] std::error_code get_random_bytes(std::uint8_t* buffer, std::size_t len) noexcept;
 
     //Fills a buffer with random bytes using a CSPRNG
@@ -23,14 +38,29 @@ namespace pm
         return get_random_bytes(buffer, N);
     }
 
+    //Fills a buffer with random bytes straight from the system generator, which seeds get_random_bytes
+    [[nodiscard]] std::error_code get_system_random_bytes(std::uint8_t* buffer, std::size_t len) noexcept;
+
     //Calculates the SHA-256 hash of the input data
     [[nodiscard]] std::error_code hash(span<std::uint8_t> data, owned_byte_array* result) noexcept;
 
-    //Encrypts the input with AES-128 using the provided password and initialization vector
-    [[nodiscard]] std::error_code encrypt(span<std::uint8_t> input, span<std::uint8_t> password, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept;
+    /*
+     * The ciphers are not padded: the input must be a whole number
+     * of 16 byte blocks, and the output is as long as the input.
+     * The output buffer may be the input buffer itself.
+     */
+
+    //Encrypts the input with AES-256 using the provided 32 byte key and initialization vector
+    [[nodiscard]] std::error_code encrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept;
+
+    //Encrypts the input with AES-256 into a buffer provided by the caller
+    [[nodiscard]] std::error_code encrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept;
+
+    //Decrypts the input with AES-256 using the provided 32 byte key and initialization vector
+    [[nodiscard]] std::error_code decrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept;
 
-    //Decrypts the input with AES-128 using the provided password and initialization vector
-    [[nodiscard]] std::error_code decrypt(span<std::uint8_t> input, span<std::uint8_t> password, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept;
+    //Decrypts the input with AES-256 into a buffer provided by the caller
+    [[nodiscard]] std::error_code decrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept;
 };
 
 #endif
@@ -0,0 +1,380 @@
+#include "aes.h"
+#include "chacha20.h"
+#include "cpu_features.h"
+#include "crypto.h"
+#include "poly1305.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(PM_ARCH_X86)
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <x86intrin.h>
+#   endif
+#endif
+
+/*
+ * Measures the crypto API and SHA-256 across message sizes from
+ * 16 bytes to 1 GB, and reports the time per call, the throughput
+ * and the cycles per byte.
+ *
+ * Every case is warmed up while the number of calls per repetition
+ * is calibrated, then timed over a number of repetitions. The table
+ * shows the median, and the JSON report written with --json keeps
+ * the minimum, median, mean and standard deviation so releases can
+ * be compared.
+ *
+ * Usage: crypto_benchmark [--json FILE] [--max-size BYTES] [--repetitions N]
+ */
+
+using clock_type = std::chrono::steady_clock;
+
+//Each repetition lasts at least this long so the timer resolution does not matter
+static constexpr std::chrono::milliseconds const min_repetition_time{ 20 };
+
+//The smallest and largest message, stepping by a factor of four
+static constexpr std::size_t const min_size = 16;
+static constexpr std::size_t const max_size = std::size_t{ 1 } << 30;
+
+//Keeps the results alive so the work is not optimized away
+static std::uint8_t volatile sink;
+
+/*
+ * The time stamp counter ticks at a fixed rate close to the nominal
+ * clock, so cycles per byte are reference cycles. Other processors
+ * have no counter that is readable everywhere, and report none.
+ */
+#if defined(PM_ARCH_X86)
+static constexpr bool const has_cycle_counter = true;
+
+static std::uint64_t read_cycle_counter() noexcept
+{
+    return __rdtsc();
+}
+#else
+static constexpr bool const has_cycle_counter = false;
+
+static std::uint64_t read_cycle_counter() noexcept
+{
+    return 0;
+}
+#endif
+
+struct sample
+{
+    double ns_per_call;
+    double cycles_per_call;
+};
+
+struct summary
+{
+    double min;
+    double median;
+    double mean;
+    double stddev;
+};
+
+struct result
+{
+    char const* name;
+    std::size_t size;
+    std::size_t calls_per_repetition;
+    summary     ns_per_call;
+    double      cycles_per_call;
+};
+
+/*
+ * Calls the function a number of times and measures one sample.
+ * Returns false if any call failed.
+ */
+template<typename F>
+static bool run_calls(F& f, std::uint64_t calls, sample* s) noexcept
+{
+    auto const start_cycles = read_cycle_counter();
+    auto const start        = clock_type::now();
+
+    for (std::uint64_t i = 0; i < calls; i++)
+    {
+        if (!f()) return false;
+    }
+
+    auto const end        = clock_type::now();
+    auto const end_cycles = read_cycle_counter();
+
+    s->ns_per_call     = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(calls);
+    s->cycles_per_call = static_cast<double>(end_cycles - start_cycles) / static_cast<double>(calls);
+
+    return true;
+}
+
+static summary summarize(std::vector<double> values) noexcept
+{
+    std::sort(values.begin(), values.end());
+
+    summary s{};
+    auto const n = values.size();
+
+    s.min    = values.front();
+    s.median = (n % 2 == 1) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+
+    for (auto const v : values) s.mean += v;
+    s.mean /= static_cast<double>(n);
+
+    for (auto const v : values) s.stddev += (v - s.mean) * (v - s.mean);
+    s.stddev = (n > 1) ? std::sqrt(s.stddev / static_cast<double>(n - 1)) : 0;
+
+    return s;
+}
+
+/*
+ * Warms the function up while doubling the calls until a repetition
+ * takes long enough, then measures the repetitions. Returns false
+ * if any call failed.
+ */
+template<typename F>
+static bool measure(char const* name, std::size_t size, std::size_t repetitions, F&& f, result* r)
+{
+    sample        s;
+    std::uint64_t calls = 1;
+
+    for (;;)
+    {
+        if (!run_calls(f, calls, &s)) return false;
+
+        if (s.ns_per_call * static_cast<double>(calls) >= std::chrono::duration<double, std::nano>(min_repetition_time).count()) break;
+
+        calls *= 2;
+    }
+
+    std::vector<double> times;
+    std::vector<double> cycles;
+
+    for (std::size_t i = 0; i < repetitions; i++)
+    {
+        if (!run_calls(f, calls, &s)) return false;
+
+        times .push_back(s.ns_per_call);
+        cycles.push_back(s.cycles_per_call);
+    }
+
+    r->name                 = name;
+    r->size                 = size;
+    r->calls_per_repetition = static_cast<std::size_t>(calls);
+    r->ns_per_call          = summarize(times);
+    r->cycles_per_call      = summarize(cycles).median;
+
+    return true;
+}
+
+static double megabytes_per_second(result const& r) noexcept
+{
+    return static_cast<double>(r.size) / r.ns_per_call.median * 1e3;
+}
+
+static void print_result(result const& r) noexcept
+{
+    std::printf("%-22s %12zu %16.1f %12.1f", r.name, r.size, r.ns_per_call.median, megabytes_per_second(r));
+
+    if (has_cycle_counter)
+        std::printf(" %12.2f\n", r.cycles_per_call / static_cast<double>(r.size));
+    else
+        std::printf(" %12s\n", "-");
+}
+
+static bool write_json(char const* path, std::vector<result> const& results, std::size_t repetitions) noexcept
+{
+    auto* const file = std::fopen(path, "w");
+    if (!file) return false;
+
+    auto const& cpu = pm::cpu::get_features();
+
+    std::fprintf(file, "{\n");
+    std::fprintf(file, "  \"context\": {\n");
+    std::fprintf(file, "    \"repetitions\": %zu,\n", repetitions);
+    std::fprintf(file, "    \"min_repetition_ns\": %lld,\n", static_cast<long long>(std::chrono::nanoseconds(min_repetition_time).count()));
+    std::fprintf(file, "    \"cycle_counter\": %s,\n", has_cycle_counter ? "\"tsc\"" : "null");
+    std::fprintf(file, "    \"cpu\": { \"sse2\": %s, \"sse41\": %s, \"avx2\": %s, \"avx512f\": %s, \"sha\": %s, \"aesni\": %s, \"sha2\": %s, \"aes\": %s }\n",
+        cpu.sse2    ? "true" : "false",
+        cpu.sse41   ? "true" : "false",
+        cpu.avx2    ? "true" : "false",
+        cpu.avx512f ? "true" : "false",
+        cpu.sha     ? "true" : "false",
+        cpu.aesni   ? "true" : "false",
+        cpu.sha2    ? "true" : "false",
+        cpu.aes     ? "true" : "false");
+    std::fprintf(file, "  },\n");
+    std::fprintf(file, "  \"benchmarks\": [\n");
+
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        auto const& r = results[i];
+
+        std::fprintf(file, "    {\n");
+        std::fprintf(file, "      \"name\": \"%s\",\n", r.name);
+        std::fprintf(file, "      \"bytes\": %zu,\n", r.size);
+        std::fprintf(file, "      \"calls_per_repetition\": %zu,\n", r.calls_per_repetition);
+        std::fprintf(file, "      \"ns_per_op\": { \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f },\n",
+            r.ns_per_call.min, r.ns_per_call.median, r.ns_per_call.mean, r.ns_per_call.stddev);
+        std::fprintf(file, "      \"mb_per_s\": %.3f,\n", megabytes_per_second(r));
+
+        if (has_cycle_counter)
+            std::fprintf(file, "      \"cycles_per_byte\": %.4f\n", r.cycles_per_call / static_cast<double>(r.size));
+        else
+            std::fprintf(file, "      \"cycles_per_byte\": null\n");
+
+        std::fprintf(file, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+
+    std::fprintf(file, "  ]\n");
+    std::fprintf(file, "}\n");
+
+    return std::fclose(file) == 0;
+}
+
+static void print_usage() noexcept
+{
+    std::printf("Usage: crypto_benchmark [--json FILE] [--max-size BYTES] [--repetitions N]\n");
+}
+
+int main(int argc, char** argv)
+{
+    using pm::security::aes256;
+    using pm::security::chacha20;
+    using pm::security::poly1305;
+    using pm::security::sha256;
+
+    char const* json_path   = nullptr;
+    std::size_t largest     = max_size;
+    std::size_t repetitions = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto const has_value = (i + 1 < argc);
+
+        if (std::strcmp(argv[i], "--json") == 0 && has_value)
+            json_path = argv[++i];
+        else if (std::strcmp(argv[i], "--max-size") == 0 && has_value)
+            largest = std::min<std::size_t>(std::strtoull(argv[++i], nullptr, 10), max_size);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && has_value)
+            repetitions = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (!sha256::self_test() || !aes256::self_test() || !chacha20::self_test() || !poly1305::self_test())
+    {
+        std::printf("Self-test failed!\n");
+        return 1;
+    }
+
+    std::vector<std::size_t> sizes;
+    for (auto size = min_size; size <= largest; size *= 4) sizes.push_back(size);
+
+    if (sizes.empty())
+    {
+        print_usage();
+        return 1;
+    }
+
+    //One buffer serves every case, any content will do
+    std::vector<std::uint8_t> buffer(sizes.back());
+    for (std::size_t i = 0; i < buffer.size(); i++) buffer[i] = static_cast<std::uint8_t>(i * 131);
+
+    std::uint8_t key[32];
+    std::uint8_t iv [16];
+    for (std::size_t i = 0; i < sizeof(key); i++) key[i] = static_cast<std::uint8_t>(i);
+    for (std::size_t i = 0; i < sizeof(iv);  i++) iv [i] = static_cast<std::uint8_t>(i * 7);
+
+    std::vector<result> results;
+
+    std::printf("%-22s %12s %16s %12s %12s\n", "operation", "bytes", "ns/op", "MB/s", "cycles/byte");
+
+    for (auto const size : sizes)
+    {
+        auto* const data = buffer.data();
+        auto const  in   = pm::span<std::uint8_t>(data, static_cast<std::ptrdiff_t>(size));
+
+        std::array<std::uint8_t, sha256::digest_length> digest;
+        pm::owned_byte_array                            owned;
+        std::size_t                                     length;
+
+        auto const compute_hash = [&]() noexcept
+        {
+            sha256::compute_hash(data, size, digest);
+            sink = digest[0];
+            return true;
+        };
+
+        auto const hash = [&]() noexcept
+        {
+            if (pm::hash(in, &owned)) return false;
+            sink = owned[0];
+            return true;
+        };
+
+        //The ciphers work in place, so the buffer is scrambled as it goes
+        auto const encrypt = [&]() noexcept
+        {
+            if (pm::encrypt(in, key, iv, data, size, &length)) return false;
+            sink = data[0];
+            return true;
+        };
+
+        auto const decrypt = [&]() noexcept
+        {
+            if (pm::decrypt(in, key, iv, data, size, &length)) return false;
+            sink = data[0];
+            return true;
+        };
+
+        auto const random = [&]() noexcept
+        {
+            if (pm::get_random_bytes(data, size)) return false;
+            sink = data[0];
+            return true;
+        };
+
+        result r;
+        auto const run = [&](char const* name, auto&& f)
+        {
+            if (!measure(name, size, repetitions, f, &r))
+            {
+                std::printf("%s failed at %zu bytes!\n", name, size);
+                return false;
+            }
+
+            print_result(r);
+            results.push_back(r);
+            return true;
+        };
+
+        if (!run("sha256::compute_hash", compute_hash)) return 1;
+        if (!run("hash",                 hash))         return 1;
+        if (!run("encrypt",              encrypt))      return 1;
+        if (!run("decrypt",              decrypt))      return 1;
+        if (!run("get_random_bytes",     random))       return 1;
+    }
+
+    if (json_path && !write_json(json_path, results, repetitions))
+    {
+        std::printf("Could not write %s!\n", json_path);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include "crypto.h"
+
+#if !defined(PM_CRYPTO_BCRYPT)
+
+#include "aes.h"
+#include "crypto_session.h"
+#include "secure_memory.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#   include <bcrypt.h>
+#   pragma comment(lib, "bcrypt.lib")
+#elif defined(__linux__)
+#   include <sys/random.h>
+#else
+#   include <unistd.h>
+#endif
+
+/*
+ * Implements the crypto API with the in-tree primitives, for the
+ * systems without BCrypt. The output is the same as BCrypt's:
+ * AES-256 in CBC mode without padding, and SHA-256.
+ */
+
+using pm::security::aes256;
+
+std::error_code pm::get_system_random_bytes(std::uint8_t* buffer, std::size_t len) noexcept
+{
+#if defined(_WIN32)
+    //Portable builds on Windows still need the system generator
+    auto const success = BCryptGenRandom(nullptr, static_cast<PUCHAR>(buffer), static_cast<ULONG>(len), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+
+    return static_cast<ntstatus_t>(success);
+#elif defined(__linux__)
+    //Large requests may be cut short, and any request may be interrupted
+    while (len > 0)
+    {
+        auto const result = getrandom(buffer, len, 0);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+
+            return ntstatus_t::UNSUCCESSFUL;
+        }
+
+        buffer += result;
+        len    -= static_cast<std::size_t>(result);
+    }
+
+    return ntstatus_t::SUCCESS;
+#else
+    //getentropy hands out at most 256 bytes at a time
+    while (len > 0)
+    {
+        auto const chunk = std::min<std::size_t>(len, 256);
+        if (getentropy(buffer, chunk) != 0) return ntstatus_t::UNSUCCESSFUL;
+
+        buffer += chunk;
+        len    -= chunk;
+    }
+
+    return ntstatus_t::SUCCESS;
+#endif
+}
+
+std::error_code pm::hash(span<std::uint8_t> data, owned_byte_array* result) noexcept
+{
+    std::array<std::uint8_t, security::sha256::digest_length> digest;
+    security::sha256::compute_hash(data.data(), static_cast<std::uint64_t>(data.size()), digest);
+
+    //Assign the result
+    *result = std::make_unique<std::uint8_t[]>(digest.size());
+    std::copy(digest.begin(), digest.end(), result->get());
+
+    return ntstatus_t::SUCCESS;
+}
+
+/*
+ * Checks the arguments the same way for both directions. BCrypt
+ * refuses anything that is not a whole number of blocks when it
+ * is not asked to pad.
+ */
+static std::error_code check_arguments(pm::span<std::uint8_t> input, std::size_t output_size) noexcept
+{
+    if (input.size() % static_cast<std::ptrdiff_t>(aes256::block_length) != 0) return pm::ntstatus_t::INVALID_BUFFER_SIZE;
+
+    if (output_size < static_cast<std::size_t>(input.size())) return pm::ntstatus_t::BUFFER_TOO_SMALL;
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+/*
+ * Runs the cipher in either direction with an expanded key. The
+ * output may be the input itself, and the IV is left holding the
+ * chaining value for the blocks that follow.
+ */
+static std::error_code run_cbc(aes256::key_schedule const& schedule, bool decrypt, pm::span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    auto err = check_arguments(input, output_size);
+    if (err) return err;
+
+    auto const length = static_cast<std::size_t>(input.size());
+
+    if (decrypt)
+        aes256::decrypt_cbc(schedule, iv, input.data(), output, length / aes256::block_length);
+    else
+        aes256::encrypt_cbc(schedule, iv, input.data(), output, length / aes256::block_length);
+
+    *output_len = length;
+
+    return pm::ntstatus_t::SUCCESS;
+}
+
+/*
+ * Runs the cipher with a key and IV provided by the caller. The
+ * key is expanded on the stack and wiped before returning, and
+ * the caller's IV is left alone.
+ */
+static std::error_code run_cbc(pm::span<std::uint8_t> key, bool decrypt, pm::span<std::uint8_t> input, pm::span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    if (key.size() != static_cast<std::ptrdiff_t>(aes256::key_length))  return pm::ntstatus_t::INVALID_PARAMETER;
+    if (iv.size()  <  static_cast<std::ptrdiff_t>(aes256::block_length)) return pm::ntstatus_t::INVALID_PARAMETER;
+
+    //Expand the key
+    aes256::key_schedule schedule;
+    aes256::expand_key(key.data(), &schedule);
+
+    std::uint8_t chain[aes256::block_length];
+    std::memcpy(chain, iv.data(), sizeof(chain));
+
+    auto err = run_cbc(schedule, decrypt, input, chain, output, output_size, output_len);
+
+    pm::secure_wipe(&schedule, sizeof(schedule));
+
+    return err;
+}
+
+std::error_code pm::encrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    return run_cbc(key, false, input, iv, output, output_size, output_len);
+}
+
+std::error_code pm::encrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept
+{
+    //The cipher is not padded, the result is as long as the input
+    auto result  = std::make_unique<std::uint8_t[]>(static_cast<std::size_t>(input.size()));
+    auto success = run_cbc(key, false, input, iv, result.get(), static_cast<std::size_t>(input.size()), output_len);
+    if (success) return success;
+
+    //Assign the result
+    *output = std::move(result);
+
+    return success;
+}
+
+std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    return run_cbc(key, true, input, iv, output, output_size, output_len);
+}
+
+std::error_code pm::decrypt(span<std::uint8_t> input, span<std::uint8_t> key, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) noexcept
+{
+    //The cipher is not padded, the result is as long as the input
+    auto result  = std::make_unique<std::uint8_t[]>(static_cast<std::size_t>(input.size()));
+    auto success = run_cbc(key, true, input, iv, result.get(), static_cast<std::size_t>(input.size()), output_len);
+    if (success) return success;
+
+    //Assign the result
+    *output = std::move(result);
+
+    return success;
+}
+
+struct pm::crypto_session::backend
+{
+    aes256::key_schedule schedule;
+};
+
+std::error_code pm::crypto_session::open(derived_key const& key) noexcept
+{
+    this->close();
+
+    auto* state = new (std::nothrow) backend;
+    if (state == nullptr) return ntstatus_t::NO_MEMORY;
+
+    //Expand the key once for the whole session
+    aes256::expand_key(key.data(), &state->schedule);
+
+    this->state = state;
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::crypto_session::close() noexcept
+{
+    if (this->state == nullptr) return;
+
+    secure_wipe(&this->state->schedule, sizeof(this->state->schedule));
+
+    delete this->state;
+    this->state = nullptr;
+}
+
+std::error_code pm::crypto_session::encrypt_chained(span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept
+{
+    if (this->state == nullptr) return ntstatus_t::INVALID_HANDLE;
+
+    return run_cbc(this->state->schedule, false, input, iv, output, output_size, output_len);
+}
+
+std::error_code pm::crypto_session::decrypt_chained(span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept
+{
+    if (this->state == nullptr) return ntstatus_t::INVALID_HANDLE;
+
+    return run_cbc(this->state->schedule, true, input, iv, output, output_size, output_len);
+}
+
+#endif
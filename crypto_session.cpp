@@ -0,0 +1,97 @@
+#include "crypto_session.h"
+#include "secure_memory.h"
+
+#include <cstring>
+#include <utility>
+
+/*
+ * Opening, closing, and the chained encryption and decryption are
+ * defined by the crypto backend, next to the rest of its code.
+ */
+
+pm::crypto_session::crypto_session(crypto_session&& other) noexcept
+    : state{ std::exchange(other.state, nullptr) }
+{}
+
+pm::crypto_session& pm::crypto_session::operator = (crypto_session&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->close();
+
+        this->state = std::exchange(other.state, nullptr);
+    }
+
+    return *this;
+}
+
+pm::crypto_session::~crypto_session()
+{
+    this->close();
+}
+
+std::error_code pm::crypto_session::open(span<std::uint8_t> password, kdf_params const& params) noexcept
+{
+    //Derive the key
+    auto key     = derived_key{};
+    auto success = derive_key(password, params, &key);
+
+    //Expand it
+    if (!success)
+        success = this->open(key);
+
+    //The session keeps its own copy
+    secure_wipe(key.data(), key.size());
+
+    return success;
+}
+
+std::error_code pm::crypto_session::encrypt(span<std::uint8_t> input, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept
+{
+    //Check that the provided IV is long enough
+    if (iv.size() < static_cast<std::ptrdiff_t>(iv_length)) return ntstatus_t::INVALID_PARAMETER;
+
+    //The caller's IV is left alone
+    std::uint8_t chain[iv_length];
+    std::memcpy(chain, iv.data(), iv_length);
+
+    return this->encrypt_chained(input, chain, output, output_size, output_len);
+}
+
+std::error_code pm::crypto_session::decrypt(span<std::uint8_t> input, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept
+{
+    //Check that the provided IV is long enough
+    if (iv.size() < static_cast<std::ptrdiff_t>(iv_length)) return ntstatus_t::INVALID_PARAMETER;
+
+    //The caller's IV is left alone
+    std::uint8_t chain[iv_length];
+    std::memcpy(chain, iv.data(), iv_length);
+
+    return this->decrypt_chained(input, chain, output, output_size, output_len);
+}
+
+std::error_code pm::crypto_session::encrypt(span<std::uint8_t> input, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) const noexcept
+{
+    //The cipher is not padded, the result is as long as the input
+    auto result  = std::make_unique<std::uint8_t[]>(static_cast<std::size_t>(input.size()));
+    auto success = this->encrypt(input, iv, result.get(), static_cast<std::size_t>(input.size()), output_len);
+    if (success) return success;
+
+    //Assign the result
+    *output = std::move(result);
+
+    return success;
+}
+
+std::error_code pm::crypto_session::decrypt(span<std::uint8_t> input, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) const noexcept
+{
+    //The cipher is not padded, the result is as long as the input
+    auto result  = std::make_unique<std::uint8_t[]>(static_cast<std::size_t>(input.size()));
+    auto success = this->decrypt(input, iv, result.get(), static_cast<std::size_t>(input.size()), output_len);
+    if (success) return success;
+
+    //Assign the result
+    *output = std::move(result);
+
+    return success;
+}
@@ -0,0 +1,88 @@
+#ifndef PM_CRYPTO_SESSION_H
+#define PM_CRYPTO_SESSION_H
+#pragma once
+
+#include "crypto.h"
+#include "kdf.h"
+#include "span.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * The key of an unlocked archive, ready to use. The key is
+ * derived and expanded once when the session is opened, and
+ * whatever the backend needs to use it is kept until the
+ * session is closed, so encrypting and decrypting cost only
+ * the cipher work. The key is wiped when the session closes.
+ *
+ * A session may be used by one thread at a time.
+ */
+
+namespace pm
+{
+    struct crypto_session
+    {
+    public:
+        //The length of the initialization vector, one cipher block
+        static constexpr std::size_t iv_length = 16;
+
+        crypto_session() noexcept = default;
+
+        crypto_session(crypto_session&& other) noexcept;
+        crypto_session& operator = (crypto_session&& other) noexcept;
+
+        crypto_session(crypto_session const&) = delete;
+        crypto_session& operator = (crypto_session const&) = delete;
+
+        ~crypto_session();
+
+        //Derives the key from the password and opens the session with it
+        [[nodiscard]] std::error_code open(span<std::uint8_t> password, kdf_params const& params) noexcept;
+
+        //Opens the session with a key that has already been derived
+        [[nodiscard]] std::error_code open(derived_key const& key) noexcept;
+
+        //Wipes the key and releases everything the session holds
+        void close() noexcept;
+
+        bool is_open() const noexcept
+        {
+            return this->state != nullptr;
+        }
+
+        //Encrypts the input with the session key and the provided initialization vector
+        [[nodiscard]] std::error_code encrypt(span<std::uint8_t> input, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) const noexcept;
+
+        //Encrypts the input into a buffer provided by the caller, which may be the input itself
+        [[nodiscard]] std::error_code encrypt(span<std::uint8_t> input, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept;
+
+        //Decrypts the input with the session key and the provided initialization vector
+        [[nodiscard]] std::error_code decrypt(span<std::uint8_t> input, span<std::uint8_t> iv, owned_byte_array* output, std::size_t* output_len) const noexcept;
+
+        //Decrypts the input into a buffer provided by the caller, which may be the input itself
+        [[nodiscard]] std::error_code decrypt(span<std::uint8_t> input, span<std::uint8_t> iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept;
+
+        /*
+         * Encrypts the input like the overloads above, but updates
+         * the iv_length bytes of the IV to chain into the input that
+         * follows, so a long message can be encrypted in pieces.
+         */
+        [[nodiscard]] std::error_code encrypt_chained(span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept;
+
+        /*
+         * Decrypts the input like the overloads above, but updates
+         * the iv_length bytes of the IV to chain into the input that
+         * follows, so a long message can be decrypted in pieces.
+         */
+        [[nodiscard]] std::error_code decrypt_chained(span<std::uint8_t> input, std::uint8_t* iv, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) const noexcept;
+
+    private:
+        //Defined by the crypto backend
+        struct backend;
+
+        backend* state = nullptr;
+    };
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include "crypto_stream.h"
+#include "secure_memory.h"
+
+#include <cstring>
+
+pm::cipher_stream::~cipher_stream()
+{
+    secure_wipe(this->chain, sizeof(this->chain));
+}
+
+std::error_code pm::cipher_stream::init(span<std::uint8_t> iv) noexcept
+{
+    //Check that the provided IV is long enough
+    if (iv.size() < static_cast<std::ptrdiff_t>(sizeof(this->chain))) return ntstatus_t::INVALID_PARAMETER;
+
+    //The chaining value starts out as the IV
+    std::memcpy(this->chain, iv.data(), sizeof(this->chain));
+    this->started = true;
+
+    return ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::cipher_stream::update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    //Check that a message has been started
+    if (!this->started) return ntstatus_t::INVALID_HANDLE;
+
+    //The session carries the chaining value over to the next chunk
+    if (this->dir == direction::ENCRYPT)
+        return this->session->encrypt_chained(input, this->chain, output, output_size, output_len);
+    else
+        return this->session->decrypt_chained(input, this->chain, output, output_size, output_len);
+}
+
+std::error_code pm::cipher_stream::finish() noexcept
+{
+    //Check that a message has been started
+    if (!this->started) return ntstatus_t::INVALID_HANDLE;
+
+    //Nothing is buffered, so all that is left is to forget the chain
+    secure_wipe(this->chain, sizeof(this->chain));
+    this->started = false;
+
+    return ntstatus_t::SUCCESS;
+}
@@ -0,0 +1,60 @@
+#ifndef PM_CRYPTO_STREAM_H
+#define PM_CRYPTO_STREAM_H
+#pragma once
+
+#include "crypto_session.h"
+#include "span.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Encrypts or decrypts a message too large to hold in memory at
+ * once, a chunk at a time, with the key of an open session. The
+ * chunks are chained together, so the result is the same as if
+ * the whole message had gone through the session in one call.
+ *
+ * A message is started with init, fed through update any number
+ * of times, and ended with finish. The cipher is not padded, so
+ * every chunk must be a whole number of blocks.
+ */
+
+namespace pm
+{
+    struct cipher_stream
+    {
+    public:
+        enum class direction : std::uint8_t
+        {
+            ENCRYPT,
+            DECRYPT,
+        };
+
+        //The session must stay open for as long as the stream is used
+        cipher_stream(crypto_session const& session, direction dir) noexcept
+            : session{ &session }, dir{ dir }
+        {}
+
+        cipher_stream(cipher_stream const&) = delete;
+        cipher_stream& operator = (cipher_stream const&) = delete;
+
+        ~cipher_stream();
+
+        //Starts a new message with the provided initialization vector
+        [[nodiscard]] std::error_code init(span<std::uint8_t> iv) noexcept;
+
+        //Processes the next chunk of the message into the output, which may be the chunk itself
+        [[nodiscard]] std::error_code update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept;
+
+        //Ends the message
+        [[nodiscard]] std::error_code finish() noexcept;
+
+    private:
+        crypto_session const* session;
+        direction             dir;
+        bool                  started = false;
+        std::uint8_t          chain[crypto_session::iv_length]{};
+    };
+};
+
+#endif
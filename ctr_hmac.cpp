@@ -0,0 +1,200 @@
+#include "ctr_hmac.h"
+#include "secure_memory.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+using pm::security::aes256;
+using pm::security::hmac_sha256;
+
+//The segments handed to the thread pool at once, which bounds the MACs kept on the stack
+static constexpr std::size_t max_parallel_segments = 64;
+
+//The labels the two keys are derived with
+static constexpr char const encryption_label[]     = "BHPM CTR-HMAC encryption key";
+static constexpr char const authentication_label[] = "BHPM CTR-HMAC authentication key";
+
+static void store_u64_big_endian(std::uint8_t* p, std::uint64_t x) noexcept
+{
+    for (std::size_t i = 0; i < 8; i++) p[i] = static_cast<std::uint8_t>(x >> (56 - 8 * i));
+}
+
+pm::ctr_hmac_stream::~ctr_hmac_stream()
+{
+    this->wipe();
+}
+
+std::error_code pm::ctr_hmac_stream::init(derived_key const& key, span<std::uint8_t> nonce, span<std::uint8_t> associated_data) noexcept
+{
+    //Check that the provided nonce is long enough
+    if (nonce.size() < static_cast<std::ptrdiff_t>(nonce_length)) return ntstatus_t::INVALID_PARAMETER;
+
+    //Derive a key for each job, so neither says anything about the other
+    auto encryption_key     = hmac_sha256::compute_mac(key.data(), key.size(), encryption_label,     sizeof(encryption_label) - 1);
+    auto authentication_key = hmac_sha256::compute_mac(key.data(), key.size(), authentication_label, sizeof(authentication_label) - 1);
+
+    aes256::expand_key(encryption_key.data(), &this->schedule);
+    this->segment_mac.set_key(authentication_key.data(), authentication_key.size());
+    this->message_mac.set_key(authentication_key.data(), authentication_key.size());
+
+    secure_wipe(encryption_key.data(),     encryption_key.size());
+    secure_wipe(authentication_key.data(), authentication_key.size());
+
+    std::memcpy(this->nonce, nonce.data(), nonce_length);
+    this->segment_index = 0;
+    this->total_length  = 0;
+    this->ended         = false;
+    this->started       = true;
+
+    //The tag of the message starts with the associated data
+    std::uint8_t length[8];
+    store_u64_big_endian(length, static_cast<std::uint64_t>(associated_data.size()));
+    this->message_mac.init();
+    this->message_mac.update(length, sizeof(length));
+    this->message_mac.update(associated_data.data(), static_cast<std::size_t>(associated_data.size()));
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::ctr_hmac_stream::process_segment(std::uint64_t index, std::uint8_t const* input, std::uint8_t* output, std::size_t length, hmac_sha256::digest& mac) const noexcept
+{
+    //Each segment starts its own stretch of the counter
+    std::uint8_t counter[nonce_length];
+    std::memcpy(counter, this->nonce, nonce_length);
+    aes256::add_to_counter(counter, index * (segment_length / aes256::block_length));
+
+    std::uint8_t position[8];
+    store_u64_big_endian(position, index);
+
+    auto context = this->segment_mac;
+    context.init();
+    context.update(this->nonce, nonce_length);
+    context.update(position, sizeof(position));
+
+    //Decrypt in the output, so input that can change underneath is read once and what is checked is what is decrypted
+    if ((this->dir == direction::DECRYPT) && (output != input))
+    {
+        std::memcpy(output, input, length);
+        input = output;
+    }
+
+    //The MAC always covers the cipher text, which is the input unless encrypting
+    if (this->dir != direction::ENCRYPT) context.update(input, length);
+
+    if (this->dir != direction::AUTHENTICATE) aes256::crypt_ctr(this->schedule, counter, input, output, length);
+
+    if (this->dir == direction::ENCRYPT) context.update(output, length);
+
+    context.finish(mac);
+
+    secure_wipe(&context, sizeof(context));
+}
+
+std::error_code pm::ctr_hmac_stream::update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept
+{
+    return this->update(input, output, output_size, output_len, nullptr);
+}
+
+std::error_code pm::ctr_hmac_stream::update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len, std::uint8_t* segment_tags) noexcept
+{
+    //Check that a message has been started
+    if (!this->started) return ntstatus_t::INVALID_HANDLE;
+
+    //Authenticating writes nothing, so it needs no output
+    auto const length  = static_cast<std::size_t>(input.size());
+    auto const writing = (this->dir != direction::AUTHENTICATE);
+    if (writing && (output_size < length)) return ntstatus_t::BUFFER_TOO_SMALL;
+
+    //Only the last piece may end partway through a segment
+    if (this->ended && (length > 0)) return ntstatus_t::INVALID_PARAMETER;
+    if (length % segment_length != 0) this->ended = true;
+
+    auto const segment_count = (length + segment_length - 1) / segment_length;
+    auto&      pool          = thread_pool::get_shared();
+
+    for (std::size_t first = 0; first < segment_count; first += max_parallel_segments)
+    {
+        auto const count = std::min(segment_count - first, max_parallel_segments);
+
+        std::array<hmac_sha256::digest, max_parallel_segments> macs;
+
+        auto const task = [&](std::size_t k) noexcept
+        {
+            auto const offset = (first + k) * segment_length;
+            auto const size   = std::min(segment_length, length - offset);
+
+            this->process_segment(this->segment_index + k, input.data() + offset, writing ? output + offset : nullptr, size, macs[k]);
+        };
+
+        //A single segment is not worth waking the workers for
+        if (count == 1)
+            task(0);
+        else
+            pool.parallel_for(count, task);
+
+        //The MACs of the segments go into the tag in order
+        for (std::size_t k = 0; k < count; k++) this->message_mac.update(macs[k].data(), macs[k].size());
+
+        for (std::size_t k = 0; segment_tags && (k < count); k++) std::memcpy(segment_tags + (first + k) * segment_tag_length, macs[k].data(), segment_tag_length);
+
+        this->segment_index += count;
+    }
+
+    this->total_length += length;
+    *output_len = writing ? length : 0;
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::ctr_hmac_stream::finish_tag(hmac_sha256::digest& tag) noexcept
+{
+    //The tag ends with the length, so the message cannot be cut short at a segment boundary
+    std::uint8_t length[8];
+    store_u64_big_endian(length, this->total_length);
+    this->message_mac.update(length, sizeof(length));
+    this->message_mac.finish(tag);
+
+    this->wipe();
+}
+
+std::error_code pm::ctr_hmac_stream::finish(std::uint8_t* tag, std::size_t tag_size) noexcept
+{
+    //Check that a message is being encrypted
+    if (!this->started)                  return ntstatus_t::INVALID_HANDLE;
+    if (this->dir != direction::ENCRYPT) return ntstatus_t::INVALID_PARAMETER;
+    if (tag_size < tag_length)           return ntstatus_t::BUFFER_TOO_SMALL;
+
+    auto computed = hmac_sha256::digest{};
+    this->finish_tag(computed);
+
+    std::memcpy(tag, computed.data(), tag_length);
+
+    return ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::ctr_hmac_stream::verify(span<std::uint8_t> tag) noexcept
+{
+    //Check that a message is being decrypted or authenticated
+    if (!this->started)                                        return ntstatus_t::INVALID_HANDLE;
+    if (this->dir == direction::ENCRYPT)                       return ntstatus_t::INVALID_PARAMETER;
+    if (tag.size() != static_cast<std::ptrdiff_t>(tag_length)) return ntstatus_t::INVALID_PARAMETER;
+
+    auto computed = hmac_sha256::digest{};
+    this->finish_tag(computed);
+
+    if (!secure_equal(computed.data(), tag.data(), tag_length)) return ntstatus_t::AUTH_TAG_MISMATCH;
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::ctr_hmac_stream::wipe() noexcept
+{
+    secure_wipe(&this->schedule,    sizeof(this->schedule));
+    secure_wipe(&this->segment_mac, sizeof(this->segment_mac));
+    secure_wipe(&this->message_mac, sizeof(this->message_mac));
+    secure_wipe(this->nonce,        sizeof(this->nonce));
+
+    this->started = false;
+}
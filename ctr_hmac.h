@@ -0,0 +1,107 @@
+#ifndef PM_CTR_HMAC_H
+#define PM_CTR_HMAC_H
+#pragma once
+
+#include "aes.h"
+#include "hmac.h"
+#include "kdf.h"
+#include "ntstatus.h"
+#include "span.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Encrypts and authenticates a message with AES-256 in CTR mode
+ * and HMAC-SHA-256, encrypt-then-MAC. Separate keys for the two
+ * are derived from the archive key.
+ *
+ * The message is cut into segments of segment_length bytes. Each
+ * segment starts at its own point of the counter and has its own
+ * MAC over the nonce, its index and its cipher text, so segments
+ * do not depend on each other and are spread across the shared
+ * thread pool. The tag of the message is the MAC of the associated
+ * data, the MACs of the segments in order, and the total length,
+ * so segments cannot be dropped, reordered or cut short.
+ *
+ * A message is started with init, fed through update any number of
+ * times, and ended with finish when encrypting or verify when
+ * decrypting. Every piece but the last must be a whole number of
+ * segments. Decrypted data must not be trusted until verify has
+ * succeeded.
+ *
+ * A stream that authenticates only checks the tag of the cipher
+ * text and writes nothing, which takes a fraction of the time of
+ * decrypting. That lets a reader check a whole message before
+ * decrypting any of it, without room to keep it. It can keep the
+ * MACs of the segments too, so that the pass that decrypts can
+ * check every piece is the cipher text that was checked before
+ * handing it out.
+ *
+ * Decrypting copies each segment to the output first, and checks
+ * and decrypts the copy, so input that can change underneath, such
+ * as a file mapping, is never checked as one thing and decrypted as
+ * another.
+ */
+
+namespace pm
+{
+    struct ctr_hmac_stream
+    {
+    public:
+        enum class direction : std::uint8_t
+        {
+            ENCRYPT,
+            DECRYPT,
+            AUTHENTICATE,
+        };
+
+        static constexpr std::size_t nonce_length   = security::aes256::block_length;
+        static constexpr std::size_t tag_length     = security::hmac_sha256::digest_length;
+        static constexpr std::size_t segment_length = 64 * 1024;
+
+        //The MAC of each segment, which a later pass over the same message can be checked against
+        static constexpr std::size_t segment_tag_length = security::hmac_sha256::digest_length;
+
+        explicit ctr_hmac_stream(direction dir) noexcept
+            : dir{ dir }
+        {}
+
+        ctr_hmac_stream(ctr_hmac_stream const&) = delete;
+        ctr_hmac_stream& operator = (ctr_hmac_stream const&) = delete;
+
+        ~ctr_hmac_stream();
+
+        //Starts a new message with a nonce that is never used twice with the same key
+        [[nodiscard]] std::error_code init(derived_key const& key, span<std::uint8_t> nonce, span<std::uint8_t> associated_data) noexcept;
+
+        //Processes the next piece of the message into the output, which may be the piece itself, or is not needed to authenticate
+        [[nodiscard]] std::error_code update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len) noexcept;
+
+        //Does the same, and writes the tag of each segment of the piece, segment_tag_length bytes apiece, to the segment tags
+        [[nodiscard]] std::error_code update(span<std::uint8_t> input, std::uint8_t* output, std::size_t output_size, std::size_t* output_len, std::uint8_t* segment_tags) noexcept;
+
+        //Ends an encrypted message and writes its tag
+        [[nodiscard]] std::error_code finish(std::uint8_t* tag, std::size_t tag_size) noexcept;
+
+        //Ends a decrypted or authenticated message and checks it against its tag
+        [[nodiscard]] std::error_code verify(span<std::uint8_t> tag) noexcept;
+
+    private:
+        void process_segment(std::uint64_t index, std::uint8_t const* input, std::uint8_t* output, std::size_t length, security::hmac_sha256::digest& mac) const noexcept;
+        void finish_tag(security::hmac_sha256::digest& tag) noexcept;
+        void wipe() noexcept;
+
+        direction                      dir;
+        bool                           started = false;
+        bool                           ended   = false;
+        std::uint64_t                  segment_index = 0;
+        std::uint64_t                  total_length  = 0;
+        std::uint8_t                   nonce[nonce_length]{};
+        security::aes256::key_schedule schedule{};
+        security::hmac_sha256          segment_mac;
+        security::hmac_sha256          message_mac;
+    };
+};
+
+#endif
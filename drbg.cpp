@@ -0,0 +1,163 @@
+#include "drbg.h"
+#include "crypto.h"
+#include "secure_memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+
+#if !defined(_WIN32)
+#   include <pthread.h>
+#endif
+
+using pm::security::chacha20;
+
+//Every key makes a single stream before it is replaced, so they can all use the same nonce
+static constexpr std::uint8_t const zero_nonce[chacha20::nonce_length]{};
+
+//The most handed out from one key by a large request, far below the end of the block counter
+static constexpr std::size_t const max_direct_length = 1 << 20;
+
+//The forks this process has been through, counted by the child
+static std::atomic<std::uint64_t> process_forks{ 0 };
+
+#if !defined(_WIN32)
+static void count_fork() noexcept
+{
+    process_forks.fetch_add(1, std::memory_order_relaxed);
+}
+#endif
+
+/*
+ * Makes sure forks are counted from now on. Windows has no fork,
+ * so there is nothing to watch.
+ */
+static bool watch_forks() noexcept
+{
+#if defined(_WIN32)
+    return true;
+#else
+    static bool const registered = (pthread_atfork(nullptr, nullptr, count_fork) == 0);
+
+    return registered;
+#endif
+}
+
+pm::security::chacha20_drbg::~chacha20_drbg()
+{
+    secure_wipe(this->key,    sizeof(this->key));
+    secure_wipe(this->stream, sizeof(this->stream));
+}
+
+std::error_code pm::security::chacha20_drbg::reseed() noexcept
+{
+    //A child process that is not told about the fork repeats the output of its parent
+    if (!watch_forks()) return ntstatus_t::UNSUCCESSFUL;
+
+    //Read the count first, so a fork while the system is being asked is caught on the next call
+    auto const forks = process_forks.load(std::memory_order_relaxed);
+
+    std::uint8_t entropy[chacha20::key_length];
+    auto const   success = get_system_random_bytes(entropy, sizeof(entropy));
+    if (success)
+    {
+        secure_wipe(entropy, sizeof(entropy));
+        return success;
+    }
+
+    //Mix rather than replace, so the key never gets weaker than it was
+    for (std::size_t i = 0; i < sizeof(this->key); i++) this->key[i] ^= entropy[i];
+    secure_wipe(entropy, sizeof(entropy));
+
+    //Whatever was made with the old key is not handed out any more
+    secure_wipe(this->stream, sizeof(this->stream));
+    this->available  = 0;
+    this->generated  = 0;
+    this->forks_seen = forks;
+    this->seeded     = true;
+
+    return ntstatus_t::SUCCESS;
+}
+
+void pm::security::chacha20_drbg::refill() noexcept
+{
+    chacha20::state st;
+    chacha20::init(&st, this->key, zero_nonce, 0);
+
+    std::fill(std::begin(this->stream), std::end(this->stream), std::uint8_t{ 0 });
+    chacha20::crypt(&st, this->stream, this->stream, sizeof(this->stream));
+
+    //The start of the stream becomes the next key and is never handed out
+    std::memcpy(this->key, this->stream, sizeof(this->key));
+    secure_wipe(this->stream, sizeof(this->key));
+    this->available = sizeof(this->stream) - sizeof(this->key);
+
+    secure_wipe(&st, sizeof(st));
+}
+
+void pm::security::chacha20_drbg::generate_direct(std::uint8_t* output, std::size_t len) noexcept
+{
+    chacha20::state st;
+    chacha20::init(&st, this->key, zero_nonce, 0);
+
+    //Take the next key first, then write the rest of the stream straight to the output
+    std::uint8_t next_key[chacha20::key_length]{};
+    chacha20::crypt(&st, next_key, next_key, sizeof(next_key));
+
+    std::memset(output, 0, len);
+    chacha20::crypt(&st, output, output, len);
+
+    std::memcpy(this->key, next_key, sizeof(this->key));
+
+    secure_wipe(next_key, sizeof(next_key));
+    secure_wipe(&st, sizeof(st));
+}
+
+std::error_code pm::security::chacha20_drbg::generate(std::uint8_t* buffer, std::size_t len) noexcept
+{
+    while (len > 0)
+    {
+        //Seed before the first use, now and then, and in a child after fork
+        if (!this->seeded || (this->generated >= reseed_interval) || (this->forks_seen != process_forks.load(std::memory_order_relaxed)))
+        {
+            auto const success = this->reseed();
+            if (success) return success;
+        }
+
+        std::size_t count;
+
+        if ((this->available == 0) && (len >= sizeof(this->stream)))
+        {
+            //Large requests skip the buffer
+            count = std::min(len, max_direct_length);
+            this->generate_direct(buffer, count);
+        }
+        else
+        {
+            if (this->available == 0) this->refill();
+
+            //Hand out the buffered bytes in order, wiping them as they go
+            auto* const start = this->stream + (sizeof(this->stream) - this->available);
+            count = std::min(len, this->available);
+
+            std::memcpy(buffer, start, count);
+            secure_wipe(start, count);
+            this->available -= count;
+        }
+
+        buffer          += count;
+        len             -= count;
+        this->generated += count;
+    }
+
+    return ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::get_random_bytes(std::uint8_t* buffer, std::size_t len) noexcept
+{
+    //Each thread has its own generator, so nothing is shared or locked
+    static thread_local security::chacha20_drbg generator;
+
+    return generator.generate(buffer, len);
+}
@@ -0,0 +1,64 @@
+#ifndef PM_DRBG_H
+#define PM_DRBG_H
+#pragma once
+
+#include "chacha20.h"
+#include "ntstatus.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * A deterministic random bit generator built on ChaCha20 with fast
+ * key erasure: every refill of the buffer starts by replacing the
+ * key with the first bytes of its own key stream, so nothing that
+ * was handed out can be recovered from the state afterwards. Bytes
+ * are wiped from the buffer as they are handed out for the same
+ * reason.
+ *
+ * The key is taken from the system generator before the first use,
+ * mixed with fresh system entropy after every reseed_interval bytes,
+ * and replaced in a child process after fork, which would otherwise
+ * repeat the parent's output.
+ *
+ * It is not thread safe: pm::get_random_bytes keeps one per thread.
+ */
+
+namespace pm::security
+{
+    struct chacha20_drbg
+    {
+    public:
+        //The bytes of key stream made at once, the first key_length of them becoming the next key
+        static constexpr std::size_t const buffer_length = 12 * chacha20::block_length;
+
+        //The bytes handed out under one seed before the system is asked for more entropy
+        static constexpr std::uint64_t const reseed_interval = 1 << 20;
+
+        chacha20_drbg() noexcept = default;
+
+        chacha20_drbg(chacha20_drbg const&) = delete;
+        chacha20_drbg& operator = (chacha20_drbg const&) = delete;
+
+        ~chacha20_drbg();
+
+        //Fills a buffer with random bytes, reseeding first if it is due
+        [[nodiscard]] std::error_code generate(std::uint8_t* buffer, std::size_t len) noexcept;
+
+        //Mixes fresh entropy from the system into the key and drops the buffered output
+        [[nodiscard]] std::error_code reseed() noexcept;
+
+    private:
+        void refill() noexcept;
+        void generate_direct(std::uint8_t* output, std::size_t len) noexcept;
+
+        std::uint8_t  key[chacha20::key_length]{};
+        std::uint8_t  stream[buffer_length]{};
+        std::size_t   available  = 0;
+        std::uint64_t generated  = 0;
+        std::uint64_t forks_seen = 0;
+        bool          seeded     = false;
+    };
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "hmac.h"
+
+#include <cstddef>
+#include <string_view>
+
+/*
+ * Instantiates HMAC-SHA-256 once for the whole program.
+ */
+
+template struct pm::security::hmac<pm::security::sha256>;
+
+/*
+ * Test cases 1, 2 and 6 from RFC 4231, covering a short key,
+ * a key shorter than the digest and a key longer than a block.
+ */
+namespace
+{
+    struct known_answer
+    {
+        std::string_view                key;
+        std::string_view                message;
+        pm::security::hmac_sha256::byte digest[pm::security::hmac_sha256::digest_length];
+    };
+};
+
+static constexpr char const long_key[131]
+{
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA', '\xAA',
+    '\xAA', '\xAA', '\xAA'
+};
+
+static constexpr known_answer const known_answers[]
+{
+    {
+        "\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B\x0B",
+        "Hi There",
+        {
+            0xB0, 0x34, 0x4C, 0x61, 0xD8, 0xDB, 0x38, 0x53, 0x5C, 0xA8, 0xAF, 0xCE, 0xAF, 0x0B, 0xF1, 0x2B,
+            0x88, 0x1D, 0xC2, 0x00, 0xC9, 0x83, 0x3D, 0xA7, 0x26, 0xE9, 0x37, 0x6C, 0x2E, 0x32, 0xCF, 0xF7
+        }
+    },
+    {
+        "Jefe",
+        "what do ya want for nothing?",
+        {
+            0x5B, 0xDC, 0xC1, 0x46, 0xBF, 0x60, 0x75, 0x4E, 0x6A, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xC7,
+            0x5A, 0x00, 0x3F, 0x08, 0x9D, 0x27, 0x39, 0x83, 0x9D, 0xEC, 0x58, 0xB9, 0x64, 0xEC, 0x38, 0x43
+        }
+    },
+    {
+        std::string_view{ long_key, sizeof(long_key) },
+        "Test Using Larger Than Block-Size Key - Hash Key First",
+        {
+            0x60, 0xE4, 0x31, 0x59, 0x1E, 0xE0, 0xB6, 0x7F, 0x0D, 0x8A, 0x26, 0xAA, 0xCB, 0xF5, 0xB7, 0x7F,
+            0x8E, 0x0B, 0xC6, 0x21, 0x37, 0x28, 0xC5, 0x14, 0x05, 0x46, 0x04, 0x0F, 0x0E, 0xE3, 0x7F, 0x54
+        }
+    }
+};
+
+/*
+ * Checks a MAC computed in a constant expression against
+ * one of the known answers.
+ */
+static constexpr bool matches_known_answer(known_answer const& test) noexcept
+{
+    auto const mac = pm::security::hmac_sha256::compute_mac(test.key.data(), test.key.size(), test.message.data(), test.message.size());
+
+    for (std::size_t i = 0; i < mac.size(); i++)
+    {
+        if (mac[i] != test.digest[i]) return false;
+    }
+
+    return true;
+}
+
+static_assert(matches_known_answer(known_answers[0]), "HMAC-SHA-256 is broken!");
+static_assert(matches_known_answer(known_answers[1]), "HMAC-SHA-256 is broken!");
+static_assert(matches_known_answer(known_answers[2]), "HMAC-SHA-256 is broken!");
@@ -0,0 +1,229 @@
+#ifndef PM_HMAC_H
+#define PM_HMAC_H
+#pragma once
+
+/*
+ * Implements HMAC as described in FIPS PUB 198-1 (July 2008),
+ * on top of any hash that provides a streaming context such
+ * as pm::security::sha256.
+ *
+ * Setting the key hashes the key XORed with ipad and opad
+ * once, and keeps the two resulting midstates. Every message
+ * authenticated under that key starts from a copy of them, so
+ * the two key blocks are never compressed again.
+ *
+ * The midstates are as secret as the key. The type has to stay
+ * usable in constant expressions, so it has no destructor, and
+ * its owner calls clear when the key is no longer needed.
+ */
+
+#include "secure_memory.h"
+#include "sha256.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace pm::security
+{
+    template<typename Hash>
+    struct hmac
+    {
+    public:
+        static constexpr std::size_t const block_length  = Hash::block_length;
+        static constexpr std::size_t const digest_length = Hash::digest_length;
+
+        using byte    = typename Hash::byte;
+        using context = typename Hash::context;
+        using digest  = std::array<byte, digest_length>;
+
+        constexpr hmac() noexcept = default;
+
+        /*
+         * Prepares the midstates for the given key.
+         */
+        template<typename T>
+        constexpr hmac(T const* key, std::size_t key_length) noexcept
+        {
+            this->set_key(key, key_length);
+        }
+
+        /*
+         * Replaces the key, computing the inner and outer
+         * midstates. Keys longer than a block are hashed
+         * first, as the specification requires.
+         */
+        template<typename T>
+        constexpr void set_key(T const* key, std::size_t key_length) noexcept
+        {
+            std::array<byte, block_length> pad{};
+
+            //Shorten the key if it does not fit in a block
+            if (key_length > block_length)
+            {
+                digest hashed{};
+
+                context ctx{};
+                ctx.init();
+                ctx.update(key, key_length);
+                ctx.finish(hashed);
+
+                for (std::size_t i = 0; i < digest_length; i++) pad[i] = hashed[i];
+
+                wipe(hashed);
+                wipe(ctx);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < key_length; i++) pad[i] = static_cast<byte>(key[i]);
+            }
+
+            //Compress K ^ ipad
+            for (auto& b : pad) b ^= 0x36;
+
+            this->inner_midstate.init();
+            this->inner_midstate.update(pad.data(), block_length);
+
+            //Compress K ^ opad, undoing the ipad at the same time
+            for (auto& b : pad) b ^= (0x36 ^ 0x5C);
+
+            this->outer_midstate.init();
+            this->outer_midstate.update(pad.data(), block_length);
+
+            //Clear the padded key
+            wipe(pad);
+
+            this->init();
+        }
+
+        /*
+         * Starts a new message under the current key.
+         */
+        constexpr void init() noexcept
+        {
+            this->inner = this->inner_midstate;
+        }
+
+        /*
+         * Feeds an arbitrary amount of the message. Can be
+         * called any number of times.
+         */
+        template<typename T>
+        constexpr void update(T const* data, std::size_t data_length) noexcept
+        {
+            this->inner.update(data, data_length);
+        }
+
+        /*
+         * Writes the MAC of the message fed so far into the
+         * provided array. The context must be initialized
+         * again before it is reused.
+         */
+        constexpr void finish(digest& mac) noexcept
+        {
+            digest inner_digest{};
+            this->inner.finish(inner_digest);
+
+            //H((K ^ opad) || H((K ^ ipad) || message))
+            auto outer = this->outer_midstate;
+            outer.update(inner_digest.data(), digest_length);
+            outer.finish(mac);
+
+            wipe(inner_digest);
+            wipe(outer);
+        }
+
+        /*
+         * Computes the MAC of a whole message under the current
+         * key. Does not disturb a message in progress, and can
+         * be called on a shared context.
+         */
+        template<typename T>
+        constexpr void compute(T const* data, std::size_t data_length, digest& mac) const noexcept
+        {
+            digest inner_digest{};
+
+            auto inner = this->inner_midstate;
+            inner.update(data, data_length);
+            inner.finish(inner_digest);
+
+            auto outer = this->outer_midstate;
+            outer.update(inner_digest.data(), digest_length);
+            outer.finish(mac);
+
+            wipe(inner_digest);
+            wipe(inner);
+            wipe(outer);
+        }
+
+        /*
+         * Computes the MAC of a whole message under the given key.
+         */
+        template<typename K, typename T>
+        static constexpr digest compute_mac(K const* key, std::size_t key_length, T const* data, std::size_t data_length) noexcept
+        {
+            digest mac{};
+
+            auto h = hmac{ key, key_length };
+            h.compute(data, data_length, mac);
+            h.clear();
+
+            return mac;
+        }
+
+        /*
+         * Wipes the midstates and the message in progress. A key
+         * has to be set again before the context is reused.
+         */
+        constexpr void clear() noexcept
+        {
+            wipe(this->inner_midstate);
+            wipe(this->outer_midstate);
+            wipe(this->inner);
+        }
+
+        /*
+         * Retrieves the contexts left after compressing K ^ ipad
+         * and K ^ opad.
+         */
+        constexpr context const& get_inner_midstate() const noexcept
+        {
+            return this->inner_midstate;
+        }
+
+        constexpr context const& get_outer_midstate() const noexcept
+        {
+            return this->outer_midstate;
+        }
+
+    private:
+        /*
+         * Clears something that held key material. At run-time
+         * it is wiped so the store cannot be removed, and in a
+         * constant expression it is simply reset.
+         */
+        template<typename T>
+        static constexpr void wipe(T& object) noexcept
+        {
+#if defined(PM_HAS_IS_CONSTANT_EVALUATED)
+            if (!__builtin_is_constant_evaluated())
+            {
+                secure_wipe(&object, sizeof(object));
+                return;
+            }
+#endif
+
+            object = T{};
+        }
+
+        context inner_midstate{};
+        context outer_midstate{};
+        context inner{};
+    };
+
+    extern template struct hmac<sha256>;
+
+    using hmac_sha256 = hmac<sha256>;
+};
+
+#endif
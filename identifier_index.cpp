@@ -0,0 +1,81 @@
+#include "identifier_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+/*
+ * Compares two identifiers byte by byte, the shorter first if one
+ * is a prefix of the other.
+ */
+static int compare_identifiers(pm::span<char> a, pm::span<char> b) noexcept
+{
+    auto const common = static_cast<std::size_t>(std::min(a.size(), b.size()));
+
+    //memcmp compares as unsigned char, which is the order wanted
+    auto const result = (common > 0) ? std::memcmp(a.data(), b.data(), common) : 0;
+    if (result != 0) return result;
+
+    return (a.size() < b.size()) ? -1 : (a.size() > b.size()) ? 1 : 0;
+}
+
+static bool identifier_less(pm::entry const& a, pm::entry const& b) noexcept
+{
+    return compare_identifiers(a.identifier, b.identifier) < 0;
+}
+
+/*
+ * Orders entries against a prefix with each identifier cut to the
+ * length of the prefix, so all that start with it compare equal.
+ */
+struct prefix_order
+{
+    static pm::span<char> cut(pm::span<char> identifier, pm::span<char> prefix) noexcept
+    {
+        return pm::span<char>(identifier.data(), std::min(identifier.size(), prefix.size()));
+    }
+
+    bool operator ()(pm::entry const& e, pm::span<char> prefix) const noexcept
+    {
+        return compare_identifiers(cut(e.identifier, prefix), prefix) < 0;
+    }
+
+    bool operator ()(pm::span<char> prefix, pm::entry const& e) const noexcept
+    {
+        return compare_identifiers(prefix, cut(e.identifier, prefix)) < 0;
+    }
+};
+
+pm::identifier_index::identifier_index(std::vector<entry> const& entries) noexcept
+    : sorted{ entries }
+{
+    //Stable, so entries with the same identifier stay in archive order
+    std::stable_sort(this->sorted.begin(), this->sorted.end(), identifier_less);
+}
+
+void pm::identifier_index::insert(entry const& e) noexcept
+{
+    //Moving the tail up one place is far cheaper than sorting everything again
+    auto const position = std::upper_bound(this->sorted.begin(), this->sorted.end(), e, identifier_less);
+
+    this->sorted.insert(position, e);
+}
+
+pm::span<pm::entry> pm::identifier_index::find_prefix(span<char> prefix) const noexcept
+{
+    auto const range = std::equal_range(this->sorted.begin(), this->sorted.end(), prefix, prefix_order{});
+
+    return span<entry>(this->sorted.data() + (range.first - this->sorted.begin()), range.second - range.first);
+}
+
+pm::span<pm::entry> pm::identifier_index::find_range(span<char> first, span<char> last) const noexcept
+{
+    auto const before = [](entry const& e, span<char> bound) noexcept
+    {
+        return compare_identifiers(e.identifier, bound) < 0;
+    };
+
+    auto const lower = std::lower_bound(this->sorted.begin(), this->sorted.end(), first, before);
+    auto const upper = std::lower_bound(lower,                this->sorted.end(), last,  before);
+
+    return span<entry>(this->sorted.data() + (lower - this->sorted.begin()), upper - lower);
+}
@@ -0,0 +1,57 @@
+#ifndef PM_IDENTIFIER_INDEX_H
+#define PM_IDENTIFIER_INDEX_H
+#pragma once
+
+#include "archive.h"
+#include "span.h"
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * The entries of a vault in identifier order, for autocomplete and
+ * range queries. It is a sorted array of the entries, which are
+ * views into the plain text, so the identifiers are not copied and
+ * a query is a binary search followed by a contiguous run of the
+ * matches. The entries must outlive the index.
+ *
+ * Identifiers compare byte by byte as unsigned values, and a prefix
+ * sorts before everything that starts with it. Entries with the
+ * same identifier keep the order they were added in.
+ */
+
+namespace pm
+{
+    struct identifier_index
+    {
+    public:
+        identifier_index() noexcept = default;
+
+        //Sorts the entries in one pass, replacing anything indexed before
+        explicit identifier_index(std::vector<entry> const& entries) noexcept;
+
+        //Adds an entry in its place, after any with the same identifier, without sorting again
+        void insert(entry const& e) noexcept;
+
+        //Returns the entries whose identifiers start with the prefix, in order
+        span<entry> find_prefix(span<char> prefix) const noexcept;
+
+        //Returns the entries with identifiers from first up to but not including last, in order
+        span<entry> find_range(span<char> first, span<char> last) const noexcept;
+
+        std::size_t size() const noexcept
+        {
+            return this->sorted.size();
+        }
+
+        bool empty() const noexcept
+        {
+            return this->sorted.empty();
+        }
+
+    private:
+        std::vector<entry> sorted;
+    };
+};
+
+#endif
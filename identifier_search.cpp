@@ -0,0 +1,457 @@
+#include "identifier_search.h"
+#include "identifier_search_impl.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+using pm::detail::find_substring_fn;
+
+//Typos are only looked for in queries this long, shorter ones would match nearly everything
+static constexpr std::size_t const min_typo_query = 4;
+
+//The longest query the typo search can hold, one bit per byte
+static constexpr std::size_t const max_typo_query = 64;
+
+//The most trigrams one typo can break: those that overlap the byte that is wrong
+static constexpr std::size_t const trigrams_per_typo = 3;
+
+//The base score of each tier, and the most a match can gain within one
+static constexpr int const substring_score   = 3000;
+static constexpr int const typo_score        = 2000;
+static constexpr int const subsequence_score = 1000;
+static constexpr int const max_bonus         = 200;
+
+//The most a match can lose within a tier, which keeps the tiers from crossing however long the identifier
+static constexpr int const max_penalty = (substring_score - typo_score) - max_bonus - 1;
+
+static int cap_penalty(std::size_t penalty) noexcept
+{
+    return static_cast<int>(std::min(penalty, static_cast<std::size_t>(max_penalty)));
+}
+
+std::size_t pm::detail::find_substring_portable(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept
+{
+    if (needle_length > length) return length;
+
+    auto const last_start = length - needle_length;
+
+    for (std::size_t i = 0; i <= last_start; i++)
+    {
+        //Skip to the next place the first byte occurs
+        auto const* p = static_cast<std::uint8_t const*>(std::memchr(haystack + i, needle[0], last_start - i + 1));
+        if (!p) break;
+
+        i = static_cast<std::size_t>(p - haystack);
+        if (std::memcmp(haystack + i + 1, needle + 1, needle_length - 1) == 0) return i;
+    }
+
+    return length;
+}
+
+/*
+ * Picks the fastest implementation supported by the processor.
+ */
+static find_substring_fn select_find_substring() noexcept
+{
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    if (cpu.avx2) return pm::detail::find_substring_avx2;
+    if (cpu.sse2) return pm::detail::find_substring_sse2;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    return pm::detail::find_substring_neon;
+#endif
+
+    return pm::detail::find_substring_portable;
+}
+
+find_substring_fn pm::detail::get_find_substring() noexcept
+{
+    static find_substring_fn const find = select_find_substring();
+
+    return find;
+}
+
+static std::uint8_t fold(char c) noexcept
+{
+    auto const b = static_cast<std::uint8_t>(c);
+
+    return ((b >= 'A') && (b <= 'Z')) ? static_cast<std::uint8_t>(b - 'A' + 'a') : b;
+}
+
+static bool is_word_byte(std::uint8_t b) noexcept
+{
+    return ((b >= 'a') && (b <= 'z')) || ((b >= '0') && (b <= '9')) || (b >= 0x80);
+}
+
+static std::uint64_t make_signature(std::uint8_t const* p, std::size_t length) noexcept
+{
+    std::uint64_t signature = 0;
+    for (std::size_t i = 0; i < length; i++) signature |= std::uint64_t{ 1 } << (p[i] & 63);
+
+    return signature;
+}
+
+static std::uint32_t make_trigram(std::uint8_t const* p) noexcept
+{
+    return (static_cast<std::uint32_t>(p[0]) << 16) | (static_cast<std::uint32_t>(p[1]) << 8) | p[2];
+}
+
+pm::identifier_search::identifier_search(std::vector<entry> const& entries) noexcept
+{
+    //Every identifier is followed by a zero byte, and the offsets and entry numbers must fit in 32 bits
+    std::size_t length = 0;
+    for (auto const& e : entries) length += static_cast<std::size_t>(e.identifier.size()) + 1;
+
+    if (entries.empty() || (length >= UINT32_MAX) || (entries.size() >= UINT32_MAX)) return;
+
+    auto* const buffer     = new (std::nothrow) std::uint8_t[length];
+    auto* const signatures = new (std::nothrow) std::uint64_t[entries.size()];
+    if (!buffer || !signatures)
+    {
+        delete[] buffer;
+        delete[] signatures;
+        return;
+    }
+
+    this->text        = secure_byte_array{ buffer, secure_array_deleter<std::uint8_t>{ length } };
+    this->signatures  = decltype(this->signatures){ signatures, secure_array_deleter<std::uint64_t>{ entries.size() } };
+    this->text_length = length;
+    this->entries     = entries;
+    this->starts.reserve(entries.size() + 1);
+
+    //Fold the identifiers, and pair every trigram in them with the entry it came from
+    std::vector<std::uint64_t> pairs;
+    std::size_t                position = 0;
+
+    for (std::size_t i = 0; i < entries.size(); i++)
+    {
+        auto const* const folded = buffer + position;
+
+        this->starts.push_back(static_cast<std::uint32_t>(position));
+        for (auto const c : entries[i].identifier) buffer[position++] = fold(c);
+        buffer[position++] = 0;
+
+        signatures[i] = make_signature(folded, static_cast<std::size_t>(entries[i].identifier.size()));
+
+        for (std::size_t p = 0; p + 3 <= static_cast<std::size_t>(entries[i].identifier.size()); p++)
+        {
+            pairs.push_back((static_cast<std::uint64_t>(make_trigram(folded + p)) << 32) | i);
+        }
+    }
+
+    this->starts.push_back(static_cast<std::uint32_t>(position));
+
+    //Sorting groups the entries by trigram in archive order, and drops trigrams an identifier holds more than once
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    std::vector<std::uint32_t> keys;
+
+    for (auto const pair : pairs)
+    {
+        auto const trigram = static_cast<std::uint32_t>(pair >> 32);
+
+        if (keys.empty() || (keys.back() != trigram))
+        {
+            keys.push_back(trigram);
+            this->trigram_starts.push_back(static_cast<std::uint32_t>(this->postings.size()));
+        }
+
+        this->postings.push_back(static_cast<std::uint32_t>(pair));
+    }
+
+    this->trigram_starts.push_back(static_cast<std::uint32_t>(this->postings.size()));
+
+    //The trigrams are pieces of the identifiers, so they are kept where they will be wiped
+    auto* const trigrams = new (std::nothrow) std::uint32_t[keys.size()];
+    if (trigrams)
+    {
+        std::copy(keys.begin(), keys.end(), trigrams);
+
+        this->trigrams      = decltype(this->trigrams){ trigrams, secure_array_deleter<std::uint32_t>{ keys.size() } };
+        this->trigram_count = keys.size();
+    }
+
+    secure_wipe(pairs.data(), pairs.size() * sizeof(std::uint64_t));
+    secure_wipe(keys.data(),  keys.size()  * sizeof(std::uint32_t));
+}
+
+pm::span<std::uint32_t> pm::identifier_search::get_postings(std::uint32_t trigram) const noexcept
+{
+    auto const* const first = this->trigrams.get();
+    auto const* const last  = first + this->trigram_count;
+
+    auto const* const found = std::lower_bound(first, last, trigram);
+    if ((found == last) || (*found != trigram)) return {};
+
+    auto const k = static_cast<std::size_t>(found - first);
+
+    return span<std::uint32_t>(this->postings.data() + this->trigram_starts[k], static_cast<std::ptrdiff_t>(this->trigram_starts[k + 1] - this->trigram_starts[k]));
+}
+
+std::vector<std::uint32_t> pm::identifier_search::find_all_trigrams(std::uint8_t const* query, std::size_t length) const noexcept
+{
+    std::vector<span<std::uint32_t>> lists;
+
+    for (std::size_t p = 0; p + 3 <= length; p++)
+    {
+        auto const list = this->get_postings(make_trigram(query + p));
+        if (list.size() == 0) return {};
+
+        lists.push_back(list);
+    }
+
+    //Start from the rarest trigram, so the candidates are few from the outset
+    std::sort(lists.begin(), lists.end(), [](span<std::uint32_t> a, span<std::uint32_t> b) noexcept { return a.size() < b.size(); });
+
+    std::vector<std::uint32_t> result(lists.front().begin(), lists.front().end());
+    std::vector<std::uint32_t> next;
+
+    for (std::size_t i = 1; (i < lists.size()) && !result.empty(); i++)
+    {
+        next.clear();
+        std::set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(), std::back_inserter(next));
+        result.swap(next);
+    }
+
+    return result;
+}
+
+bool pm::identifier_search::find_most_trigrams(std::uint8_t const* query, std::size_t length, std::size_t max_missing, std::vector<std::uint32_t>* result) const noexcept
+{
+    std::vector<std::uint32_t> keys;
+    for (std::size_t p = 0; p + 3 <= length; p++) keys.push_back(make_trigram(query + p));
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    //With too few trigrams to go on, every entry is a candidate
+    if (keys.size() <= max_missing) return false;
+
+    //Count the trigrams every entry shares with the query, and take each entry as it reaches enough of them
+    auto const min_shared = keys.size() - max_missing;
+
+    std::vector<std::uint8_t> counts(this->entries.size());
+
+    for (auto const key : keys)
+    {
+        for (auto const index : this->get_postings(key))
+        {
+            if (++counts[index] == min_shared) result->push_back(index);
+        }
+    }
+
+    std::sort(result->begin(), result->end());
+
+    return true;
+}
+
+void pm::identifier_search::find_substrings(std::uint8_t const* query, std::size_t length, std::vector<std::uint8_t>* matched, std::vector<candidate>* found) const noexcept
+{
+    auto const  find = detail::get_find_substring();
+    auto const* text = this->text.get();
+
+    auto const record = [&](std::size_t index, std::size_t position) noexcept
+    {
+        auto const identifier_length = static_cast<std::size_t>(this->starts[index + 1] - this->starts[index] - 1);
+
+        //Best at the start of the identifier, then at the start of a word, then the earlier and the tighter the better
+        auto score = substring_score - cap_penalty(position + (identifier_length - length));
+        if (position == 0)
+            score += max_bonus;
+        else if (!is_word_byte(text[this->starts[index] + position - 1]))
+            score += 100;
+
+        (*matched)[index] = 1;
+        found->push_back(candidate{ static_cast<std::uint32_t>(index), score });
+    };
+
+    //Queries with trigrams only check the identifiers that hold all of them, unless that is most of them anyway
+    if ((length >= 3) && this->trigrams)
+    {
+        auto const candidates = this->find_all_trigrams(query, length);
+
+        if (candidates.size() < this->entries.size() / 8)
+        {
+            for (auto const index : candidates)
+            {
+                auto const start             = this->starts[index];
+                auto const identifier_length = static_cast<std::size_t>(this->starts[index + 1] - start - 1);
+
+                auto const position = find(text + start, identifier_length, query, length);
+                if (position != identifier_length) record(index, position);
+            }
+
+            return;
+        }
+    }
+
+    //Otherwise scan all of the identifiers in one go, moving on to the next identifier after a match
+    std::size_t position = 0;
+    std::size_t index    = 0;
+
+    while (position < this->text_length)
+    {
+        auto const hit = position + find(text + position, this->text_length - position, query, length);
+        if (hit == this->text_length) break;
+
+        //The matches only move forward, so the identifier they are in is found by walking forward too
+        while (this->starts[index + 1] <= hit) index++;
+
+        auto const next = this->starts[index + 1];
+
+        //A query with a zero byte in it could match across the end of an identifier
+        if (hit + length < next)
+        {
+            record(index, hit - this->starts[index]);
+            position = next;
+        }
+        else
+        {
+            position = hit + 1;
+        }
+    }
+}
+
+void pm::identifier_search::find_typos(std::uint8_t const* query, std::size_t length, std::vector<std::uint8_t>* matched, std::vector<candidate>* found) const noexcept
+{
+    //Bit j of a mask is set if the query has the byte at position j
+    std::uint64_t masks[256]{};
+    for (std::size_t j = 0; j < length; j++) masks[query[j]] |= std::uint64_t{ 1 } << j;
+
+    auto const accept    = std::uint64_t{ 1 } << (length - 1);
+    auto const signature = make_signature(query, length);
+
+    /*
+     * Runs the bit-parallel matcher of Wu and Manber over one
+     * identifier. Bit j of exact is set while the first j + 1
+     * bytes of the query end at the current byte, and of one_typo
+     * while they do with one byte wrong, missing or extra.
+     */
+    auto const check = [&](std::uint32_t index) noexcept
+    {
+        if ((*matched)[index]) return;
+
+        //One typo can leave out at most one byte of the query
+        auto const missing = signature & ~this->signatures[index];
+        if ((missing & (missing - 1)) != 0) return;
+
+        auto const* const identifier        = this->text.get() + this->starts[index];
+        auto const        identifier_length = static_cast<std::size_t>(this->starts[index + 1] - this->starts[index] - 1);
+
+        //Before any byte, the first byte of the query can already be the one missing
+        std::uint64_t exact    = 0;
+        std::uint64_t one_typo = 1;
+
+        for (std::size_t p = 0; p < identifier_length; p++)
+        {
+            auto const mask       = masks[identifier[p]];
+            auto const next_exact = ((exact << 1) | 1) & mask;
+
+            //Matching this byte, wrong, extra or with a byte of the query missing before it
+            one_typo = (((one_typo << 1) | 1) & mask) | (exact << 1) | 1 | exact | (next_exact << 1);
+            exact    = next_exact;
+
+            if (one_typo & accept)
+            {
+                auto const difference = (identifier_length > length) ? (identifier_length - length) : (length - identifier_length);
+
+                (*matched)[index] = 1;
+                found->push_back(candidate{ index, typo_score - cap_penalty(difference) });
+                return;
+            }
+        }
+    };
+
+    //An identifier with a typo of the query still holds all but a few of its trigrams
+    std::vector<std::uint32_t> candidates;
+    if (this->trigrams && this->find_most_trigrams(query, length, trigrams_per_typo, &candidates))
+    {
+        for (auto const index : candidates) check(index);
+    }
+    else
+    {
+        for (std::size_t index = 0; index < this->entries.size(); index++) check(static_cast<std::uint32_t>(index));
+    }
+}
+
+void pm::identifier_search::find_sequences(std::uint8_t const* query, std::size_t length, std::vector<std::uint8_t>* matched, std::vector<candidate>* found) const noexcept
+{
+    auto const signature = make_signature(query, length);
+
+    for (std::size_t index = 0; index < this->entries.size(); index++)
+    {
+        //Every byte of the query has to be in the identifier
+        if ((*matched)[index] || ((signature & ~this->signatures[index]) != 0)) continue;
+
+        auto const* const identifier        = this->text.get() + this->starts[index];
+        auto const        identifier_length = static_cast<std::size_t>(this->starts[index + 1] - this->starts[index] - 1);
+        if (identifier_length < length) continue;
+
+        //Take each byte of the query at the first place it occurs after the one before
+        std::size_t j     = 0;
+        std::size_t first = 0;
+        std::size_t last  = 0;
+
+        for (std::size_t p = 0; (p < identifier_length) && (j < length); p++)
+        {
+            if (identifier[p] != query[j]) continue;
+
+            if (j == 0) first = p;
+            last = p;
+            j++;
+        }
+
+        if (j < length) continue;
+
+        //Best when the bytes are close together and start the identifier
+        auto const gaps  = (last - first + 1) - length;
+        auto       score = subsequence_score - cap_penalty(4 * gaps + (identifier_length - length));
+        if (first == 0) score += 50;
+
+        found->push_back(candidate{ static_cast<std::uint32_t>(index), score });
+    }
+}
+
+std::vector<pm::search_result> pm::identifier_search::search(span<char> query, std::size_t max_results) const noexcept
+{
+    std::vector<search_result> results;
+    if ((max_results == 0) || (query.size() <= 0) || !this->text) return results;
+
+    auto const length = static_cast<std::size_t>(query.size());
+
+    std::vector<std::uint8_t> folded(length);
+    std::transform(query.begin(), query.end(), folded.begin(), fold);
+
+    std::vector<std::uint8_t> matched(this->entries.size());
+    std::vector<candidate>    found;
+
+    this->find_substrings(folded.data(), length, &matched, &found);
+
+    //Fuzzy matches always rank below exact ones, so they are only needed to fill the results up
+    if (found.size() < max_results)
+    {
+        if ((length >= min_typo_query) && (length <= max_typo_query)) this->find_typos(folded.data(), length, &matched, &found);
+        if (length >= 2)                                              this->find_sequences(folded.data(), length, &matched, &found);
+    }
+
+    secure_wipe(folded.data(), folded.size());
+
+    //Keep the best, with earlier entries first among equals
+    auto const count = std::min(max_results, found.size());
+
+    std::partial_sort(found.begin(), found.begin() + static_cast<std::ptrdiff_t>(count), found.end(), [](candidate const& a, candidate const& b) noexcept
+    {
+        return (a.score != b.score) ? (a.score > b.score) : (a.index < b.index);
+    });
+
+    results.reserve(count);
+    for (std::size_t i = 0; i < count; i++) results.push_back(search_result{ this->entries[found[i].index], found[i].score });
+
+    return results;
+}
@@ -0,0 +1,101 @@
+#ifndef PM_IDENTIFIER_SEARCH_H
+#define PM_IDENTIFIER_SEARCH_H
+#pragma once
+
+#include "archive.h"
+#include "secure_memory.h"
+#include "span.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * Searches the identifiers of a vault for a query as the user types
+ * it, ignoring ASCII case, and returns the best few matches.
+ *
+ * The identifiers are folded to lower case into one buffer, which a
+ * SIMD kernel scans for queries too short to prefilter. For longer
+ * queries, a trigram index narrows the search down to the entries
+ * that hold every trigram of the query before any text is compared.
+ *
+ * Matches are ranked in three tiers:
+ *
+ *     - the identifier contains the query, best at the start or at
+ *       the start of a word;
+ *     - it contains the query with one typo, a byte that is wrong,
+ *       missing or extra, for queries of four bytes or more;
+ *     - it contains the bytes of the query in order with others in
+ *       between, best when they are close together.
+ *
+ * Within a tier, shorter identifiers rank first, and equal scores
+ * keep archive order. The penalties within a tier are capped, so a
+ * match in a better tier always ranks first. The fuzzy tiers are skipped when enough exact
+ * matches were found, since they could not make the cut. Otherwise
+ * a 64-bit signature of the bytes in each identifier rules out most
+ * of them before their text is read.
+ *
+ * The entries are views into the vault, which must outlive the
+ * engine. The folded identifiers are wiped when it goes away.
+ */
+
+namespace pm
+{
+    struct search_result
+    {
+        entry match;
+        int   score;
+    };
+
+    struct identifier_search
+    {
+    public:
+        identifier_search() noexcept = default;
+
+        //Folds and indexes the identifiers, or leaves the engine empty if they are too large to index
+        explicit identifier_search(std::vector<entry> const& entries) noexcept;
+
+        //Returns up to max_results matches for the query, best first
+        std::vector<search_result> search(span<char> query, std::size_t max_results) const noexcept;
+
+        std::size_t size() const noexcept
+        {
+            return this->entries.size();
+        }
+
+    private:
+        struct candidate
+        {
+            std::uint32_t index;
+            int           score;
+        };
+
+        span<std::uint32_t> get_postings(std::uint32_t trigram) const noexcept;
+
+        std::vector<std::uint32_t> find_all_trigrams (std::uint8_t const* query, std::size_t length) const noexcept;
+        bool                       find_most_trigrams(std::uint8_t const* query, std::size_t length, std::size_t max_missing, std::vector<std::uint32_t>* result) const noexcept;
+
+        void find_substrings(std::uint8_t const* query, std::size_t length, std::vector<std::uint8_t>* matched, std::vector<candidate>* found) const noexcept;
+        void find_typos     (std::uint8_t const* query, std::size_t length, std::vector<std::uint8_t>* matched, std::vector<candidate>* found) const noexcept;
+        void find_sequences (std::uint8_t const* query, std::size_t length, std::vector<std::uint8_t>* matched, std::vector<candidate>* found) const noexcept;
+
+        std::vector<entry>                                                    entries;
+
+        //The folded identifiers, each followed by a zero byte, and where each one starts
+        secure_byte_array                                                     text;
+        std::size_t                                                           text_length = 0;
+        std::vector<std::uint32_t>                                            starts;
+
+        //For each identifier, a bit for every byte value it holds modulo 64, to rule it out of fuzzy matches quickly
+        std::unique_ptr<std::uint64_t[], secure_array_deleter<std::uint64_t>> signatures;
+
+        //The trigrams in order, where the entries holding each one start, and the entries
+        std::unique_ptr<std::uint32_t[], secure_array_deleter<std::uint32_t>> trigrams;
+        std::size_t                                                           trigram_count = 0;
+        std::vector<std::uint32_t>                                            trigram_starts;
+        std::vector<std::uint32_t>                                            postings;
+    };
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "identifier_search_impl.h"
+
+/*
+ * Implements the substring search with AVX2, testing 32 starting
+ * positions at once. The first and last byte of the needle are
+ * compared at every position, and the bytes between are only
+ * compared where both match.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("avx2")
+#endif
+
+#include <cstring>
+
+static constexpr std::size_t const parallel_positions = 32;
+
+std::size_t pm::detail::find_substring_avx2(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept
+{
+    if (needle_length > length) return length;
+
+    auto const first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+    auto const last  = _mm256_set1_epi8(static_cast<char>(needle[needle_length - 1]));
+
+    //Stop while the loads of the last bytes still fit in the haystack
+    std::size_t i = 0;
+    for (; i + needle_length - 1 + parallel_positions <= length; i += parallel_positions)
+    {
+        auto const block_first = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(haystack + i));
+        auto const block_last  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(haystack + i + needle_length - 1));
+
+        auto candidates = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+
+        while (candidates != 0)
+        {
+            auto const offset = lowest_set_bit(candidates);
+
+            if ((needle_length <= 2) || (std::memcmp(haystack + i + offset + 1, needle + 1, needle_length - 2) == 0)) return i + offset;
+
+            candidates &= candidates - 1;
+        }
+    }
+
+    return find_substring_tail(haystack, length, i, needle, needle_length);
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef PM_IDENTIFIER_SEARCH_IMPL_H
+#define PM_IDENTIFIER_SEARCH_IMPL_H
+#pragma once
+
+#include "cpu_features.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+/*
+ * Internal definitions shared between the different
+ * implementations of the substring search.
+ */
+
+namespace pm::detail
+{
+    /*
+     * Finds the first place the needle occurs in the haystack and
+     * returns its position, or the length of the haystack if it
+     * does not occur. The needle is at least one byte long.
+     */
+    using find_substring_fn = std::size_t(*)
+    (
+        std::uint8_t const* haystack,
+        std::size_t length,
+        std::uint8_t const* needle,
+        std::size_t needle_length
+    ) noexcept;
+
+    /*
+     * Portable implementation, built on memchr. Always
+     * available.
+     */
+    std::size_t find_substring_portable(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Tests 16 starting positions at once. Requires SSE2.
+     */
+    std::size_t find_substring_sse2(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept;
+
+    /*
+     * Tests 32 starting positions at once. Requires AVX2.
+     */
+    std::size_t find_substring_avx2(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    /*
+     * Tests 16 starting positions at once. NEON is always
+     * present.
+     */
+    std::size_t find_substring_neon(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept;
+#endif
+
+    /*
+     * Retrieves the fastest implementation supported by the
+     * processor.
+     */
+    find_substring_fn get_find_substring() noexcept;
+
+    /*
+     * Finishes a search the vector code stopped short of, from the
+     * first starting position it did not test.
+     */
+    static inline std::size_t find_substring_tail(std::uint8_t const* haystack, std::size_t length, std::size_t start, std::uint8_t const* needle, std::size_t needle_length) noexcept
+    {
+        auto const position = find_substring_portable(haystack + start, length - start, needle, needle_length);
+
+        return (position == length - start) ? length : start + position;
+    }
+
+    static inline unsigned lowest_set_bit(std::uint32_t x) noexcept
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, x);
+
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(x));
+#endif
+    }
+};
+
+#endif
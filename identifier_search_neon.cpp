@@ -0,0 +1,57 @@
+#include "identifier_search_impl.h"
+
+/*
+ * Implements the substring search with NEON, testing 16 starting
+ * positions at once. The first and last byte of the needle are
+ * compared at every position, and the bytes between are only
+ * compared where both match.
+ */
+
+#if defined(PM_ARCH_ARM64)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <arm64_neon.h>
+#else
+#   include <arm_neon.h>
+#endif
+
+#include <cstring>
+
+static constexpr std::size_t const parallel_positions = 16;
+
+std::size_t pm::detail::find_substring_neon(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept
+{
+    if (needle_length > length) return length;
+
+    auto const first = vdupq_n_u8(needle[0]);
+    auto const last  = vdupq_n_u8(needle[needle_length - 1]);
+
+    //Stop while the loads of the last bytes still fit in the haystack
+    std::size_t i = 0;
+    for (; i + needle_length - 1 + parallel_positions <= length; i += parallel_positions)
+    {
+        auto const matches = vandq_u8(vceqq_u8(first, vld1q_u8(haystack + i)), vceqq_u8(last, vld1q_u8(haystack + i + needle_length - 1)));
+
+        //There is no movemask, so narrow every byte to four bits of a 64-bit mask instead
+        auto const mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+
+        //One bit per position is enough, taking each half of the mask in turn
+        for (int half = 0; half < 2; half++)
+        {
+            auto candidates = static_cast<std::uint32_t>(mask >> (32 * half)) & 0x11111111u;
+
+            while (candidates != 0)
+            {
+                auto const offset = 8 * half + lowest_set_bit(candidates) / 4;
+
+                if ((needle_length <= 2) || (std::memcmp(haystack + i + offset + 1, needle + 1, needle_length - 2) == 0)) return i + offset;
+
+                candidates &= candidates - 1;
+            }
+        }
+    }
+
+    return find_substring_tail(haystack, length, i, needle, needle_length);
+}
+
+#endif
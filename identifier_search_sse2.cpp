@@ -0,0 +1,51 @@
+#include "identifier_search_impl.h"
+
+/*
+ * Implements the substring search with SSE2, testing 16 starting
+ * positions at once. The first and last byte of the needle are
+ * compared at every position, and the bytes between are only
+ * compared where both match.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("sse2")
+#endif
+
+#include <cstring>
+
+static constexpr std::size_t const parallel_positions = 16;
+
+std::size_t pm::detail::find_substring_sse2(std::uint8_t const* haystack, std::size_t length, std::uint8_t const* needle, std::size_t needle_length) noexcept
+{
+    if (needle_length > length) return length;
+
+    auto const first = _mm_set1_epi8(static_cast<char>(needle[0]));
+    auto const last  = _mm_set1_epi8(static_cast<char>(needle[needle_length - 1]));
+
+    //Stop while the loads of the last bytes still fit in the haystack
+    std::size_t i = 0;
+    for (; i + needle_length - 1 + parallel_positions <= length; i += parallel_positions)
+    {
+        auto const block_first = _mm_loadu_si128(reinterpret_cast<__m128i const*>(haystack + i));
+        auto const block_last  = _mm_loadu_si128(reinterpret_cast<__m128i const*>(haystack + i + needle_length - 1));
+
+        auto candidates = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+
+        while (candidates != 0)
+        {
+            auto const offset = lowest_set_bit(candidates);
+
+            if ((needle_length <= 2) || (std::memcmp(haystack + i + offset + 1, needle + 1, needle_length - 2) == 0)) return i + offset;
+
+            candidates &= candidates - 1;
+        }
+    }
+
+    return find_substring_tail(haystack, length, i, needle, needle_length);
+}
+
+#endif
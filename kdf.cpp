@@ -0,0 +1,236 @@
+#include "kdf.h"
+#include "argon2.h"
+#include "crypto.h"
+#include "pbkdf2.h"
+#include "sha256.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+std::error_code pm::make_kdf_params(kdf_params* params) noexcept
+{
+    return make_kdf_params(kdf_algorithm::ARGON2ID, params);
+}
+
+std::error_code pm::make_kdf_params(kdf_algorithm algorithm, kdf_params* params) noexcept
+{
+    switch (algorithm)
+    {
+        case kdf_algorithm::PBKDF2_HMAC_SHA256:
+        {
+            params->algorithm   = kdf_algorithm::PBKDF2_HMAC_SHA256;
+            params->time_cost   = default_pbkdf2_time_cost;
+            params->memory_cost = 0;
+            params->parallelism = default_pbkdf2_parallelism;
+            break;
+        }
+
+        case kdf_algorithm::ARGON2ID:
+        {
+            params->algorithm   = kdf_algorithm::ARGON2ID;
+            params->time_cost   = default_argon2_time_cost;
+            params->memory_cost = default_argon2_memory_cost;
+            params->parallelism = default_argon2_parallelism;
+            break;
+        }
+
+        //New archives never use the unsalted hash
+        default:
+            return ntstatus_t::NOT_SUPPORTED;
+    }
+
+    //Every archive gets its own salt
+    return get_random_bytes(params->salt);
+}
+
+using seconds = std::chrono::duration<double>;
+
+/*
+ * The shortest run that can be timed reliably when calibrating
+ * for the given latency.
+ */
+static seconds get_sample_time(std::chrono::milliseconds target_latency) noexcept
+{
+    return std::max(seconds(target_latency) / 10, seconds(0.01));
+}
+
+static void calibrate_pbkdf2(std::chrono::milliseconds target_latency, pm::kdf_params* params) noexcept
+{
+    using clock = std::chrono::steady_clock;
+
+    //Give every lane of every thread a chain of its own
+    params->parallelism = std::clamp(pm::security::pbkdf2_hmac_sha256_parallelism(), std::uint32_t{ 1 }, pm::max_pbkdf2_parallelism);
+
+    //The cost does not depend on the password or salt
+    auto key = pm::derived_key{};
+    auto run = [&](std::uint32_t iterations) noexcept
+    {
+        auto const start = clock::now();
+        pm::security::pbkdf2_hmac_sha256(nullptr, 0, params->salt, sizeof(params->salt), iterations, params->parallelism, key);
+
+        return seconds(clock::now() - start);
+    };
+
+    //Wake the thread pool up before anything is timed
+    run(1);
+
+    //Double the run until it is long enough to time reliably
+    auto const sample_time = get_sample_time(target_latency);
+    auto       iterations  = std::uint32_t{ 1000 };
+    auto       elapsed     = run(iterations);
+
+    while (elapsed < sample_time && iterations < pm::max_pbkdf2_time_cost / 2)
+    {
+        iterations *= 2;
+        elapsed     = run(iterations);
+    }
+
+    //Scale the iterations to the target
+    auto const scaled = iterations * (seconds(target_latency) / elapsed);
+
+    params->time_cost = static_cast<std::uint32_t>(std::clamp(scaled, static_cast<double>(pm::min_pbkdf2_time_cost), static_cast<double>(pm::max_pbkdf2_time_cost)));
+}
+
+static void calibrate_argon2(std::chrono::milliseconds target_latency, pm::kdf_params* params) noexcept
+{
+    using clock = std::chrono::steady_clock;
+
+    //Give every thread a lane of its own
+    auto const concurrency = static_cast<std::uint32_t>(std::min<std::size_t>(pm::thread_pool::get_shared().get_concurrency(), pm::max_argon2_parallelism));
+    params->parallelism = std::max(concurrency, pm::default_argon2_parallelism);
+
+    //The cost does not depend on the password or salt
+    std::uint8_t tag[32];
+    auto run = [&](std::uint32_t memory_cost) noexcept
+    {
+        auto const in = pm::security::argon2id::input
+        {
+            nullptr, 0,
+            params->salt, sizeof(params->salt),
+            nullptr, 0,
+            nullptr, 0,
+            params->time_cost,
+            memory_cost,
+            params->parallelism
+        };
+
+        auto const start = clock::now();
+        auto const done  = pm::security::argon2id::compute_hash(in, tag, sizeof(tag));
+
+        return done ? seconds(clock::now() - start) : seconds(-1);
+    };
+
+    //Double the memory until the run is long enough to time reliably
+    auto const sample_time = get_sample_time(target_latency);
+    auto       memory_cost = pm::min_argon2_memory_cost / 4;
+    auto       elapsed     = run(memory_cost);
+
+    while (elapsed >= seconds(0) && elapsed < sample_time && memory_cost <= pm::max_argon2_memory_cost / 2)
+    {
+        memory_cost *= 2;
+        elapsed      = run(memory_cost);
+    }
+
+    //Keep the defaults if not even that much memory could be had
+    if (elapsed <= seconds(0)) return;
+
+    //The cost grows with the memory, so scale it to the target
+    auto scaled = memory_cost * (seconds(target_latency) / elapsed);
+
+    //Small samples stay in the cache, so time the estimate once and correct it
+    if (scaled > memory_cost && scaled <= pm::max_argon2_memory_cost)
+    {
+        memory_cost = static_cast<std::uint32_t>(scaled);
+        elapsed     = run(memory_cost);
+
+        if (elapsed > seconds(0)) scaled = memory_cost * (seconds(target_latency) / elapsed);
+    }
+
+    params->memory_cost = static_cast<std::uint32_t>(std::clamp(scaled, static_cast<double>(pm::min_argon2_memory_cost), static_cast<double>(pm::max_argon2_memory_cost)));
+
+    //Spend what time is left over once the memory is capped on more passes
+    if (scaled > pm::max_argon2_memory_cost)
+    {
+        auto const passes = params->time_cost * (scaled / pm::max_argon2_memory_cost);
+        params->time_cost = static_cast<std::uint32_t>(std::min(passes, static_cast<double>(pm::max_argon2_time_cost)));
+    }
+}
+
+std::error_code pm::calibrate_kdf_params(kdf_algorithm algorithm, std::chrono::milliseconds target_latency, kdf_params* params) noexcept
+{
+    auto err = make_kdf_params(algorithm, params);
+    if (err) return err;
+
+    if (algorithm == kdf_algorithm::PBKDF2_HMAC_SHA256) calibrate_pbkdf2(target_latency, params);
+    if (algorithm == kdf_algorithm::ARGON2ID)           calibrate_argon2(target_latency, params);
+
+    return ntstatus_t::SUCCESS;
+}
+
+std::error_code pm::derive_key(span<std::uint8_t> password, kdf_params const& params, derived_key* key) noexcept
+{
+    switch (params.algorithm)
+    {
+        case kdf_algorithm::SHA256:
+        {
+            security::sha256::compute_hash(password.data(), static_cast<std::uint64_t>(password.size()), *key);
+
+            return ntstatus_t::SUCCESS;
+        }
+
+        case kdf_algorithm::PBKDF2_HMAC_SHA256:
+        {
+            //Refuse parameters that would never finish, or do no work at all
+            if (params.time_cost == 0)                       return ntstatus_t::INVALID_PARAMETER;
+            if (params.time_cost > max_pbkdf2_time_cost)     return ntstatus_t::INVALID_PARAMETER;
+            if (params.parallelism == 0)                     return ntstatus_t::INVALID_PARAMETER;
+            if (params.parallelism > max_pbkdf2_parallelism) return ntstatus_t::INVALID_PARAMETER;
+
+            security::pbkdf2_hmac_sha256
+            (
+                password.data(),
+                static_cast<std::size_t>(password.size()),
+                params.salt,
+                sizeof(params.salt),
+                params.time_cost,
+                params.parallelism,
+                *key
+            );
+
+            return ntstatus_t::SUCCESS;
+        }
+
+        case kdf_algorithm::ARGON2ID:
+        {
+            //Refuse parameters that would never finish, or exhaust the machine
+            if (params.time_cost == 0)                             return ntstatus_t::INVALID_PARAMETER;
+            if (params.time_cost > max_argon2_time_cost)           return ntstatus_t::INVALID_PARAMETER;
+            if (params.parallelism == 0)                           return ntstatus_t::INVALID_PARAMETER;
+            if (params.parallelism > max_argon2_parallelism)       return ntstatus_t::INVALID_PARAMETER;
+            if (params.memory_cost < 8 * params.parallelism)       return ntstatus_t::INVALID_PARAMETER;
+            if (params.memory_cost > max_argon2_memory_cost)       return ntstatus_t::INVALID_PARAMETER;
+
+            auto const in = security::argon2id::input
+            {
+                password.data(), static_cast<std::size_t>(password.size()),
+                params.salt,     sizeof(params.salt),
+                nullptr,         0,
+                nullptr,         0,
+                params.time_cost,
+                params.memory_cost,
+                params.parallelism
+            };
+
+            //The parameters are checked, so only the allocation can fail
+            if (!security::argon2id::compute_hash(in, key->data(), static_cast<std::uint32_t>(key->size())))
+                return ntstatus_t::NO_MEMORY;
+
+            return ntstatus_t::SUCCESS;
+        }
+
+        default:
+            return ntstatus_t::NOT_SUPPORTED;
+    }
+}
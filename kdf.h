@@ -0,0 +1,88 @@
+#ifndef PM_KDF_H
+#define PM_KDF_H
+#pragma once
+
+#include "ntstatus.h"
+#include "span.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace pm
+{
+    //The algorithms an archive key can be derived with
+    enum class kdf_algorithm : std::uint8_t
+    {
+        SHA256             = 0, //A single SHA-256 of the password, kept for old archives
+        PBKDF2_HMAC_SHA256 = 1,
+        ARGON2ID           = 2,
+    };
+
+    //The parameters a key was derived with, as stored in the archive
+    struct kdf_params
+    {
+        kdf_algorithm algorithm;
+        std::uint32_t time_cost;   //Number of iterations, or passes over the memory
+        std::uint32_t memory_cost; //Memory used in KiB, zero when the algorithm takes none
+        std::uint32_t parallelism; //Number of independent chains
+        std::uint8_t  salt[16];
+    };
+
+    using derived_key = std::array<std::uint8_t, 32>;
+
+    //The iterations of each PBKDF2 chain when nothing better is known
+    inline constexpr std::uint32_t default_pbkdf2_time_cost = 200000;
+
+    //The PBKDF2 chains, a multiple of the widest SIMD transform
+    inline constexpr std::uint32_t default_pbkdf2_parallelism = 16;
+
+    //The most PBKDF2 chains an archive may ask for
+    inline constexpr std::uint32_t max_pbkdf2_parallelism = 1024;
+
+    //The fewest iterations calibration will settle for, however slow the machine
+    inline constexpr std::uint32_t min_pbkdf2_time_cost = 10000;
+
+    //The most iterations an archive may ask for, so a forged header cannot keep unlocking busy for days
+    inline constexpr std::uint32_t max_pbkdf2_time_cost = 10000000;
+
+    //The passes Argon2id makes over its memory, as RFC 9106 recommends
+    inline constexpr std::uint32_t default_argon2_time_cost = 3;
+
+    //The memory Argon2id fills, in KiB
+    inline constexpr std::uint32_t default_argon2_memory_cost = 64 * 1024;
+
+    //The Argon2id lanes, filled in parallel
+    inline constexpr std::uint32_t default_argon2_parallelism = 4;
+
+    //The least memory calibration will settle for, the OWASP minimum
+    inline constexpr std::uint32_t min_argon2_memory_cost = 19 * 1024;
+
+    //The most memory an archive may ask for, so a forged header cannot exhaust the machine
+    inline constexpr std::uint32_t max_argon2_memory_cost = 4 * 1024 * 1024;
+
+    //The most Argon2id lanes an archive may ask for
+    inline constexpr std::uint32_t max_argon2_parallelism = 255;
+
+    //The most passes an archive may ask for
+    inline constexpr std::uint32_t max_argon2_time_cost = 1024;
+
+    //How long unlocking an archive should take when nothing else is asked for
+    inline constexpr std::chrono::milliseconds default_unlock_latency{ 250 };
+
+    //Fills in the default parameters for a new archive, with a fresh random salt
+    [[nodiscard]] std::error_code make_kdf_params(kdf_params* params) noexcept;
+
+    //Fills in the parameters of the algorithm for a new archive, with a fresh random salt
+    [[nodiscard]] std::error_code make_kdf_params(kdf_algorithm algorithm, kdf_params* params) noexcept;
+
+    //Fills in the parameters of the algorithm for a new archive, with a fresh random salt and
+    //the highest cost that derives the key within the target latency on this machine
+    [[nodiscard]] std::error_code calibrate_kdf_params(kdf_algorithm algorithm, std::chrono::milliseconds target_latency, kdf_params* params) noexcept;
+
+    //Derives the archive key from the password
+    [[nodiscard]] std::error_code derive_key(span<std::uint8_t> password, kdf_params const& params, derived_key* key) noexcept;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "large_pages.h"
+#include "secure_memory.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#else
+#   include <sys/mman.h>
+#endif
+
+/*
+ * Rounds a size up to a multiple of a power of two.
+ */
+static std::size_t round_up(std::size_t size, std::size_t multiple) noexcept
+{
+    return (size + multiple - 1) & ~(multiple - 1);
+}
+
+pm::large_page_buffer::large_page_buffer(std::size_t size) noexcept
+{
+    if (size == 0) return;
+
+#if defined(_WIN32)
+    //Large pages need the "Lock pages in memory" privilege, so this may well fail
+    auto const large_page_size = GetLargePageMinimum();
+    if (large_page_size > 0)
+    {
+        auto const rounded = round_up(size, large_page_size);
+
+        this->ptr = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (this->ptr)
+        {
+            this->length = rounded;
+            this->large  = true;
+
+            return;
+        }
+    }
+
+    //Settle for ordinary pages
+    this->ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (this->ptr) this->length = size;
+#else
+    constexpr std::size_t const large_page_size = 2 * 1024 * 1024;
+
+#   if defined(MAP_HUGETLB)
+    //Explicit huge pages only work if the administrator has reserved some
+    {
+        auto const rounded = round_up(size, large_page_size);
+
+        auto* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            this->ptr    = p;
+            this->length = rounded;
+            this->large  = true;
+
+            return;
+        }
+    }
+#   endif
+
+    //Settle for ordinary pages, and ask for transparent huge pages
+    auto const rounded = round_up(size, large_page_size);
+
+    auto* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return;
+
+    this->ptr    = p;
+    this->length = rounded;
+
+#   if defined(MADV_HUGEPAGE)
+    this->large = (madvise(p, rounded, MADV_HUGEPAGE) == 0);
+#   endif
+#endif
+}
+
+pm::large_page_buffer::large_page_buffer(large_page_buffer&& other) noexcept
+    : ptr   { std::exchange(other.ptr,    nullptr) },
+      length{ std::exchange(other.length, 0)       },
+      large { std::exchange(other.large,  false)   }
+{}
+
+pm::large_page_buffer& pm::large_page_buffer::operator = (large_page_buffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        this->ptr    = std::exchange(other.ptr,    nullptr);
+        this->length = std::exchange(other.length, 0);
+        this->large  = std::exchange(other.large,  false);
+    }
+
+    return *this;
+}
+
+pm::large_page_buffer::~large_page_buffer()
+{
+    this->release();
+}
+
+void pm::large_page_buffer::release() noexcept
+{
+    if (this->ptr == nullptr) return;
+
+    secure_wipe(this->ptr, this->length);
+
+#if defined(_WIN32)
+    VirtualFree(this->ptr, 0, MEM_RELEASE);
+#else
+    munmap(this->ptr, this->length);
+#endif
+
+    this->ptr    = nullptr;
+    this->length = 0;
+    this->large  = false;
+}
@@ -0,0 +1,62 @@
+#ifndef PM_LARGE_PAGES_H
+#define PM_LARGE_PAGES_H
+#pragma once
+
+#include <cstddef>
+
+/*
+ * An owning buffer taken straight from the operating system,
+ * backed by large pages where the system allows it. Meant for
+ * big working areas that are swept over many times, where the
+ * TLB misses of ordinary pages add up. The memory is wiped
+ * before it is given back.
+ */
+
+namespace pm
+{
+    struct large_page_buffer
+    {
+    public:
+        large_page_buffer() noexcept = default;
+
+        /*
+         * Allocates at least size bytes, aligned to a page.
+         * Falls back to ordinary pages when large pages are not
+         * available, and leaves the buffer empty if even that
+         * fails.
+         */
+        explicit large_page_buffer(std::size_t size) noexcept;
+
+        large_page_buffer(large_page_buffer&& other) noexcept;
+        large_page_buffer& operator = (large_page_buffer&& other) noexcept;
+
+        large_page_buffer(large_page_buffer const&) = delete;
+        large_page_buffer& operator = (large_page_buffer const&) = delete;
+
+        ~large_page_buffer();
+
+        void* data() const noexcept
+        {
+            return this->ptr;
+        }
+
+        std::size_t size() const noexcept
+        {
+            return this->length;
+        }
+
+        bool uses_large_pages() const noexcept
+        {
+            return this->large;
+        }
+
+    private:
+        void release() noexcept;
+
+        void*       ptr    = nullptr;
+        std::size_t length = 0;
+        bool        large  = false;
+    };
+};
+
+#endif
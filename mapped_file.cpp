@@ -0,0 +1,121 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <utility>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+pm::mapped_file::mapped_file(char const* path, access pattern) noexcept
+{
+    auto const sequential = (pattern == access::SEQUENTIAL);
+
+#if defined(_WIN32)
+    auto const hint = sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+    auto const file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | hint, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    //An empty file cannot be mapped, and one larger than the address space does not fit
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && (size.QuadPart > 0) && (static_cast<std::uint64_t>(size.QuadPart) <= SIZE_MAX))
+    {
+        //The view keeps the mapping alive after the handles are closed
+        auto const mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            auto const* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (view)
+            {
+                this->ptr    = static_cast<std::uint8_t const*>(view);
+                this->length = static_cast<std::size_t>(size.QuadPart);
+            }
+
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+
+    //Start reading the file in while the caller gets going, unless only parts of it are wanted
+    if (this->ptr && sequential)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range{ const_cast<std::uint8_t*>(this->ptr), this->length };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    auto const fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    //An empty file cannot be mapped, and one larger than the address space does not fit
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0) && (static_cast<std::uint64_t>(st.st_size) <= SIZE_MAX))
+    {
+        auto const size = static_cast<std::size_t>(st.st_size);
+
+        //The mapping stays valid after the descriptor is closed
+        auto* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            this->ptr    = static_cast<std::uint8_t const*>(p);
+            this->length = size;
+
+            //A file read once from start to end is read ahead hard and started now, other files are left to the system
+            if (sequential)
+            {
+#   if defined(MADV_SEQUENTIAL)
+                madvise(p, size, MADV_SEQUENTIAL);
+#   endif
+#   if defined(MADV_WILLNEED)
+                madvise(p, size, MADV_WILLNEED);
+#   endif
+            }
+        }
+    }
+
+    close(fd);
+#endif
+}
+
+pm::mapped_file::mapped_file(mapped_file&& other) noexcept
+    : ptr   { std::exchange(other.ptr,    nullptr) },
+      length{ std::exchange(other.length, 0)       }
+{}
+
+pm::mapped_file& pm::mapped_file::operator = (mapped_file&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        this->ptr    = std::exchange(other.ptr,    nullptr);
+        this->length = std::exchange(other.length, 0);
+    }
+
+    return *this;
+}
+
+pm::mapped_file::~mapped_file()
+{
+    this->release();
+}
+
+void pm::mapped_file::release() noexcept
+{
+    if (this->ptr == nullptr) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(this->ptr);
+#else
+    munmap(const_cast<std::uint8_t*>(this->ptr), this->length);
+#endif
+
+    this->ptr    = nullptr;
+    this->length = 0;
+}
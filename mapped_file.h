@@ -0,0 +1,69 @@
+#ifndef PM_MAPPED_FILE_H
+#define PM_MAPPED_FILE_H
+#pragma once
+
+#include "span.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * A whole file mapped read-only into memory. The pages are read in
+ * by the system as they are first touched, so opening a large file
+ * neither copies it nor allocates its size up front. The system is
+ * told how the file will be read: from start to end, so it reads
+ * ahead of the reader, or only in parts, so nothing is read before
+ * it is touched.
+ */
+
+namespace pm
+{
+    struct mapped_file
+    {
+    public:
+        enum class access
+        {
+            SEQUENTIAL,
+            SPARSE,
+        };
+
+        mapped_file() noexcept = default;
+
+        /*
+         * Maps the file at the path. Leaves the mapping empty if
+         * the file cannot be opened or mapped, or is empty.
+         */
+        explicit mapped_file(char const* path, access pattern = access::SEQUENTIAL) noexcept;
+
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator = (mapped_file&& other) noexcept;
+
+        mapped_file(mapped_file const&) = delete;
+        mapped_file& operator = (mapped_file const&) = delete;
+
+        ~mapped_file();
+
+        std::uint8_t const* data() const noexcept
+        {
+            return this->ptr;
+        }
+
+        std::size_t size() const noexcept
+        {
+            return this->length;
+        }
+
+        operator span<std::uint8_t>() const noexcept
+        {
+            return { this->ptr, static_cast<std::ptrdiff_t>(this->length) };
+        }
+
+    private:
+        void release() noexcept;
+
+        std::uint8_t const* ptr    = nullptr;
+        std::size_t         length = 0;
+    };
+};
+
+#endif
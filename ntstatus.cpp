@@ -22,6 +22,7 @@ struct ntstatus_category : std::error_category
             X(NOT_SUPPORTED)
             X(INVALID_BUFFER_SIZE)
             X(NOT_FOUND)
+            X(AUTH_TAG_MISMATCH)
             X(SUCCESS)
             default: return "UNKNOWN_ERROR";
         }
@@ -17,6 +17,7 @@ namespace pm
         NOT_SUPPORTED       = static_cast<std::int32_t>(0xC00000BBL),
         INVALID_BUFFER_SIZE = static_cast<std::int32_t>(0xC0000206L),
         NOT_FOUND           = static_cast<std::int32_t>(0xC0000225L),
+        AUTH_TAG_MISMATCH   = static_cast<std::int32_t>(0xC000A002L),
 
         SUCCESS             = static_cast<std::int32_t>(0x00000000L)
     };
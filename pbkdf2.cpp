@@ -0,0 +1,252 @@
+#include "pbkdf2.h"
+#include "hmac.h"
+#include "secure_memory.h"
+#include "sha256_impl.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+ * Each chain of PBKDF2 iterates U_k = HMAC(P, U_k-1). Past
+ * the first iteration, U is always a single digest, so with
+ * the HMAC midstates in hand every iteration is exactly two
+ * compressions: the block holding U after K ^ ipad, and the
+ * block holding the inner digest after K ^ opad. Both blocks
+ * carry the same padding, so it is written once and only the
+ * digest at the front is replaced.
+ */
+
+using byte = std::uint8_t;
+using word = std::uint32_t;
+
+using pm::security::sha256;
+using pm::security::hmac_sha256;
+using pm::security::detail::sha256_max_lanes;
+
+namespace
+{
+    using chain_value = std::array<word, sha256::digest_length / sizeof(word)>;
+
+    /*
+     * Everything the chains of one derivation share.
+     */
+    struct derivation
+    {
+        hmac_sha256   mac;
+        byte const*   salt;
+        std::size_t   salt_length;
+        std::uint32_t iterations;
+    };
+};
+
+/*
+ * Writes the words of an intermediate hash value to the start
+ * of a block in big-endian order, reading every stride'th word
+ * of the state.
+ */
+static void store_digest(word const* state, std::size_t stride, byte* block) noexcept
+{
+    for (std::size_t i = 0; i < std::tuple_size_v<chain_value>; i++)
+        pm::security::detail::sha256_ops::store_big_endian(block + i * sizeof(word), state[i * stride]);
+}
+
+/*
+ * Prepares a block that holds a digest as the last block of
+ * an HMAC message: the digest, the byte 0x80, zeros, and the
+ * bit length of one block of key followed by the digest.
+ */
+static void init_digest_block(byte* block) noexcept
+{
+    constexpr std::uint64_t const bit_count = (sha256::block_length + sha256::digest_length) * 8;
+
+    std::fill(block, block + sha256::block_length, byte{ 0 });
+    block[sha256::digest_length] = 0x80;
+
+    for (int j = 0; j < 8; j++)
+        block[sha256::block_length - 1 - j] = static_cast<byte>(bit_count >> (j * 8));
+}
+
+/*
+ * Computes U_1 = HMAC(P, S || INT(i)) into the front of the
+ * block, and returns it as the start of the chain value.
+ */
+static chain_value first_iteration(derivation const& d, std::uint32_t index, byte* block) noexcept
+{
+    byte const counter[4]
+    {
+        static_cast<byte>(index >> 24),
+        static_cast<byte>(index >> 16),
+        static_cast<byte>(index >>  8),
+        static_cast<byte>(index >>  0)
+    };
+
+    auto mac = d.mac;
+    mac.init();
+    mac.update(d.salt, d.salt_length);
+    mac.update(counter, sizeof(counter));
+
+    hmac_sha256::digest u{};
+    mac.finish(u);
+    mac.clear();
+
+    std::copy(u.begin(), u.end(), block);
+
+    chain_value t{};
+    for (std::size_t i = 0; i < t.size(); i++)
+        t[i] = pm::security::detail::sha256_ops::load_big_endian(block + i * sizeof(word));
+
+    return t;
+}
+
+/*
+ * Runs a single chain with the single-lane transform.
+ */
+static chain_value run_chain(derivation const& d, std::uint32_t index) noexcept
+{
+    auto const& inner = d.mac.get_inner_midstate().get_state();
+    auto const& outer = d.mac.get_outer_midstate().get_state();
+
+    byte block[sha256::block_length];
+    init_digest_block(block);
+
+    auto t = first_iteration(d, index, block);
+
+    for (std::uint32_t k = 1; k < d.iterations; k++)
+    {
+        //Hash the previous U after K ^ ipad
+        auto state = inner;
+        pm::security::detail::sha256_transform_dispatch(state.data(), block, 1);
+        store_digest(state.data(), 1, block);
+
+        //Hash the inner digest after K ^ opad, giving the next U
+        state = outer;
+        pm::security::detail::sha256_transform_dispatch(state.data(), block, 1);
+        store_digest(state.data(), 1, block);
+
+        for (std::size_t i = 0; i < t.size(); i++) t[i] ^= state[i];
+    }
+
+    return t;
+}
+
+/*
+ * Runs up to one chain per lane of a multi-lane transform, and
+ * returns the XOR of their values. Lanes past the last chain
+ * hash a dummy block and are ignored.
+ */
+static chain_value run_chains_in_lanes
+(
+    derivation const& d,
+    pm::security::detail::sha256_lanes kernel,
+    std::uint32_t first_index,
+    std::size_t count
+) noexcept
+{
+    auto const [transform, lanes] = kernel;
+
+    auto const& inner = d.mac.get_inner_midstate().get_state();
+    auto const& outer = d.mac.get_outer_midstate().get_state();
+
+    alignas(64) word states[8 * sha256_max_lanes];
+    byte             blocks  [sha256_max_lanes][sha256::block_length];
+    byte const*      pointers[sha256_max_lanes];
+    chain_value      t       [sha256_max_lanes]{};
+
+    for (std::size_t l = 0; l < lanes; l++)
+    {
+        init_digest_block(blocks[l]);
+        pointers[l] = blocks[l];
+
+        if (l < count) t[l] = first_iteration(d, first_index + static_cast<std::uint32_t>(l), blocks[l]);
+    }
+
+    for (std::uint32_t k = 1; k < d.iterations; k++)
+    {
+        //Hash the previous U of every lane after K ^ ipad
+        for (std::size_t i = 0; i < inner.size(); i++)
+            std::fill(states + i * lanes, states + (i + 1) * lanes, inner[i]);
+
+        transform(states, pointers);
+
+        for (std::size_t l = 0; l < lanes; l++)
+            store_digest(states + l, lanes, blocks[l]);
+
+        //Hash the inner digests after K ^ opad, giving the next U
+        for (std::size_t i = 0; i < outer.size(); i++)
+            std::fill(states + i * lanes, states + (i + 1) * lanes, outer[i]);
+
+        transform(states, pointers);
+
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            store_digest(states + l, lanes, blocks[l]);
+
+            for (std::size_t i = 0; i < t[l].size(); i++) t[l][i] ^= states[i * lanes + l];
+        }
+    }
+
+    //Combine the chains
+    chain_value result{};
+    for (std::size_t l = 0; l < count; l++)
+    {
+        for (std::size_t i = 0; i < result.size(); i++) result[i] ^= t[l][i];
+    }
+
+    return result;
+}
+
+void pm::security::pbkdf2_hmac_sha256
+(
+    std::uint8_t const* password,
+    std::size_t password_length,
+    std::uint8_t const* salt,
+    std::size_t salt_length,
+    std::uint32_t iterations,
+    std::uint32_t parallelism,
+    std::array<std::uint8_t, sha256::digest_length>& key
+) noexcept
+{
+    assert(iterations  > 0);
+    assert(parallelism > 0);
+
+    derivation d{ hmac_sha256{ password, password_length }, salt, salt_length, iterations };
+
+    //Group the chains by the lanes of the transform
+    auto const kernel = detail::get_sha256_lanes();
+    auto const lanes  = std::max<std::size_t>(kernel.lanes, 1);
+    auto const groups = (parallelism + lanes - 1) / lanes;
+
+    std::mutex  result_lock;
+    chain_value result{};
+
+    thread_pool::get_shared().parallel_for(groups, [&](std::size_t group) noexcept
+    {
+        //The blocks of PBKDF2 are numbered from one
+        auto const first = static_cast<std::uint32_t>(group * lanes + 1);
+        auto const count = std::min<std::size_t>(lanes, parallelism - group * lanes);
+
+        auto const t = (kernel.lanes > 0) ? run_chains_in_lanes(d, kernel, first, count) : run_chain(d, first);
+
+        std::lock_guard<std::mutex> guard{ result_lock };
+        for (std::size_t i = 0; i < result.size(); i++) result[i] ^= t[i];
+    });
+
+    store_digest(result.data(), 1, key.data());
+
+    //The midstates stand in for the password
+    d.mac.clear();
+    secure_wipe(result.data(), sizeof(result));
+}
+
+std::uint32_t pm::security::pbkdf2_hmac_sha256_parallelism() noexcept
+{
+    auto const lanes   = std::max<std::size_t>(detail::get_sha256_lanes().lanes, 1);
+    auto const threads = thread_pool::get_shared().get_concurrency();
+
+    return static_cast<std::uint32_t>(lanes * threads);
+}
@@ -0,0 +1,50 @@
+#ifndef PM_PBKDF2_H
+#define PM_PBKDF2_H
+#pragma once
+
+/*
+ * Implements PBKDF2 as described in RFC 8018 (January 2017),
+ * with HMAC-SHA-256 as the pseudorandom function.
+ */
+
+#include "sha256.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace pm::security
+{
+    /*
+     * Derives a 256-bit key from a password and salt.
+     *
+     * The key is the XOR of the first parallelism blocks
+     * T_1 ... T_p of the PBKDF2 output, each of which is an
+     * independent chain of the given number of iterations.
+     * With a parallelism of one this is plain PBKDF2 with a
+     * 32 byte output.
+     *
+     * The chains are spread across the SIMD lanes and the
+     * threads of the processor, so a parallelism matching the
+     * hardware buys a higher total cost for the same latency.
+     * The result never depends on the hardware it runs on.
+     */
+    void pbkdf2_hmac_sha256
+    (
+        std::uint8_t const* password,
+        std::size_t password_length,
+        std::uint8_t const* salt,
+        std::size_t salt_length,
+        std::uint32_t iterations,
+        std::uint32_t parallelism,
+        std::array<std::uint8_t, sha256::digest_length>& key
+    ) noexcept;
+
+    /*
+     * Retrieves the parallelism that keeps every SIMD lane of
+     * every thread busy on this machine.
+     */
+    std::uint32_t pbkdf2_hmac_sha256_parallelism() noexcept;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "poly1305.h"
+#include "secure_memory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+/*
+ * Implements Poly1305 as described in RFC 8439 (June 2018).
+ *
+ * The accumulator h and the key r are numbers modulo 2^130 - 5
+ * held in five 26-bit limbs. The products of two limbs fit in 64
+ * bits with room to add five of them up, and the limbs that spill
+ * past 2^130 wrap around multiplied by 5.
+ */
+
+using byte = std::uint8_t;
+
+using pm::security::poly1305;
+
+//The bits of a limb
+static constexpr std::uint32_t const limb_mask = 0x3FFFFFF;
+
+static std::uint32_t load_little_endian(byte const* p) noexcept
+{
+    return (static_cast<std::uint32_t>(p[0]) <<  0) |
+           (static_cast<std::uint32_t>(p[1]) <<  8) |
+           (static_cast<std::uint32_t>(p[2]) << 16) |
+           (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+static void store_little_endian(byte* p, std::uint32_t x) noexcept
+{
+    p[0] = static_cast<byte>(x >>  0);
+    p[1] = static_cast<byte>(x >>  8);
+    p[2] = static_cast<byte>(x >> 16);
+    p[3] = static_cast<byte>(x >> 24);
+}
+
+void pm::security::poly1305::context::init(byte const* key) noexcept
+{
+    //Clamp r while splitting it into limbs
+    this->r[0] = (load_little_endian(key +  0) >> 0) & 0x3FFFFFF;
+    this->r[1] = (load_little_endian(key +  3) >> 2) & 0x3FFFF03;
+    this->r[2] = (load_little_endian(key +  6) >> 4) & 0x3FFC0FF;
+    this->r[3] = (load_little_endian(key +  9) >> 6) & 0x3F03FFF;
+    this->r[4] = (load_little_endian(key + 12) >> 8) & 0x00FFFFF;
+
+    for (std::size_t i = 0; i < 4; i++) this->pad[i] = load_little_endian(key + 16 + 4 * i);
+
+    std::fill(std::begin(this->h), std::end(this->h), std::uint32_t{ 0 });
+    this->buffer_length = 0;
+}
+
+void pm::security::poly1305::context::process_blocks(byte const* data, std::size_t block_count, std::uint32_t high_bit) noexcept
+{
+    auto const r0 = this->r[0], r1 = this->r[1], r2 = this->r[2], r3 = this->r[3], r4 = this->r[4];
+    auto const s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+
+    auto h0 = this->h[0], h1 = this->h[1], h2 = this->h[2], h3 = this->h[3], h4 = this->h[4];
+
+    for (; block_count > 0; block_count--, data += block_length)
+    {
+        //h += m, with the bit above the block set
+        h0 += (load_little_endian(data +  0) >> 0) & limb_mask;
+        h1 += (load_little_endian(data +  3) >> 2) & limb_mask;
+        h2 += (load_little_endian(data +  6) >> 4) & limb_mask;
+        h3 += (load_little_endian(data +  9) >> 6) & limb_mask;
+        h4 += (load_little_endian(data + 12) >> 8) | high_bit;
+
+        //h *= r
+        auto const d0 = std::uint64_t{ h0 } * r0 + std::uint64_t{ h1 } * s4 + std::uint64_t{ h2 } * s3 + std::uint64_t{ h3 } * s2 + std::uint64_t{ h4 } * s1;
+        auto       d1 = std::uint64_t{ h0 } * r1 + std::uint64_t{ h1 } * r0 + std::uint64_t{ h2 } * s4 + std::uint64_t{ h3 } * s3 + std::uint64_t{ h4 } * s2;
+        auto       d2 = std::uint64_t{ h0 } * r2 + std::uint64_t{ h1 } * r1 + std::uint64_t{ h2 } * r0 + std::uint64_t{ h3 } * s4 + std::uint64_t{ h4 } * s3;
+        auto       d3 = std::uint64_t{ h0 } * r3 + std::uint64_t{ h1 } * r2 + std::uint64_t{ h2 } * r1 + std::uint64_t{ h3 } * r0 + std::uint64_t{ h4 } * s4;
+        auto       d4 = std::uint64_t{ h0 } * r4 + std::uint64_t{ h1 } * r3 + std::uint64_t{ h2 } * r2 + std::uint64_t{ h3 } * r1 + std::uint64_t{ h4 } * r0;
+
+        //Carry the limbs back down to 26 bits, partly
+        std::uint32_t c;
+        c = static_cast<std::uint32_t>(d0 >> 26); h0 = static_cast<std::uint32_t>(d0) & limb_mask;
+        d1 += c; c = static_cast<std::uint32_t>(d1 >> 26); h1 = static_cast<std::uint32_t>(d1) & limb_mask;
+        d2 += c; c = static_cast<std::uint32_t>(d2 >> 26); h2 = static_cast<std::uint32_t>(d2) & limb_mask;
+        d3 += c; c = static_cast<std::uint32_t>(d3 >> 26); h3 = static_cast<std::uint32_t>(d3) & limb_mask;
+        d4 += c; c = static_cast<std::uint32_t>(d4 >> 26); h4 = static_cast<std::uint32_t>(d4) & limb_mask;
+        h0 += c * 5;   c = h0 >> 26;                       h0 = h0 & limb_mask;
+        h1 += c;
+    }
+
+    this->h[0] = h0; this->h[1] = h1; this->h[2] = h2; this->h[3] = h3; this->h[4] = h4;
+}
+
+void pm::security::poly1305::context::update(byte const* data, std::size_t data_length) noexcept
+{
+    //Fill up a partial block first
+    if (this->buffer_length > 0)
+    {
+        auto const count = std::min(block_length - this->buffer_length, data_length);
+        std::memcpy(this->buffer + this->buffer_length, data, count);
+        this->buffer_length += count;
+        data                += count;
+        data_length         -= count;
+
+        if (this->buffer_length < block_length) return;
+
+        this->process_blocks(this->buffer, 1, 1u << 24);
+        this->buffer_length = 0;
+    }
+
+    //Then whole blocks straight from the input
+    auto const block_count = data_length / block_length;
+    this->process_blocks(data, block_count, 1u << 24);
+    data        += block_count * block_length;
+    data_length -= block_count * block_length;
+
+    //And keep the rest
+    std::memcpy(this->buffer, data, data_length);
+    this->buffer_length = data_length;
+}
+
+void pm::security::poly1305::context::finish(byte* tag) noexcept
+{
+    //A final partial block is padded with a one and zeros instead of the high bit
+    if (this->buffer_length > 0)
+    {
+        this->buffer[this->buffer_length] = 1;
+        std::fill(this->buffer + this->buffer_length + 1, this->buffer + block_length, byte{ 0 });
+        this->process_blocks(this->buffer, 1, 0);
+    }
+
+    auto h0 = this->h[0], h1 = this->h[1], h2 = this->h[2], h3 = this->h[3], h4 = this->h[4];
+
+    //Carry fully
+    std::uint32_t c;
+    c = h1 >> 26; h1 &= limb_mask;
+    h2 += c; c = h2 >> 26; h2 &= limb_mask;
+    h3 += c; c = h3 >> 26; h3 &= limb_mask;
+    h4 += c; c = h4 >> 26; h4 &= limb_mask;
+    h0 += c * 5; c = h0 >> 26; h0 &= limb_mask;
+    h1 += c;
+
+    //Compute h - p, which is h + 5 - 2^130
+    auto g0 = h0 + 5; c = g0 >> 26; g0 &= limb_mask;
+    auto g1 = h1 + c; c = g1 >> 26; g1 &= limb_mask;
+    auto g2 = h2 + c; c = g2 >> 26; g2 &= limb_mask;
+    auto g3 = h3 + c; c = g3 >> 26; g3 &= limb_mask;
+    auto g4 = h4 + c - (1u << 26);
+
+    //Keep h - p unless it went negative, without branching
+    auto const mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    //Pack into 32-bit words and add the pad modulo 2^128
+    std::uint32_t const words[4]
+    {
+        (h0 >>  0) | (h1 << 26),
+        (h1 >>  6) | (h2 << 20),
+        (h2 >> 12) | (h3 << 14),
+        (h3 >> 18) | (h4 <<  8),
+    };
+
+    std::uint64_t f = 0;
+    for (std::size_t i = 0; i < 4; i++)
+    {
+        f = std::uint64_t{ words[i] } + this->pad[i] + (f >> 32);
+        store_little_endian(tag + 4 * i, static_cast<std::uint32_t>(f));
+    }
+
+    pm::secure_wipe(this, sizeof(*this));
+}
+
+void pm::security::poly1305::compute_mac(byte const* key, byte const* data, std::size_t data_length, byte* tag) noexcept
+{
+    context ctx;
+    ctx.init(key);
+    ctx.update(data, data_length);
+    ctx.finish(tag);
+}
+
+/*
+ * The example of RFC 8439 section 2.5.2.
+ */
+static constexpr byte const rfc8439_key[32]
+{
+    0x85, 0xD6, 0xBE, 0x78, 0x57, 0x55, 0x6D, 0x33, 0x7F, 0x44, 0x52, 0xFE, 0x42, 0xD5, 0x06, 0xA8,
+    0x01, 0x03, 0x80, 0x8A, 0xFB, 0x0D, 0xB2, 0xFD, 0x4A, 0xBF, 0xF6, 0xAF, 0x41, 0x49, 0xF5, 0x1B
+};
+
+static constexpr char const rfc8439_message[] = "Cryptographic Forum Research Group";
+
+static constexpr byte const rfc8439_tag[16]
+{
+    0xA8, 0x06, 0x1D, 0xC1, 0x30, 0x51, 0x36, 0xC6, 0xC2, 0x2B, 0x8B, 0xAF, 0x0C, 0x01, 0x27, 0xA9
+};
+
+bool pm::security::poly1305::self_test() noexcept
+{
+    auto const* message = reinterpret_cast<byte const*>(rfc8439_message);
+    auto const  length  = sizeof(rfc8439_message) - 1;
+
+    byte tag[tag_length];
+    compute_mac(rfc8439_key, message, length, tag);
+    if (!std::equal(std::begin(tag), std::end(tag), rfc8439_tag)) return false;
+
+    //Feed it again a byte at a time, to check the buffering
+    context ctx;
+    ctx.init(rfc8439_key);
+    for (std::size_t i = 0; i < length; i++) ctx.update(message + i, 1);
+    ctx.finish(tag);
+
+    return std::equal(std::begin(tag), std::end(tag), rfc8439_tag);
+}
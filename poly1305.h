@@ -0,0 +1,76 @@
+#ifndef PM_POLY1305_H
+#define PM_POLY1305_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Implements the Poly1305 one-time authenticator as described in
+ * RFC 8439 (June 2018). A key must never authenticate more than
+ * one message.
+ *
+ * The arithmetic is done in five 26-bit limbs with 64-bit
+ * products, which needs nothing wider than the compiler offers
+ * everywhere and runs in constant time.
+ */
+
+namespace pm::security
+{
+    struct poly1305
+    {
+        static constexpr std::size_t const block_length = 16;
+        static constexpr std::size_t const key_length   = 32;
+        static constexpr std::size_t const tag_length   = 16;
+
+        using byte = std::uint8_t;
+
+        /*
+         * A low-level authenticating primitive.
+         */
+        struct context
+        {
+        public:
+            /*
+             * Prepares the context to authenticate one message
+             * under the given key.
+             */
+            void init(byte const* key) noexcept;
+
+            /*
+             * Feeds an arbitrary amount of the message. Can be
+             * called any number of times.
+             */
+            void update(byte const* data, std::size_t data_length) noexcept;
+
+            /*
+             * Writes the tag of the message fed so far. The
+             * context must be initialized again before it is
+             * reused.
+             */
+            void finish(byte* tag) noexcept;
+
+        private:
+            void process_blocks(byte const* data, std::size_t block_count, std::uint32_t high_bit) noexcept;
+
+            std::uint32_t r[5];
+            std::uint32_t h[5];
+            std::uint32_t pad[4];
+            byte          buffer[block_length];
+            std::size_t   buffer_length;
+        };
+
+        /*
+         * Computes the tag of a whole message under the given key.
+         */
+        static void compute_mac(byte const* key, byte const* data, std::size_t data_length, byte* tag) noexcept;
+
+        /*
+         * Runs the known-answer test from RFC 8439. Returns false
+         * if it got it wrong.
+         */
+        static bool self_test() noexcept;
+    };
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "identifier_search.h"
+#include "xorshift.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Measures the latency of identifier searches on a synthetic vault,
+ * one query at a time as a user would type them. Each query runs a
+ * number of times and the table shows the minimum, median and 99th
+ * percentile latency, along with how many results came back.
+ *
+ * Usage: search_benchmark [--entries N] [--repetitions N] [--results K]
+ */
+
+using clock_type = std::chrono::steady_clock;
+
+//The pieces identifiers are made of, so they share words the way real ones do
+static char const* const services[]
+{
+    "github", "gitlab", "google", "amazon", "netflix", "spotify", "dropbox", "twitter",
+    "facebook", "linkedin", "reddit", "discord", "slack", "zoom", "paypal", "stripe",
+    "bank", "mail", "cloud", "office", "router", "server", "vpn", "wiki",
+};
+
+static char const* const qualifiers[]
+{
+    "work", "home", "personal", "admin", "test", "backup", "old", "shared",
+};
+
+static char const* const domains[]
+{
+    ".com", ".org", ".net", ".io", ".example.com", ".local",
+};
+
+//Queries of each kind the engine handles, from a keystroke or two up to a whole name
+static char const* const queries[][2]
+{
+    { "short",       "gi"                },
+    { "prefix",      "github"            },
+    { "substring",   "hub-work"          },
+    { "rare",        "spotify-admin-77"  },
+    { "typo",        "githb-work"        },
+    { "typo first",  "xgitlab-work"      },
+    { "subsequence", "gthbadm"           },
+    { "no match",    "qqzzxx"            },
+};
+
+struct sample_summary
+{
+    double min;
+    double median;
+    double p99;
+};
+
+static sample_summary summarize(std::vector<double> values) noexcept
+{
+    std::sort(values.begin(), values.end());
+
+    auto const n = values.size();
+
+    return sample_summary
+    {
+        values.front(),
+        values[n / 2],
+        values[std::min(n - 1, (n * 99) / 100)],
+    };
+}
+
+static void print_usage() noexcept
+{
+    std::printf("Usage: search_benchmark [--entries N] [--repetitions N] [--results K]\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t entry_count = 100000;
+    std::size_t repetitions = 200;
+    std::size_t max_results = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto const has_value = (i + 1 < argc);
+
+        if (std::strcmp(argv[i], "--entries") == 0 && has_value)
+            entry_count = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && has_value)
+            repetitions = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        else if (std::strcmp(argv[i], "--results") == 0 && has_value)
+            max_results = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    //The same vault every run, so results can be compared
+    std::uint64_t const seed[2]{ 0x9E3779B97F4A7C15, 0xD1B54A32D192ED03 };
+    pm::xorshift_state  rng{ seed };
+
+    auto const pick = [&](auto const& list) noexcept
+    {
+        return list[rng.next() % (sizeof(list) / sizeof(list[0]))];
+    };
+
+    std::vector<std::string> identifiers;
+    identifiers.reserve(entry_count);
+
+    for (std::size_t i = 0; i < entry_count; i++)
+    {
+        auto id = std::string(pick(services)) + "-" + pick(qualifiers) + "-" + std::to_string(rng.next() % 1000) + pick(domains);
+        if (rng.next() % 4 == 0) id[0] = static_cast<char>(id[0] - 'a' + 'A');
+
+        identifiers.push_back(std::move(id));
+    }
+
+    static char const password[]{ "hunter2" };
+
+    std::vector<pm::entry> entries;
+    entries.reserve(entry_count);
+
+    for (auto const& id : identifiers)
+    {
+        entries.push_back(pm::entry
+        {
+            pm::span<char>(id.data(), static_cast<std::ptrdiff_t>(id.size())),
+            pm::span<char>(password,  static_cast<std::ptrdiff_t>(sizeof(password) - 1)),
+        });
+    }
+
+    auto const build_start = clock_type::now();
+    pm::identifier_search engine{ entries };
+    auto const build_end   = clock_type::now();
+
+    std::printf("Indexed %zu identifiers in %.1f ms\n\n", engine.size(), std::chrono::duration<double, std::milli>(build_end - build_start).count());
+    std::printf("%-12s %-18s %8s %12s %12s %12s\n", "kind", "query", "results", "min us", "median us", "p99 us");
+
+    for (auto const& q : queries)
+    {
+        auto const query = pm::span<char>(q[1], static_cast<std::ptrdiff_t>(std::strlen(q[1])));
+
+        std::vector<double> times;
+        std::size_t         found = 0;
+
+        for (std::size_t r = 0; r < repetitions; r++)
+        {
+            auto const start   = clock_type::now();
+            auto const results = engine.search(query, max_results);
+            auto const end     = clock_type::now();
+
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            found = results.size();
+        }
+
+        auto const s = summarize(times);
+
+        std::printf("%-12s %-18s %8zu %12.1f %12.1f %12.1f\n", q[0], q[1], found, s.min, s.median, s.p99);
+    }
+
+    return 0;
+}
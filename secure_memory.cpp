@@ -0,0 +1,34 @@
+#include "secure_memory.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#endif
+
+void pm::secure_wipe(void* ptr, std::size_t size) noexcept
+{
+    if (ptr == nullptr) return;
+
+#if defined(_WIN32)
+    SecureZeroMemory(ptr, size);
+#else
+    std::memset(ptr, 0, size);
+
+    //Make the stores visible to an unknown reader
+    __asm__ __volatile__("" : : "r"(ptr) : "memory");
+#endif
+}
+
+bool pm::secure_equal(void const* a, void const* b, std::size_t size) noexcept
+{
+    auto const* x = static_cast<unsigned char const volatile*>(a);
+    auto const* y = static_cast<unsigned char const volatile*>(b);
+
+    //Gather every difference rather than stopping at the first one
+    unsigned char difference = 0;
+    for (std::size_t i = 0; i < size; i++) difference |= static_cast<unsigned char>(x[i] ^ y[i]);
+
+    return difference == 0;
+}
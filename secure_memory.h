@@ -0,0 +1,43 @@
+#ifndef PM_SECURE_MEMORY_H
+#define PM_SECURE_MEMORY_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace pm
+{
+    /*
+     * Clears memory that held secrets, in a way the compiler
+     * may not remove even though the memory is never read
+     * again.
+     */
+    void secure_wipe(void* ptr, std::size_t size) noexcept;
+
+    /*
+     * Compares two buffers in a time that depends only on their
+     * size, for checking secrets such as authentication tags.
+     */
+    bool secure_equal(void const* a, void const* b, std::size_t size) noexcept;
+
+    /*
+     * Wipes an array before freeing it, for std::unique_ptr. It
+     * carries the number of elements, since the array does not.
+     */
+    template<typename T>
+    struct secure_array_deleter
+    {
+        std::size_t count = 0;
+
+        void operator ()(T* ptr) const noexcept
+        {
+            secure_wipe(ptr, this->count * sizeof(T));
+            delete[] ptr;
+        }
+    };
+
+    using secure_byte_array = std::unique_ptr<std::uint8_t[], secure_array_deleter<std::uint8_t>>;
+};
+
+#endif
@@ -1,437 +1,431 @@
 #include "sha256.h"
+#include "sha256_impl.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
 
 /*
  * Implements SHA-256 as described in FIPS PUB 180-4 (August 2015).
  */
 
-//We will assume any non-win32 targets have endian.h
-#if !defined(_WIN32)
-#   include <endian.h>
-#endif
-
-#if !defined(LITTLE_ENDIAN)
-#   define LITTLE_ENDIAN 1234
-#endif
-
-#if !defined(BIG_ENDIAN)
-#   define BIG_ENDIAN 4321
-#endif
-
-#if !defined(BYTE_ORDER)
-#   pragma message("Warning: Byte order is not defined! Assuming little-endian")
-#   define BYTE_ORDER LITTLE_ENDIAN
-#endif
-
-#if defined(__has_attribute)
-#   if __has_attribute(const)
-#       define pure __attribute__((const))
-#   endif
-#endif
-
-#if !defined(pure)
-#   define pure
-#endif
-
 /* Types defined for SHA-256 */
 
 using byte = std::uint8_t;
 using word = std::uint32_t;
 
-/* Operations defined for SHA-256 */
+/* Implementation */
 
-/*
- * Discards the right-most n bits of the word and pads the result
- * with n zero bits on the left.
- */
-pure static constexpr word right_shift(word x, byte n) noexcept
-{
-    constexpr byte const w = sizeof(word) * 8;
+using std::uint64_t;
 
-    assert(n < w);
+using pm::security::detail::sha256_initial_hash_value;
+using pm::security::detail::sha256_pad_final_blocks;
+using pm::security::detail::sha256_transform_fn;
 
-    return static_cast<word>(x >> n);
+void pm::security::detail::sha256_transform_scalar(word* state, byte const* data, std::size_t block_count) noexcept
+{
+    sha256_transform_portable(state, data, block_count);
 }
 
 /*
- * Discards the left-most n bits of the word and pads the result
- * with n zero bits on the right.
+ * Picks the fastest transform supported by the processor.
  */
-pure static constexpr word left_shift(word x, byte n) noexcept
+static sha256_transform_fn select_transform() noexcept
 {
-    constexpr byte const w = sizeof(word) * 8;
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
 
-    assert(n < w);
+#if defined(PM_ARCH_X86)
+    if (cpu.sha && cpu.ssse3 && cpu.sse41) return pm::security::detail::sha256_transform_shani;
+#endif
 
-    return static_cast<word>(x << n);
+#if defined(PM_ARCH_ARM64)
+    if (cpu.sha2) return pm::security::detail::sha256_transform_armv8;
+#endif
+
+    return pm::security::detail::sha256_transform_scalar;
 }
 
-/* 
- * Performs the bitwise-and operation, where each bit in the result
- * is 1 if both words have a 1 in the same location, otherwise it
- * is 0.
+/*
+ * Retrieves the transform selected for this processor.
+ * The selection is only made once.
  */
-pure static constexpr word bitwise_and(word lhs, word rhs) noexcept
+static sha256_transform_fn get_transform() noexcept
 {
-    return lhs & rhs;
+    static sha256_transform_fn const transform = select_transform();
+
+    return transform;
 }
 
-/* 
- * Performs the bitwise-or ("inclusive-or") operation, where each
- * bit in the result is 1 if either word has a 1 in the same
- * location, otherwise it is 0.
- */
-pure static constexpr word bitwise_or(word lhs, word rhs) noexcept
+void pm::security::detail::sha256_transform_dispatch(word* state, byte const* data, std::size_t block_count) noexcept
 {
-    return lhs | rhs;
+    get_transform()(state, data, block_count);
 }
 
-/* 
- * Performs the bitwise-xor ("exclusive-or") operation, where each
- * bit in the result is 1 if only one word has a 1 in the same
- * location, otherwise it is 0.
- */
-pure static constexpr word bitwise_xor(word lhs, word rhs) noexcept
+pm::security::detail::sha256_lanes pm::security::detail::get_sha256_lanes() noexcept
 {
-    return lhs ^ rhs;
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    //The SHA extensions outrun anything narrower than AVX-512
+    auto const shani = cpu.sha && cpu.ssse3 && cpu.sse41;
+
+    if (cpu.avx512f)         return { sha256_lanes_avx512, 16 };
+    if (cpu.avx2  && !shani) return { sha256_lanes_avx2,    8 };
+    if (cpu.sse41 && !shani) return { sha256_lanes_sse41,   4 };
+#endif
+
+    return { nullptr, 0 };
 }
 
 /*
- * Performs the bitwise-complement operation, where each bit in
- * the result is the opposite of what is in the input.
+ * Writes the words of an intermediate hash value in big-endian
+ * order, reading every stride'th word of the state.
  */
-pure static constexpr word bitwise_complement(word x) noexcept
+static void write_digest(word const* state, std::size_t stride, byte* digest) noexcept
 {
-    return ~x;
+    for (std::size_t i = 0; i < 8; i++)
+    {
+        auto const w = state[i * stride];
+
+        digest[i * 4 + 0] = static_cast<byte>((w & 0xFF000000u) >> 24);
+        digest[i * 4 + 1] = static_cast<byte>((w & 0x00FF0000u) >> 16);
+        digest[i * 4 + 2] = static_cast<byte>((w & 0x0000FF00u) >>  8);
+        digest[i * 4 + 3] = static_cast<byte>((w & 0x000000FFu) >>  0);
+    }
 }
 
 /*
- * Performs the rotate right (circular right shift) operation,
- * which is defined as: right_rotate(x, n) := 
- *     bitwise_or(right_shift(x, n), left_shift(x, w - n))
- * where w is the number of bits in a word.
- * The operation is thus equivalent to a circular shift
- * of x by n positions to the right.
+ * Hashes a message with a single-lane transform. The whole
+ * blocks are fed straight from the message, followed by the
+ * padded tail.
  */
-pure static constexpr word right_rotate(word x, byte n) noexcept
+static void hash_message(sha256_transform_fn transform, byte const* data, uint64_t data_length, byte* digest) noexcept
 {
-    constexpr byte const w = sizeof(word) * 8;
+    constexpr auto const block_length = pm::security::sha256::block_length;
 
-    word const rs = right_shift(x, n);
-    word const ls = left_shift (x, w - n);
+    //Setup the state
+    word state[8];
+    std::copy(std::begin(sha256_initial_hash_value), std::end(sha256_initial_hash_value), state);
 
-    return bitwise_or(rs, ls);
-}
+    //Process the whole blocks
+    auto const whole = data_length / block_length;
+    transform(state, data, static_cast<std::size_t>(whole));
 
-/* Functions defined for SHA-256 */
+    //Process the padded tail
+    byte tail[2 * block_length];
+    auto const tail_blocks = sha256_pad_final_blocks(data + whole * block_length, data_length % block_length, data_length, tail);
+    transform(state, tail, tail_blocks);
 
-/*
- * The first of six logical functions defined for SHA-256.
- * Referred to as "Ch" in the specification.
- */
-pure static constexpr word F0(word x, word y, word z) noexcept
-{
-    word const l = bitwise_and(x, y);
-    word const r = bitwise_and(bitwise_complement(x), z);
-
-    return bitwise_xor(l, r);
+    write_digest(state, 1, digest);
 }
 
 /*
- * The second of six logical functions defined for SHA-256.
- * Referred to as "Maj" in the specification.
+ * Hashes a batch of messages with a multi-lane transform. Each
+ * lane is given a message, and as soon as a lane has fed the
+ * last block of its message it is handed the next one. Lanes
+ * left without a message are fed a dummy block.
  */
-pure static constexpr word F1(word x, word y, word z) noexcept
+static void hash_in_lanes
+(
+    pm::security::detail::sha256_lanes kernel,
+    byte const* const* data,
+    uint64_t const* data_lengths,
+    std::array<byte, pm::security::sha256::digest_length>* digests,
+    std::size_t count
+) noexcept
 {
-    word const t0 = bitwise_and(x, y);
-    word const t1 = bitwise_and(x, z);
-    word const t2 = bitwise_and(y, z);
-
-    return bitwise_xor
-    (
-        bitwise_xor(t0, t1),
-        t2
-    );
+    using pm::security::detail::sha256_max_lanes;
+
+    constexpr auto const block_length = pm::security::sha256::block_length;
+
+    auto const [transform, lanes] = kernel;
+
+    //The bookkeeping needed for each lane
+    struct lane_job
+    {
+        std::size_t message;
+        byte const* next;
+        uint64_t    full_blocks;
+        std::size_t tail_blocks;
+        std::size_t tail_fed;
+        byte        tail[2 * block_length];
+    };
+
+    //An idle lane is fed this block, and its result discarded
+    static byte const idle_block[block_length]{};
+
+    alignas(64) word states[8 * sha256_max_lanes];
+    lane_job         jobs  [sha256_max_lanes];
+    byte const*      blocks[sha256_max_lanes];
+    bool             active[sha256_max_lanes]{};
+
+    //Assigns the next unhashed message to a lane
+    std::size_t next_message = 0;
+    auto const assign = [&](std::size_t l) noexcept
+    {
+        if (next_message == count)
+        {
+            active[l] = false;
+            return;
+        }
+
+        auto&      job   = jobs[l];
+        auto const len   = data_lengths[next_message];
+        auto const whole = len / block_length;
+
+        job.message     = next_message++;
+        job.next        = data[job.message];
+        job.full_blocks = whole;
+        job.tail_blocks = sha256_pad_final_blocks(job.next + whole * block_length, len % block_length, len, job.tail);
+        job.tail_fed    = 0;
+
+        //Reset the intermediate hash value of the lane
+        for (std::size_t i = 0; i < 8; i++)
+            states[i * lanes + l] = sha256_initial_hash_value[i];
+
+        active[l] = true;
+    };
+
+    //Fill the lanes
+    for (std::size_t l = 0; l < lanes; l++) assign(l);
+
+    //Run until every lane has gone idle
+    while (std::any_of(active, active + lanes, [](bool a) { return a; }))
+    {
+        //Pick the next block of each lane
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            auto& job = jobs[l];
+
+            if (!active[l])
+            {
+                blocks[l] = idle_block;
+            }
+            else if (job.full_blocks > 0)
+            {
+                blocks[l] = job.next;
+                job.next += block_length;
+                job.full_blocks--;
+            }
+            else
+            {
+                blocks[l] = job.tail + job.tail_fed * block_length;
+                job.tail_fed++;
+            }
+        }
+
+        transform(states, blocks);
+
+        //Retire the lanes that fed their last block
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            auto const& job = jobs[l];
+
+            if (!active[l] || job.full_blocks > 0 || job.tail_fed < job.tail_blocks) continue;
+
+            write_digest(states + l, lanes, digests[job.message].data());
+
+            assign(l);
+        }
+    }
 }
 
-/*
- * The third of six logical functions defined for SHA-256.
- * Referred to as "Sigma0" in the specification.
- */
-pure static constexpr word F2(word x) noexcept
+void pm::security::sha256::compute_hashes
+(
+    byte const* const* data,
+    uint64_t const* data_lengths,
+    std::array<byte, digest_length>* digests,
+    std::size_t count
+) noexcept
 {
-    word const t0 = right_rotate(x,  2);
-    word const t1 = right_rotate(x, 13);
-    word const t2 = right_rotate(x, 22);
-
-    return bitwise_xor
-    (
-        bitwise_xor(t0, t1),
-        t2
-    );
+    //Pick the multi-lane transform
+    auto const kernel = detail::get_sha256_lanes();
+
+    //A single message gains nothing from the lanes
+    if (kernel.lanes == 0 || count == 1)
+    {
+        for (std::size_t m = 0; m < count; m++)
+            hash_message(get_transform(), data[m], data_lengths[m], digests[m].data());
+
+        return;
+    }
+
+    hash_in_lanes(kernel, data, data_lengths, digests, count);
 }
 
-/*
- * The fourth of six logical functions defined for SHA-256.
- * Referred to as "Sigma1" in the specification.
- */
-pure static constexpr word F3(word x) noexcept
+byte* pm::security::sha256::sha256_context::get_digest() noexcept
 {
-    word const t0 = right_rotate(x,  6);
-    word const t1 = right_rotate(x, 11);
-    word const t2 = right_rotate(x, 25);
-
-    return bitwise_xor
-    (
-        bitwise_xor(t0, t1),
-        t2
-    );
+    byte* result = new byte[digest_length];
+
+    //Insert the words in big-endian order
+    write_digest(this->state.data(), 1, result);
+
+    return result;
 }
 
-/*
- * The fifth of six logical functions defined for SHA-256.
- * Referred to as "sigma0" in the specification.
- */
-pure static constexpr word F4(word x) noexcept
+byte* pm::security::sha256::compute_hash(byte const* data, uint64_t data_length) noexcept
 {
-    word const t0 = right_rotate(x,  7);
-    word const t1 = right_rotate(x, 18);
-    word const t2 = right_shift (x,  3);
-
-    return bitwise_xor
-    (
-        bitwise_xor(t0, t1),
-        t2
-    );
+    byte* hash = new byte[digest_length];
+
+    //Hash the message straight into the result
+    hash_message(get_transform(), data, data_length, hash);
+
+    return hash;
 }
 
 /*
- * The sixth of six logical functions defined for SHA-256.
- * Referred to as "sigma1" in the specification.
+ * The examples given in FIPS PUB 180-4 and its accompanying
+ * test vectors.
  */
-pure static constexpr word F5(word x) noexcept
+namespace
 {
-    word const t0 = right_rotate(x, 17);
-    word const t1 = right_rotate(x, 19);
-    word const t2 = right_shift (x, 10);
-
-    return bitwise_xor
-    (
-        bitwise_xor(t0, t1),
-        t2
-    );
-}
-
-/* Constants defined for SHA-256 */
+    struct known_answer
+    {
+        char const* message;
+        byte        digest[pm::security::sha256::digest_length];
+    };
+};
 
-/*
- * These 64 constant words represent the first 32 bits
- * of the fractional parts of the cube roots of the 
- * first 64 prime numbers.
- */
-static constexpr word const sha256_hash_constants[64]
+static constexpr known_answer const known_answers[]
 {
-    0x428A2F98u, 0x71374491u, 0xB5C0FBCFu, 0xE9B5DBA5u,
-    0x3956C25Bu, 0x59F111F1u, 0x923F82A4u, 0xAB1C5ED5u,
-    0xD807AA98u, 0x12835B01u, 0x243185BEu, 0x550C7DC3u,
-    0x72BE5D74u, 0x80DEB1FEu, 0x9BDC06A7u, 0xC19BF174u,
-    0xE49B69C1u, 0xEFBE4786u, 0x0FC19DC6u, 0x240CA1CCu,
-    0x2DE92C6Fu, 0x4A7484AAu, 0x5CB0A9DCu, 0x76F988DAu,
-    0x983E5152u, 0xA831C66Du, 0xB00327C8u, 0xBF597FC7u,
-    0xC6E00BF3u, 0xD5A79147u, 0x06CA6351u, 0x14292967u,
-    0x27B70A85u, 0x2E1B2138u, 0x4D2C6DFCu, 0x53380D13u,
-    0x650A7354u, 0x766A0ABBu, 0x81C2C92Eu, 0x92722C85u,
-    0xA2BFE8A1u, 0xA81A664Bu, 0xC24B8B70u, 0xC76C51A3u,
-    0xD192E819u, 0xD6990624u, 0xF40E3585u, 0x106AA070u,
-    0x19A4C116u, 0x1E376C08u, 0x2748774Cu, 0x34B0BCB5u,
-    0x391C0CB3u, 0x4ED8AA4Au, 0x5B9CCA4Fu, 0x682E6FF3u,
-    0x748F82EEu, 0x78A5636Fu, 0x84C87814u, 0x8CC70208u,
-    0x90BEFFFAu, 0xA4506CEBu, 0xBEF9A3F7u, 0xC67178F2u
+    {
+        "",
+        {
+            0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14, 0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
+            0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C, 0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55
+        }
+    },
+    {
+        "abc",
+        {
+            0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+            0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD
+        }
+    },
+    {
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+        {
+            0x24, 0x8D, 0x6A, 0x61, 0xD2, 0x06, 0x38, 0xB8, 0xE5, 0xC0, 0x26, 0x93, 0x0C, 0x3E, 0x60, 0x39,
+            0xA3, 0x3C, 0xE4, 0x59, 0x64, 0xFF, 0x21, 0x67, 0xF6, 0xEC, 0xED, 0xD4, 0x19, 0xDB, 0x06, 0xC1
+        }
+    },
+    {
+        "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+        {
+            0xCF, 0x5B, 0x16, 0xA7, 0x78, 0xAF, 0x83, 0x80, 0x03, 0x6C, 0xE5, 0x9E, 0x7B, 0x04, 0x92, 0x37,
+            0x0B, 0x24, 0x9B, 0x11, 0xE8, 0xF0, 0x7A, 0x51, 0xAF, 0xAC, 0x45, 0x03, 0x7A, 0xFE, 0xE9, 0xD1
+        }
+    }
 };
 
 /*
- * These 8 constant words are the initial hash value
- * used in SHA-256 and were obtained by taking the
- * first 32 bits of the fractional parts of the
- * square roots of the first eight prime numbers.
+ * Checks a digest computed in a constant expression against
+ * one of the known answers.
  */
-static constexpr word const sha256_initial_hash_value[8]
+static constexpr bool matches_known_answer(known_answer const& test) noexcept
 {
-    0x6A09E667u, 0xBB67AE85u, 0x3C6EF372u, 0xA54FF53Au,
-    0x510E527Fu, 0x9B05688Cu, 0x1F83D9ABu, 0x5BE0CD19u
-};
+    auto const digest = pm::security::sha256::digest(std::string_view{ test.message });
 
-/* Implementation */
-
-using std::uint64_t;
+    for (std::size_t i = 0; i < digest.size(); i++)
+    {
+        if (digest[i] != test.digest[i]) return false;
+    }
 
-void pm::security::sha256::sha256_context::init() noexcept
-{
-    //Setup the state
-    std::copy
-    (
-        std::begin(sha256_initial_hash_value),
-        std::end  (sha256_initial_hash_value),
-        std::begin(this->state)
-    );
+    return true;
 }
 
-void pm::security::sha256::sha256_context::update(byte const* data) noexcept
+//Make sure the portable transform also works at compile-time
+static_assert(matches_known_answer(known_answers[0]), "SHA-256 is broken in constant expressions!");
+static_assert(matches_known_answer(known_answers[1]), "SHA-256 is broken in constant expressions!");
+static_assert(matches_known_answer(known_answers[2]), "SHA-256 is broken in constant expressions!");
+static_assert(matches_known_answer(known_answers[3]), "SHA-256 is broken in constant expressions!");
+
+bool pm::security::sha256::self_test() noexcept
 {
-    //Initialize our eight working variables with previous state
-    word a = this->state[0],
-         b = this->state[1],
-         c = this->state[2],
-         d = this->state[3],
-         e = this->state[4],
-         f = this->state[5],
-         g = this->state[6],
-         h = this->state[7];
-
-    //Treat the input as words
-    auto M = reinterpret_cast<word const*>(data);
-
-    //Prepare the message schedule W
-    word W[64];
-    for (int t = 0; t < 16; t++)
+    //Gather every transform this processor can run
+    auto const& cpu = pm::cpu::get_features();
+    std::pair<sha256_transform_fn, bool> const transforms[]
     {
-#if (BYTE_ORDER == LITTLE_ENDIAN)
-        W[t] = ((M[t] & 0x000000FFu) << 24) |
-               ((M[t] & 0x0000FF00u) <<  8) |
-               ((M[t] & 0x00FF0000u) >>  8) |
-               ((M[t] & 0xFF000000u) >> 24);
-#else
-        W[t] = M[t];
+        { detail::sha256_transform_scalar, true },
+#if defined(PM_ARCH_X86)
+        { detail::sha256_transform_shani,  cpu.sha && cpu.ssse3 && cpu.sse41 },
 #endif
-    }
-    for (int t = 16; t < 64; t++)
+#if defined(PM_ARCH_ARM64)
+        { detail::sha256_transform_armv8,  cpu.sha2 },
+#endif
+    };
+
+    std::pair<detail::sha256_lanes, bool> const lane_transforms[]
     {
-        W[t] = F5(W[t - 2]) + W[t - 7] + F4(W[t - 15]) + W[t - 16];
-    }
+#if defined(PM_ARCH_X86)
+        { { detail::sha256_lanes_sse41,   4 }, cpu.sse41   },
+        { { detail::sha256_lanes_avx2,    8 }, cpu.avx2    },
+        { { detail::sha256_lanes_avx512, 16 }, cpu.avx512f },
+#endif
+        { { nullptr, 0 }, false }
+    };
+
+    //Prepare the messages
+    constexpr auto const count = std::size(known_answers);
 
-    //Perform the main transformation
-    for (int t = 0; t < 64; t++)
+    byte const*                     messages[count];
+    uint64_t                        lengths [count];
+    std::array<byte, digest_length> digests [count];
+
+    for (std::size_t i = 0; i < count; i++)
     {
-        word T1 = h + F3(e) + F0(e, f, g) + sha256_hash_constants[t] + W[t];
-        word T2 = F2(a) + F1(a, b, c);
-
-        h = g;
-        g = f;
-        f = e;
-        e = d + T1;
-        d = c;
-        c = b;
-        b = a;
-        a = T1 + T2;
+        messages[i] = reinterpret_cast<byte const*>(known_answers[i].message);
+        lengths [i] = static_cast<uint64_t>(std::char_traits<char>::length(known_answers[i].message));
     }
 
-    //Calculate the intermediate hash value
-    this->state[0] += a;
-    this->state[1] += b;
-    this->state[2] += c;
-    this->state[3] += d;
-    this->state[4] += e;
-    this->state[5] += f;
-    this->state[6] += g;
-    this->state[7] += h;
-}
-
-void pm::security::sha256::sha256_context::update_final(byte const* data, uint64_t data_length, uint64_t message_length) noexcept
-{
-    //Check that it's not too big
-    assert(data_length < sha256::block_length);
+    //Compares the digests with the known answers
+    auto const check = [&]() noexcept
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (!std::equal(digests[i].begin(), digests[i].end(), known_answers[i].digest)) return false;
+        }
 
-    //Preprocess the block
-    auto [padded_data, padded_size] = sha256::pad_message(data, data_length, message_length);
+        return true;
+    };
 
-    //Process the blocks
-    for (uint64_t i = 0; i < (padded_size / sha256::block_length); i++)
-        this->update(padded_data + (i * sha256::block_length));
+    //Check each transform against each known answer
+    for (auto const& [transform, supported] : transforms)
+    {
+        if (!supported) continue;
 
-    //Cleanup
-    delete[] padded_data;
-}
+        for (std::size_t i = 0; i < count; i++)
+            hash_message(transform, messages[i], lengths[i], digests[i].data());
 
-byte* pm::security::sha256::sha256_context::get_digest() noexcept
-{
-    byte* result = new byte[digest_length];
+        if (!check()) return false;
+    }
 
-    //Iterate over the words
-    for (unsigned int i = 0; i < digest_length / sizeof(word); i++)
+    //Check the streaming interface, feeding the messages a byte at a time
+    for (std::size_t i = 0; i < count; i++)
     {
-        //Read the word
-        word w = this->state[i];
-
-        //Insert the bytes in big-endian order
-        result[i * 4 + 0] = static_cast<byte>((w & 0xFF000000u) >> 24);
-        result[i * 4 + 1] = static_cast<byte>((w & 0x00FF0000u) >> 16);
-        result[i * 4 + 2] = static_cast<byte>((w & 0x0000FF00u) >>  8);
-        result[i * 4 + 3] = static_cast<byte>((w & 0x000000FFu) >>  0);
+        sha256_context ctx;
+        ctx.init();
+
+        for (uint64_t j = 0; j < lengths[i]; j++) ctx.update(messages[i] + j, 1);
+
+        ctx.finish(digests[i]);
     }
 
-    return result;
-}
+    if (!check()) return false;
 
-std::tuple<byte*, uint64_t> pm::security::sha256::pad_message(byte const* data, uint64_t data_length, uint64_t message_length) noexcept
-{
-    constexpr auto const mask    = static_cast<uint64_t>(sha256::block_length - 1);
-    constexpr auto const min_pad = 1 + sizeof(uint64_t); //The byte 0x80 + length of message
-
-    //Check that it's not too big
-    assert(message_length < sha256::max_message_length);
-
-    //Calculate how big of an allocation we must make
-    uint64_t const padded_size = ((data_length + min_pad) + mask) & ~mask;
-
-    //Allocate space for the padded data
-    byte* padded_data = new byte[padded_size];
-
-    //Copy the data
-    uint64_t i = 0;
-    for (; i < data_length; i++) padded_data[i] = data[i];
-
-    //Pad the data
-    padded_data[i++] = static_cast<byte>(0x80);
-    for (; i < (padded_size - sizeof(uint64_t)); i++) 
-        padded_data[i] = 0;
-
-    //Add the length
-    auto const bit_count = message_length * 8;
-#if (BYTE_ORDER == LITTLE_ENDIAN)
-    *reinterpret_cast<uint64_t*>(&padded_data[i]) =
-               ((bit_count & 0x00000000000000FFull) << 56) |
-               ((bit_count & 0x000000000000FF00ull) << 40) |
-               ((bit_count & 0x0000000000FF0000ull) << 24) |
-               ((bit_count & 0x00000000FF000000ull) <<  8) |
-               ((bit_count & 0x000000FF00000000ull) >>  8) |
-               ((bit_count & 0x0000FF0000000000ull) >> 24) |
-               ((bit_count & 0x00FF000000000000ull) >> 40) |
-               ((bit_count & 0xFF00000000000000ull) >> 56);
-#else
-    *reinterpret_cast<uint64_t*>(&padded_data[i]) = bit_count;
-#endif
+    //Check each multi-lane transform, with all the known answers in flight at once
+    for (auto const& [kernel, supported] : lane_transforms)
+    {
+        if (!supported) continue;
 
-    return { padded_data, padded_size };
-}
+        hash_in_lanes(kernel, messages, lengths, digests, count);
 
-byte* pm::security::sha256::compute_hash(byte const* data, uint64_t data_length) noexcept
-{
-    //Prepare the message
-    auto [padded_data, padded_size] = sha256::pad_message(data, data_length, data_length);
-    
-    //Initialize the hashing primitive
-    sha256_context ctx;
-    ctx.init();
-
-    //Process the blocks
-    for (uint64_t i = 0; i < (padded_size / sha256::block_length); i++)
-        ctx.update(padded_data + (i * sha256::block_length));
-
-    //Retrieve the hash
-    byte* hash = ctx.get_digest();
-
-    //Cleanup and return result
-    delete[] padded_data;
-    return hash;
+        if (!check()) return false;
+    }
+
+    return true;
 }
@@ -1,15 +1,419 @@
 #ifndef PM_SHA256_H
-#define PM_SHA256_h
+#define PM_SHA256_H
 #pragma once
 
 /*
  * Implements SHA-256 as described in FIPS PUB 180-4 (August 2015).
+ *
+ * Everything except get_digest, compute_hash with an allocated
+ * result, compute_hashes and self_test can be used in constant
+ * expressions. At run-time the same functions use the fastest
+ * transform the processor supports.
  */
 
 #include <array>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
-#include <tuple>
+#include <string_view>
+
+#if defined(__has_builtin)
+#   if __has_builtin(__builtin_is_constant_evaluated)
+#       define PM_HAS_IS_CONSTANT_EVALUATED 1
+#   endif
+#endif
+
+#if !defined(PM_HAS_IS_CONSTANT_EVALUATED) && defined(_MSC_VER) && (_MSC_VER >= 1925)
+#   define PM_HAS_IS_CONSTANT_EVALUATED 1
+#endif
+
+namespace pm::security::detail::sha256_ops
+{
+    /* Types defined for SHA-256 */
+
+    using byte = std::uint8_t;
+    using word = std::uint32_t;
+
+    /* Operations defined for SHA-256 */
+
+    /*
+     * Discards the right-most n bits of the word and pads the result
+     * with n zero bits on the left.
+     */
+    inline constexpr word right_shift(word x, byte n) noexcept
+    {
+        constexpr byte const w = sizeof(word) * 8;
+
+        assert(n < w);
+
+        return static_cast<word>(x >> n);
+    }
+
+    /*
+     * Discards the left-most n bits of the word and pads the result
+     * with n zero bits on the right.
+     */
+    inline constexpr word left_shift(word x, byte n) noexcept
+    {
+        constexpr byte const w = sizeof(word) * 8;
+
+        assert(n < w);
+
+        return static_cast<word>(x << n);
+    }
+
+    /* 
+     * Performs the bitwise-and operation, where each bit in the result
+     * is 1 if both words have a 1 in the same location, otherwise it
+     * is 0.
+     */
+    inline constexpr word bitwise_and(word lhs, word rhs) noexcept
+    {
+        return lhs & rhs;
+    }
+
+    /* 
+     * Performs the bitwise-or ("inclusive-or") operation, where each
+     * bit in the result is 1 if either word has a 1 in the same
+     * location, otherwise it is 0.
+     */
+    inline constexpr word bitwise_or(word lhs, word rhs) noexcept
+    {
+        return lhs | rhs;
+    }
+
+    /* 
+     * Performs the bitwise-xor ("exclusive-or") operation, where each
+     * bit in the result is 1 if only one word has a 1 in the same
+     * location, otherwise it is 0.
+     */
+    inline constexpr word bitwise_xor(word lhs, word rhs) noexcept
+    {
+        return lhs ^ rhs;
+    }
+
+    /*
+     * Performs the bitwise-complement operation, where each bit in
+     * the result is the opposite of what is in the input.
+     */
+    inline constexpr word bitwise_complement(word x) noexcept
+    {
+        return ~x;
+    }
+
+    /*
+     * Performs the rotate right (circular right shift) operation,
+     * which is defined as: right_rotate(x, n) := 
+     *     bitwise_or(right_shift(x, n), left_shift(x, w - n))
+     * where w is the number of bits in a word.
+     * The operation is thus equivalent to a circular shift
+     * of x by n positions to the right.
+     */
+    inline constexpr word right_rotate(word x, byte n) noexcept
+    {
+        constexpr byte const w = sizeof(word) * 8;
+
+        word const rs = right_shift(x, n);
+        word const ls = left_shift (x, w - n);
+
+        return bitwise_or(rs, ls);
+    }
+
+    /* Functions defined for SHA-256 */
+
+    /*
+     * The first of six logical functions defined for SHA-256.
+     * Referred to as "Ch" in the specification.
+     */
+    inline constexpr word F0(word x, word y, word z) noexcept
+    {
+        word const l = bitwise_and(x, y);
+        word const r = bitwise_and(bitwise_complement(x), z);
+
+        return bitwise_xor(l, r);
+    }
+
+    /*
+     * The second of six logical functions defined for SHA-256.
+     * Referred to as "Maj" in the specification.
+     */
+    inline constexpr word F1(word x, word y, word z) noexcept
+    {
+        word const t0 = bitwise_and(x, y);
+        word const t1 = bitwise_and(x, z);
+        word const t2 = bitwise_and(y, z);
+
+        return bitwise_xor
+        (
+            bitwise_xor(t0, t1),
+            t2
+        );
+    }
+
+    /*
+     * The third of six logical functions defined for SHA-256.
+     * Referred to as "Sigma0" in the specification.
+     */
+    inline constexpr word F2(word x) noexcept
+    {
+        word const t0 = right_rotate(x,  2);
+        word const t1 = right_rotate(x, 13);
+        word const t2 = right_rotate(x, 22);
+
+        return bitwise_xor
+        (
+            bitwise_xor(t0, t1),
+            t2
+        );
+    }
+
+    /*
+     * The fourth of six logical functions defined for SHA-256.
+     * Referred to as "Sigma1" in the specification.
+     */
+    inline constexpr word F3(word x) noexcept
+    {
+        word const t0 = right_rotate(x,  6);
+        word const t1 = right_rotate(x, 11);
+        word const t2 = right_rotate(x, 25);
+
+        return bitwise_xor
+        (
+            bitwise_xor(t0, t1),
+            t2
+        );
+    }
+
+    /*
+     * The fifth of six logical functions defined for SHA-256.
+     * Referred to as "sigma0" in the specification.
+     */
+    inline constexpr word F4(word x) noexcept
+    {
+        word const t0 = right_rotate(x,  7);
+        word const t1 = right_rotate(x, 18);
+        word const t2 = right_shift (x,  3);
+
+        return bitwise_xor
+        (
+            bitwise_xor(t0, t1),
+            t2
+        );
+    }
+
+    /*
+     * The sixth of six logical functions defined for SHA-256.
+     * Referred to as "sigma1" in the specification.
+     */
+    inline constexpr word F5(word x) noexcept
+    {
+        word const t0 = right_rotate(x, 17);
+        word const t1 = right_rotate(x, 19);
+        word const t2 = right_shift (x, 10);
+
+        return bitwise_xor
+        (
+            bitwise_xor(t0, t1),
+            t2
+        );
+    }
+
+    /*
+     * Reads a word stored in big-endian byte order.
+     */
+    template<typename T>
+    inline constexpr word load_big_endian(T const* p) noexcept
+    {
+        return (static_cast<word>(static_cast<byte>(p[0])) << 24) |
+               (static_cast<word>(static_cast<byte>(p[1])) << 16) |
+               (static_cast<word>(static_cast<byte>(p[2])) <<  8) |
+               (static_cast<word>(static_cast<byte>(p[3])) <<  0);
+    }
+
+    /*
+     * Writes a word in big-endian byte order.
+     */
+    inline constexpr void store_big_endian(byte* p, word w) noexcept
+    {
+        p[0] = static_cast<byte>((w & 0xFF000000u) >> 24);
+        p[1] = static_cast<byte>((w & 0x00FF0000u) >> 16);
+        p[2] = static_cast<byte>((w & 0x0000FF00u) >>  8);
+        p[3] = static_cast<byte>((w & 0x000000FFu) >>  0);
+    }
+};
+
+namespace pm::security::detail
+{
+    /* Constants defined for SHA-256 */
+
+    /*
+     * These 64 constant words represent the first 32 bits
+     * of the fractional parts of the cube roots of the
+     * first 64 prime numbers.
+     */
+    alignas(16) inline constexpr std::uint32_t const sha256_hash_constants[64]
+    {
+        0x428A2F98u, 0x71374491u, 0xB5C0FBCFu, 0xE9B5DBA5u,
+        0x3956C25Bu, 0x59F111F1u, 0x923F82A4u, 0xAB1C5ED5u,
+        0xD807AA98u, 0x12835B01u, 0x243185BEu, 0x550C7DC3u,
+        0x72BE5D74u, 0x80DEB1FEu, 0x9BDC06A7u, 0xC19BF174u,
+        0xE49B69C1u, 0xEFBE4786u, 0x0FC19DC6u, 0x240CA1CCu,
+        0x2DE92C6Fu, 0x4A7484AAu, 0x5CB0A9DCu, 0x76F988DAu,
+        0x983E5152u, 0xA831C66Du, 0xB00327C8u, 0xBF597FC7u,
+        0xC6E00BF3u, 0xD5A79147u, 0x06CA6351u, 0x14292967u,
+        0x27B70A85u, 0x2E1B2138u, 0x4D2C6DFCu, 0x53380D13u,
+        0x650A7354u, 0x766A0ABBu, 0x81C2C92Eu, 0x92722C85u,
+        0xA2BFE8A1u, 0xA81A664Bu, 0xC24B8B70u, 0xC76C51A3u,
+        0xD192E819u, 0xD6990624u, 0xF40E3585u, 0x106AA070u,
+        0x19A4C116u, 0x1E376C08u, 0x2748774Cu, 0x34B0BCB5u,
+        0x391C0CB3u, 0x4ED8AA4Au, 0x5B9CCA4Fu, 0x682E6FF3u,
+        0x748F82EEu, 0x78A5636Fu, 0x84C87814u, 0x8CC70208u,
+        0x90BEFFFAu, 0xA4506CEBu, 0xBEF9A3F7u, 0xC67178F2u
+    };
+
+    /*
+     * These 8 constant words are the initial hash value
+     * used in SHA-256 and were obtained by taking the
+     * first 32 bits of the fractional parts of the
+     * square roots of the first eight prime numbers.
+     */
+    inline constexpr std::uint32_t const sha256_initial_hash_value[8]
+    {
+        0x6A09E667u, 0xBB67AE85u, 0x3C6EF372u, 0xA54FF53Au,
+        0x510E527Fu, 0x9B05688Cu, 0x1F83D9ABu, 0x5BE0CD19u
+    };
+
+    /* Transforms */
+
+    /*
+     * The portable transform, usable in constant expressions.
+     * Feeds a number of consecutive blocks to the transform,
+     * updating the intermediate hash value.
+     */
+    template<typename T>
+    inline constexpr void sha256_transform_portable(std::uint32_t* state, T const* data, std::size_t block_count) noexcept
+    {
+        using namespace sha256_ops;
+
+        for (std::size_t i = 0; i < block_count; i++, data += 64)
+        {
+            //Initialize our eight working variables with previous state
+            word a = state[0],
+                 b = state[1],
+                 c = state[2],
+                 d = state[3],
+                 e = state[4],
+                 f = state[5],
+                 g = state[6],
+                 h = state[7];
+
+            //Prepare the message schedule W
+            word W[64]{};
+            for (int t = 0; t < 16; t++)
+            {
+                W[t] = load_big_endian(data + t * sizeof(word));
+            }
+            for (int t = 16; t < 64; t++)
+            {
+                W[t] = F5(W[t - 2]) + W[t - 7] + F4(W[t - 15]) + W[t - 16];
+            }
+
+            //Perform the main transformation
+            for (int t = 0; t < 64; t++)
+            {
+                word T1 = h + F3(e) + F0(e, f, g) + sha256_hash_constants[t] + W[t];
+                word T2 = F2(a) + F1(a, b, c);
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + T1;
+                d = c;
+                c = b;
+                b = a;
+                a = T1 + T2;
+            }
+
+            //Calculate the intermediate hash value
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+    /*
+     * Feeds the blocks to the fastest transform supported
+     * by the processor.
+     */
+    void sha256_transform_dispatch(std::uint32_t* state, std::uint8_t const* data, std::size_t block_count) noexcept;
+
+    /*
+     * Uses the portable transform in constant expressions and
+     * the fastest transform otherwise. If the compiler cannot
+     * tell the two apart, the portable transform is always used.
+     */
+    template<typename T>
+    inline constexpr void sha256_transform(std::uint32_t* state, T const* data, std::size_t block_count) noexcept
+    {
+        static_assert(sizeof(T) == 1, "Data must be a string of bytes!");
+
+#if defined(PM_HAS_IS_CONSTANT_EVALUATED)
+        if (!__builtin_is_constant_evaluated())
+        {
+            sha256_transform_dispatch(state, reinterpret_cast<std::uint8_t const*>(data), block_count);
+            return;
+        }
+#endif
+
+        sha256_transform_portable(state, data, block_count);
+    }
+
+    /*
+     * Pads the last partial block of a message and embeds the
+     * message length, writing the resulting one or two blocks
+     * into the provided buffer. Returns the number of blocks.
+     */
+    template<typename T>
+    inline constexpr std::size_t sha256_pad_final_blocks
+    (
+        T const* data,
+        std::uint64_t data_length,
+        std::uint64_t message_length,
+        std::uint8_t(&blocks)[128]
+    ) noexcept
+    {
+        constexpr std::size_t const block_length = 64;
+        constexpr std::size_t const min_pad      = 1 + sizeof(std::uint64_t); //The byte 0x80 + length of message
+
+        //Check that it's not too big
+        assert(data_length < block_length);
+        assert(message_length < 0x2000000000000000ull);
+
+        //Find how many blocks the padding spills into
+        auto const count  = (data_length + min_pad > block_length) ? std::size_t{ 2 } : std::size_t{ 1 };
+        auto const padded = count * block_length;
+
+        //Copy the data and pad it
+        std::size_t i = 0;
+        for (; i < data_length; i++) blocks[i] = static_cast<std::uint8_t>(data[i]);
+
+        blocks[i++] = static_cast<std::uint8_t>(0x80);
+        for (; i < (padded - sizeof(std::uint64_t)); i++)
+            blocks[i] = 0;
+
+        //Add the length in big-endian order
+        auto const bit_count = message_length * 8;
+        for (int j = 7; j >= 0; j--, i++)
+            blocks[i] = static_cast<std::uint8_t>(bit_count >> (j * 8));
+
+        return count;
+    }
+};
 
 namespace pm::security
 {
@@ -27,6 +431,53 @@ namespace pm::security
          */
         static byte* compute_hash(byte const* data, std::uint64_t data_length) noexcept;
 
+        /*
+         * Computes the SHA-256 hash of a data string into
+         * the provided digest. Does not allocate.
+         */
+        static constexpr void compute_hash
+        (
+            byte const* data,
+            std::uint64_t data_length,
+            std::array<byte, digest_length>& digest
+        ) noexcept;
+
+        /*
+         * Computes the SHA-256 hash of a string of bytes or characters
+         * and returns the digest by value. Intended for precomputing
+         * digests in constant expressions.
+         */
+        template<typename T>
+        static constexpr std::array<byte, digest_length> digest(T const* data, std::size_t data_length) noexcept;
+
+        /*
+         * Computes the SHA-256 hash of a string and returns the
+         * digest by value. Intended for precomputing digests in
+         * constant expressions.
+         */
+        static constexpr std::array<byte, digest_length> digest(std::string_view str) noexcept;
+
+        /*
+         * Computes the SHA-256 hashes of several independent data
+         * strings, hashing as many of them in parallel as the
+         * processor has SIMD lanes for. The data strings may have
+         * different lengths.
+         */
+        static void compute_hashes
+        (
+            byte const* const* data,
+            std::uint64_t const* data_lengths,
+            std::array<byte, digest_length>* digests,
+            std::size_t count
+        ) noexcept;
+
+        /*
+         * Runs the known-answer tests from FIPS PUB 180-4 against
+         * every transform supported by the processor. Returns
+         * false if any of them produced a wrong digest.
+         */
+        static bool self_test() noexcept;
+
         /*
          * A low-level hashing primitive.
          */
@@ -37,7 +488,7 @@ namespace pm::security
              * Prepares or resets the context. Must be called
              * before computing the hash of a message.
              */
-            void init() noexcept;
+            constexpr void init() noexcept;
 
             /* 
              * Feeds a single block to the SHA-256 transform,
@@ -45,14 +496,32 @@ namespace pm::security
              * message. Must be called for each block length
              * sized chunk of the message.
              */
-            void update(byte const* data) noexcept;
+            constexpr void update(byte const* data) noexcept;
+
+            /*
+             * Feeds an arbitrary amount of the message to the
+             * SHA-256 transform. Whole blocks are transformed
+             * straight from the input, and anything left over
+             * is buffered until the next call. Can be called
+             * any number of times, but not mixed with the
+             * single block update or update_final.
+             */
+            template<typename T>
+            constexpr void update(T const* data, std::size_t data_length) noexcept;
+
+            /*
+             * Pads the buffered remainder of a message fed through
+             * the streaming update, and writes the message digest
+             * into the provided array. Does not allocate.
+             */
+            constexpr void finish(std::array<byte, digest_length>& digest) noexcept;
 
             /*
              * Pads and embeds the message length into the
              * final block and proceeds with feeding the
              * resulting block(s) to the SHA-256 transform.
              */
-            void update_final
+            constexpr void update_final
             (
                 byte const* data,
                 std::uint64_t data_length,
@@ -64,20 +533,139 @@ namespace pm::security
              */
             byte* get_digest() noexcept;
 
+            /*
+             * Retrieves the intermediate hash value. Only meaningful
+             * on a block boundary, where it can seed code that drives
+             * the transform directly.
+             */
+            constexpr std::array<word, digest_length / sizeof(word)> const& get_state() const noexcept
+            {
+                return this->state;
+            }
+
         private:
-            std::array<word, digest_length / sizeof(word)> state;
+            friend struct sha256;
+
+            std::array<word, digest_length / sizeof(word)> state{};
+            std::array<byte, block_length>                 buffer{};
+            std::size_t                                    buffer_length  = 0;
+            std::uint64_t                                  message_length = 0;
         };
 
         sha256() = delete;
-
-    private:
-        static std::tuple<byte*, std::uint64_t> pad_message
-        (
-            byte const* data,
-            std::uint64_t data_length,
-            std::uint64_t message_length
-        ) noexcept;
     };
+
+    /* Implementation */
+
+    inline constexpr void sha256::sha256_context::init() noexcept
+    {
+        //Setup the state
+        for (std::size_t i = 0; i < this->state.size(); i++)
+            this->state[i] = detail::sha256_initial_hash_value[i];
+
+        //Nothing has been fed yet
+        this->buffer_length  = 0;
+        this->message_length = 0;
+    }
+
+    inline constexpr void sha256::sha256_context::update(byte const* data) noexcept
+    {
+        //Feed the block to the transform
+        detail::sha256_transform(this->state.data(), data, 1);
+    }
+
+    template<typename T>
+    inline constexpr void sha256::sha256_context::update(T const* data, std::size_t data_length) noexcept
+    {
+        //Check that it's not too big
+        assert(data_length < max_message_length - this->message_length);
+
+        this->message_length += data_length;
+
+        //Top up a partially filled buffer first
+        if (this->buffer_length > 0)
+        {
+            auto const count = (block_length - this->buffer_length < data_length) ? block_length - this->buffer_length : data_length;
+
+            for (std::size_t i = 0; i < count; i++)
+                this->buffer[this->buffer_length + i] = static_cast<byte>(data[i]);
+
+            this->buffer_length += count;
+            data                += count;
+            data_length         -= count;
+
+            //Wait for more if the block is still not full
+            if (this->buffer_length < block_length) return;
+
+            detail::sha256_transform(this->state.data(), this->buffer.data(), 1);
+            this->buffer_length = 0;
+        }
+
+        //Process the whole blocks without copying them
+        auto const whole = data_length / block_length;
+        if (whole > 0)
+        {
+            detail::sha256_transform(this->state.data(), data, whole);
+            data        += whole * block_length;
+            data_length -= whole * block_length;
+        }
+
+        //Keep the remainder for later
+        for (std::size_t i = 0; i < data_length; i++)
+            this->buffer[i] = static_cast<byte>(data[i]);
+
+        this->buffer_length = data_length;
+    }
+
+    inline constexpr void sha256::sha256_context::finish(std::array<byte, digest_length>& digest) noexcept
+    {
+        //Pad the remainder and embed the message length
+        byte tail[2 * block_length]{};
+        auto const tail_blocks = detail::sha256_pad_final_blocks(this->buffer.data(), this->buffer_length, this->message_length, tail);
+
+        //Process the blocks
+        detail::sha256_transform(this->state.data(), tail, tail_blocks);
+
+        //Insert the words in big-endian order
+        for (std::size_t i = 0; i < this->state.size(); i++)
+            detail::sha256_ops::store_big_endian(&digest[i * sizeof(word)], this->state[i]);
+    }
+
+    inline constexpr void sha256::sha256_context::update_final(byte const* data, std::uint64_t data_length, std::uint64_t message_length) noexcept
+    {
+        //Preprocess the block
+        byte tail[2 * block_length]{};
+        auto const tail_blocks = detail::sha256_pad_final_blocks(data, data_length, message_length, tail);
+
+        //Process the blocks
+        detail::sha256_transform(this->state.data(), tail, tail_blocks);
+    }
+
+    inline constexpr void sha256::compute_hash(byte const* data, std::uint64_t data_length, std::array<byte, digest_length>& digest) noexcept
+    {
+        sha256_context ctx;
+        ctx.init();
+        ctx.update(data, static_cast<std::size_t>(data_length));
+        ctx.finish(digest);
+    }
+
+    template<typename T>
+    inline constexpr std::array<sha256::byte, sha256::digest_length> sha256::digest(T const* data, std::size_t data_length) noexcept
+    {
+        std::array<byte, digest_length> result{};
+
+        sha256_context ctx;
+        ctx.init();
+        ctx.update(data, data_length);
+        ctx.finish(result);
+
+        return result;
+    }
+
+    inline constexpr std::array<sha256::byte, sha256::digest_length> sha256::digest(std::string_view str) noexcept
+    {
+        return sha256::digest(str.data(), str.size());
+    }
 };
 
 #endif
@@ -0,0 +1,73 @@
+#include "sha256_impl.h"
+
+/*
+ * Implements the SHA-256 transform using the ARMv8 cryptography
+ * extensions. Only called after the processor has been checked
+ * for support.
+ */
+
+#if defined(PM_ARCH_ARM64)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <arm64_neon.h>
+#else
+#   include <arm_neon.h>
+#endif
+
+#if defined(__clang__)
+#   pragma clang attribute push(__attribute__((target("crypto"))), apply_to = function)
+#elif defined(__GNUC__)
+#   pragma GCC target("+crypto")
+#endif
+
+using byte = pm::security::sha256::byte;
+using word = pm::security::sha256::word;
+
+using pm::security::detail::sha256_hash_constants;
+
+void pm::security::detail::sha256_transform_armv8(word* state, byte const* data, std::size_t block_count) noexcept
+{
+    //Load the state
+    auto abcd = vld1q_u32(&state[0]);
+    auto efgh = vld1q_u32(&state[4]);
+
+    for (std::size_t i = 0; i < block_count; i++, data += sha256::block_length)
+    {
+        //Save the intermediate hash value
+        auto const abcd_save = abcd;
+        auto const efgh_save = efgh;
+
+        //Load the message block and convert each word from big-endian
+        uint32x4_t m[4];
+        for (int j = 0; j < 4; j++)
+            m[j] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + j * 16)));
+
+        //Perform the main transformation, four rounds at a time
+        for (int j = 0; j < 16; j++)
+        {
+            auto const wk  = vaddq_u32(m[j % 4], vld1q_u32(&sha256_hash_constants[j * 4]));
+            auto const tmp = abcd;
+
+            //Expand the message schedule while there are rounds left to feed
+            if (j < 12)
+                m[j % 4] = vsha256su1q_u32(vsha256su0q_u32(m[j % 4], m[(j + 1) % 4]), m[(j + 2) % 4], m[(j + 3) % 4]);
+
+            abcd = vsha256hq_u32 (abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, tmp,  wk);
+        }
+
+        //Calculate the intermediate hash value
+        abcd = vaddq_u32(abcd, abcd_save);
+        efgh = vaddq_u32(efgh, efgh_save);
+    }
+
+    //Store the state
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+#if defined(__clang__)
+#   pragma clang attribute pop
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#include "sha256_impl.h"
+
+/*
+ * Implements the multi-lane SHA-256 transform with AVX2,
+ * hashing eight messages at once.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("avx2")
+#endif
+
+#include "sha256_lanes.h"
+
+namespace
+{
+    struct avx2_ops
+    {
+        using reg = __m256i;
+
+        static constexpr std::size_t lanes = 8;
+
+        static reg load (pm::security::sha256::word const* p) noexcept { return _mm256_load_si256(reinterpret_cast<reg const*>(p)); }
+        static void store(pm::security::sha256::word* p, reg x) noexcept { _mm256_store_si256(reinterpret_cast<reg*>(p), x); }
+        static reg set1 (pm::security::sha256::word x) noexcept { return _mm256_set1_epi32(static_cast<int>(x)); }
+
+        static reg add           (reg x, reg y) noexcept { return _mm256_add_epi32(x, y); }
+        static reg bitwise_and   (reg x, reg y) noexcept { return _mm256_and_si256(x, y); }
+        static reg bitwise_andnot(reg x, reg y) noexcept { return _mm256_andnot_si256(x, y); }
+        static reg bitwise_or    (reg x, reg y) noexcept { return _mm256_or_si256(x, y); }
+        static reg bitwise_xor   (reg x, reg y) noexcept { return _mm256_xor_si256(x, y); }
+
+        template<int n>
+        static reg right_shift(reg x) noexcept { return _mm256_srli_epi32(x, n); }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+    };
+};
+
+void pm::security::detail::sha256_lanes_avx2(sha256::word* states, sha256::byte const* const* blocks) noexcept
+{
+    sha256_lanes_transform<avx2_ops>(states, blocks);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include "sha256_impl.h"
+
+/*
+ * Implements the multi-lane SHA-256 transform with AVX-512,
+ * hashing sixteen messages at once.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("avx512f")
+#endif
+
+#include "sha256_lanes.h"
+
+namespace
+{
+    struct avx512_ops
+    {
+        using reg = __m512i;
+
+        static constexpr std::size_t lanes = 16;
+
+        static reg load (pm::security::sha256::word const* p) noexcept { return _mm512_load_si512(p); }
+        static void store(pm::security::sha256::word* p, reg x) noexcept { _mm512_store_si512(p, x); }
+        static reg set1 (pm::security::sha256::word x) noexcept { return _mm512_set1_epi32(static_cast<int>(x)); }
+
+        static reg add           (reg x, reg y) noexcept { return _mm512_add_epi32(x, y); }
+        static reg bitwise_and   (reg x, reg y) noexcept { return _mm512_and_si512(x, y); }
+        static reg bitwise_andnot(reg x, reg y) noexcept { return _mm512_andnot_si512(x, y); }
+        static reg bitwise_or    (reg x, reg y) noexcept { return _mm512_or_si512(x, y); }
+        static reg bitwise_xor   (reg x, reg y) noexcept { return _mm512_xor_si512(x, y); }
+
+        template<int n>
+        static reg right_shift(reg x) noexcept { return _mm512_srli_epi32(x, n); }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept { return _mm512_ror_epi32(x, n); }
+    };
+};
+
+void pm::security::detail::sha256_lanes_avx512(sha256::word* states, sha256::byte const* const* blocks) noexcept
+{
+    sha256_lanes_transform<avx512_ops>(states, blocks);
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef PM_SHA256_IMPL_H
+#define PM_SHA256_IMPL_H
+#pragma once
+
+#include "cpu_features.h"
+#include "sha256.h"
+
+#include <cstddef>
+
+/*
+ * Internal definitions shared between the different
+ * implementations of the SHA-256 transform.
+ */
+
+namespace pm::security::detail
+{
+    /* Transforms */
+
+    /*
+     * Feeds a number of consecutive blocks to the SHA-256
+     * transform, updating the intermediate hash value.
+     */
+    using sha256_transform_fn = void(*)
+    (
+        sha256::word* state,
+        sha256::byte const* data,
+        std::size_t block_count
+    ) noexcept;
+
+    /*
+     * Portable implementation. Always available.
+     */
+    void sha256_transform_scalar(sha256::word* state, sha256::byte const* data, std::size_t block_count) noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Implementation using the Intel SHA extensions.
+     * Requires SHA, SSSE3 and SSE4.1.
+     */
+    void sha256_transform_shani(sha256::word* state, sha256::byte const* data, std::size_t block_count) noexcept;
+#endif
+
+#if defined(PM_ARCH_ARM64)
+    /*
+     * Implementation using the ARMv8 cryptography extensions.
+     * Requires SHA2.
+     */
+    void sha256_transform_armv8(sha256::word* state, sha256::byte const* data, std::size_t block_count) noexcept;
+#endif
+
+    /* Multi-lane transforms */
+
+    /*
+     * Feeds one block from each of several independent messages
+     * to the SHA-256 transform at once. The states are stored
+     * word-major: word i of lane l is at states[i * lanes + l],
+     * and the array must be aligned to 64 bytes.
+     */
+    using sha256_lanes_fn = void(*)
+    (
+        sha256::word* states,
+        sha256::byte const* const* blocks
+    ) noexcept;
+
+    /*
+     * The widest number of lanes any transform processes.
+     */
+    inline constexpr std::size_t sha256_max_lanes = 16;
+
+    struct sha256_lanes
+    {
+        sha256_lanes_fn transform;
+        std::size_t     lanes;
+    };
+
+    /*
+     * Retrieves the multi-lane transform to use on this processor.
+     * Has zero lanes if there is none, or if hashing the messages
+     * one at a time with the single-lane transform is faster.
+     */
+    sha256_lanes get_sha256_lanes() noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Four lanes. Requires SSE4.1.
+     */
+    void sha256_lanes_sse41(sha256::word* states, sha256::byte const* const* blocks) noexcept;
+
+    /*
+     * Eight lanes. Requires AVX2.
+     */
+    void sha256_lanes_avx2(sha256::word* states, sha256::byte const* const* blocks) noexcept;
+
+    /*
+     * Sixteen lanes. Requires AVX-512F.
+     */
+    void sha256_lanes_avx512(sha256::word* states, sha256::byte const* const* blocks) noexcept;
+#endif
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "sha256_impl.h"
+
+/*
+ * Implements the SHA-256 transform using the Intel SHA extensions.
+ * Only called after the processor has been checked for support.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("sha,ssse3,sse4.1")
+#endif
+
+using byte = pm::security::sha256::byte;
+using word = pm::security::sha256::word;
+
+using pm::security::detail::sha256_hash_constants;
+
+/*
+ * Loads four round constants starting at round t.
+ */
+static inline __m128i load_constants(int t) noexcept
+{
+    return _mm_load_si128(reinterpret_cast<__m128i const*>(&sha256_hash_constants[t]));
+}
+
+/*
+ * Performs four rounds of the transform. The SHA256RNDS2
+ * instruction performs two rounds at a time, reading the
+ * message words from the low half of its last operand.
+ */
+static inline void four_rounds(__m128i* abef, __m128i* cdgh, __m128i msg, int t) noexcept
+{
+    auto const wk = _mm_add_epi32(msg, load_constants(t));
+
+    *cdgh = _mm_sha256rnds2_epu32(*cdgh, *abef, wk);
+    *abef = _mm_sha256rnds2_epu32(*abef, *cdgh, _mm_shuffle_epi32(wk, 0x0E));
+}
+
+/*
+ * Computes the next four words of the message schedule,
+ * given the previous sixteen words in m0 through m3.
+ */
+static inline __m128i schedule(__m128i m0, __m128i m1, __m128i m2, __m128i m3) noexcept
+{
+    auto const t = _mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4));
+
+    return _mm_sha256msg2_epu32(t, m3);
+}
+
+void pm::security::detail::sha256_transform_shani(word* state, byte const* data, std::size_t block_count) noexcept
+{
+    //Mask used to convert each word from big-endian
+    auto const bswap_mask = _mm_set_epi64x(0x0C0D0E0F08090A0BLL, 0x0405060700010203LL);
+
+    //Load the state and rearrange it into the ABEF/CDGH layout the instructions expect
+    auto dcba = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&state[0]));
+    auto hgfe = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&state[4]));
+
+    auto const cdab = _mm_shuffle_epi32(dcba, 0xB1);
+    auto const efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+
+    auto abef = _mm_alignr_epi8(cdab, efgh, 8);
+    auto cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (std::size_t i = 0; i < block_count; i++, data += sha256::block_length)
+    {
+        //Save the intermediate hash value
+        auto const abef_save = abef;
+        auto const cdgh_save = cdgh;
+
+        //Load the message block
+        auto m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data +  0)), bswap_mask);
+        auto m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 16)), bswap_mask);
+        auto m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 32)), bswap_mask);
+        auto m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 48)), bswap_mask);
+
+        //Rounds 0 to 15 consume the message block directly
+        four_rounds(&abef, &cdgh, m0,  0);
+        four_rounds(&abef, &cdgh, m1,  4);
+        four_rounds(&abef, &cdgh, m2,  8);
+        four_rounds(&abef, &cdgh, m3, 12);
+
+        //Rounds 16 to 63 consume the expanded message schedule
+        for (int t = 16; t < 64; t += 16)
+        {
+            m0 = schedule(m0, m1, m2, m3); four_rounds(&abef, &cdgh, m0, t +  0);
+            m1 = schedule(m1, m2, m3, m0); four_rounds(&abef, &cdgh, m1, t +  4);
+            m2 = schedule(m2, m3, m0, m1); four_rounds(&abef, &cdgh, m2, t +  8);
+            m3 = schedule(m3, m0, m1, m2); four_rounds(&abef, &cdgh, m3, t + 12);
+        }
+
+        //Calculate the intermediate hash value
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    //Rearrange the state back into the regular order
+    auto const feba = _mm_shuffle_epi32(abef, 0x1B);
+    auto const dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+
+    dcba = _mm_blend_epi16(feba, dchg, 0xF0);
+    hgfe = _mm_alignr_epi8(dchg, feba, 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), dcba);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), hgfe);
+}
+
+#endif
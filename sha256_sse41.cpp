@@ -0,0 +1,49 @@
+#include "sha256_impl.h"
+
+/*
+ * Implements the multi-lane SHA-256 transform with SSE4.1,
+ * hashing four messages at once.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("sse4.1")
+#endif
+
+#include "sha256_lanes.h"
+
+namespace
+{
+    struct sse41_ops
+    {
+        using reg = __m128i;
+
+        static constexpr std::size_t lanes = 4;
+
+        static reg load (pm::security::sha256::word const* p) noexcept { return _mm_load_si128(reinterpret_cast<reg const*>(p)); }
+        static void store(pm::security::sha256::word* p, reg x) noexcept { _mm_store_si128(reinterpret_cast<reg*>(p), x); }
+        static reg set1 (pm::security::sha256::word x) noexcept { return _mm_set1_epi32(static_cast<int>(x)); }
+
+        static reg add           (reg x, reg y) noexcept { return _mm_add_epi32(x, y); }
+        static reg bitwise_and   (reg x, reg y) noexcept { return _mm_and_si128(x, y); }
+        static reg bitwise_andnot(reg x, reg y) noexcept { return _mm_andnot_si128(x, y); }
+        static reg bitwise_or    (reg x, reg y) noexcept { return _mm_or_si128(x, y); }
+        static reg bitwise_xor   (reg x, reg y) noexcept { return _mm_xor_si128(x, y); }
+
+        template<int n>
+        static reg right_shift(reg x) noexcept { return _mm_srli_epi32(x, n); }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept { return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n)); }
+    };
+};
+
+void pm::security::detail::sha256_lanes_sse41(sha256::word* states, sha256::byte const* const* blocks) noexcept
+{
+    sha256_lanes_transform<sse41_ops>(states, blocks);
+}
+
+#endif
@@ -0,0 +1,448 @@
+#include "sha512.h"
+#include "sha512_impl.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/*
+ * Implements SHA-512 and SHA-384 as described in FIPS PUB 180-4
+ * (August 2015).
+ */
+
+/* Types defined for SHA-512 */
+
+using byte = std::uint8_t;
+using word = std::uint64_t;
+
+/* Implementation */
+
+using std::uint64_t;
+
+using pm::security::detail::sha512_pad_final_blocks;
+using pm::security::detail::sha512_transform_fn;
+
+void pm::security::detail::sha512_transform_scalar(word* state, byte const* data, std::size_t block_count) noexcept
+{
+    sha512_transform_portable(state, data, block_count);
+}
+
+/*
+ * Picks the fastest transform supported by the processor.
+ * No processor we target has SHA-512 instructions, so the
+ * SIMD units are only used to hash several messages at once.
+ */
+static sha512_transform_fn select_transform() noexcept
+{
+    return pm::security::detail::sha512_transform_scalar;
+}
+
+/*
+ * Retrieves the transform selected for this processor.
+ * The selection is only made once.
+ */
+static sha512_transform_fn get_transform() noexcept
+{
+    static sha512_transform_fn const transform = select_transform();
+
+    return transform;
+}
+
+void pm::security::detail::sha512_transform_dispatch(word* state, byte const* data, std::size_t block_count) noexcept
+{
+    get_transform()(state, data, block_count);
+}
+
+pm::security::detail::sha512_lanes pm::security::detail::get_sha512_lanes() noexcept
+{
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+
+#if defined(PM_ARCH_X86)
+    if (cpu.avx512f) return { sha512_lanes_avx512, 8 };
+    if (cpu.avx2)    return { sha512_lanes_avx2,   4 };
+#endif
+
+    return { nullptr, 0 };
+}
+
+/*
+ * Retrieves the initial hash value of the variant producing
+ * digests of the given length.
+ */
+static word const* get_initial_hash_value(std::size_t digest_length) noexcept
+{
+    return (digest_length == pm::security::sha512::digest_length) ? pm::security::detail::sha512_initial_hash_value
+                                                                  : pm::security::detail::sha384_initial_hash_value;
+}
+
+/*
+ * Writes the first words of an intermediate hash value in
+ * big-endian order, reading every stride'th word of the state.
+ */
+static void write_digest(word const* state, std::size_t stride, byte* digest, std::size_t digest_length) noexcept
+{
+    for (std::size_t i = 0; i < digest_length / sizeof(word); i++)
+        pm::security::detail::sha512_ops::store_big_endian(digest + i * sizeof(word), state[i * stride]);
+}
+
+/*
+ * Hashes a message with a single-lane transform. The whole
+ * blocks are fed straight from the message, followed by the
+ * padded tail.
+ */
+static void hash_message(sha512_transform_fn transform, byte const* data, uint64_t data_length, byte* digest, std::size_t digest_length) noexcept
+{
+    constexpr auto const block_length = pm::security::sha512::block_length;
+
+    //Setup the state
+    auto const* initial_hash_value = get_initial_hash_value(digest_length);
+
+    word state[8];
+    std::copy(initial_hash_value, initial_hash_value + 8, state);
+
+    //Process the whole blocks
+    auto const whole = data_length / block_length;
+    transform(state, data, static_cast<std::size_t>(whole));
+
+    //Process the padded tail
+    byte tail[2 * block_length];
+    auto const tail_blocks = sha512_pad_final_blocks(data + whole * block_length, data_length % block_length, data_length, tail);
+    transform(state, tail, tail_blocks);
+
+    write_digest(state, 1, digest, digest_length);
+}
+
+/*
+ * Hashes a batch of messages with a multi-lane transform. Each
+ * lane is given a message, and as soon as a lane has fed the
+ * last block of its message it is handed the next one. Lanes
+ * left without a message are fed a dummy block.
+ */
+static void hash_in_lanes
+(
+    pm::security::detail::sha512_lanes kernel,
+    byte const* const* data,
+    uint64_t const* data_lengths,
+    byte* digests,
+    std::size_t digest_length,
+    std::size_t count
+) noexcept
+{
+    using pm::security::detail::sha512_max_lanes;
+
+    constexpr auto const block_length = pm::security::sha512::block_length;
+
+    auto const [transform, lanes] = kernel;
+    auto const* initial_hash_value = get_initial_hash_value(digest_length);
+
+    //The bookkeeping needed for each lane
+    struct lane_job
+    {
+        std::size_t message;
+        byte const* next;
+        uint64_t    full_blocks;
+        std::size_t tail_blocks;
+        std::size_t tail_fed;
+        byte        tail[2 * block_length];
+    };
+
+    //An idle lane is fed this block, and its result discarded
+    static byte const idle_block[block_length]{};
+
+    alignas(64) word states[8 * sha512_max_lanes];
+    lane_job         jobs  [sha512_max_lanes];
+    byte const*      blocks[sha512_max_lanes];
+    bool             active[sha512_max_lanes]{};
+
+    //Assigns the next unhashed message to a lane
+    std::size_t next_message = 0;
+    auto const assign = [&](std::size_t l) noexcept
+    {
+        if (next_message == count)
+        {
+            active[l] = false;
+            return;
+        }
+
+        auto&      job   = jobs[l];
+        auto const len   = data_lengths[next_message];
+        auto const whole = len / block_length;
+
+        job.message     = next_message++;
+        job.next        = data[job.message];
+        job.full_blocks = whole;
+        job.tail_blocks = sha512_pad_final_blocks(job.next + whole * block_length, len % block_length, len, job.tail);
+        job.tail_fed    = 0;
+
+        //Reset the intermediate hash value of the lane
+        for (std::size_t i = 0; i < 8; i++)
+            states[i * lanes + l] = initial_hash_value[i];
+
+        active[l] = true;
+    };
+
+    //Fill the lanes
+    for (std::size_t l = 0; l < lanes; l++) assign(l);
+
+    //Run until every lane has gone idle
+    while (std::any_of(active, active + lanes, [](bool a) { return a; }))
+    {
+        //Pick the next block of each lane
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            auto& job = jobs[l];
+
+            if (!active[l])
+            {
+                blocks[l] = idle_block;
+            }
+            else if (job.full_blocks > 0)
+            {
+                blocks[l] = job.next;
+                job.next += block_length;
+                job.full_blocks--;
+            }
+            else
+            {
+                blocks[l] = job.tail + job.tail_fed * block_length;
+                job.tail_fed++;
+            }
+        }
+
+        transform(states, blocks);
+
+        //Retire the lanes that fed their last block
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            auto const& job = jobs[l];
+
+            if (!active[l] || job.full_blocks > 0 || job.tail_fed < job.tail_blocks) continue;
+
+            write_digest(states + l, lanes, digests + job.message * digest_length, digest_length);
+
+            assign(l);
+        }
+    }
+}
+
+template<std::size_t digest_bits>
+void pm::security::basic_sha512<digest_bits>::compute_hashes
+(
+    byte const* const* data,
+    uint64_t const* data_lengths,
+    std::array<byte, digest_length>* digests,
+    std::size_t count
+) noexcept
+{
+    //The digests are written as one flat array
+    static_assert(sizeof(std::array<byte, digest_length>) == digest_length, "Digests must be tightly packed!");
+
+    //Pick the multi-lane transform
+    auto const kernel = detail::get_sha512_lanes();
+
+    //A single message gains nothing from the lanes
+    if (kernel.lanes == 0 || count == 1)
+    {
+        for (std::size_t m = 0; m < count; m++)
+            hash_message(get_transform(), data[m], data_lengths[m], digests[m].data(), digest_length);
+
+        return;
+    }
+
+    hash_in_lanes(kernel, data, data_lengths, digests[0].data(), digest_length, count);
+}
+
+/*
+ * The examples given in FIPS PUB 180-4 and its accompanying
+ * test vectors, with the SHA-512 and the SHA-384 digest of
+ * each message.
+ */
+namespace
+{
+    struct known_answer
+    {
+        char const* message;
+        byte        digest512[pm::security::sha512::digest_length];
+        byte        digest384[pm::security::sha384::digest_length];
+    };
+};
+
+static constexpr known_answer const known_answers[]
+{
+    {
+        "",
+        {
+            0xCF, 0x83, 0xE1, 0x35, 0x7E, 0xEF, 0xB8, 0xBD, 0xF1, 0x54, 0x28, 0x50, 0xD6, 0x6D, 0x80, 0x07,
+            0xD6, 0x20, 0xE4, 0x05, 0x0B, 0x57, 0x15, 0xDC, 0x83, 0xF4, 0xA9, 0x21, 0xD3, 0x6C, 0xE9, 0xCE,
+            0x47, 0xD0, 0xD1, 0x3C, 0x5D, 0x85, 0xF2, 0xB0, 0xFF, 0x83, 0x18, 0xD2, 0x87, 0x7E, 0xEC, 0x2F,
+            0x63, 0xB9, 0x31, 0xBD, 0x47, 0x41, 0x7A, 0x81, 0xA5, 0x38, 0x32, 0x7A, 0xF9, 0x27, 0xDA, 0x3E
+        },
+        {
+            0x38, 0xB0, 0x60, 0xA7, 0x51, 0xAC, 0x96, 0x38, 0x4C, 0xD9, 0x32, 0x7E, 0xB1, 0xB1, 0xE3, 0x6A,
+            0x21, 0xFD, 0xB7, 0x11, 0x14, 0xBE, 0x07, 0x43, 0x4C, 0x0C, 0xC7, 0xBF, 0x63, 0xF6, 0xE1, 0xDA,
+            0x27, 0x4E, 0xDE, 0xBF, 0xE7, 0x6F, 0x65, 0xFB, 0xD5, 0x1A, 0xD2, 0xF1, 0x48, 0x98, 0xB9, 0x5B
+        }
+    },
+    {
+        "abc",
+        {
+            0xDD, 0xAF, 0x35, 0xA1, 0x93, 0x61, 0x7A, 0xBA, 0xCC, 0x41, 0x73, 0x49, 0xAE, 0x20, 0x41, 0x31,
+            0x12, 0xE6, 0xFA, 0x4E, 0x89, 0xA9, 0x7E, 0xA2, 0x0A, 0x9E, 0xEE, 0xE6, 0x4B, 0x55, 0xD3, 0x9A,
+            0x21, 0x92, 0x99, 0x2A, 0x27, 0x4F, 0xC1, 0xA8, 0x36, 0xBA, 0x3C, 0x23, 0xA3, 0xFE, 0xEB, 0xBD,
+            0x45, 0x4D, 0x44, 0x23, 0x64, 0x3C, 0xE8, 0x0E, 0x2A, 0x9A, 0xC9, 0x4F, 0xA5, 0x4C, 0xA4, 0x9F
+        },
+        {
+            0xCB, 0x00, 0x75, 0x3F, 0x45, 0xA3, 0x5E, 0x8B, 0xB5, 0xA0, 0x3D, 0x69, 0x9A, 0xC6, 0x50, 0x07,
+            0x27, 0x2C, 0x32, 0xAB, 0x0E, 0xDE, 0xD1, 0x63, 0x1A, 0x8B, 0x60, 0x5A, 0x43, 0xFF, 0x5B, 0xED,
+            0x80, 0x86, 0x07, 0x2B, 0xA1, 0xE7, 0xCC, 0x23, 0x58, 0xBA, 0xEC, 0xA1, 0x34, 0xC8, 0x25, 0xA7
+        }
+    },
+    {
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+        {
+            0x20, 0x4A, 0x8F, 0xC6, 0xDD, 0xA8, 0x2F, 0x0A, 0x0C, 0xED, 0x7B, 0xEB, 0x8E, 0x08, 0xA4, 0x16,
+            0x57, 0xC1, 0x6E, 0xF4, 0x68, 0xB2, 0x28, 0xA8, 0x27, 0x9B, 0xE3, 0x31, 0xA7, 0x03, 0xC3, 0x35,
+            0x96, 0xFD, 0x15, 0xC1, 0x3B, 0x1B, 0x07, 0xF9, 0xAA, 0x1D, 0x3B, 0xEA, 0x57, 0x78, 0x9C, 0xA0,
+            0x31, 0xAD, 0x85, 0xC7, 0xA7, 0x1D, 0xD7, 0x03, 0x54, 0xEC, 0x63, 0x12, 0x38, 0xCA, 0x34, 0x45
+        },
+        {
+            0x33, 0x91, 0xFD, 0xDD, 0xFC, 0x8D, 0xC7, 0x39, 0x37, 0x07, 0xA6, 0x5B, 0x1B, 0x47, 0x09, 0x39,
+            0x7C, 0xF8, 0xB1, 0xD1, 0x62, 0xAF, 0x05, 0xAB, 0xFE, 0x8F, 0x45, 0x0D, 0xE5, 0xF3, 0x6B, 0xC6,
+            0xB0, 0x45, 0x5A, 0x85, 0x20, 0xBC, 0x4E, 0x6F, 0x5F, 0xE9, 0x5B, 0x1F, 0xE3, 0xC8, 0x45, 0x2B
+        }
+    },
+    {
+        "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+        {
+            0x8E, 0x95, 0x9B, 0x75, 0xDA, 0xE3, 0x13, 0xDA, 0x8C, 0xF4, 0xF7, 0x28, 0x14, 0xFC, 0x14, 0x3F,
+            0x8F, 0x77, 0x79, 0xC6, 0xEB, 0x9F, 0x7F, 0xA1, 0x72, 0x99, 0xAE, 0xAD, 0xB6, 0x88, 0x90, 0x18,
+            0x50, 0x1D, 0x28, 0x9E, 0x49, 0x00, 0xF7, 0xE4, 0x33, 0x1B, 0x99, 0xDE, 0xC4, 0xB5, 0x43, 0x3A,
+            0xC7, 0xD3, 0x29, 0xEE, 0xB6, 0xDD, 0x26, 0x54, 0x5E, 0x96, 0xE5, 0x5B, 0x87, 0x4B, 0xE9, 0x09
+        },
+        {
+            0x09, 0x33, 0x0C, 0x33, 0xF7, 0x11, 0x47, 0xE8, 0x3D, 0x19, 0x2F, 0xC7, 0x82, 0xCD, 0x1B, 0x47,
+            0x53, 0x11, 0x1B, 0x17, 0x3B, 0x3B, 0x05, 0xD2, 0x2F, 0xA0, 0x80, 0x86, 0xE3, 0xB0, 0xF7, 0x12,
+            0xFC, 0xC7, 0xC7, 0x1A, 0x55, 0x7E, 0x2D, 0xB9, 0x66, 0xC3, 0xE9, 0xFA, 0x91, 0x74, 0x60, 0x39
+        }
+    }
+};
+
+/*
+ * Retrieves the digest of a known answer for the given variant.
+ */
+template<std::size_t digest_bits>
+static constexpr byte const* get_known_digest(known_answer const& test) noexcept
+{
+    if constexpr (digest_bits == 512) return test.digest512;
+    else                              return test.digest384;
+}
+
+/*
+ * Checks a digest computed in a constant expression against
+ * one of the known answers.
+ */
+template<std::size_t digest_bits>
+static constexpr bool matches_known_answer(known_answer const& test) noexcept
+{
+    auto const  digest   = pm::security::basic_sha512<digest_bits>::digest(std::string_view{ test.message });
+    auto const* expected = get_known_digest<digest_bits>(test);
+
+    for (std::size_t i = 0; i < digest.size(); i++)
+    {
+        if (digest[i] != expected[i]) return false;
+    }
+
+    return true;
+}
+
+//Make sure the portable transform also works at compile-time
+static_assert(matches_known_answer<512>(known_answers[1]), "SHA-512 is broken in constant expressions!");
+static_assert(matches_known_answer<512>(known_answers[3]), "SHA-512 is broken in constant expressions!");
+static_assert(matches_known_answer<384>(known_answers[1]), "SHA-384 is broken in constant expressions!");
+static_assert(matches_known_answer<384>(known_answers[3]), "SHA-384 is broken in constant expressions!");
+
+template<std::size_t digest_bits>
+bool pm::security::basic_sha512<digest_bits>::self_test() noexcept
+{
+    //Gather every transform this processor can run
+    [[maybe_unused]] auto const& cpu = pm::cpu::get_features();
+    std::pair<sha512_transform_fn, bool> const transforms[]
+    {
+        { detail::sha512_transform_scalar, true },
+    };
+
+    std::pair<detail::sha512_lanes, bool> const lane_transforms[]
+    {
+#if defined(PM_ARCH_X86)
+        { { detail::sha512_lanes_avx2,   4 }, cpu.avx2    },
+        { { detail::sha512_lanes_avx512, 8 }, cpu.avx512f },
+#endif
+        { { nullptr, 0 }, false }
+    };
+
+    //Prepare the messages
+    constexpr auto const count = std::size(known_answers);
+
+    byte const*                     messages[count];
+    uint64_t                        lengths [count];
+    std::array<byte, digest_length> digests [count];
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        messages[i] = reinterpret_cast<byte const*>(known_answers[i].message);
+        lengths [i] = static_cast<uint64_t>(std::char_traits<char>::length(known_answers[i].message));
+    }
+
+    //Compares the digests with the known answers
+    auto const check = [&]() noexcept
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (!std::equal(digests[i].begin(), digests[i].end(), get_known_digest<digest_bits>(known_answers[i]))) return false;
+        }
+
+        return true;
+    };
+
+    //Check each transform against each known answer
+    for (auto const& [transform, supported] : transforms)
+    {
+        if (!supported) continue;
+
+        for (std::size_t i = 0; i < count; i++)
+            hash_message(transform, messages[i], lengths[i], digests[i].data(), digest_length);
+
+        if (!check()) return false;
+    }
+
+    //Check the streaming interface, feeding the messages a byte at a time
+    for (std::size_t i = 0; i < count; i++)
+    {
+        sha512_context ctx;
+        ctx.init();
+
+        for (uint64_t j = 0; j < lengths[i]; j++) ctx.update(messages[i] + j, 1);
+
+        ctx.finish(digests[i]);
+    }
+
+    if (!check()) return false;
+
+    //Check each multi-lane transform, with all the known answers in flight at once
+    for (auto const& [kernel, supported] : lane_transforms)
+    {
+        if (!supported) continue;
+
+        hash_in_lanes(kernel, messages, lengths, digests[0].data(), digest_length, count);
+
+        if (!check()) return false;
+    }
+
+    return true;
+}
+
+template struct pm::security::basic_sha512<512>;
+template struct pm::security::basic_sha512<384>;
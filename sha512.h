@@ -0,0 +1,604 @@
+#ifndef PM_SHA512_H
+#define PM_SHA512_H
+#pragma once
+
+/*
+ * Implements SHA-512 and SHA-384 as described in FIPS PUB 180-4
+ * (August 2015).
+ *
+ * The two only differ in their initial hash value and in how much
+ * of the final hash value makes up the digest, so both are built
+ * from the same template. As with SHA-256, everything except
+ * compute_hashes and self_test can be used in constant expressions,
+ * and at run-time the fastest transform the processor supports is
+ * used.
+ */
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if !defined(PM_HAS_IS_CONSTANT_EVALUATED) && defined(__has_builtin)
+#   if __has_builtin(__builtin_is_constant_evaluated)
+#       define PM_HAS_IS_CONSTANT_EVALUATED 1
+#   endif
+#endif
+
+#if !defined(PM_HAS_IS_CONSTANT_EVALUATED) && defined(_MSC_VER) && (_MSC_VER >= 1925)
+#   define PM_HAS_IS_CONSTANT_EVALUATED 1
+#endif
+
+namespace pm::security::detail::sha512_ops
+{
+    /* Types defined for SHA-512 */
+
+    using byte = std::uint8_t;
+    using word = std::uint64_t;
+
+    /* Operations defined for SHA-512 */
+
+    /*
+     * Discards the right-most n bits of the word and pads the result
+     * with n zero bits on the left.
+     */
+    inline constexpr word right_shift(word x, byte n) noexcept
+    {
+        constexpr byte const w = sizeof(word) * 8;
+
+        assert(n < w);
+
+        return static_cast<word>(x >> n);
+    }
+
+    /*
+     * Discards the left-most n bits of the word and pads the result
+     * with n zero bits on the right.
+     */
+    inline constexpr word left_shift(word x, byte n) noexcept
+    {
+        constexpr byte const w = sizeof(word) * 8;
+
+        assert(n < w);
+
+        return static_cast<word>(x << n);
+    }
+
+    /*
+     * Performs the rotate right (circular right shift) operation,
+     * shifting x by n positions to the right.
+     */
+    inline constexpr word right_rotate(word x, byte n) noexcept
+    {
+        constexpr byte const w = sizeof(word) * 8;
+
+        return right_shift(x, n) | left_shift(x, w - n);
+    }
+
+    /* Functions defined for SHA-512 */
+
+    /*
+     * The first of six logical functions defined for SHA-512.
+     * Referred to as "Ch" in the specification.
+     */
+    inline constexpr word F0(word x, word y, word z) noexcept
+    {
+        return (x & y) ^ (~x & z);
+    }
+
+    /*
+     * The second of six logical functions defined for SHA-512.
+     * Referred to as "Maj" in the specification.
+     */
+    inline constexpr word F1(word x, word y, word z) noexcept
+    {
+        return (x & y) ^ (x & z) ^ (y & z);
+    }
+
+    /*
+     * The third of six logical functions defined for SHA-512.
+     * Referred to as "Sigma0" in the specification.
+     */
+    inline constexpr word F2(word x) noexcept
+    {
+        return right_rotate(x, 28) ^ right_rotate(x, 34) ^ right_rotate(x, 39);
+    }
+
+    /*
+     * The fourth of six logical functions defined for SHA-512.
+     * Referred to as "Sigma1" in the specification.
+     */
+    inline constexpr word F3(word x) noexcept
+    {
+        return right_rotate(x, 14) ^ right_rotate(x, 18) ^ right_rotate(x, 41);
+    }
+
+    /*
+     * The fifth of six logical functions defined for SHA-512.
+     * Referred to as "sigma0" in the specification.
+     */
+    inline constexpr word F4(word x) noexcept
+    {
+        return right_rotate(x, 1) ^ right_rotate(x, 8) ^ right_shift(x, 7);
+    }
+
+    /*
+     * The sixth of six logical functions defined for SHA-512.
+     * Referred to as "sigma1" in the specification.
+     */
+    inline constexpr word F5(word x) noexcept
+    {
+        return right_rotate(x, 19) ^ right_rotate(x, 61) ^ right_shift(x, 6);
+    }
+
+    /*
+     * Reads a word stored in big-endian byte order.
+     */
+    template<typename T>
+    inline constexpr word load_big_endian(T const* p) noexcept
+    {
+        word w = 0;
+        for (int i = 0; i < 8; i++) w = (w << 8) | static_cast<word>(static_cast<byte>(p[i]));
+
+        return w;
+    }
+
+    /*
+     * Writes a word in big-endian byte order.
+     */
+    inline constexpr void store_big_endian(byte* p, word w) noexcept
+    {
+        for (int i = 0; i < 8; i++) p[i] = static_cast<byte>(w >> (56 - i * 8));
+    }
+};
+
+namespace pm::security::detail
+{
+    /* Constants defined for SHA-512 */
+
+    /*
+     * These 80 constant words represent the first 64 bits
+     * of the fractional parts of the cube roots of the
+     * first 80 prime numbers.
+     */
+    alignas(64) inline constexpr std::uint64_t const sha512_hash_constants[80]
+    {
+        0x428A2F98D728AE22ull, 0x7137449123EF65CDull, 0xB5C0FBCFEC4D3B2Full, 0xE9B5DBA58189DBBCull,
+        0x3956C25BF348B538ull, 0x59F111F1B605D019ull, 0x923F82A4AF194F9Bull, 0xAB1C5ED5DA6D8118ull,
+        0xD807AA98A3030242ull, 0x12835B0145706FBEull, 0x243185BE4EE4B28Cull, 0x550C7DC3D5FFB4E2ull,
+        0x72BE5D74F27B896Full, 0x80DEB1FE3B1696B1ull, 0x9BDC06A725C71235ull, 0xC19BF174CF692694ull,
+        0xE49B69C19EF14AD2ull, 0xEFBE4786384F25E3ull, 0x0FC19DC68B8CD5B5ull, 0x240CA1CC77AC9C65ull,
+        0x2DE92C6F592B0275ull, 0x4A7484AA6EA6E483ull, 0x5CB0A9DCBD41FBD4ull, 0x76F988DA831153B5ull,
+        0x983E5152EE66DFABull, 0xA831C66D2DB43210ull, 0xB00327C898FB213Full, 0xBF597FC7BEEF0EE4ull,
+        0xC6E00BF33DA88FC2ull, 0xD5A79147930AA725ull, 0x06CA6351E003826Full, 0x142929670A0E6E70ull,
+        0x27B70A8546D22FFCull, 0x2E1B21385C26C926ull, 0x4D2C6DFC5AC42AEDull, 0x53380D139D95B3DFull,
+        0x650A73548BAF63DEull, 0x766A0ABB3C77B2A8ull, 0x81C2C92E47EDAEE6ull, 0x92722C851482353Bull,
+        0xA2BFE8A14CF10364ull, 0xA81A664BBC423001ull, 0xC24B8B70D0F89791ull, 0xC76C51A30654BE30ull,
+        0xD192E819D6EF5218ull, 0xD69906245565A910ull, 0xF40E35855771202Aull, 0x106AA07032BBD1B8ull,
+        0x19A4C116B8D2D0C8ull, 0x1E376C085141AB53ull, 0x2748774CDF8EEB99ull, 0x34B0BCB5E19B48A8ull,
+        0x391C0CB3C5C95A63ull, 0x4ED8AA4AE3418ACBull, 0x5B9CCA4F7763E373ull, 0x682E6FF3D6B2B8A3ull,
+        0x748F82EE5DEFB2FCull, 0x78A5636F43172F60ull, 0x84C87814A1F0AB72ull, 0x8CC702081A6439ECull,
+        0x90BEFFFA23631E28ull, 0xA4506CEBDE82BDE9ull, 0xBEF9A3F7B2C67915ull, 0xC67178F2E372532Bull,
+        0xCA273ECEEA26619Cull, 0xD186B8C721C0C207ull, 0xEADA7DD6CDE0EB1Eull, 0xF57D4F7FEE6ED178ull,
+        0x06F067AA72176FBAull, 0x0A637DC5A2C898A6ull, 0x113F9804BEF90DAEull, 0x1B710B35131C471Bull,
+        0x28DB77F523047D84ull, 0x32CAAB7B40C72493ull, 0x3C9EBE0A15C9BEBCull, 0x431D67C49C100D4Cull,
+        0x4CC5D4BECB3E42B6ull, 0x597F299CFC657E2Aull, 0x5FCB6FAB3AD6FAECull, 0x6C44198C4A475817ull
+    };
+
+    /*
+     * The initial hash value of SHA-512, the first 64 bits
+     * of the fractional parts of the square roots of the
+     * first eight prime numbers.
+     */
+    inline constexpr std::uint64_t const sha512_initial_hash_value[8]
+    {
+        0x6A09E667F3BCC908ull, 0xBB67AE8584CAA73Bull, 0x3C6EF372FE94F82Bull, 0xA54FF53A5F1D36F1ull,
+        0x510E527FADE682D1ull, 0x9B05688C2B3E6C1Full, 0x1F83D9ABFB41BD6Bull, 0x5BE0CD19137E2179ull
+    };
+
+    /*
+     * The initial hash value of SHA-384, the first 64 bits
+     * of the fractional parts of the square roots of the
+     * ninth through sixteenth prime numbers.
+     */
+    inline constexpr std::uint64_t const sha384_initial_hash_value[8]
+    {
+        0xCBBB9D5DC1059ED8ull, 0x629A292A367CD507ull, 0x9159015A3070DD17ull, 0x152FECD8F70E5939ull,
+        0x67332667FFC00B31ull, 0x8EB44A8768581511ull, 0xDB0C2E0D64F98FA7ull, 0x47B5481DBEFA4FA4ull
+    };
+
+    /* Transforms */
+
+    /*
+     * The portable transform, usable in constant expressions.
+     * Feeds a number of consecutive blocks to the transform,
+     * updating the intermediate hash value.
+     */
+    template<typename T>
+    inline constexpr void sha512_transform_portable(std::uint64_t* state, T const* data, std::size_t block_count) noexcept
+    {
+        using namespace sha512_ops;
+
+        for (std::size_t i = 0; i < block_count; i++, data += 128)
+        {
+            //Initialize our eight working variables with previous state
+            word a = state[0],
+                 b = state[1],
+                 c = state[2],
+                 d = state[3],
+                 e = state[4],
+                 f = state[5],
+                 g = state[6],
+                 h = state[7];
+
+            //Prepare the message schedule W
+            word W[80]{};
+            for (int t = 0; t < 16; t++)
+            {
+                W[t] = load_big_endian(data + t * sizeof(word));
+            }
+            for (int t = 16; t < 80; t++)
+            {
+                W[t] = F5(W[t - 2]) + W[t - 7] + F4(W[t - 15]) + W[t - 16];
+            }
+
+            //Perform the main transformation
+            for (int t = 0; t < 80; t++)
+            {
+                word T1 = h + F3(e) + F0(e, f, g) + sha512_hash_constants[t] + W[t];
+                word T2 = F2(a) + F1(a, b, c);
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + T1;
+                d = c;
+                c = b;
+                b = a;
+                a = T1 + T2;
+            }
+
+            //Calculate the intermediate hash value
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+    /*
+     * Feeds the blocks to the fastest transform supported
+     * by the processor.
+     */
+    void sha512_transform_dispatch(std::uint64_t* state, std::uint8_t const* data, std::size_t block_count) noexcept;
+
+    /*
+     * Uses the portable transform in constant expressions and
+     * the fastest transform otherwise. If the compiler cannot
+     * tell the two apart, the portable transform is always used.
+     */
+    template<typename T>
+    inline constexpr void sha512_transform(std::uint64_t* state, T const* data, std::size_t block_count) noexcept
+    {
+        static_assert(sizeof(T) == 1, "Data must be a string of bytes!");
+
+#if defined(PM_HAS_IS_CONSTANT_EVALUATED)
+        if (!__builtin_is_constant_evaluated())
+        {
+            sha512_transform_dispatch(state, reinterpret_cast<std::uint8_t const*>(data), block_count);
+            return;
+        }
+#endif
+
+        sha512_transform_portable(state, data, block_count);
+    }
+
+    /*
+     * Pads the last partial block of a message and embeds the
+     * 128-bit message length, writing the resulting one or two
+     * blocks into the provided buffer. Returns the number of
+     * blocks.
+     */
+    template<typename T>
+    inline constexpr std::size_t sha512_pad_final_blocks
+    (
+        T const* data,
+        std::uint64_t data_length,
+        std::uint64_t message_length,
+        std::uint8_t(&blocks)[256]
+    ) noexcept
+    {
+        constexpr std::size_t const block_length = 128;
+        constexpr std::size_t const min_pad      = 1 + 2 * sizeof(std::uint64_t); //The byte 0x80 + length of message
+
+        //Check that it's not too big
+        assert(data_length < block_length);
+
+        //Find how many blocks the padding spills into
+        auto const count  = (data_length + min_pad > block_length) ? std::size_t{ 2 } : std::size_t{ 1 };
+        auto const padded = count * block_length;
+
+        //Copy the data and pad it
+        std::size_t i = 0;
+        for (; i < data_length; i++) blocks[i] = static_cast<std::uint8_t>(data[i]);
+
+        blocks[i++] = static_cast<std::uint8_t>(0x80);
+        for (; i < (padded - 2 * sizeof(std::uint64_t)); i++)
+            blocks[i] = 0;
+
+        //Add the length in bits in big-endian order, the high half only holds the bits shifted out
+        sha512_ops::store_big_endian(&blocks[i],     message_length >> 61);
+        sha512_ops::store_big_endian(&blocks[i + 8], message_length << 3);
+
+        return count;
+    }
+};
+
+namespace pm::security
+{
+    template<std::size_t digest_bits>
+    struct basic_sha512
+    {
+        static_assert(digest_bits == 512 || digest_bits == 384, "Only SHA-512 and SHA-384 are supported!");
+
+        static constexpr std::size_t   const block_length       = 1024 / 8;
+        static constexpr std::size_t   const digest_length      = digest_bits / 8;
+        static constexpr std::uint64_t const max_message_length = 0xFFFFFFFFFFFFFFFFull;
+
+        using byte = std::uint8_t;
+        using word = std::uint64_t;
+
+        /*
+         * Computes the hash of a data string into the provided
+         * digest. Does not allocate.
+         */
+        static constexpr void compute_hash
+        (
+            byte const* data,
+            std::uint64_t data_length,
+            std::array<byte, digest_length>& digest
+        ) noexcept;
+
+        /*
+         * Computes the hash of a string of bytes or characters and
+         * returns the digest by value. Intended for precomputing
+         * digests in constant expressions.
+         */
+        template<typename T>
+        static constexpr std::array<byte, digest_length> digest(T const* data, std::size_t data_length) noexcept;
+
+        /*
+         * Computes the hash of a string and returns the digest by
+         * value. Intended for precomputing digests in constant
+         * expressions.
+         */
+        static constexpr std::array<byte, digest_length> digest(std::string_view str) noexcept;
+
+        /*
+         * Computes the hashes of several independent data strings,
+         * hashing as many of them in parallel as the processor has
+         * SIMD lanes for. The data strings may have different
+         * lengths.
+         */
+        static void compute_hashes
+        (
+            byte const* const* data,
+            std::uint64_t const* data_lengths,
+            std::array<byte, digest_length>* digests,
+            std::size_t count
+        ) noexcept;
+
+        /*
+         * Runs the known-answer tests from FIPS PUB 180-4 against
+         * every transform supported by the processor. Returns
+         * false if any of them produced a wrong digest.
+         */
+        static bool self_test() noexcept;
+
+        /*
+         * A low-level hashing primitive.
+         */
+        using context = struct sha512_context
+        {
+        public:
+            /*
+             * Prepares or resets the context. Must be called
+             * before computing the hash of a message.
+             */
+            constexpr void init() noexcept;
+
+            /*
+             * Feeds a single block to the SHA-512 transform,
+             * updating the intermediate hash value of the
+             * message. Must be called for each block length
+             * sized chunk of the message.
+             */
+            constexpr void update(byte const* data) noexcept;
+
+            /*
+             * Feeds an arbitrary amount of the message to the
+             * SHA-512 transform. Whole blocks are transformed
+             * straight from the input, and anything left over
+             * is buffered until the next call. Can be called
+             * any number of times, but not mixed with the
+             * single block update or update_final.
+             */
+            template<typename T>
+            constexpr void update(T const* data, std::size_t data_length) noexcept;
+
+            /*
+             * Pads the buffered remainder of a message fed through
+             * the streaming update, and writes the message digest
+             * into the provided array. Does not allocate.
+             */
+            constexpr void finish(std::array<byte, digest_length>& digest) noexcept;
+
+            /*
+             * Pads and embeds the message length into the
+             * final block and proceeds with feeding the
+             * resulting block(s) to the SHA-512 transform.
+             */
+            constexpr void update_final
+            (
+                byte const* data,
+                std::uint64_t data_length,
+                std::uint64_t message_length
+            ) noexcept;
+
+            /*
+             * Retrieves the intermediate hash value. Only meaningful
+             * on a block boundary, where it can seed code that drives
+             * the transform directly.
+             */
+            constexpr std::array<word, 8> const& get_state() const noexcept
+            {
+                return this->state;
+            }
+
+        private:
+            friend struct basic_sha512;
+
+            std::array<word, 8>            state{};
+            std::array<byte, block_length> buffer{};
+            std::size_t                    buffer_length  = 0;
+            std::uint64_t                  message_length = 0;
+        };
+
+        basic_sha512() = delete;
+    };
+
+    extern template struct basic_sha512<512>;
+    extern template struct basic_sha512<384>;
+
+    using sha512 = basic_sha512<512>;
+    using sha384 = basic_sha512<384>;
+
+    /* Implementation */
+
+    template<std::size_t digest_bits>
+    inline constexpr void basic_sha512<digest_bits>::sha512_context::init() noexcept
+    {
+        auto const& initial_hash_value = (digest_bits == 512) ? detail::sha512_initial_hash_value : detail::sha384_initial_hash_value;
+
+        //Setup the state
+        for (std::size_t i = 0; i < this->state.size(); i++)
+            this->state[i] = initial_hash_value[i];
+
+        //Nothing has been fed yet
+        this->buffer_length  = 0;
+        this->message_length = 0;
+    }
+
+    template<std::size_t digest_bits>
+    inline constexpr void basic_sha512<digest_bits>::sha512_context::update(byte const* data) noexcept
+    {
+        //Feed the block to the transform
+        detail::sha512_transform(this->state.data(), data, 1);
+    }
+
+    template<std::size_t digest_bits>
+    template<typename T>
+    inline constexpr void basic_sha512<digest_bits>::sha512_context::update(T const* data, std::size_t data_length) noexcept
+    {
+        //Check that it's not too big
+        assert(data_length <= max_message_length - this->message_length);
+
+        this->message_length += data_length;
+
+        //Top up a partially filled buffer first
+        if (this->buffer_length > 0)
+        {
+            auto const count = (block_length - this->buffer_length < data_length) ? block_length - this->buffer_length : data_length;
+
+            for (std::size_t i = 0; i < count; i++)
+                this->buffer[this->buffer_length + i] = static_cast<byte>(data[i]);
+
+            this->buffer_length += count;
+            data                += count;
+            data_length         -= count;
+
+            //Wait for more if the block is still not full
+            if (this->buffer_length < block_length) return;
+
+            detail::sha512_transform(this->state.data(), this->buffer.data(), 1);
+            this->buffer_length = 0;
+        }
+
+        //Process the whole blocks without copying them
+        auto const whole = data_length / block_length;
+        if (whole > 0)
+        {
+            detail::sha512_transform(this->state.data(), data, whole);
+            data        += whole * block_length;
+            data_length -= whole * block_length;
+        }
+
+        //Keep the remainder for later
+        for (std::size_t i = 0; i < data_length; i++)
+            this->buffer[i] = static_cast<byte>(data[i]);
+
+        this->buffer_length = data_length;
+    }
+
+    template<std::size_t digest_bits>
+    inline constexpr void basic_sha512<digest_bits>::sha512_context::finish(std::array<byte, digest_length>& digest) noexcept
+    {
+        //Pad the remainder and embed the message length
+        byte tail[2 * block_length]{};
+        auto const tail_blocks = detail::sha512_pad_final_blocks(this->buffer.data(), this->buffer_length, this->message_length, tail);
+
+        //Process the blocks
+        detail::sha512_transform(this->state.data(), tail, tail_blocks);
+
+        //Insert the words in big-endian order, SHA-384 drops the last two
+        for (std::size_t i = 0; i < digest_length / sizeof(word); i++)
+            detail::sha512_ops::store_big_endian(&digest[i * sizeof(word)], this->state[i]);
+    }
+
+    template<std::size_t digest_bits>
+    inline constexpr void basic_sha512<digest_bits>::sha512_context::update_final(byte const* data, std::uint64_t data_length, std::uint64_t message_length) noexcept
+    {
+        //Preprocess the block
+        byte tail[2 * block_length]{};
+        auto const tail_blocks = detail::sha512_pad_final_blocks(data, data_length, message_length, tail);
+
+        //Process the blocks
+        detail::sha512_transform(this->state.data(), tail, tail_blocks);
+    }
+
+    template<std::size_t digest_bits>
+    inline constexpr void basic_sha512<digest_bits>::compute_hash(byte const* data, std::uint64_t data_length, std::array<byte, digest_length>& digest) noexcept
+    {
+        sha512_context ctx;
+        ctx.init();
+        ctx.update(data, static_cast<std::size_t>(data_length));
+        ctx.finish(digest);
+    }
+
+    template<std::size_t digest_bits>
+    template<typename T>
+    inline constexpr std::array<typename basic_sha512<digest_bits>::byte, basic_sha512<digest_bits>::digest_length> basic_sha512<digest_bits>::digest(T const* data, std::size_t data_length) noexcept
+    {
+        std::array<byte, digest_length> result{};
+
+        sha512_context ctx;
+        ctx.init();
+        ctx.update(data, data_length);
+        ctx.finish(result);
+
+        return result;
+    }
+
+    template<std::size_t digest_bits>
+    inline constexpr std::array<typename basic_sha512<digest_bits>::byte, basic_sha512<digest_bits>::digest_length> basic_sha512<digest_bits>::digest(std::string_view str) noexcept
+    {
+        return basic_sha512::digest(str.data(), str.size());
+    }
+};
+
+#endif
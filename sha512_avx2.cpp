@@ -0,0 +1,49 @@
+#include "sha512_impl.h"
+
+/*
+ * Implements the multi-lane SHA-512 transform with AVX2,
+ * hashing four messages at once.
+ */
+
+#if defined(PM_ARCH_X86)
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+#   pragma GCC target("avx2")
+#endif
+
+#include "sha512_lanes.h"
+
+namespace
+{
+    struct avx2_ops
+    {
+        using reg = __m256i;
+
+        static constexpr std::size_t lanes = 4;
+
+        static reg load (pm::security::sha512::word const* p) noexcept { return _mm256_load_si256(reinterpret_cast<reg const*>(p)); }
+        static void store(pm::security::sha512::word* p, reg x) noexcept { _mm256_store_si256(reinterpret_cast<reg*>(p), x); }
+        static reg set1 (pm::security::sha512::word x) noexcept { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+
+        static reg add           (reg x, reg y) noexcept { return _mm256_add_epi64(x, y); }
+        static reg bitwise_and   (reg x, reg y) noexcept { return _mm256_and_si256(x, y); }
+        static reg bitwise_andnot(reg x, reg y) noexcept { return _mm256_andnot_si256(x, y); }
+        static reg bitwise_or    (reg x, reg y) noexcept { return _mm256_or_si256(x, y); }
+        static reg bitwise_xor   (reg x, reg y) noexcept { return _mm256_xor_si256(x, y); }
+
+        template<int n>
+        static reg right_shift(reg x) noexcept { return _mm256_srli_epi64(x, n); }
+
+        template<int n>
+        static reg right_rotate(reg x) noexcept { return _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - n)); }
+    };
+};
+
+void pm::security::detail::sha512_lanes_avx2(sha512::word* states, sha512::byte const* const* blocks) noexcept
+{
+    sha512_lanes_transform<avx2_ops>(states, blocks);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef PM_SHA512_IMPL_H
+#define PM_SHA512_IMPL_H
+#pragma once
+
+#include "cpu_features.h"
+#include "sha512.h"
+
+#include <cstddef>
+
+/*
+ * Internal definitions shared between the different
+ * implementations of the SHA-512 transform. SHA-384
+ * uses the same transforms.
+ */
+
+namespace pm::security::detail
+{
+    /* Transforms */
+
+    /*
+     * Feeds a number of consecutive blocks to the SHA-512
+     * transform, updating the intermediate hash value.
+     */
+    using sha512_transform_fn = void(*)
+    (
+        sha512::word* state,
+        sha512::byte const* data,
+        std::size_t block_count
+    ) noexcept;
+
+    /*
+     * Portable implementation. Always available.
+     */
+    void sha512_transform_scalar(sha512::word* state, sha512::byte const* data, std::size_t block_count) noexcept;
+
+    /* Multi-lane transforms */
+
+    /*
+     * Feeds one block from each of several independent messages
+     * to the SHA-512 transform at once. The states are stored
+     * word-major: word i of lane l is at states[i * lanes + l],
+     * and the array must be aligned to 64 bytes.
+     */
+    using sha512_lanes_fn = void(*)
+    (
+        sha512::word* states,
+        sha512::byte const* const* blocks
+    ) noexcept;
+
+    /*
+     * The widest number of lanes any transform processes.
+     */
+    inline constexpr std::size_t sha512_max_lanes = 8;
+
+    struct sha512_lanes
+    {
+        sha512_lanes_fn transform;
+        std::size_t     lanes;
+    };
+
+    /*
+     * Retrieves the multi-lane transform to use on this processor.
+     * Has zero lanes if there is none, or if hashing the messages
+     * one at a time with the single-lane transform is faster.
+     */
+    sha512_lanes get_sha512_lanes() noexcept;
+
+#if defined(PM_ARCH_X86)
+    /*
+     * Four lanes. Requires AVX2.
+     */
+    void sha512_lanes_avx2(sha512::word* states, sha512::byte const* const* blocks) noexcept;
+
+    /*
+     * Eight lanes. Requires AVX-512F.
+     */
+    void sha512_lanes_avx512(sha512::word* states, sha512::byte const* const* blocks) noexcept;
+#endif
+};
+
+#endif
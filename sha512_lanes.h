@@ -0,0 +1,143 @@
+#ifndef PM_SHA512_LANES_H
+#define PM_SHA512_LANES_H
+#pragma once
+
+#include "sha512_impl.h"
+
+/*
+ * A SHA-512 transform that processes one block from each of
+ * several independent messages at once, one message per SIMD
+ * lane. The vector operations are supplied by V, which must
+ * provide:
+ *
+ *     reg, lanes, load, store, set1, add, bitwise_and,
+ *     bitwise_andnot, bitwise_or, bitwise_xor,
+ *     right_shift<n>, right_rotate<n>
+ *
+ * This header must only be included by the translation units
+ * that instantiate it, after they have enabled the instruction
+ * set V is written for. Everything in here has internal linkage
+ * so each instantiation keeps the code generation options of the
+ * unit it was compiled in.
+ */
+
+namespace pm::security::detail
+{
+    /*
+     * Reads a word stored in big-endian byte order.
+     */
+    static inline sha512::word load_big_endian(sha512::byte const* p) noexcept
+    {
+        return (static_cast<sha512::word>(p[0]) << 56) |
+               (static_cast<sha512::word>(p[1]) << 48) |
+               (static_cast<sha512::word>(p[2]) << 40) |
+               (static_cast<sha512::word>(p[3]) << 32) |
+               (static_cast<sha512::word>(p[4]) << 24) |
+               (static_cast<sha512::word>(p[5]) << 16) |
+               (static_cast<sha512::word>(p[6]) <<  8) |
+               (static_cast<sha512::word>(p[7]) <<  0);
+    }
+
+    /*
+     * The states are stored word-major: word i of lane l is
+     * found at states[i * lanes + l]. One block is read from
+     * each of the lane pointers.
+     */
+    template<typename V>
+    static void sha512_lanes_transform(sha512::word* states, sha512::byte const* const* blocks) noexcept
+    {
+        using reg = typename V::reg;
+        constexpr auto lanes = V::lanes;
+
+        //Gather the message words so that each row holds one word from every lane
+        alignas(64) sha512::word M[16][lanes];
+        for (std::size_t l = 0; l < lanes; l++)
+        {
+            for (int t = 0; t < 16; t++)
+            {
+                M[t][l] = load_big_endian(blocks[l] + t * sizeof(sha512::word));
+            }
+        }
+
+        //Initialize our eight working variables with previous state
+        reg a = V::load(states + 0 * lanes),
+            b = V::load(states + 1 * lanes),
+            c = V::load(states + 2 * lanes),
+            d = V::load(states + 3 * lanes),
+            e = V::load(states + 4 * lanes),
+            f = V::load(states + 5 * lanes),
+            g = V::load(states + 6 * lanes),
+            h = V::load(states + 7 * lanes);
+
+        //The message schedule is kept as a rolling window of 16 words
+        reg W[16];
+
+        //Perform the main transformation
+        for (int t = 0; t < 80; t++)
+        {
+            if (t < 16)
+            {
+                W[t] = V::load(M[t]);
+            }
+            else
+            {
+                auto const w2  = W[(t -  2) & 15];
+                auto const w15 = W[(t - 15) & 15];
+
+                //sigma1(W[t - 2]) + W[t - 7] + sigma0(W[t - 15]) + W[t - 16]
+                auto const s1 = V::bitwise_xor
+                (
+                    V::bitwise_xor(V::template right_rotate<19>(w2), V::template right_rotate<61>(w2)),
+                    V::template right_shift<6>(w2)
+                );
+                auto const s0 = V::bitwise_xor
+                (
+                    V::bitwise_xor(V::template right_rotate<1>(w15), V::template right_rotate<8>(w15)),
+                    V::template right_shift<7>(w15)
+                );
+
+                W[t & 15] = V::add(V::add(s1, W[(t - 7) & 15]), V::add(s0, W[t & 15]));
+            }
+
+            //Sigma1(e) and Ch(e, f, g)
+            auto const S1 = V::bitwise_xor
+            (
+                V::bitwise_xor(V::template right_rotate<14>(e), V::template right_rotate<18>(e)),
+                V::template right_rotate<41>(e)
+            );
+            auto const ch = V::bitwise_xor(V::bitwise_and(e, f), V::bitwise_andnot(e, g));
+
+            //Sigma0(a) and Maj(a, b, c)
+            auto const S0 = V::bitwise_xor
+            (
+                V::bitwise_xor(V::template right_rotate<28>(a), V::template right_rotate<34>(a)),
+                V::template right_rotate<39>(a)
+            );
+            auto const maj = V::bitwise_or(V::bitwise_and(a, b), V::bitwise_and(c, V::bitwise_or(a, b)));
+
+            auto const T1 = V::add(V::add(V::add(h, S1), V::add(ch, V::set1(sha512_hash_constants[t]))), W[t & 15]);
+            auto const T2 = V::add(S0, maj);
+
+            h = g;
+            g = f;
+            f = e;
+            e = V::add(d, T1);
+            d = c;
+            c = b;
+            b = a;
+            a = V::add(T1, T2);
+        }
+
+        //Calculate the intermediate hash values
+        V::store(states + 0 * lanes, V::add(a, V::load(states + 0 * lanes)));
+        V::store(states + 1 * lanes, V::add(b, V::load(states + 1 * lanes)));
+        V::store(states + 2 * lanes, V::add(c, V::load(states + 2 * lanes)));
+        V::store(states + 3 * lanes, V::add(d, V::load(states + 3 * lanes)));
+        V::store(states + 4 * lanes, V::add(e, V::load(states + 4 * lanes)));
+        V::store(states + 5 * lanes, V::add(f, V::load(states + 5 * lanes)));
+        V::store(states + 6 * lanes, V::add(g, V::load(states + 6 * lanes)));
+        V::store(states + 7 * lanes, V::add(h, V::load(states + 7 * lanes)));
+    }
+};
+
+#endif
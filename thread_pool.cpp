@@ -0,0 +1,97 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+pm::thread_pool::thread_pool(std::size_t worker_count) noexcept
+{
+    try
+    {
+        this->workers.reserve(worker_count);
+
+        for (std::size_t i = 0; i < worker_count; i++)
+            this->workers.emplace_back([this]() noexcept { this->work(); });
+    }
+    catch (std::exception const&)
+    {
+        //Keep the workers that did start
+    }
+}
+
+pm::thread_pool::~thread_pool()
+{
+    //Tell the workers to leave
+    {
+        std::lock_guard<std::mutex> guard{ this->lock };
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+
+    for (auto& worker : this->workers) worker.join();
+}
+
+void pm::thread_pool::run(std::size_t count, task_fn task, void* ctx) noexcept
+{
+    if (count == 0) return;
+
+    std::lock_guard<std::mutex> run_guard{ this->run_lock };
+
+    //Publish the loop and wake the workers
+    {
+        std::lock_guard<std::mutex> guard{ this->lock };
+
+        this->task  = task;
+        this->ctx   = ctx;
+        this->count = count;
+        this->next.store(0);
+        this->busy  = this->workers.size();
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    //Help out
+    this->drain();
+
+    //Wait for the workers to run out of iterations
+    std::unique_lock<std::mutex> guard{ this->lock };
+    this->done.wait(guard, [this]() noexcept { return this->busy == 0; });
+}
+
+void pm::thread_pool::work() noexcept
+{
+    std::uint64_t seen = 0;
+
+    for (;;)
+    {
+        //Sleep until there is a new loop
+        {
+            std::unique_lock<std::mutex> guard{ this->lock };
+            this->wake.wait(guard, [&]() noexcept { return this->stopping || this->generation != seen; });
+
+            if (this->stopping) return;
+
+            seen = this->generation;
+        }
+
+        this->drain();
+
+        //Report back
+        std::lock_guard<std::mutex> guard{ this->lock };
+        if (--this->busy == 0) this->done.notify_one();
+    }
+}
+
+void pm::thread_pool::drain() noexcept
+{
+    //Claim iterations until there are none left
+    for (auto i = this->next.fetch_add(1); i < this->count; i = this->next.fetch_add(1))
+        this->task(this->ctx, i);
+}
+
+pm::thread_pool& pm::thread_pool::get_shared() noexcept
+{
+    //The calling thread counts as one of them
+    static thread_pool pool{ std::max(std::thread::hardware_concurrency(), 1u) - 1 };
+
+    return pool;
+}
@@ -0,0 +1,97 @@
+#ifndef PM_THREAD_POOL_H
+#define PM_THREAD_POOL_H
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * A fixed set of worker threads that split a loop between
+ * them. The calling thread takes part in the loop as well,
+ * so a pool without workers simply runs it in place.
+ */
+
+namespace pm
+{
+    struct thread_pool
+    {
+    public:
+        /*
+         * Starts the requested number of workers. If a thread
+         * cannot be started, the pool makes do with the ones
+         * it already has.
+         */
+        explicit thread_pool(std::size_t worker_count) noexcept;
+
+        thread_pool(thread_pool const&) = delete;
+        thread_pool& operator = (thread_pool const&) = delete;
+
+        ~thread_pool();
+
+        /*
+         * The number of threads a loop is spread across,
+         * including the calling thread.
+         */
+        std::size_t get_concurrency() const noexcept
+        {
+            return this->workers.size() + 1;
+        }
+
+        /*
+         * Calls task(i) for every i in [0, count) and waits for
+         * all of the calls to return. The calls are made from
+         * several threads at once, in no particular order. A
+         * task must not start another loop on the same pool.
+         */
+        template<typename F>
+        void parallel_for(std::size_t count, F&& task) noexcept
+        {
+            auto const invoke = [](void* ctx, std::size_t i) noexcept
+            {
+                (*static_cast<std::remove_reference_t<F>*>(ctx))(i);
+            };
+
+            this->run(count, invoke, const_cast<void*>(static_cast<void const*>(&task)));
+        }
+
+        /*
+         * Retrieves a pool with one thread per logical processor,
+         * shared by the whole program. It is created on first use.
+         */
+        static thread_pool& get_shared() noexcept;
+
+    private:
+        using task_fn = void(*)(void* ctx, std::size_t i) noexcept;
+
+        void run(std::size_t count, task_fn task, void* ctx) noexcept;
+        void work() noexcept;
+        void drain() noexcept;
+
+        std::vector<std::thread> workers;
+
+        //Serializes the loops started on this pool
+        std::mutex run_lock;
+
+        //Protects everything below
+        std::mutex              lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::uint64_t           generation = 0;
+        std::size_t             busy       = 0;
+        bool                    stopping   = false;
+
+        //The loop being run
+        task_fn                  task  = nullptr;
+        void*                    ctx   = nullptr;
+        std::size_t              count = 0;
+        std::atomic<std::size_t> next  = 0;
+    };
+};
+
+#endif